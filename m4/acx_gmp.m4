@@ -3,6 +3,8 @@
 AC_DEFUN([ACX_GMP],[
 	AC_CHECK_LIB(gmp, __gmpz_init, , 
 		[AC_MSG_ERROR([GNU MP not found, see http://gmplib.org/])])
+	AC_CHECK_LIB(gmp, __gmpz_limbs_read, [:],
+		[AC_MSG_ERROR([GNU MP 6.0 or newer is required, see http://gmplib.org/])])
 	
 	AC_CHECK_HEADERS([gmp.h])
 	AC_CHECK_HEADERS([gmpxx.h])
@@ -0,0 +1,8 @@
+# $Id$
+
+AC_DEFUN([ACX_PTHREAD],[
+	AC_CHECK_HEADER(pthread.h, , AC_MSG_ERROR([POSIX threads (pthread.h) not found]))
+	AC_SEARCH_LIBS(pthread_create, pthread, , AC_MSG_ERROR([POSIX threads library not found]))
+	CFLAGS="${CFLAGS} -pthread"
+	CXXFLAGS="${CXXFLAGS} -pthread"
+])
@@ -0,0 +1,697 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_bench.cpp
+
+ Benchmark for the issuing, proving and verifying operations
+ *****************************************************************************/
+
+#include "config.h"
+#include <gmpxx.h>
+#include "silvia_types.h"
+#include "silvia_parameters.h"
+#include "silvia_rand.h"
+#include "silvia_issuer.h"
+#include "silvia_issuer_keygen.h"
+#include "silvia_prover.h"
+#include "silvia_prover_credgen.h"
+#include "silvia_verifier.h"
+#include "silvia_thread_pool.h"
+#include "silvia_timer.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+// Default number of untimed warm-up runs of every operation
+#define DEFAULT_WARMUP		5
+
+// Default number of timed repetitions of every operation
+#define DEFAULT_REPS		50
+
+// Default number of timed key generations per modulus size
+#define DEFAULT_KEYGEN_REPS	3
+
+// Default sweeps
+#define DEFAULT_BITSIZES	"1024,2048,4096"
+#define DEFAULT_ATTRIBS		"2,5,10"
+#define DEFAULT_RATIOS		"0,0.5,1"
+
+void version(void)
+{
+	printf("The Simple Library for Verifying and Issuing Attributes (silvia)\n");
+	printf("\n");
+	printf("Benchmark utility version %s\n", VERSION);
+	printf("\n");
+	printf("Copyright (c) 2013 Roland van Rijswijk-Deij\n\n");
+	printf("Use, modification and redistribution of this software is subject to the terms\n");
+	printf("of the license agreement. This software is licensed under a 2-clause BSD-style\n");
+	printf("license a copy of which is included as the file LICENSE in the distribution.\n");
+}
+
+void usage(void)
+{
+	printf("Silvia benchmark utility %s\n\n", VERSION);
+	printf("Usage:\n");
+	printf("\tsilvia_bench [-n <bits>] [-a <#-attribs>] [-d <ratios>] [-w <warm-up>] [-r <reps>] [-k <reps>] [-o <file>]\n");
+	printf("\tsilvia_bench -h\n");
+	printf("\tsilvia_bench -v\n");
+	printf("\n");
+	printf("\t-n <bits>      Comma separated modulus sizes to benchmark; supported sizes\n");
+	printf("\t               are 1024, 2048 and 4096 (defaults to %s)\n", DEFAULT_BITSIZES);
+	printf("\t-a <#-attribs> Comma separated numbers of attributes per credential\n");
+	printf("\t               (defaults to %s)\n", DEFAULT_ATTRIBS);
+	printf("\t-d <ratios>    Comma separated fractions of the attributes to disclose\n");
+	printf("\t               in proofs (defaults to %s)\n", DEFAULT_RATIOS);
+	printf("\t-w <warm-up>   Run every operation <warm-up> times before timing it\n");
+	printf("\t               (defaults to %d)\n", DEFAULT_WARMUP);
+	printf("\t-r <reps>      Time every operation <reps> times (defaults to %d)\n", DEFAULT_REPS);
+	printf("\t-k <reps>      Time key generation <reps> times per modulus size; with 0,\n");
+	printf("\t               one key-pair is generated but not reported (defaults to %d)\n", DEFAULT_KEYGEN_REPS);
+	printf("\t-o <file>      Write the JSON report to <file> (defaults to stdout)\n");
+	printf("\n");
+	printf("\t-h             Print this help message\n");
+	printf("\n");
+	printf("\t-v             Print the version number\n");
+}
+
+/**
+ * Set the system parameters for a modulus size; the parameters for
+ * 1024 bits are the ones used by IRMA cards, the larger sizes scale
+ * l_e and l_v with the modulus
+ */
+bool set_parameters(unsigned long l_n)
+{
+	silvia_system_parameters::i()->reset();
+	
+	silvia_system_parameters::i()->set_l_m(256);
+	silvia_system_parameters::i()->set_l_statzk(80);
+	silvia_system_parameters::i()->set_l_H(256);
+	silvia_system_parameters::i()->set_l_e_prime(120);
+	silvia_system_parameters::i()->set_hash_type("sha256");
+	
+	switch(l_n)
+	{
+	case 1024:
+		silvia_system_parameters::i()->set_l_n(1024);
+		silvia_system_parameters::i()->set_l_e(597);
+		silvia_system_parameters::i()->set_l_v(1700);
+		return true;
+	case 2048:
+		silvia_system_parameters::i()->set_l_n(2048);
+		silvia_system_parameters::i()->set_l_e(645);
+		silvia_system_parameters::i()->set_l_v(2724);
+		return true;
+	case 4096:
+		silvia_system_parameters::i()->set_l_n(4096);
+		silvia_system_parameters::i()->set_l_e(901);
+		silvia_system_parameters::i()->set_l_v(4772);
+		return true;
+	}
+	
+	return false;
+}
+
+/**
+ * Timing samples of one operation
+ */
+class bench_result
+{
+public:
+	bench_result(const std::string& operation, unsigned long l_n, unsigned long attribs, long disclosed)
+	{
+		this->operation = operation;
+		this->l_n = l_n;
+		this->attribs = attribs;
+		this->disclosed = disclosed;
+	}
+	
+	// Write the statistics of the samples as a JSON object
+	void write_json(FILE* out)
+	{
+		std::vector<unsigned long long> sorted = samples;
+		unsigned long long total = 0;
+		
+		std::sort(sorted.begin(), sorted.end());
+		
+		for (std::vector<unsigned long long>::iterator i = sorted.begin(); i != sorted.end(); i++)
+		{
+			total += *i;
+		}
+		
+		size_t n = sorted.size();
+		
+		// The 99th percentile uses the nearest rank
+		double median = (n % 2 == 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+		double p99 = sorted[(n * 99 + 99) / 100 - 1];
+		double mean = (double) total / n;
+		
+		fprintf(out, "\t\t{ \"operation\": \"%s\", \"l_n\": %lu, \"attributes\": %lu, ", operation.c_str(), l_n, attribs);
+		
+		if (disclosed >= 0)
+		{
+			fprintf(out, "\"disclosed\": %ld, ", disclosed);
+		}
+		
+		fprintf(out, "\"samples\": %lu, \"min_us\": %.1f, \"median_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, \"mean_us\": %.1f, \"ops_per_sec\": %.2f }",
+			(unsigned long) n,
+			sorted.front() / 1000.0,
+			median / 1000.0,
+			p99 / 1000.0,
+			sorted.back() / 1000.0,
+			mean / 1000.0,
+			1000000000.0 / mean);
+	}
+	
+	std::string operation;
+	unsigned long l_n;
+	unsigned long attribs;
+	long disclosed;
+	std::vector<unsigned long long> samples;
+};
+
+/**
+ * Parse a comma separated list of numbers
+ */
+bool parse_list(const char* arg, std::vector<double>& values)
+{
+	values.clear();
+	
+	const char* p = arg;
+	
+	while (*p != '\0')
+	{
+		char* end = NULL;
+		
+		values.push_back(strtod(p, &end));
+		
+		if ((end == p) || ((*end != ',') && (*end != '\0')))
+		{
+			return false;
+		}
+		
+		p = (*end == ',') ? end + 1 : end;
+	}
+	
+	return !values.empty();
+}
+
+/**
+ * Issue a credential; the time taken by the issuer and prover operations
+ * is added to the results if they are not NULL
+ */
+silvia_credential* issue_credential(silvia_pub_key* pubkey,
+		silvia_priv_key* privkey,
+		std::vector<silvia_attribute*>& attributes,
+		bench_result* compute_commitment,
+		bench_result* prove_commitment,
+		bench_result* compute_signature,
+		bench_result* prove_signature)
+{
+	silvia_timer timer;
+	mpz_class context = silvia_rng::i()->get_random(SYSPAR(l_H));
+	
+	silvia_issuer issuer(pubkey, privkey);
+	silvia_credential_generator credgen(pubkey);
+	
+	credgen.new_secret();
+	credgen.set_attributes(attributes);
+	
+	mpz_class U;
+	mpz_class v_prime;
+	
+	timer.mark();
+	credgen.compute_commitment(U, v_prime);
+	if (compute_commitment != NULL) compute_commitment->samples.push_back(timer.elapsed());
+	
+	issuer.set_attributes(attributes);
+	
+	mpz_class n1 = issuer.get_issuer_nonce();
+	
+	mpz_class c_commit;
+	mpz_class v_prime_hat;
+	mpz_class s_hat;
+	
+	timer.mark();
+	credgen.prove_commitment(n1, context, c_commit, v_prime_hat, s_hat);
+	if (prove_commitment != NULL) prove_commitment->samples.push_back(timer.elapsed());
+	
+	if (!issuer.submit_and_verify_commitment(context, U, c_commit, v_prime_hat, s_hat))
+	{
+		fprintf(stderr, "Failed to verify the proof of the commitment\n");
+		
+		return NULL;
+	}
+	
+	mpz_class A;
+	mpz_class e;
+	mpz_class v_prime_prime;
+	
+	timer.mark();
+	issuer.compute_signature(A, e, v_prime_prime);
+	if (compute_signature != NULL) compute_signature->samples.push_back(timer.elapsed());
+	
+	mpz_class n2 = credgen.get_prover_nonce();
+	
+	mpz_class c_signature;
+	mpz_class e_hat;
+	
+	timer.mark();
+	issuer.prove_signature(n2, context, c_signature, e_hat);
+	if (prove_signature != NULL) prove_signature->samples.push_back(timer.elapsed());
+	
+	if (!credgen.verify_signature(context, A, e, c_signature, e_hat))
+	{
+		fprintf(stderr, "Failed to verify the proof of the signature\n");
+		
+		return NULL;
+	}
+	
+	credgen.compute_credential(A, e, v_prime_prime);
+	
+	if (!credgen.verify_credential())
+	{
+		fprintf(stderr, "Failed to verify the credential\n");
+		
+		return NULL;
+	}
+	
+	return credgen.get_credential();
+}
+
+/**
+ * Generate <reps> proofs disclosing <disclosed> of the attributes of the
+ * credential and verify them; the proofs of the first <warmup> runs are
+ * not timed
+ */
+bool bench_prove_verify(silvia_pub_key* pubkey,
+		silvia_credential* credential,
+		size_t attribs,
+		size_t disclosed,
+		size_t warmup,
+		size_t reps,
+		bench_result& prove_result,
+		bench_result& verify_result)
+{
+	silvia_timer timer;
+	mpz_class context = silvia_rng::i()->get_random(SYSPAR(l_H));
+	
+	silvia_prover prover(pubkey, credential);
+	silvia_verifier verifier(pubkey);
+	
+	std::vector<bool> D(attribs, false);
+	
+	for (size_t i = 0; i < disclosed; i++)
+	{
+		D[i] = true;
+	}
+	
+	for (size_t i = 0; i < warmup + reps; i++)
+	{
+		mpz_class n1 = verifier.get_verifier_nonce();
+		mpz_class c;
+		mpz_class A_prime;
+		mpz_class e_hat;
+		mpz_class v_prime_hat;
+		std::vector<mpz_class> a_i_hat;
+		std::vector<silvia_attribute*> a_i;
+		
+		timer.mark();
+		prover.prove(D, n1, context, c, A_prime, e_hat, v_prime_hat, a_i_hat, a_i);
+		if (i >= warmup) prove_result.samples.push_back(timer.elapsed());
+		
+		timer.mark();
+		bool verified = verifier.verify(D, context, c, A_prime, e_hat, v_prime_hat, a_i_hat, a_i);
+		if (i >= warmup) verify_result.samples.push_back(timer.elapsed());
+		
+		if (!verified)
+		{
+			fprintf(stderr, "Failed to verify a proof\n");
+			
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+/**
+ * Run the benchmarks for one modulus size
+ */
+bool bench_modulus(unsigned long l_n,
+		const std::vector<double>& attribs,
+		const std::vector<double>& ratios,
+		size_t warmup,
+		size_t reps,
+		size_t keygen_reps,
+		std::vector<bench_result*>& results)
+{
+	if (!set_parameters(l_n))
+	{
+		fprintf(stderr, "Unsupported modulus size %lu\n", l_n);
+		
+		return false;
+	}
+	
+	// The key-pair is shared by all attribute counts
+	unsigned long max_attribs = (unsigned long) *std::max_element(attribs.begin(), attribs.end());
+	
+	silvia_pub_key* pubkey = NULL;
+	silvia_priv_key* privkey = NULL;
+	
+	bench_result* keygen_result = new bench_result("keygen", l_n, max_attribs, -1);
+	silvia_timer timer;
+	
+	fprintf(stderr, "Generating %lu-bit key-pairs for %lu attributes ... ", l_n, max_attribs); fflush(stderr);
+	
+	for (size_t i = 0; (i < keygen_reps) || (pubkey == NULL); i++)
+	{
+		silvia_pub_key* new_pubkey;
+		silvia_priv_key* new_privkey;
+		
+		timer.mark();
+		silvia_issuer_keyfactory::i()->generate_keypair(max_attribs + 1, &new_pubkey, &new_privkey);
+		if (i < keygen_reps) keygen_result->samples.push_back(timer.elapsed());
+		
+		if (pubkey == NULL)
+		{
+			pubkey = new_pubkey;
+			privkey = new_privkey;
+		}
+		else
+		{
+			delete new_pubkey;
+			delete new_privkey;
+		}
+	}
+	
+	fprintf(stderr, "OK\n");
+	
+	if (keygen_reps > 0)
+	{
+		results.push_back(keygen_result);
+	}
+	else
+	{
+		delete keygen_result;
+	}
+	
+	// Build the tables of the public key before timing anything
+	pubkey->precompute();
+	
+	bool rv = true;
+	
+	for (std::vector<double>::const_iterator a = attribs.begin(); rv && (a != attribs.end()); a++)
+	{
+		unsigned long num_attribs = (unsigned long) *a;
+		
+		std::vector<silvia_attribute*> attributes;
+		
+		for (unsigned long i = 0; i < num_attribs; i++)
+		{
+			attributes.push_back(new silvia_integer_attribute((int) i + 1));
+		}
+		
+		fprintf(stderr, "Benchmarking issuance (%lu bits, %lu attributes) ... ", l_n, num_attribs); fflush(stderr);
+		
+		bench_result* compute_commitment = new bench_result("compute_commitment", l_n, num_attribs, -1);
+		bench_result* prove_commitment = new bench_result("prove_commitment", l_n, num_attribs, -1);
+		bench_result* compute_signature = new bench_result("compute_signature", l_n, num_attribs, -1);
+		bench_result* prove_signature = new bench_result("prove_signature", l_n, num_attribs, -1);
+		
+		results.push_back(compute_commitment);
+		results.push_back(prove_commitment);
+		results.push_back(compute_signature);
+		results.push_back(prove_signature);
+		
+		silvia_credential* credential = NULL;
+		
+		for (size_t i = 0; i < warmup + reps; i++)
+		{
+			bool timed = (i >= warmup);
+			
+			silvia_credential* new_credential = issue_credential(pubkey, privkey, attributes,
+				timed ? compute_commitment : NULL,
+				timed ? prove_commitment : NULL,
+				timed ? compute_signature : NULL,
+				timed ? prove_signature : NULL);
+			
+			if (new_credential == NULL)
+			{
+				rv = false;
+				
+				break;
+			}
+			
+			delete credential;
+			credential = new_credential;
+		}
+		
+		if (rv)
+		{
+			fprintf(stderr, "OK\n");
+		}
+		
+		for (std::vector<double>::const_iterator r = ratios.begin(); rv && (r != ratios.end()); r++)
+		{
+			size_t disclosed = (size_t) (*r * num_attribs + 0.5);
+			
+			fprintf(stderr, "Benchmarking proofs (%lu bits, %lu attributes, %lu disclosed) ... ", l_n, num_attribs, (unsigned long) disclosed); fflush(stderr);
+			
+			bench_result* prove_result = new bench_result("prove", l_n, num_attribs, disclosed);
+			bench_result* verify_result = new bench_result("verify", l_n, num_attribs, disclosed);
+			
+			results.push_back(prove_result);
+			results.push_back(verify_result);
+			
+			rv = bench_prove_verify(pubkey, credential, num_attribs, disclosed, warmup, reps, *prove_result, *verify_result);
+			
+			if (rv)
+			{
+				fprintf(stderr, "OK\n");
+			}
+		}
+		
+		delete credential;
+		
+		for (std::vector<silvia_attribute*>::iterator i = attributes.begin(); i != attributes.end(); i++)
+		{
+			delete *i;
+		}
+	}
+	
+	delete pubkey;
+	delete privkey;
+	
+	return rv;
+}
+
+/**
+ * Write the report
+ */
+void write_report(FILE* out,
+		const std::vector<double>& bitsizes,
+		const std::vector<double>& attribs,
+		const std::vector<double>& ratios,
+		size_t warmup,
+		size_t reps,
+		size_t keygen_reps,
+		std::vector<bench_result*>& results)
+{
+	fprintf(out, "{\n");
+	fprintf(out, "\t\"version\": \"%s\",\n", VERSION);
+	fprintf(out, "\t\"timestamp\": %lu,\n", (unsigned long) time(NULL));
+	fprintf(out, "\t\"cpus\": %lu,\n", (unsigned long) silvia_thread_pool::num_cpus());
+	fprintf(out, "\t\"config\": {\n");
+	
+	fprintf(out, "\t\t\"l_n\": [");
+	for (size_t i = 0; i < bitsizes.size(); i++) fprintf(out, "%s%lu", (i > 0) ? ", " : "", (unsigned long) bitsizes[i]);
+	fprintf(out, "],\n");
+	
+	fprintf(out, "\t\t\"attributes\": [");
+	for (size_t i = 0; i < attribs.size(); i++) fprintf(out, "%s%lu", (i > 0) ? ", " : "", (unsigned long) attribs[i]);
+	fprintf(out, "],\n");
+	
+	fprintf(out, "\t\t\"disclosure_ratios\": [");
+	for (size_t i = 0; i < ratios.size(); i++) fprintf(out, "%s%g", (i > 0) ? ", " : "", ratios[i]);
+	fprintf(out, "],\n");
+	
+	fprintf(out, "\t\t\"warmup\": %lu,\n", (unsigned long) warmup);
+	fprintf(out, "\t\t\"repetitions\": %lu,\n", (unsigned long) reps);
+	fprintf(out, "\t\t\"keygen_repetitions\": %lu\n", (unsigned long) keygen_reps);
+	fprintf(out, "\t},\n");
+	fprintf(out, "\t\"results\": [\n");
+	
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		results[i]->write_json(out);
+		
+		fprintf(out, "%s\n", (i + 1 < results.size()) ? "," : "");
+	}
+	
+	fprintf(out, "\t]\n");
+	fprintf(out, "}\n");
+}
+
+int main(int argc, char* argv[])
+{
+	// Program parameters
+	std::vector<double> bitsizes;
+	std::vector<double> attribs;
+	std::vector<double> ratios;
+	size_t warmup = DEFAULT_WARMUP;
+	size_t reps = DEFAULT_REPS;
+	size_t keygen_reps = DEFAULT_KEYGEN_REPS;
+	std::string report_filename;
+	int c = 0;
+	
+	parse_list(DEFAULT_BITSIZES, bitsizes);
+	parse_list(DEFAULT_ATTRIBS, attribs);
+	parse_list(DEFAULT_RATIOS, ratios);
+	
+	while ((c = getopt(argc, argv, "n:a:d:w:r:k:o:hv")) != -1)
+	{
+		switch (c)
+		{
+		case 'h':
+			usage();
+			return 0;
+		case 'v':
+			version();
+			return 0;
+		case 'n':
+			if (!parse_list(optarg, bitsizes))
+			{
+				fprintf(stderr, "Invalid list of modulus sizes %s\n", optarg);
+				
+				return -1;
+			}
+			break;
+		case 'a':
+			if (!parse_list(optarg, attribs))
+			{
+				fprintf(stderr, "Invalid list of attribute counts %s\n", optarg);
+				
+				return -1;
+			}
+			break;
+		case 'd':
+			if (!parse_list(optarg, ratios))
+			{
+				fprintf(stderr, "Invalid list of disclosure ratios %s\n", optarg);
+				
+				return -1;
+			}
+			break;
+		case 'w':
+			warmup = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			reps = strtoul(optarg, NULL, 10);
+			break;
+		case 'k':
+			keygen_reps = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			report_filename = std::string(optarg);
+			break;
+		}
+	}
+	
+	if (reps == 0)
+	{
+		fprintf(stderr, "At least one repetition is required\n");
+		
+		return -1;
+	}
+	
+	for (std::vector<double>::iterator i = attribs.begin(); i != attribs.end(); i++)
+	{
+		if ((*i < 1) || (*i != (unsigned long) *i))
+		{
+			fprintf(stderr, "Invalid number of attributes %g\n", *i);
+			
+			return -1;
+		}
+	}
+	
+	for (std::vector<double>::iterator i = ratios.begin(); i != ratios.end(); i++)
+	{
+		if ((*i < 0) || (*i > 1))
+		{
+			fprintf(stderr, "Invalid disclosure ratio %g; must be between 0 and 1\n", *i);
+			
+			return -1;
+		}
+	}
+	
+	FILE* report_file = stdout;
+	
+	if (!report_filename.empty())
+	{
+		report_file = fopen(report_filename.c_str(), "w");
+		
+		if (report_file == NULL)
+		{
+			fprintf(stderr, "Failed to open %s for writing\n", report_filename.c_str());
+			
+			return -1;
+		}
+	}
+	
+	std::vector<bench_result*> results;
+	int rv = 0;
+	
+	for (std::vector<double>::iterator i = bitsizes.begin(); i != bitsizes.end(); i++)
+	{
+		if (!bench_modulus((unsigned long) *i, attribs, ratios, warmup, reps, keygen_reps, results))
+		{
+			rv = -1;
+			
+			break;
+		}
+	}
+	
+	if (rv == 0)
+	{
+		write_report(report_file, bitsizes, attribs, ratios, warmup, reps, keygen_reps, results);
+	}
+	
+	for (std::vector<bench_result*>::iterator i = results.begin(); i != results.end(); i++)
+	{
+		delete *i;
+	}
+	
+	if (!report_filename.empty()) fclose(report_file);
+	
+	return rv;
+}
@@ -0,0 +1,242 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_compile.cpp
+
+ Compiles issuer keys and specifications from XML into a binary cache
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_cache.h"
+#include "silvia_idemix_xmlreader.h"
+#include "silvia_irma_xmlreader.h"
+#include "silvia_parameters.h"
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void set_parameters()
+{
+	////////////////////////////////////////////////////////////////////
+	// Set the system parameters in the IRMA library; this function must
+	// be updated if we ever change the parameters for IRMA cards!!!
+	////////////////////////////////////////////////////////////////////
+	
+	silvia_system_parameters::i()->set_l_n(1024);
+	silvia_system_parameters::i()->set_l_m(256);
+	silvia_system_parameters::i()->set_l_statzk(80);
+	silvia_system_parameters::i()->set_l_H(256);
+	silvia_system_parameters::i()->set_l_v(1700);
+	silvia_system_parameters::i()->set_l_e(597);
+	silvia_system_parameters::i()->set_l_e_prime(120);
+	silvia_system_parameters::i()->set_hash_type("sha256");
+}
+
+void version(void)
+{
+	printf("The Simple Library for Verifying and Issuing Attributes (silvia)\n");
+	printf("\n");
+	printf("Key and specification compiler version %s\n", VERSION);
+	printf("\n");
+	printf("Copyright (c) 2013 Roland van Rijswijk-Deij\n\n");
+	printf("Use, modification and redistribution of this software is subject to the terms\n");
+	printf("of the license agreement. This software is licensed under a 2-clause BSD-style\n");
+	printf("license a copy of which is included as the file LICENSE in the distribution.\n");
+}
+
+void usage(void)
+{
+	printf("Silvia key and specification compiler %s\n\n", VERSION);
+	printf("Usage:\n");
+	printf("\tsilvia_compile -o <cache> -k <issuer-pubkey> [-t] [-s <issuer-privkey>] [-I <issuer-spec> -V <verifier-spec>] [-i <issue-spec>]\n");
+	printf("\tsilvia_compile -h\n");
+	printf("\tsilvia_compile -v\n");
+	printf("\n");
+	printf("\t-o <cache>          Write the compiled cache to <cache>\n");
+	printf("\t-k <issuer-pubkey>  Read issuer public key from <issuer-pubkey>\n");
+	printf("\t-t                  Also store the precomputed tables of the public key\n");
+	printf("\t-s <issuer-privkey> Read issuer private key from <issuer-privkey>\n");
+	printf("\t-I <issuer-spec>    Read issuer specification from <issuer-spec>\n");
+	printf("\t-V <verifier-spec>  Read verifier specification from <verifier-spec>\n");
+	printf("\t-i <issue-spec>     Read credential issue specification from <issue-spec>\n");
+	printf("\n");
+	printf("\t-h                  Print this help message\n");
+	printf("\n");
+	printf("\t-v                  Print the version number\n");
+}
+
+int main(int argc, char* argv[])
+{
+	// Set library parameters
+	set_parameters();
+	
+	// Program parameters
+	std::string cache_file;
+	std::string issuer_pubkey;
+	std::string issuer_privkey;
+	std::string issuer_spec;
+	std::string verifier_spec;
+	std::string issue_spec;
+	bool tables = false;
+	int c = 0;
+	
+	while ((c = getopt(argc, argv, "o:k:s:I:V:i:thv")) != -1)
+	{
+		switch (c)
+		{
+		case 'h':
+			usage();
+			return 0;
+		case 'v':
+			version();
+			return 0;
+		case 'o':
+			cache_file = std::string(optarg);
+			break;
+		case 'k':
+			issuer_pubkey = std::string(optarg);
+			break;
+		case 's':
+			issuer_privkey = std::string(optarg);
+			break;
+		case 'I':
+			issuer_spec = std::string(optarg);
+			break;
+		case 'V':
+			verifier_spec = std::string(optarg);
+			break;
+		case 'i':
+			issue_spec = std::string(optarg);
+			break;
+		case 't':
+			tables = true;
+			break;
+		}
+	}
+	
+	if (cache_file.empty())
+	{
+		fprintf(stderr, "No output file specified!\n");
+		
+		return -1;
+	}
+	
+	if (issuer_pubkey.empty())
+	{
+		fprintf(stderr, "No issuer public key file specified!\n");
+		
+		return -1;
+	}
+	
+	if (issuer_spec.empty() != verifier_spec.empty())
+	{
+		fprintf(stderr, "A verifier specification needs both an issuer and a verifier specification file!\n");
+		
+		return -1;
+	}
+	
+	silvia_cache_writer writer;
+	
+	// Compile the public key
+	silvia_pub_key* pubkey = silvia_idemix_xmlreader::i()->read_idemix_pubkey(issuer_pubkey);
+	
+	if (pubkey == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer public key\n");
+		
+		return -1;
+	}
+	
+	writer.add_pubkey(pubkey, tables);
+	
+	delete pubkey;
+	
+	// Compile the private key
+	if (!issuer_privkey.empty())
+	{
+		silvia_priv_key* privkey = silvia_idemix_xmlreader::i()->read_idemix_privkey(issuer_privkey);
+		
+		if (privkey == NULL)
+		{
+			fprintf(stderr, "Failed to read issuer private key\n");
+			
+			return -1;
+		}
+		
+		writer.add_privkey(privkey);
+		
+		delete privkey;
+	}
+	
+	// Compile the verifier specification
+	if (!verifier_spec.empty())
+	{
+		silvia_verifier_specification* vspec = silvia_irma_xmlreader::i()->read_verifier_spec(issuer_spec, verifier_spec);
+		
+		if (vspec == NULL)
+		{
+			fprintf(stderr, "Failed to read issuer and verifier specification\n");
+			
+			return -1;
+		}
+		
+		writer.add_verifier_spec(vspec);
+		
+		delete vspec;
+	}
+	
+	// Compile the issue specification
+	if (!issue_spec.empty())
+	{
+		silvia_issue_specification* ispec = silvia_irma_xmlreader::i()->read_issue_spec(issue_spec);
+		
+		if (ispec == NULL)
+		{
+			fprintf(stderr, "Failed to read credential issue specification\n");
+			
+			return -1;
+		}
+		
+		writer.add_issue_spec(ispec);
+		
+		delete ispec;
+	}
+	
+	if (!writer.write(cache_file))
+	{
+		fprintf(stderr, "Failed to write %s\n", cache_file.c_str());
+		
+		return -1;
+	}
+	
+	printf("Wrote %s\n", cache_file.c_str());
+	
+	return 0;
+}
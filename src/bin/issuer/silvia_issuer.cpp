@@ -42,17 +42,25 @@
 #include "silvia_nfc_card.h"
 #endif // WITH_NFC
 #include "silvia_stdio_card.h"
+#include "silvia_stdio_server.h"
 #include "silvia_card_channel.h"
+#include "silvia_apdu.h"
 #include "silvia_irma_xmlreader.h"
 #include "silvia_idemix_xmlreader.h"
+#include "silvia_cache.h"
 #include "silvia_types.h"
 #include "silvia_issuescript.h"
+#include "silvia_prime_pool.h"
+#include "silvia_thread_pool.h"
+#include "silvia_irma_batch_issuer.h"
+#include "silvia_timer.h"
 #include <string>
 #include <iostream>
 #include <unistd.h>
 #include <stdio.h>
 #include <time.h>
 #include <signal.h>
+#include <pthread.h>
 
 static bool debug_output = false;
 
@@ -63,6 +71,40 @@ const char* weekday[7] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday
 const char* month[12] = { "January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December" };
 
 bool parseable_output = false;
+bool binary_framing = false;
+
+// Compiled cache to read the specification and keys from instead of XML
+silvia_cache* cache = NULL;
+
+silvia_issue_specification* read_issue_spec(std::string issue_spec)
+{
+	if (cache != NULL)
+	{
+		return cache->get_issue_spec();
+	}
+	
+	return silvia_irma_xmlreader::i()->read_issue_spec(issue_spec);
+}
+
+silvia_pub_key* read_pubkey(std::string issuer_pubkey)
+{
+	if (cache != NULL)
+	{
+		return cache->get_pubkey();
+	}
+	
+	return silvia_idemix_xmlreader::i()->read_idemix_pubkey(issuer_pubkey);
+}
+
+silvia_priv_key* read_privkey(std::string issuer_privkey)
+{
+	if (cache != NULL)
+	{
+		return cache->get_privkey();
+	}
+	
+	return silvia_idemix_xmlreader::i()->read_idemix_privkey(issuer_privkey);
+}
 
 void signal_handler(int signal)
 {
@@ -120,21 +162,29 @@ void usage(void)
 {
 	printf("Silvia command-line IRMA issuer %s\n\n", VERSION);
 	printf("Usage:\n");
-	printf("\tsilvia_issuer -I <issue-spec> -k <issuer-pubkey> -s <issuer-privkey> [-d] [-S]");
+	printf("\tsilvia_issuer {-I <issue-spec> -k <issuer-pubkey> -s <issuer-privkey> | -C <cache>} [-d] [-S]");
 #if defined(WITH_PCSC)
 	printf(" [-P]");
 #endif // WITH_PCSC
 #if defined(WITH_NFC)
     printf(" [-N");
 #endif // WITH_NFC
+#ifdef HAVE_SYS_EPOLL_H
+	printf(" [-L <address>]");
+#endif // HAVE_SYS_EPOLL_H
+	printf("\n");
+	printf("\tsilvia_issuer -i <issue-script> [-d]");
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	printf(" [-M]");
+#endif // WITH_PCSC || WITH_NFC
 	printf("\n");
-	printf("\tsilvia_issuer -i <issue-script> [-d]\n");
 	printf("\tsilvia_issuer -h\n");
 	printf("\tsilvia_issuer -v\n");
 	printf("\n");
 	printf("\t-I <issue-spec>     Read issue specification from <issue-spec>\n");
 	printf("\t-k <issuer-pubkey>  Read issuer public key from <issuer-pubkey>\n");
 	printf("\t-s <issuer-privkey> Read issuer private key from <issuer-privkey>\n");
+	printf("\t-C <cache>          Read issue specification and keys from the compiled <cache>\n");
 	printf("\t-d                  Print debug output\n");
 #if defined(WITH_PCSC)
 	printf("\t-P                  Use PC/SC for card communication (default)\n");
@@ -143,9 +193,18 @@ void usage(void)
 	printf("\t-N                  Use NFC for card communication\n");
 #endif // WITH_NFC
     printf("\t-S                 Use StdIO for card communication (changes output to parseable format)\n");
+	printf("\t-B                  Offer binary framing to the StdIO peer\n");
+#ifdef HAVE_SYS_EPOLL_H
+	printf("\t-L <address>        Serve the StdIO protocol to many clients concurrently on\n");
+	printf("\t                    <address> (unix:<path>, tcp:<port> or tcp:<host>:<port>)\n");
+#endif // HAVE_SYS_EPOLL_H
 	printf("\n");
 	printf("\t-i <issue-script>   Issue multiple credentials according to the\n");
 	printf("\t                    specified issuing script <issue-script>\n");
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	printf("\t-M                  Monitor all attached readers and run the issuing script\n");
+	printf("\t                    on all of them concurrently (no PIN entry)\n");
+#endif // WITH_PCSC || WITH_NFC
 	printf("\t-d                  Print debug output\n");
 	printf("\n");
 	printf("\t-h                  Print this help message\n");
@@ -228,22 +287,10 @@ bool verify_pin(silvia_card_channel* card)
         printf("Verifying PIN... "); fflush(stdout);
     }
 
-    bytestring verify_pin_apdu = "0020000008";
-
-    for (std::string::iterator i = PIN.begin(); i != PIN.end(); i++)
-    {
-        verify_pin_apdu += (unsigned char) *i;
-    }
-
-    while (verify_pin_apdu.size() < 13)
-    {
-        verify_pin_apdu += "00";
-    }
-
     bytestring data;
     unsigned short sw;
 
-    if (!card->transmit(verify_pin_apdu, data, sw))
+    if (!card->transmit(silvia_apdu::verify_pin(PIN), data, sw))
     {
         if(!parseable_output)
         {
@@ -326,23 +373,23 @@ bool communicate_with_card(silvia_card_channel* card, std::vector<bytestring>& c
     }
 		
 	bool comm_ok = true;
-	size_t cmd_ctr = 0;
 	
-	for (std::vector<bytestring>::iterator i = commands.begin(); (i != commands.end()) && comm_ok; i++)
-	{	
-		bytestring result;
-		
-		DEBUG_MSG("--> %s\n", i->hex_str().c_str());
-		
-		if (!card->transmit(*i, result))
-		{
-			comm_ok = false;
-			break;
-		}
-		
-		DEBUG_MSG("<-- %s\n", result.hex_str().c_str());
+	// Send all commands in one batch; the batch stops at the first
+	// command that does not return 9000
+	std::vector<bytestring> batch_results;
+	std::vector<unsigned long long> timings;
+	
+	if (!card->transmit_batch(commands, batch_results, &timings))
+	{
+		comm_ok = false;
+	}
+	
+	for (size_t i = 0; (i < batch_results.size()) && comm_ok; i++)
+	{
+		bytestring& result = batch_results[i];
 		
-		cmd_ctr++;
+		DEBUG_MSG("--> %s\n", commands[i].hex_str().c_str());
+		DEBUG_MSG("<-- %s (%0.1fms)\n", result.hex_str().c_str(), (float) timings[i] / 1000000.0f);
 		
 		if (result.substr(result.size() - 2) != "9000")
 		{
@@ -397,7 +444,7 @@ bool issue_one_credential(silvia_card_channel* card, std::string issue_spec, std
 	bool rv = true;
 
 	// Read configuration files
-	silvia_issue_specification* ispec = silvia_irma_xmlreader::i()->read_issue_spec(issue_spec);
+	silvia_issue_specification* ispec = read_issue_spec(issue_spec);
 	
 	if (ispec == NULL)
 	{
@@ -413,7 +460,7 @@ bool issue_one_credential(silvia_card_channel* card, std::string issue_spec, std
 		return false;
 	}
 	
-	silvia_pub_key* pubkey = silvia_idemix_xmlreader::i()->read_idemix_pubkey(issuer_pubkey);
+	silvia_pub_key* pubkey = read_pubkey(issuer_pubkey);
 	
 	if (pubkey == NULL)
 	{
@@ -431,7 +478,7 @@ bool issue_one_credential(silvia_card_channel* card, std::string issue_spec, std
 		return false;
 	}
 	
-	silvia_priv_key* privkey = silvia_idemix_xmlreader::i()->read_idemix_privkey(issuer_privkey);
+	silvia_priv_key* privkey = read_privkey(issuer_privkey);
 	
 	if (privkey == NULL)
 	{
@@ -684,7 +731,7 @@ void do_issue(int channel_type, std::string issue_spec, std::string issuer_pubke
     if (channel_type == SILVIA_CHANNEL_STDIO)
     {
         silvia_stdio_card* stdio_card = NULL;
-        stdio_card = new silvia_stdio_card();
+        stdio_card = new silvia_stdio_card(binary_framing);
 
         card = stdio_card;
     }
@@ -777,7 +824,7 @@ void execute_issue_script(int channel_type, std::string issue_script)
 	if (channel_type == SILVIA_CHANNEL_STDIO)
 	{
 		silvia_stdio_card* stdio_card = NULL;
-		stdio_card = new silvia_stdio_card();
+		stdio_card = new silvia_stdio_card(binary_framing);
 
 		card = stdio_card;
 	}
@@ -825,7 +872,499 @@ void execute_issue_script(int channel_type, std::string issue_script)
 	}
 	delete card;
 }
+
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+
+////////////////////////////////////////////////////////////////////////
+// Multi-reader mode
+////////////////////////////////////////////////////////////////////////
+
+// State shared by all reader threads
+struct multi_reader_state
+{
+	silvia_irma_batch_issuer* batch;
+	std::string PIN;
+	pthread_mutex_t output_lock;
+	
+	// Aggregate statistics
+	silvia_timer timer;
+	unsigned long cards_ok;
+	unsigned long cards_failed;
+	unsigned long credentials;
+};
+
+// A reader that is monitored by its own thread
+struct reader_thread
+{
+	multi_reader_state* state;
+	int channel_type;
+	std::string reader_id;
+	std::string reader_name;
+	pthread_t thread;
+};
+
+// Print the result for a card and the totals so far
+void reader_output(reader_thread* reader, const std::string& line, bool ok, size_t issued)
+{
+	multi_reader_state* state = reader->state;
+	
+	pthread_mutex_lock(&state->output_lock);
+	
+	if (ok)
+	{
+		state->cards_ok++;
+	}
+	else
+	{
+		state->cards_failed++;
+	}
+	
+	state->credentials += issued;
+	
+	float minutes = (float) state->timer.elapsed() / 60000000000.0f;
+	
+	printf("[%s] %s\n", reader->reader_name.c_str(), line.c_str());
+	printf("Total: %lu cards OK, %lu failed, %lu credentials (%0.1f cards/minute)\n",
+		state->cards_ok,
+		state->cards_failed,
+		state->credentials,
+		(minutes > 0.0f) ? (float) state->cards_ok / minutes : 0.0f);
+	fflush(stdout);
+	
+	pthread_mutex_unlock(&state->output_lock);
+}
+
+// Run the issuing script on a card
+void reader_session(reader_thread* reader, silvia_card_channel* card)
+{
+	silvia_timer timer;
+	size_t issued = 0;
+	std::string error;
+	
+	timer.mark();
+	
+	bool ok = reader->state->batch->issue(card, reader->state->PIN, issued, error);
+	
+	float seconds = (float) timer.elapsed() / 1000000000.0f;
+	char line[256];
+	
+	if (ok)
+	{
+		snprintf(line, 256, "OK (%lu credentials in %0.2fs, %0.2f credentials/s)", (unsigned long) issued, seconds, (seconds > 0.0f) ? (float) issued / seconds : 0.0f);
+	}
+	else
+	{
+		snprintf(line, 256, "FAILED after %lu credentials in %0.2fs (%s)", (unsigned long) issued, seconds, error.c_str());
+	}
+	
+	reader_output(reader, line, ok, issued);
+}
+
+// Reader thread main loop
+void* reader_main(void* arg)
+{
+	reader_thread* reader = (reader_thread*) arg;
+	
+#ifdef WITH_PCSC
+	if (reader->channel_type == SILVIA_CHANNEL_PCSC)
+	{
+		silvia_pcsc_reader_monitor monitor(reader->reader_id);
+		silvia_pcsc_card* card = NULL;
+		
+		while (monitor.wait_for_card(&card))
+		{
+			reader_session(reader, card);
+			
+			while (card->status())
+			{
+				usleep(10000);
+			}
+			
+			delete card;
+		}
+	}
+#endif // WITH_PCSC
+#ifdef WITH_NFC
+	if (reader->channel_type == SILVIA_CHANNEL_NFC)
+	{
+		silvia_nfc_reader_monitor monitor(reader->reader_id);
+		silvia_nfc_card* card = NULL;
+		
+		while (monitor.wait_for_card(&card))
+		{
+			reader_session(reader, card);
+			
+			while (card->status())
+			{
+				usleep(10000);
+			}
+			
+			delete card;
+		}
+	}
+#endif // WITH_NFC
+	
+	pthread_mutex_lock(&reader->state->output_lock);
+	
+	printf("[%s] stopped monitoring reader\n", reader->reader_name.c_str()); fflush(stdout);
+	
+	pthread_mutex_unlock(&reader->state->output_lock);
+	
+	return NULL;
+}
+
+void multi_reader_loop(std::string issue_script)
+{
+	printf("Silvia command-line IRMA issuer %s\n\n", VERSION);
+	
+	// Read the issuing script
+	silvia_issuescript script(issue_script);
+	
+	if (!script.valid())
+	{
+		printf("Failed to load the issuing script %s\n", issue_script.c_str());
+		
+		return;
+	}
+	
+	// Read all specifications and keys once for all cards
+	std::vector<silvia_issue_specification*> ispecs;
+	std::vector<silvia_pub_key*> pubkeys;
+	std::vector<silvia_priv_key*> privkeys;
+	
+	silvia_thread_pool pool;
+	silvia_prime_pool prime_pool;
+	silvia_irma_batch_issuer batch(&pool, &prime_pool);
+	
+	bool config_ok = true;
+	
+	for (size_t i = 0; config_ok && (i < script.get_issue_specs().size()) && (i < script.get_issuer_ipks().size()) && (i < script.get_issuer_isks().size()); i++)
+	{
+		silvia_issue_specification* ispec = read_issue_spec(script.get_issue_specs()[i]);
+		silvia_pub_key* pubkey = read_pubkey(script.get_issuer_ipks()[i]);
+		silvia_priv_key* privkey = read_privkey(script.get_issuer_isks()[i]);
+		
+		if ((ispec == NULL) || (pubkey == NULL) || (privkey == NULL))
+		{
+			fprintf(stderr, "Failed to read the specification or keys of credential %lu\n", (unsigned long) (i + 1));
+			
+			delete ispec;
+			delete pubkey;
+			delete privkey;
+			
+			config_ok = false;
+			
+			break;
+		}
+		
+		ispecs.push_back(ispec);
+		pubkeys.push_back(pubkey);
+		privkeys.push_back(privkey);
+		
+		batch.add_credential(pubkey, privkey, ispec);
+	}
+	
+	if (config_ok)
+	{
+		multi_reader_state state;
+		
+		state.batch = &batch;
+		state.PIN = script.get_user_PIN();
+		state.cards_ok = 0;
+		state.cards_failed = 0;
+		state.credentials = 0;
+		
+		pthread_mutex_init(&state.output_lock, NULL);
+		
+		// Find all attached readers
+		std::vector<reader_thread*> readers;
+		
+#ifdef WITH_PCSC
+		std::vector<std::string> pcsc_readers;
+		
+		silvia_pcsc_reader_monitor::list_readers(pcsc_readers);
+		
+		for (std::vector<std::string>::iterator i = pcsc_readers.begin(); i != pcsc_readers.end(); i++)
+		{
+			reader_thread* reader = new reader_thread();
+			
+			reader->state = &state;
+			reader->channel_type = SILVIA_CHANNEL_PCSC;
+			reader->reader_id = *i;
+			reader->reader_name = *i;
+			
+			readers.push_back(reader);
+		}
+#endif // WITH_PCSC
+#ifdef WITH_NFC
+		std::vector<std::string> nfc_readers;
+		
+		silvia_nfc_reader_monitor::list_readers(nfc_readers);
+		
+		for (std::vector<std::string>::iterator i = nfc_readers.begin(); i != nfc_readers.end(); i++)
+		{
+			reader_thread* reader = new reader_thread();
+			
+			reader->state = &state;
+			reader->channel_type = SILVIA_CHANNEL_NFC;
+			reader->reader_id = *i;
+			reader->reader_name = "NFC " + *i;
+			
+			readers.push_back(reader);
+		}
+#endif // WITH_NFC
+		
+		if (readers.empty())
+		{
+			fprintf(stderr, "No card readers found\n");
+		}
+		else
+		{
+			printf("Starting issue script: %s\n", script.get_description().c_str());
+			printf("Issuing %lu credentials per card on %lu readers using %lu worker threads\n", (unsigned long) batch.size(), (unsigned long) readers.size(), (unsigned long) pool.size());
+			fflush(stdout);
+		}
 		
+		state.timer.mark();
+		
+		// Start a thread for every reader and wait until they all stop
+		for (std::vector<reader_thread*>::iterator i = readers.begin(); i != readers.end(); i++)
+		{
+			pthread_create(&(*i)->thread, NULL, reader_main, *i);
+		}
+		
+		for (std::vector<reader_thread*>::iterator i = readers.begin(); i != readers.end(); i++)
+		{
+			pthread_join((*i)->thread, NULL);
+			
+			delete *i;
+		}
+		
+		pthread_mutex_destroy(&state.output_lock);
+	}
+	
+	for (size_t i = 0; i < ispecs.size(); i++)
+	{
+		delete ispecs[i];
+		delete pubkeys[i];
+		delete privkeys[i];
+	}
+}
+
+#endif // WITH_PCSC || WITH_NFC
+		
+#ifdef HAVE_SYS_EPOLL_H
+
+////////////////////////////////////////////////////////////////////////
+// Server mode
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Issuance session for a client of the server; every round runs on
+ * the worker pool of the server
+ */
+class issuer_server_session : public silvia_session
+{
+public:
+	issuer_server_session(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec, silvia_prime_pool* prime_pool)
+		: issuer(pubkey, privkey, ispec, prime_pool)
+	{
+		round = 0;
+	}
+	
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands)
+	{
+		switch(round++)
+		{
+		case 0:
+			// First, perform application selection
+			commands = issuer.get_select_commands();
+			
+			return SILVIA_SESSION_RUNNING;
+		case 1:
+			if (!check_results(results))
+			{
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			if (!issuer.submit_select_data(results))
+			{
+				issuer.abort();
+				
+				add_message("carderror no-application");
+				
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			// Perform the first round of issuance after PIN verification
+			commands = issuer.get_issue_commands_round_1();
+			
+			require_pin();
+			
+			return SILVIA_SESSION_RUNNING;
+		case 2:
+			if (!check_results(results))
+			{
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			if (!issuer.submit_issue_results_round_1(results))
+			{
+				issuer.abort();
+				
+				add_message("error round-failed 1");
+				
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			commands = issuer.get_issue_commands_round_2();
+			
+			return SILVIA_SESSION_RUNNING;
+		case 3:
+			if (!check_results(results))
+			{
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			if (!issuer.submit_issue_results_round_2(results))
+			{
+				issuer.abort();
+				
+				add_message("error round-failed 2");
+				
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			add_message("result OK");
+			
+			return SILVIA_SESSION_SUCCEEDED;
+		default:
+			return SILVIA_SESSION_FAILED;
+		}
+	}
+
+private:
+	// Check that the card did not stop the round with an error
+	bool check_results(std::vector<bytestring>& results)
+	{
+		unsigned short sw = results.empty() ? 0 : silvia_apdu::get_sw(results.back());
+		
+		if (sw == 0x9000)
+		{
+			return true;
+		}
+		
+		if (sw != 0)
+		{
+			add_message("error " + silvia_apdu::sw_error(sw));
+		}
+		else
+		{
+			add_message("error card-error");
+		}
+		
+		issuer.abort();
+		
+		return false;
+	}
+	
+	silvia_irma_issuer issuer;
+	int round;
+};
+
+class issuer_session_factory : public silvia_session_factory
+{
+public:
+	issuer_session_factory(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec, silvia_prime_pool* prime_pool)
+	{
+		this->pubkey = pubkey;
+		this->privkey = privkey;
+		this->ispec = ispec;
+		this->prime_pool = prime_pool;
+	}
+	
+	virtual silvia_session* create_session()
+	{
+		return new issuer_server_session(pubkey, privkey, ispec, prime_pool);
+	}
+
+private:
+	silvia_pub_key* pubkey;
+	silvia_priv_key* privkey;
+	silvia_issue_specification* ispec;
+	silvia_prime_pool* prime_pool;
+};
+
+void server_loop(std::string issue_spec, std::string issuer_pubkey, std::string issuer_privkey, std::string listen_address)
+{
+	printf("Silvia command-line IRMA issuer %s\n\n", VERSION);
+	
+	// Read configuration files once for all sessions
+	silvia_issue_specification* ispec = read_issue_spec(issue_spec);
+	
+	if (ispec == NULL)
+	{
+		fprintf(stderr, "Failed to read issue specification\n");
+		
+		return;
+	}
+	
+	silvia_pub_key* pubkey = read_pubkey(issuer_pubkey);
+	
+	if (pubkey == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer public key\n");
+		
+		delete ispec;
+		
+		return;
+	}
+	
+	silvia_priv_key* privkey = read_privkey(issuer_privkey);
+	
+	if (privkey == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer private key\n");
+		
+		delete pubkey;
+		delete ispec;
+		
+		return;
+	}
+	
+	// Build the tables of the public key before the sessions start;
+	// after this, the sessions only read from the public key
+	pubkey->precompute(*silvia_system_parameters::i());
+	
+	// The sessions share a pool of primes for the signatures
+	silvia_prime_pool prime_pool;
+	
+	issuer_session_factory factory(pubkey, privkey, ispec, &prime_pool);
+	silvia_thread_pool pool;
+	silvia_stdio_server server(&factory, &pool);
+	
+	if (!server.listen(listen_address))
+	{
+		fprintf(stderr, "Failed to listen on %s\n", listen_address.c_str());
+	}
+	else
+	{
+		printf("Listening on %s using %lu worker threads\n", listen_address.c_str(), (unsigned long) pool.size()); fflush(stdout);
+		
+		if (!server.run())
+		{
+			fprintf(stderr, "Failed to run the server\n");
+		}
+	}
+	
+	delete ispec;
+	delete pubkey;
+	delete privkey;
+}
+
+#endif // HAVE_SYS_EPOLL_H
+
 int main(int argc, char* argv[])
 {
 	// Set library parameters
@@ -836,6 +1375,11 @@ int main(int argc, char* argv[])
 	std::string issuer_pubkey;
 	std::string issuer_privkey;
 	std::string issue_script;
+	std::string listen_address;
+	std::string cache_file;
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	bool multi_reader = false;
+#endif // WITH_PCSC || WITH_NFC
 	int c = 0;
 #if defined(WITH_PCSC)
 	int channel_type = SILVIA_CHANNEL_PCSC;
@@ -846,13 +1390,13 @@ int main(int argc, char* argv[])
 #endif
 
 #if defined(WITH_PCSC) && defined(WITH_NFC)
-	while ((c = getopt(argc, argv, "I:i:k:s:dhvSPN")) != -1)
+	while ((c = getopt(argc, argv, "I:i:k:s:C:dhvSBPNML:")) != -1)
 #elif defined(WITH_PCSC)
-	while ((c = getopt(argc, argv, "I:i:k:s:dhvSP")) != -1)
+	while ((c = getopt(argc, argv, "I:i:k:s:C:dhvSBPML:")) != -1)
 #elif defined(WITH_NFC)
-	while ((c = getopt(argc, argv, "I:i:k:s:dhvSN")) != -1)
+	while ((c = getopt(argc, argv, "I:i:k:s:C:dhvSBNML:")) != -1)
 #else
-	while ((c = getopt(argc, argv, "I:i:k:s:dhvS")) != -1)
+	while ((c = getopt(argc, argv, "I:i:k:s:C:dhvSBL:")) != -1)
 #endif
 	{
 		switch (c)
@@ -875,10 +1419,16 @@ int main(int argc, char* argv[])
 		case 's':
 			issuer_privkey = std::string(optarg);
 			break;
+		case 'C':
+			cache_file = std::string(optarg);
+			break;
         case 'S':
             channel_type = SILVIA_CHANNEL_STDIO;
             parseable_output = true;
             break;
+		case 'B':
+			binary_framing = true;
+			break;
 #if defined(WITH_PCSC)
 		case 'P':
 			channel_type = SILVIA_CHANNEL_PCSC;
@@ -888,14 +1438,41 @@ int main(int argc, char* argv[])
 		case 'N':
 			channel_type = SILVIA_CHANNEL_NFC;
 			break;
+#endif
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+		case 'M':
+			multi_reader = true;
+			break;
 #endif
 		case 'd':
 			debug_output = true;
 			break;
+		case 'L':
+			listen_address = std::string(optarg);
+			break;
+		}
+	}
+	
+	if (!cache_file.empty())
+	{
+		cache = new silvia_cache();
+		
+		if (!cache->open(cache_file))
+		{
+			if (parseable_output)
+			{
+				printf("error cache-error\n"); fflush(stdout);
+			}
+			else
+			{
+				fprintf(stderr, "Failed to read compiled cache %s\n", cache_file.c_str());
+			}
+			
+			return -1;
 		}
 	}
 	
-	if (issue_spec.empty() && issue_script.empty())
+	if (issue_spec.empty() && issue_script.empty() && (cache == NULL))
 	{
         if(parseable_output)
         {
@@ -909,7 +1486,7 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	
-	if (issuer_pubkey.empty() && !issue_spec.empty() && issue_script.empty())
+	if (issuer_pubkey.empty() && !issue_spec.empty() && issue_script.empty() && (cache == NULL))
 	{
         if(parseable_output)
         {
@@ -923,7 +1500,7 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	
-	if (issuer_privkey.empty() && !issue_spec.empty() && issue_script.empty())
+	if (issuer_privkey.empty() && !issue_spec.empty() && issue_script.empty() && (cache == NULL))
 	{
         if(parseable_output)
         {
@@ -937,7 +1514,7 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
-	if (!issue_script.empty() && (!issue_spec.empty() || !issuer_pubkey.empty() || !issuer_privkey.empty()))
+	if (!issue_script.empty() && (!issue_spec.empty() || !issuer_pubkey.empty() || !issuer_privkey.empty() || (cache != NULL)))
 	{
         if(parseable_output)
         {
@@ -951,8 +1528,17 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	if (multi_reader && issue_script.empty())
+	{
+		fprintf(stderr, "Monitoring all readers requires an issuing script!\n");
+		
+		return -1;
+	}
+#endif // WITH_PCSC || WITH_NFC
+	
 #ifdef WITH_NFC
-	if (channel_type == SILVIA_CHANNEL_NFC)
+	if ((channel_type == SILVIA_CHANNEL_NFC) || multi_reader)
 	{
 		// Handle signals when using NFC; this prevents the NFC reader
 		// from going into an undefined state when the user aborts the
@@ -964,6 +1550,28 @@ int main(int argc, char* argv[])
 	}
 #endif
 
+	if (!listen_address.empty() && (!issue_spec.empty() || (cache != NULL)))
+	{
+#ifdef HAVE_SYS_EPOLL_H
+		server_loop(issue_spec, issuer_pubkey, issuer_privkey, listen_address);
+		
+		return 0;
+#else
+		fprintf(stderr, "Server mode is not supported on this platform\n");
+		
+		return -1;
+#endif // HAVE_SYS_EPOLL_H
+	}
+	
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	if (multi_reader)
+	{
+		multi_reader_loop(issue_script);
+		
+		return 0;
+	}
+#endif // WITH_PCSC || WITH_NFC
+	
 	if (!issue_script.empty())
 	{
 		execute_issue_script(channel_type, issue_script);
@@ -36,8 +36,16 @@
 #include "silvia_issuer_keygen.h"
 #include "silvia_parameters.h"
 #include "silvia_macros.h"
+#include "silvia_cache.h"
+#include "silvia_timer.h"
 #include <string>
+#include <vector>
+#include <set>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include <ctime>
 
 // Default modulus size for new keys
@@ -63,6 +71,7 @@ void usage(void)
 	printf("Silvia issuer key generation utility %s\n\n", VERSION);
 	printf("Usage:\n");
 	printf("\tsilvia_keygen -a <#-attribs> [-n <bits>] [-c <counter>] [-d <timestamp>] [-p <file>] [-P <file>] [-u <URI>]\n");
+	printf("\tsilvia_keygen -b <manifest> [-o <dir>] [-t] [-j <threads>] [-n <bits>] [-c <counter>] [-d <timestamp>] [-u <URI>]\n");
 	printf("\tsilvia_keygen -h\n");
 	printf("\tsilvia_keygen -v\n");
 	printf("\n");
@@ -76,33 +85,46 @@ void usage(void)
 	printf("\t-P <file>      Output the private key to <file> (defaults to stdout)\n");
 	printf("\t-u <URI>       Base URI used to reference other Idemix files (defaults to http://www.irmacard.org/credentials/)\n");
 	printf("\n");
+	printf("\t-b <manifest>  Generate all key-pairs listed in <manifest> in parallel; every\n");
+	printf("\t               line has the form <name> <#-attribs> [<bits>], where <bits>\n");
+	printf("\t               defaults to the value of -n; <name> must not contain '/'\n");
+	printf("\t-o <dir>       Write the key-pairs of a manifest to <dir>/<name>/ipk.xml,\n");
+	printf("\t               isk.xml and keys.cache (defaults to the current directory);\n");
+	printf("\t               keys.cache holds only the public key\n");
+	printf("\t-t             Also store the precomputed tables of the public keys in keys.cache\n");
+	printf("\t-j <threads>   Use <threads> threads for a manifest (defaults to one per CPU)\n");
+	printf("\n");
 	printf("\t-h             Print this help message\n");
 	printf("\n");
 	printf("\t-v             Print the version number\n");
 }
 
-int generate_key_pair(FILE* pub_key_file,
-		FILE* priv_key_file,
+void keygen_progress(silvia_keygen_stage_t stage, size_t count, double elapsed, void* ctx)
+{
+	switch (stage)
+	{
+	case SILVIA_KEYGEN_SEARCHING:
+		break;
+	case SILVIA_KEYGEN_PRIME_FOUND:
+		printf("prime %lu found after %.1fs ... ", (unsigned long) count, elapsed);
+		break;
+	case SILVIA_KEYGEN_BASE_DERIVED:
+		break;
+	case SILVIA_KEYGEN_DONE:
+		printf("%lu bases derived after %.1fs ... ", (unsigned long) count, elapsed);
+		break;
+	}
+
+	fflush(stdout);
+}
+
+void write_pub_key(FILE* pub_key_file,
+		silvia_pub_key* pub_key,
 		std::string base_URI,
 		unsigned long num_attribs,
-		unsigned long bit_size,
 		unsigned long counter,
 		unsigned long expiry)
 {
-	printf("Generating %lu-bit issuer key pair for %lu attributes ... ", bit_size, num_attribs); fflush(stdout);
-	
-	// Set key size
-	silvia_system_parameters::i()->set_l_n(bit_size);
-	
-	// Generate key-pair
-	silvia_pub_key* pub_key;
-	silvia_priv_key* priv_key;
-	
-	silvia_issuer_keyfactory::i()->generate_keypair(num_attribs + 1, &pub_key, &priv_key);
-	
-	printf("OK\n");
-	
-	// Output the public key
 	fprintf(pub_key_file, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n");
 	fprintf(pub_key_file, "<IssuerPublicKey xmlns=\"http://www.zurich.ibm.com/security/idemix\" xmlns:xs=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:schemaLocation=\"http://www.zurich.ibm.com/security/idemix IssuerPublicKey.xsd\">\n");
 	fprintf(pub_key_file, "  <Counter>%lu</Counter>\n", counter);
@@ -127,8 +149,15 @@ int generate_key_pair(FILE* pub_key_file,
     fprintf(pub_key_file, "    <Epoch length=\"432000\"/>\n");
 	fprintf(pub_key_file, "  </Features>\n");
 	fprintf(pub_key_file, "</IssuerPublicKey>\n");
-	
-	// Output the private key
+}
+
+void write_priv_key(FILE* priv_key_file,
+		silvia_pub_key* pub_key,
+		silvia_priv_key* priv_key,
+		std::string base_URI,
+		unsigned long counter,
+		unsigned long expiry)
+{
 	fprintf(priv_key_file, "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n");
 	fprintf(priv_key_file, "<IssuerPrivateKey xmlns=\"http://www.zurich.ibm.com/security/idemix\" xmlns:xs=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:schemaLocation=\"http://www.zurich.ibm.com/security/idemix IssuerPrivateKey.xsd\">\n");
 	fprintf(priv_key_file, "  <Counter>%lu</Counter>\n", counter);
@@ -144,6 +173,31 @@ int generate_key_pair(FILE* pub_key_file,
     fprintf(priv_key_file, "    <qPrime>"); fprintmpzdec(priv_key_file, priv_key->get_q_prime()); fprintf(priv_key_file, "</qPrime>\n");
 	fprintf(priv_key_file, "  </Elements>\n");
 	fprintf(priv_key_file, "</IssuerPrivateKey>\n");
+}
+
+int generate_key_pair(FILE* pub_key_file,
+		FILE* priv_key_file,
+		std::string base_URI,
+		unsigned long num_attribs,
+		unsigned long bit_size,
+		unsigned long counter,
+		unsigned long expiry)
+{
+	printf("Generating %lu-bit issuer key pair for %lu attributes ... ", bit_size, num_attribs); fflush(stdout);
+	
+	// Set key size
+	silvia_system_parameters::i()->set_l_n(bit_size);
+	
+	// Generate key-pair
+	silvia_pub_key* pub_key;
+	silvia_priv_key* priv_key;
+	
+	silvia_issuer_keyfactory::i()->generate_keypair(num_attribs + 1, &pub_key, &priv_key, NULL, keygen_progress);
+	
+	printf("OK\n");
+	
+	write_pub_key(pub_key_file, pub_key, base_URI, num_attribs, counter, expiry);
+	write_priv_key(priv_key_file, pub_key, priv_key, base_URI, counter, expiry);
 	
 	delete pub_key;
 	delete priv_key;
@@ -151,6 +205,268 @@ int generate_key_pair(FILE* pub_key_file,
 	return 1;
 }
 
+// Names in the manifest become directories below the output directory
+bool valid_entry_name(const std::string& name)
+{
+	return !name.empty() && (name != ".") && (name != "..") && (name.find('/') == std::string::npos);
+}
+
+bool read_manifest(const std::string& manifest_file,
+		unsigned long default_bit_size,
+		std::vector<std::string>& names,
+		std::vector<silvia_keygen_batch_entry>& batch)
+{
+	FILE* manifest = fopen(manifest_file.c_str(), "r");
+	
+	if (manifest == NULL)
+	{
+		fprintf(stderr, "Failed to open %s for reading\n", manifest_file.c_str());
+		
+		return false;
+	}
+	
+	char line[1024];
+	unsigned long line_no = 0;
+	bool rv = true;
+	std::set<std::string> seen;
+	
+	while (fgets(line, sizeof(line), manifest) != NULL)
+	{
+		line_no++;
+		
+		char name[256];
+		unsigned long num_attribs = 0;
+		unsigned long bit_size = default_bit_size;
+		
+		int fields = sscanf(line, "%255s %lu %lu", name, &num_attribs, &bit_size);
+		
+		// Skip empty lines and comments
+		if ((fields <= 0) || (name[0] == '#')) continue;
+		
+		if ((fields < 2) || (num_attribs == 0))
+		{
+			fprintf(stderr, "%s:%lu: expected <name> <#-attribs> [<bits>]\n", manifest_file.c_str(), line_no);
+			
+			rv = false;
+			
+			continue;
+		}
+		
+		if (!valid_entry_name(name))
+		{
+			fprintf(stderr, "%s:%lu: invalid name %s; must not contain '/' or be '.' or '..'\n", manifest_file.c_str(), line_no, name);
+			
+			rv = false;
+			
+			continue;
+		}
+		
+		// Every key-pair is written to a directory of its own
+		if (!seen.insert(name).second)
+		{
+			fprintf(stderr, "%s:%lu: duplicate name %s\n", manifest_file.c_str(), line_no, name);
+			
+			rv = false;
+			
+			continue;
+		}
+		
+		if ((bit_size < 128) || (bit_size % 16 != 0))
+		{
+			fprintf(stderr, "%s:%lu: invalid modulus size %lu; must be a multiple of 16 of at least 128 bits\n", manifest_file.c_str(), line_no, bit_size);
+			
+			rv = false;
+			
+			continue;
+		}
+		
+		silvia_keygen_batch_entry entry;
+		
+		entry.max_attr = num_attribs + 1;
+		entry.l_n = bit_size;
+		entry.pubkey = NULL;
+		entry.privkey = NULL;
+		entry.elapsed = 0.0;
+		
+		names.push_back(std::string(name));
+		batch.push_back(entry);
+	}
+	
+	fclose(manifest);
+	
+	if (rv && batch.empty())
+	{
+		fprintf(stderr, "%s does not list any key-pairs\n", manifest_file.c_str());
+		
+		return false;
+	}
+	
+	return rv;
+}
+
+void batch_progress(size_t index, const silvia_keygen_batch_entry& entry, void* ctx)
+{
+	std::vector<std::string>* names = (std::vector<std::string>*) ctx;
+	
+	printf("Generated %lu-bit issuer key pair for %lu attributes for %s in %.1fs\n",
+		(unsigned long) entry.l_n,
+		(unsigned long) entry.max_attr - 1,
+		(*names)[index].c_str(),
+		entry.elapsed);
+	fflush(stdout);
+}
+
+// Open a file for a private key; only the owner may read or write it
+FILE* open_private_file(const std::string& file_name)
+{
+	int fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	
+	if (fd < 0) return NULL;
+	
+	// An existing file keeps its permissions, so restrict them as well
+	if (fchmod(fd, 0600) != 0)
+	{
+		close(fd);
+		
+		return NULL;
+	}
+	
+	FILE* rv = fdopen(fd, "w");
+	
+	if (rv == NULL) close(fd);
+	
+	return rv;
+}
+
+bool write_batch_entry(const std::string& dir,
+		const std::string& name,
+		silvia_keygen_batch_entry& entry,
+		std::string base_URI,
+		unsigned long counter,
+		unsigned long expiry,
+		bool tables)
+{
+	if (!valid_entry_name(name))
+	{
+		fprintf(stderr, "Invalid key-pair name %s\n", name.c_str());
+		
+		return false;
+	}
+	
+	std::string key_dir = dir + "/" + name;
+	
+	if ((mkdir(key_dir.c_str(), 0755) != 0) && (errno != EEXIST))
+	{
+		fprintf(stderr, "Failed to create directory %s\n", key_dir.c_str());
+		
+		return false;
+	}
+	
+	// Other files are referenced relative to the directory of the key-pair
+	std::string key_URI = base_URI + name + "/";
+	
+	std::string pub_key_filename = key_dir + "/ipk.xml";
+	std::string priv_key_filename = key_dir + "/isk.xml";
+	std::string cache_filename = key_dir + "/keys.cache";
+	
+	FILE* pub_key_file = fopen(pub_key_filename.c_str(), "w");
+	
+	if (pub_key_file == NULL)
+	{
+		fprintf(stderr, "Failed to open %s for writing\n", pub_key_filename.c_str());
+		
+		return false;
+	}
+	
+	write_pub_key(pub_key_file, entry.pubkey, key_URI, entry.max_attr - 1, counter, expiry);
+	
+	fclose(pub_key_file);
+	
+	FILE* priv_key_file = open_private_file(priv_key_filename);
+	
+	if (priv_key_file == NULL)
+	{
+		fprintf(stderr, "Failed to open %s for writing\n", priv_key_filename.c_str());
+		
+		return false;
+	}
+	
+	write_priv_key(priv_key_file, entry.pubkey, entry.privkey, key_URI, counter, expiry);
+	
+	fclose(priv_key_file);
+	
+	// Write the public key to a cache so verifiers can load it without
+	// parsing; the private key is only stored in isk.xml
+	silvia_system_parameters params = *silvia_system_parameters::i();
+	params.set_l_n(entry.l_n);
+	
+	silvia_cache_writer writer;
+	
+	writer.add_pubkey(entry.pubkey, tables, &params);
+	
+	if (!writer.write(cache_filename))
+	{
+		fprintf(stderr, "Failed to write %s\n", cache_filename.c_str());
+		
+		return false;
+	}
+	
+	printf("Wrote %s/{ipk.xml,isk.xml,keys.cache}\n", key_dir.c_str());
+	
+	return true;
+}
+
+int generate_batch(const std::string& manifest_file,
+		const std::string& dir,
+		std::string base_URI,
+		unsigned long bit_size,
+		unsigned long counter,
+		unsigned long expiry,
+		unsigned long num_threads,
+		bool tables)
+{
+	std::vector<std::string> names;
+	std::vector<silvia_keygen_batch_entry> batch;
+	
+	if (!read_manifest(manifest_file, bit_size, names, batch))
+	{
+		return -1;
+	}
+	
+	printf("Generating %lu issuer key pairs ...\n", (unsigned long) batch.size()); fflush(stdout);
+	
+	silvia_timer timer;
+	
+	timer.mark();
+	
+	silvia_issuer_keyfactory::i()->generate_keypairs(batch, num_threads, batch_progress, &names);
+	
+	float seconds = (float) timer.elapsed() / 1000000000.0f;
+	double key_seconds = 0.0;
+	
+	for (std::vector<silvia_keygen_batch_entry>::iterator i = batch.begin(); i != batch.end(); i++)
+	{
+		key_seconds += i->elapsed;
+	}
+	
+	printf("Generated %lu issuer key pairs in %.1fs (%.1fs of key generation)\n", (unsigned long) batch.size(), seconds, key_seconds);
+	
+	int rv = 0;
+	
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		if (!write_batch_entry(dir, names[i], batch[i], base_URI, counter, expiry, tables))
+		{
+			rv = -1;
+		}
+		
+		delete batch[i].pubkey;
+		delete batch[i].privkey;
+	}
+	
+	return rv;
+}
+
 int main(int argc, char* argv[])
 {
 	// Program parameters
@@ -161,6 +477,10 @@ int main(int argc, char* argv[])
 	std::string pub_key_filename;
 	std::string priv_key_filename;
 	std::string base_URI = DEFAULT_BASE_URI;
+	std::string manifest_file;
+	std::string output_dir = ".";
+	unsigned long num_threads = 0;
+	bool tables = false;
 	int c = 0;
 	
 	// Add a year to expiry and round it down to 1 day
@@ -171,7 +491,7 @@ int main(int argc, char* argv[])
 	now->tm_sec = 0;
 	expiry = mktime(now);
 
-	while ((c = getopt(argc, argv, "a:n:c:d:p:P:u:hv")) != -1)
+	while ((c = getopt(argc, argv, "a:n:c:d:p:P:u:b:o:j:thv")) != -1)
 	{
 		switch (c)
 		{
@@ -202,9 +522,26 @@ int main(int argc, char* argv[])
 		case 'u':
 			base_URI = std::string(optarg);
 			break;
+		case 'b':
+			manifest_file = std::string(optarg);
+			break;
+		case 'o':
+			output_dir = std::string(optarg);
+			break;
+		case 'j':
+			num_threads = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			tables = true;
+			break;
 		}
 	}
 	
+	if (!manifest_file.empty())
+	{
+		return generate_batch(manifest_file, output_dir, base_URI, bit_size, counter, expiry, num_threads, tables);
+	}
+	
 	if (num_attribs <= 0)
 	{
 		fprintf(stderr, "Missing argument -a; please specify a number of attributes\n");
@@ -231,7 +568,7 @@ int main(int argc, char* argv[])
 	
 	if (!priv_key_filename.empty())
 	{
-		priv_key_file = fopen(priv_key_filename.c_str(), "w");
+		priv_key_file = open_private_file(priv_key_filename);
 		
 		if (priv_key_file == NULL)
 		{
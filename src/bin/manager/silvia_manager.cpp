@@ -261,49 +261,64 @@ bool communicate_with_card(silvia_card_channel* card, std::vector<bytestring>& c
 	printf("Communicating with the card... "); fflush(stdout);
 		
 	bool comm_ok = true;
-	size_t cmd_ctr = 0;
+	size_t next = 0;
 	
-	for (std::vector<bytestring>::iterator i = commands.begin(); (i != commands.end()) && comm_ok; i++)
-	{	
-		bytestring result;
+	while (comm_ok && (next < commands.size()))
+	{
+		// Send the remaining commands in one batch; the batch stops at
+		// the first command that does not return 9000
+		std::vector<bytestring> batch_results;
+		std::vector<unsigned long long> timings;
+		bool batch_ok = false;
 		
-		DEBUG_MSG("--> %s\n", i->hex_str().c_str());
+		if (next == 0)
+		{
+			batch_ok = card->transmit_batch(commands, batch_results, &timings);
+		}
+		else
+		{
+			batch_ok = card->transmit_batch(std::vector<bytestring>(commands.begin() + next, commands.end()), batch_results, &timings);
+		}
 		
-		if (!card->transmit(*i, result))
+		if (!batch_ok)
 		{
 			comm_ok = false;
 			break;
 		}
 		
-		DEBUG_MSG("<-- %s\n", result.hex_str().c_str());
-		
-		cmd_ctr++;
-		
-        if (result.substr(result.size() - 2) == "6B00")
-        {
-            // This is a workaround for the fact that we have no idea how many attributes were in the current credential (we do not read the Issues spec)
-            // With INS_ADMIN_ATTRIBUTE (getting attribute value), this error is returned if we ask more values than are present in this credential
-            // Let's just continue for now, because who knows what we might request more in the future?
-            // Because we bail out before the push_back, we do not store anything, so we don't show anything either.
-            continue;
-        }
-		else if (result.substr(result.size() - 2) != "9000")
+		for (size_t i = 0; i < batch_results.size(); i++, next++)
 		{
-			// Return values between 63C0--63CF indicate a wrong PIN
-			const unsigned int PIN_attempts = ((result.substr(result.size() - 2) ^ "63C0")[0] << 8) | ((result.substr(result.size() - 2) ^ "63C0")[1]);
-			if (PIN_attempts <= 0xF)
+			bytestring& result = batch_results[i];
+			
+			DEBUG_MSG("--> %s\n", commands[next].hex_str().c_str());
+			DEBUG_MSG("<-- %s (%0.1fms)\n", result.hex_str().c_str(), (float) timings[i] / 1000000.0f);
+			
+			if (result.substr(result.size() - 2) == "6B00")
 			{
-				printf("wrong PIN, %u attempts remaining ", PIN_attempts);
+				// This is a workaround for the fact that we have no idea how many attributes were in the current credential (we do not read the Issues spec)
+				// With INS_ADMIN_ATTRIBUTE (getting attribute value), this error is returned if we ask more values than are present in this credential
+				// Let's just continue for now, because who knows what we might request more in the future?
+				// Because we bail out before the push_back, we do not store anything, so we don't show anything either.
+				continue;
 			}
-			else
+			else if (result.substr(result.size() - 2) != "9000")
 			{
-				printf("(0x%s) ", result.substr(result.size() - 2).hex_str().c_str());
+				// Return values between 63C0--63CF indicate a wrong PIN
+				const unsigned int PIN_attempts = ((result.substr(result.size() - 2) ^ "63C0")[0] << 8) | ((result.substr(result.size() - 2) ^ "63C0")[1]);
+				if (PIN_attempts <= 0xF)
+				{
+					printf("wrong PIN, %u attempts remaining ", PIN_attempts);
+				}
+				else
+				{
+					printf("(0x%s) ", result.substr(result.size() - 2).hex_str().c_str());
+				}
+				comm_ok = false;
+				break;
 			}
-			comm_ok = false;
-			break;
+			
+			results.push_back(result);
 		}
-		
-		results.push_back(result);
 	}
 	
 	if (comm_ok)
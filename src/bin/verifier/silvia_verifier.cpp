@@ -42,16 +42,25 @@
 #include "silvia_nfc_card.h"
 #endif // WITH_NFC
 #include "silvia_stdio_card.h"
+#include "silvia_stdio_server.h"
 #include "silvia_card_channel.h"
+#include "silvia_apdu.h"
 #include "silvia_irma_xmlreader.h"
 #include "silvia_idemix_xmlreader.h"
+#include "silvia_cache.h"
+#include "silvia_scheme_registry.h"
 #include "silvia_types.h"
+#include "silvia_thread_pool.h"
+#include "silvia_timer.h"
 #include <string>
+#include <vector>
+#include <pthread.h>
 #include <iostream>
 #include <unistd.h>
 #include <stdio.h>
 #include <time.h>
 #include <signal.h>
+#include <stdlib.h>
 
 const char* weekday[7] = { "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" };
 
@@ -60,6 +69,30 @@ const char* month[12] = { "January", "February", "March", "April", "May", "June"
 #define IRMA_VERIFIER_METADATA_OFFSET				(32 - 6)
 
 bool parseable_output = false;
+bool binary_framing = false;
+
+// Compiled cache to read the specification and key from instead of XML
+silvia_cache* cache = NULL;
+
+silvia_verifier_specification* read_verifier_spec(std::string issuer_spec, std::string verifier_spec)
+{
+	if (cache != NULL)
+	{
+		return cache->get_verifier_spec();
+	}
+	
+	return silvia_irma_xmlreader::i()->read_verifier_spec(issuer_spec, verifier_spec);
+}
+
+silvia_pub_key* read_pubkey(std::string issuer_pubkey)
+{
+	if (cache != NULL)
+	{
+		return cache->get_pubkey();
+	}
+	
+	return silvia_idemix_xmlreader::i()->read_idemix_pubkey(issuer_pubkey);
+}
 
 void signal_handler(int signal)
 {
@@ -117,20 +150,30 @@ void usage(void)
 {
 	printf("Silvia command-line IRMA verifier %s\n\n", VERSION);
 	printf("Usage:\n");
-	printf("\tsilvia_verifier -I <issuer-spec> -V <verifier-spec> -k <issuer-pubkey> [-p] [-S]");
+	printf("\tsilvia_verifier {-I <issuer-spec> -V <verifier-spec> -k <issuer-pubkey> | -C <cache>} [-p] [-S]");
 #if defined(WITH_PCSC)
 	printf(" [-P]");
 #endif // WITH_PCSC
 #if defined(WITH_NFC)
     printf(" [-N]");
 #endif // WITH_NFC
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	printf(" [-M]");
+#endif // WITH_PCSC || WITH_NFC
+#ifdef HAVE_SYS_EPOLL_H
+	printf(" [-L <address>]");
+#endif // HAVE_SYS_EPOLL_H
 	printf("\n");
+#ifdef HAVE_SYS_EPOLL_H
+	printf("\tsilvia_verifier -D <scheme-dir> -c <credential> [-p] -L <address>\n");
+#endif // HAVE_SYS_EPOLL_H
 	printf("\tsilvia_verifier -h\n");
 	printf("\tsilvia_verifier -v\n");
 	printf("\n");
 	printf("\t-I <issuer-spec>   Read issuer specification from <issuer-spec>\n");
 	printf("\t-V <verifier-spec> Read verifier specification from <verifier-spec>\n");
 	printf("\t-k <issuer-pubkey> Read issuer public key from <issuer-pubkey>\n");
+	printf("\t-C <cache>         Read specification and public key from the compiled <cache>\n");
 	printf("\t-p                 Force PIN verification\n");
 #if defined(WITH_PCSC)
 	printf("\t-P                 Use PC/SC for card communication (default)\n");
@@ -138,7 +181,20 @@ void usage(void)
 #if defined(WITH_NFC)
 	printf("\t-N                 Use NFC for card communication\n");
 #endif // WITH_NFC
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	printf("\t-M                 Monitor all attached readers and verify cards on all\n");
+	printf("\t                   of them concurrently (no PIN entry)\n");
+#endif // WITH_PCSC || WITH_NFC
     printf("\t-S                 Use StdIO for card communication (changes output to parseable format)\n");
+	printf("\t-B                 Offer binary framing to the StdIO peer\n");
+#ifdef HAVE_SYS_EPOLL_H
+	printf("\t-L <address>       Serve the StdIO protocol to many clients concurrently on\n");
+	printf("\t                   <address> (unix:<path>, tcp:<port> or tcp:<host>:<port>)\n");
+	printf("\t-D <scheme-dir>    Read the keys and specifications of all issuers and\n");
+	printf("\t                   verifiers from <scheme-dir>, and reload them when they change\n");
+	printf("\t-c <credential>    Verify <credential> from the scheme directory, given as\n");
+	printf("\t                   <issuer>:<credential-id>[:<verifier-id>]\n");
+#endif // HAVE_SYS_EPOLL_H
 	printf("\n");
 	printf("\t-h                 Print this help message\n");
 	printf("\n");
@@ -221,22 +277,10 @@ bool verify_pin(silvia_card_channel* card)
         printf("Verifying PIN... "); fflush(stdout);
     }
 	
-	bytestring verify_pin_apdu = "0020000008";
-	
-	for (std::string::iterator i = PIN.begin(); i != PIN.end(); i++)
-	{
-		verify_pin_apdu += (unsigned char) *i;
-	}
-	
-	while (verify_pin_apdu.size() < 13)
-	{
-		verify_pin_apdu += "00";
-	}
-	
 	bytestring data;
 	unsigned short sw;
 	
-	if (!card->transmit(verify_pin_apdu, data, sw))
+	if (!card->transmit(silvia_apdu::verify_pin(PIN), data, sw))
 	{
         if(!parseable_output)
         {
@@ -311,6 +355,128 @@ bytestring bs2str(const bytestring& in)
 	return out;
 }
 
+// Format the revealed attributes, either in the parseable StdIO format or
+// as a table
+void format_revealed(silvia_verifier_specification* vspec, std::vector<std::pair<std::string, bytestring> >& revealed, bool parseable, std::vector<std::string>& output)
+{
+	char line[256];
+	
+	if (parseable)
+	{
+		output.push_back("result OK");
+	}
+	else
+	{
+		output.push_back("Revealed attributes:");
+		output.push_back("");
+		output.push_back("Attribute           |Value");
+		output.push_back("--------------------+-----------------------------------------------------------");
+	}
+	
+	std::vector<std::pair<std::string, bytestring> >::iterator i = revealed.begin();
+	
+	// Check if the first attribute is "expires"
+	if ((i != revealed.end()) && ((i->first == "expires") || (i->first == "metadata")))
+	{
+		// Check if this is an "old style" expires or a "new style" expires attribute
+		time_t expires;
+		
+		if (i->second[IRMA_VERIFIER_METADATA_OFFSET] != 0x00)
+		{
+			// Check metadata version number
+			if (i->second[IRMA_VERIFIER_METADATA_OFFSET] != 0x01)
+			{
+				output.push_back(parseable ? "result expiry unknown" : "Invalid metadata attribute found!");
+			}
+			else
+			{
+				// Reconstruct expiry data from metadata
+				expires = 0;
+				expires += i->second[IRMA_VERIFIER_METADATA_OFFSET + 1] << 16;
+				expires += i->second[IRMA_VERIFIER_METADATA_OFFSET + 2] << 8;
+				expires += i->second[IRMA_VERIFIER_METADATA_OFFSET + 3];
+				
+				expires *= 86400; // convert days to seconds
+				
+				// Reconstruct credential ID as issued from metadata
+				unsigned short issued_id = 0;
+				
+				issued_id += i->second[IRMA_VERIFIER_METADATA_OFFSET + 4] << 8;
+				issued_id += i->second[IRMA_VERIFIER_METADATA_OFFSET + 5];
+				
+				if (parseable)
+				{
+					if (issued_id != vspec->get_credential_id())
+					{
+						output.push_back("carderror credential-mismatch");
+					}
+					
+					snprintf(line, 256, "result expiry %lu", (unsigned long) expires);
+					output.push_back(line);
+				}
+				else
+				{
+					struct tm* date = gmtime(&expires);
+					
+					snprintf(line, 256, "%-20s|%d (%s)", "credential ID", issued_id, (issued_id == vspec->get_credential_id()) ? "matches" : "DOES NOT MATCH");
+					output.push_back(line);
+					
+					snprintf(line, 256, "%-20s|%s %s %d %d", i->first.c_str(),
+						weekday[date->tm_wday],
+						month[date->tm_mon],
+						date->tm_mday,
+						date->tm_year + 1900);
+					output.push_back(line);
+				}
+			}
+		}
+		else
+		{
+			// This is old style
+			expires = (i->second[i->second.size() - 2] << 8) + (i->second[i->second.size() - 1]);
+			expires *= 86400; // convert days to seconds
+			
+			if (parseable)
+			{
+				snprintf(line, 256, "result expiry %lu", (unsigned long) expires);
+			}
+			else
+			{
+				struct tm* date = gmtime(&expires);
+				
+				snprintf(line, 256, "%-20s|%s %s %d %d", i->first.c_str(),
+					weekday[date->tm_wday],
+					month[date->tm_mon],
+					date->tm_mday,
+					date->tm_year + 1900);
+			}
+			
+			output.push_back(line);
+		}
+		
+		i++;
+	}
+	
+	// Assume the other attributes are strings
+	for (; i != revealed.end(); i++)
+	{
+		if (parseable)
+		{
+			output.push_back("attribute " + i->first + " " + std::string((const char*) bs2str(i->second).byte_str()));
+		}
+		else
+		{
+			snprintf(line, 256, "%-20s|%-59s", i->first.c_str(), (const char*) bs2str(i->second).byte_str());
+			output.push_back(line);
+		}
+	}
+	
+	if (!parseable)
+	{
+		output.push_back("");
+	}
+}
+
 bool communicate_with_card(silvia_card_channel* card, std::vector<bytestring>& commands, std::vector<bytestring>& results, bool force_pin)
 {
     if(!parseable_output)
@@ -319,21 +485,40 @@ bool communicate_with_card(silvia_card_channel* card, std::vector<bytestring>& c
     }
 		
 	bool comm_ok = true;
-	size_t cmd_ctr = 0;
+	size_t next = 0;
 	
-	for (std::vector<bytestring>::iterator i = commands.begin(); (i != commands.end()) && comm_ok; i++)
-	{	
-		bytestring result;
+	while (comm_ok && (next < commands.size()))
+	{
+		// Send the commands in batches; a batch ends at the first
+		// command that does not return 9000, which is handled below
+		std::vector<bytestring> batch_results;
+		bool batch_ok = false;
+		
+		if (force_pin && (next == 0))
+		{
+			batch_ok = card->transmit_batch(std::vector<bytestring>(1, commands[0]), batch_results);
+		}
+		else if (next == 0)
+		{
+			batch_ok = card->transmit_batch(commands, batch_results);
+		}
+		else
+		{
+			batch_ok = card->transmit_batch(std::vector<bytestring>(commands.begin() + next, commands.end()), batch_results);
+		}
 		
-		if (!card->transmit(*i, result))
+		if (!batch_ok || batch_results.empty())
 		{
 			comm_ok = false;
 			break;
 		}
 		
-		cmd_ctr++;
+		results.insert(results.end(), batch_results.begin(), batch_results.end() - 1);
+		next += batch_results.size() - 1;
+		
+		bytestring result = batch_results.back();
 		
-		if ((force_pin) && (cmd_ctr == 1))
+		if ((force_pin) && (next == 0))
 		{
 			if (!verify_pin(card))
 			{
@@ -361,7 +546,9 @@ bool communicate_with_card(silvia_card_channel* card, std::vector<bytestring>& c
             }
 			
 			// Re-execute the command
-			if (!card->transmit(*i, result))
+			result = bytestring();
+			
+			if (!card->transmit(commands[next], result))
 			{
 				comm_ok = false;
 				break;
@@ -385,6 +572,7 @@ bool communicate_with_card(silvia_card_channel* card, std::vector<bytestring>& c
 		}
 		
 		results.push_back(result);
+		next++;
 	}
 	
     if(!parseable_output)
@@ -412,7 +600,7 @@ void verifier_loop(std::string issuer_spec, std::string verifier_spec, std::stri
     }
 		
 	// Read configuration files
-	silvia_verifier_specification* vspec = silvia_irma_xmlreader::i()->read_verifier_spec(issuer_spec, verifier_spec);
+	silvia_verifier_specification* vspec = read_verifier_spec(issuer_spec, verifier_spec);
 	
 	if (vspec == NULL)
 	{
@@ -429,7 +617,7 @@ void verifier_loop(std::string issuer_spec, std::string verifier_spec, std::stri
 		return;
 	}
 	
-	silvia_pub_key* pubkey = silvia_idemix_xmlreader::i()->read_idemix_pubkey(issuer_pubkey);
+	silvia_pub_key* pubkey = read_pubkey(issuer_pubkey);
 	
 	if (pubkey == NULL)
 	{
@@ -498,7 +686,7 @@ void verifier_loop(std::string issuer_spec, std::string verifier_spec, std::stri
         if (channel_type == SILVIA_CHANNEL_STDIO)
         {
             silvia_stdio_card* stdio_card = NULL;
-            stdio_card = new silvia_stdio_card();
+            stdio_card = new silvia_stdio_card(binary_framing);
 
             card = stdio_card;
         }
@@ -544,122 +732,16 @@ void verifier_loop(std::string issuer_spec, std::string verifier_spec, std::stri
 						
 						if (revealed.size() > 0)
 						{
-                            if(parseable_output)
-                            {
-                                printf("result OK\n"); fflush(stdout);
-                            }
-                            else
-                            {
-                                printf("Revealed attributes:\n\n");
-                                
-                                printf("Attribute           |Value\n");
-                                printf("--------------------+-----------------------------------------------------------\n");
-                            }
+							std::vector<std::string> output;
 							
-							std::vector<std::pair<std::string, bytestring> >::iterator i = revealed.begin();
+							format_revealed(vspec, revealed, parseable_output, output);
 							
-							// Check if the first attribute is "expires"
-							if ((i->first == "expires") || (i->first == "metadata"))
+							for (std::vector<std::string>::iterator i = output.begin(); i != output.end(); i++)
 							{
-								// Check if this is an "old style" expires or a "new style" expires attribute
-								time_t expires;
-								
-								if (i->second[IRMA_VERIFIER_METADATA_OFFSET] != 0x00)
-								{
-									// Check metadata version number
-									if (i->second[IRMA_VERIFIER_METADATA_OFFSET] != 0x01)
-									{
-                                        if(parseable_output)
-                                        {
-                                            printf("result expiry unknown\n"); fflush(stdout);
-                                        }
-                                        else
-                                        {
-                                            printf("Invalid metadata attribute found!\n");
-                                        }
-									}
-									else
-									{
-										// Reconstruct expiry data from metadata
-										expires = 0;
-										expires += i->second[IRMA_VERIFIER_METADATA_OFFSET + 1] << 16;
-										expires += i->second[IRMA_VERIFIER_METADATA_OFFSET + 2] << 8;
-										expires += i->second[IRMA_VERIFIER_METADATA_OFFSET + 3];
-										
-										expires *= 86400; // convert days to seconds
-
-                                        // Reconstruct credential ID as issued from metadata
-                                        unsigned short issued_id = 0;
-                                        
-                                        issued_id += i->second[IRMA_VERIFIER_METADATA_OFFSET + 4] << 8;
-                                        issued_id += i->second[IRMA_VERIFIER_METADATA_OFFSET + 5];
-
-                                        if(parseable_output)
-                                        {
-                                            if(!issued_id == vspec->get_credential_id())
-                                            {
-                                                printf("carderror credential-mismatch\n"); fflush(stdout);
-                                            }
-
-                                            std::cout << "result expiry " << expires << std::endl;
-                                        }
-                                        else
-                                        {
-                                            struct tm* date = gmtime(&expires);
-                                            
-                                            
-                                            printf("%-20s|%d (%s)\n", "credential ID", issued_id, (issued_id == vspec->get_credential_id()) ? "matches" : "DOES NOT MATCH");
-                                            
-                                            printf("%-20s|%s %s %d %d\n", i->first.c_str(),
-                                                weekday[date->tm_wday],
-                                                month[date->tm_mon],
-                                                date->tm_mday,
-                                                date->tm_year + 1900);
-                                        }
-									}
-								}
-								else
-								{
-									// This is old style
-									expires = (i->second[i->second.size() - 2] << 8) + (i->second[i->second.size() - 1]);
-									expires *= 86400; // convert days to seconds
-
-                                    if(parseable_output)
-                                    {
-                                        std::cout << "result expiry " << expires << std::endl;
-                                    }
-                                    else
-                                    {
-                                        struct tm* date = gmtime(&expires);
-                                        
-                                        printf("%-20s|%s %s %d %d\n", i->first.c_str(),
-                                            weekday[date->tm_wday],
-                                            month[date->tm_mon],
-                                            date->tm_mday,
-                                            date->tm_year + 1900);
-                                    }
-								}
-								
-								i++;
+								printf("%s\n", i->c_str());
 							}
 							
-							// Assume the other attributes are strings
-							for (; i != revealed.end(); i++)
-							{
-                                if(parseable_output)
-                                {
-                                    printf("attribute %s %s\n", i->first.c_str(), (const char*) bs2str(i->second).byte_str()); fflush(stdout);
-                                }
-                                else
-                                {
-                                    printf("%-20s|%-59s\n", i->first.c_str(), (const char*) bs2str(i->second).byte_str());
-                                }
-							}
-
-							if(!parseable_output)
-                            {
-                                printf("\n");
-                            }
+							fflush(stdout);
 						}
 					}
 					else
@@ -725,6 +807,735 @@ void verifier_loop(std::string issuer_spec, std::string verifier_spec, std::stri
 	delete pubkey;
 }
 
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+
+////////////////////////////////////////////////////////////////////////
+// Multi-reader mode
+////////////////////////////////////////////////////////////////////////
+
+// State shared by all reader threads
+struct multi_reader_state
+{
+	silvia_pub_key* pubkey;
+	silvia_verifier_specification* vspec;
+	silvia_thread_pool* pool;
+	pthread_mutex_t output_lock;
+};
+
+// A reader that is monitored by its own thread
+struct reader_thread
+{
+	multi_reader_state* state;
+	int channel_type;
+	std::string reader_id;
+	std::string reader_name;
+	pthread_t thread;
+};
+
+/**
+ * Job that verifies the proof of a session on the shared worker pool,
+ * so the reader threads only wait for the cards
+ */
+class verify_session_job : public silvia_job
+{
+public:
+	verify_session_job(silvia_irma_verifier* verifier, std::vector<bytestring>* results, std::vector<std::pair<std::string, bytestring> >* revealed)
+	{
+		this->verifier = verifier;
+		this->results = results;
+		this->revealed = revealed;
+		
+		verified = false;
+		done = false;
+		
+		pthread_mutex_init(&done_lock, NULL);
+		pthread_cond_init(&done_cond, NULL);
+	}
+	
+	~verify_session_job()
+	{
+		pthread_cond_destroy(&done_cond);
+		pthread_mutex_destroy(&done_lock);
+	}
+	
+	virtual void run()
+	{
+		bool rv = verifier->submit_and_verify(*results, *revealed);
+		
+		pthread_mutex_lock(&done_lock);
+		
+		verified = rv;
+		done = true;
+		
+		pthread_cond_signal(&done_cond);
+		pthread_mutex_unlock(&done_lock);
+	}
+	
+	// Wait for the job to finish and return the verification result
+	bool wait()
+	{
+		pthread_mutex_lock(&done_lock);
+		
+		while (!done)
+		{
+			pthread_cond_wait(&done_cond, &done_lock);
+		}
+		
+		bool rv = verified;
+		
+		pthread_mutex_unlock(&done_lock);
+		
+		return rv;
+	}
+	
+private:
+	silvia_irma_verifier* verifier;
+	std::vector<bytestring>* results;
+	std::vector<std::pair<std::string, bytestring> >* revealed;
+	bool verified;
+	bool done;
+	pthread_mutex_t done_lock;
+	pthread_cond_t done_cond;
+};
+
+// Print a line of output for a reader
+void reader_output(reader_thread* reader, const std::string& line)
+{
+	pthread_mutex_lock(&reader->state->output_lock);
+	
+	printf("[%s] %s\n", reader->reader_name.c_str(), line.c_str()); fflush(stdout);
+	
+	pthread_mutex_unlock(&reader->state->output_lock);
+}
+
+// Exchange commands with a card without user interaction
+bool reader_communicate(silvia_card_channel* card, std::vector<bytestring>& commands, std::vector<bytestring>& results, std::string& error)
+{
+	size_t next = 0;
+	
+	while (next < commands.size())
+	{
+		std::vector<bytestring> batch_results;
+		bool batch_ok = false;
+		
+		if (next == 0)
+		{
+			batch_ok = card->transmit_batch(commands, batch_results);
+		}
+		else
+		{
+			batch_ok = card->transmit_batch(std::vector<bytestring>(commands.begin() + next, commands.end()), batch_results);
+		}
+		
+		if (!batch_ok || batch_results.empty() || (batch_results.back().size() < 2))
+		{
+			error = "card communication failed";
+			
+			return false;
+		}
+		
+		next += batch_results.size();
+		
+		unsigned short sw = silvia_apdu::get_sw(batch_results.back());
+		
+		if ((sw != 0x9000) && (sw != 0x6A82) && (sw != 0x6D00))
+		{
+			if (sw == 0x6982)
+			{
+				error = "card requires PIN";
+			}
+			else
+			{
+				error = silvia_apdu::sw_error(sw);
+			}
+			
+			return false;
+		}
+		
+		results.insert(results.end(), batch_results.begin(), batch_results.end());
+	}
+	
+	return true;
+}
+
+// Run a verification session with a card
+void reader_session(reader_thread* reader, silvia_card_channel* card)
+{
+	silvia_timer timer;
+	silvia_irma_verifier verifier(reader->state->pubkey, reader->state->vspec);
+	std::vector<bytestring> commands;
+	std::vector<bytestring> results;
+	std::string error;
+	
+	timer.mark();
+	
+	commands = verifier.get_select_commands();
+	
+	if (!reader_communicate(card, commands, results, error))
+	{
+		verifier.abort();
+		
+		reader_output(reader, "FAILED (" + error + ")");
+		
+		return;
+	}
+	
+	if (!verifier.submit_select_data(results))
+	{
+		verifier.abort();
+		
+		reader_output(reader, "FAILED (no IRMA application)");
+		
+		return;
+	}
+	
+	commands = verifier.get_proof_commands();
+	results.clear();
+	
+	if (!reader_communicate(card, commands, results, error))
+	{
+		verifier.abort();
+		
+		reader_output(reader, "FAILED (" + error + ")");
+		
+		return;
+	}
+	
+	// Verify the proof on the shared worker pool
+	std::vector<std::pair<std::string, bytestring> > revealed;
+	verify_session_job job(&verifier, &results, &revealed);
+	
+	reader->state->pool->submit(&job);
+	
+	if (!job.wait())
+	{
+		reader_output(reader, "FAILED (invalid proof)");
+		
+		return;
+	}
+	
+	char duration[32];
+	
+	snprintf(duration, 32, "%0.1fms", (float) timer.elapsed() / 1000000.0f);
+	
+	std::string line = std::string("OK (") + duration + ")";
+	
+	for (std::vector<std::pair<std::string, bytestring> >::iterator i = revealed.begin(); i != revealed.end(); i++)
+	{
+		if ((i->first == "expires") || (i->first == "metadata"))
+		{
+			line += " " + i->first + "=0x" + i->second.hex_str();
+		}
+		else
+		{
+			line += " " + i->first + "=" + std::string((const char*) bs2str(i->second).byte_str());
+		}
+	}
+	
+	reader_output(reader, line);
+}
+
+// Reader thread main loop
+void* reader_main(void* arg)
+{
+	reader_thread* reader = (reader_thread*) arg;
+	
+#ifdef WITH_PCSC
+	if (reader->channel_type == SILVIA_CHANNEL_PCSC)
+	{
+		silvia_pcsc_reader_monitor monitor(reader->reader_id);
+		silvia_pcsc_card* card = NULL;
+		
+		while (monitor.wait_for_card(&card))
+		{
+			reader_session(reader, card);
+			
+			while (card->status())
+			{
+				usleep(10000);
+			}
+			
+			delete card;
+		}
+	}
+#endif // WITH_PCSC
+#ifdef WITH_NFC
+	if (reader->channel_type == SILVIA_CHANNEL_NFC)
+	{
+		silvia_nfc_reader_monitor monitor(reader->reader_id);
+		silvia_nfc_card* card = NULL;
+		
+		while (monitor.wait_for_card(&card))
+		{
+			reader_session(reader, card);
+			
+			while (card->status())
+			{
+				usleep(10000);
+			}
+			
+			delete card;
+		}
+	}
+#endif // WITH_NFC
+	
+	reader_output(reader, "stopped monitoring reader");
+	
+	return NULL;
+}
+
+void multi_reader_loop(std::string issuer_spec, std::string verifier_spec, std::string issuer_pubkey)
+{
+	printf("Silvia command-line IRMA verifier %s\n\n", VERSION);
+	
+	multi_reader_state state;
+	
+	// Read configuration files
+	state.vspec = read_verifier_spec(issuer_spec, verifier_spec);
+	
+	if (state.vspec == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer and verifier specification\n");
+		
+		return;
+	}
+	
+	state.pubkey = read_pubkey(issuer_pubkey);
+	
+	if (state.pubkey == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer public key\n");
+		
+		delete state.vspec;
+		
+		return;
+	}
+	
+	// Build the tables of the public key before the sessions start;
+	// after this, the sessions only read from the public key
+	state.pubkey->precompute(*silvia_system_parameters::i());
+	
+	state.pool = new silvia_thread_pool();
+	
+	pthread_mutex_init(&state.output_lock, NULL);
+	
+	// Find all attached readers
+	std::vector<reader_thread*> readers;
+	
+#ifdef WITH_PCSC
+	std::vector<std::string> pcsc_readers;
+	
+	silvia_pcsc_reader_monitor::list_readers(pcsc_readers);
+	
+	for (std::vector<std::string>::iterator i = pcsc_readers.begin(); i != pcsc_readers.end(); i++)
+	{
+		reader_thread* reader = new reader_thread();
+		
+		reader->state = &state;
+		reader->channel_type = SILVIA_CHANNEL_PCSC;
+		reader->reader_id = *i;
+		reader->reader_name = *i;
+		
+		readers.push_back(reader);
+	}
+#endif // WITH_PCSC
+#ifdef WITH_NFC
+	std::vector<std::string> nfc_readers;
+	
+	silvia_nfc_reader_monitor::list_readers(nfc_readers);
+	
+	for (std::vector<std::string>::iterator i = nfc_readers.begin(); i != nfc_readers.end(); i++)
+	{
+		reader_thread* reader = new reader_thread();
+		
+		reader->state = &state;
+		reader->channel_type = SILVIA_CHANNEL_NFC;
+		reader->reader_id = *i;
+		reader->reader_name = "NFC " + *i;
+		
+		readers.push_back(reader);
+	}
+#endif // WITH_NFC
+	
+	if (readers.empty())
+	{
+		fprintf(stderr, "No card readers found\n");
+	}
+	else
+	{
+		printf("Monitoring %lu readers using %lu worker threads\n", (unsigned long) readers.size(), (unsigned long) state.pool->size());
+	}
+	
+	// Start a thread for every reader and wait until they all stop
+	for (std::vector<reader_thread*>::iterator i = readers.begin(); i != readers.end(); i++)
+	{
+		pthread_create(&(*i)->thread, NULL, reader_main, *i);
+	}
+	
+	for (std::vector<reader_thread*>::iterator i = readers.begin(); i != readers.end(); i++)
+	{
+		pthread_join((*i)->thread, NULL);
+		
+		delete *i;
+	}
+	
+	delete state.pool;
+	
+	pthread_mutex_destroy(&state.output_lock);
+	
+	delete state.vspec;
+	delete state.pubkey;
+}
+
+#endif // WITH_PCSC || WITH_NFC
+
+#ifdef HAVE_SYS_EPOLL_H
+
+////////////////////////////////////////////////////////////////////////
+// Server mode
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Verification session for a client of the server; every round runs
+ * on the worker pool of the server
+ */
+class verifier_server_session : public silvia_session
+{
+public:
+	verifier_server_session(silvia_pub_key* pubkey, silvia_verifier_specification* vspec, bool force_pin, silvia_scheme_snapshot* snapshot = NULL, const silvia_runtime* runtime = NULL)
+		: verifier(pubkey, vspec, runtime)
+	{
+		this->vspec = vspec;
+		this->force_pin = force_pin;
+		this->snapshot = snapshot;
+		
+		round = 0;
+	}
+	
+	virtual ~verifier_server_session()
+	{
+		// The key and specification of the session belong to the snapshot
+		if (snapshot != NULL)
+		{
+			snapshot->release();
+		}
+	}
+	
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands)
+	{
+		switch(round++)
+		{
+		case 0:
+			// First, perform application selection
+			commands = verifier.get_select_commands();
+			
+			return SILVIA_SESSION_RUNNING;
+		case 1:
+			if (!check_results(results))
+			{
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			if (!verifier.submit_select_data(results))
+			{
+				verifier.abort();
+				
+				add_message("carderror no-application");
+				
+				return SILVIA_SESSION_FAILED;
+			}
+			
+			// Now, perform the actual verification
+			commands = verifier.get_proof_commands();
+			
+			if (force_pin)
+			{
+				require_pin();
+			}
+			
+			return SILVIA_SESSION_RUNNING;
+		case 2:
+			if (!check_results(results))
+			{
+				return SILVIA_SESSION_FAILED;
+			}
+			else
+			{
+				std::vector<std::pair<std::string, bytestring> > revealed;
+				
+				if (!verifier.submit_and_verify(results, revealed))
+				{
+					add_message("carderror invalid-sig");
+					
+					return SILVIA_SESSION_FAILED;
+				}
+				
+				std::vector<std::string> output;
+				
+				format_revealed(vspec, revealed, true, output);
+				
+				for (std::vector<std::string>::iterator i = output.begin(); i != output.end(); i++)
+				{
+					add_message(*i);
+				}
+			}
+			
+			return SILVIA_SESSION_SUCCEEDED;
+		default:
+			return SILVIA_SESSION_FAILED;
+		}
+	}
+	
+	virtual bool accept_status(unsigned short sw)
+	{
+		return ((sw == 0x9000) || (sw == 0x6A82) || (sw == 0x6D00));
+	}
+
+private:
+	// Check that the card did not stop the round with an error
+	bool check_results(std::vector<bytestring>& results)
+	{
+		if (!results.empty())
+		{
+			unsigned short sw = silvia_apdu::get_sw(results.back());
+			
+			if ((sw == 0x9000) || (sw == 0x6A82) || (sw == 0x6D00))
+			{
+				return true;
+			}
+			
+			add_message("error " + silvia_apdu::sw_error(sw));
+		}
+		else
+		{
+			add_message("error card-error");
+		}
+		
+		verifier.abort();
+		
+		return false;
+	}
+	
+	silvia_irma_verifier verifier;
+	silvia_verifier_specification* vspec;
+	silvia_scheme_snapshot* snapshot;
+	bool force_pin;
+	int round;
+};
+
+/**
+ * Session that only reports an error to the client
+ */
+class verifier_error_session : public silvia_session
+{
+public:
+	verifier_error_session(const std::string& error)
+	{
+		this->error = error;
+	}
+	
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands)
+	{
+		add_message(error);
+		
+		return SILVIA_SESSION_FAILED;
+	}
+
+private:
+	std::string error;
+};
+
+class verifier_session_factory : public silvia_session_factory
+{
+public:
+	verifier_session_factory(silvia_pub_key* pubkey, silvia_verifier_specification* vspec, bool force_pin)
+	{
+		this->pubkey = pubkey;
+		this->vspec = vspec;
+		this->force_pin = force_pin;
+	}
+	
+	virtual silvia_session* create_session()
+	{
+		return new verifier_server_session(pubkey, vspec, force_pin);
+	}
+
+private:
+	silvia_pub_key* pubkey;
+	silvia_verifier_specification* vspec;
+	bool force_pin;
+};
+
+/**
+ * Creates sessions that verify a credential from the current snapshot
+ * of a scheme directory; a session keeps the snapshot it started with,
+ * so reloading the scheme does not affect sessions in progress
+ */
+class scheme_session_factory : public silvia_session_factory
+{
+public:
+	scheme_session_factory(silvia_scheme_registry* registry, std::string issuer, unsigned short credential_id, int verifier_id, bool force_pin)
+	{
+		this->registry = registry;
+		this->issuer = issuer;
+		this->credential_id = credential_id;
+		this->verifier_id = verifier_id;
+		this->force_pin = force_pin;
+	}
+	
+	virtual silvia_session* create_session()
+	{
+		silvia_scheme_snapshot* snapshot = registry->acquire();
+		
+		silvia_pub_key* pubkey = snapshot->get_pubkey(issuer);
+		
+		if (pubkey == NULL)
+		{
+			snapshot->release();
+			
+			return new verifier_error_session("error no-pubkey");
+		}
+		
+		const std::vector<silvia_verifier_specification*>& vspecs = snapshot->get_verifier_specs(issuer, credential_id);
+		
+		for (std::vector<silvia_verifier_specification*>::const_iterator i = vspecs.begin(); i != vspecs.end(); i++)
+		{
+			if ((verifier_id < 0) || ((int) (*i)->get_verifier_id() == verifier_id))
+			{
+				return new verifier_server_session(pubkey, *i, force_pin, snapshot, &registry->get_runtime());
+			}
+		}
+		
+		snapshot->release();
+		
+		return new verifier_error_session("error no-verifier");
+	}
+
+private:
+	silvia_scheme_registry* registry;
+	std::string issuer;
+	unsigned short credential_id;
+	int verifier_id;
+	bool force_pin;
+};
+
+// Parse <issuer>:<credential-id>[:<verifier-id>]
+bool parse_credential(const std::string& credential, std::string& issuer, unsigned short& credential_id, int& verifier_id)
+{
+	size_t first = credential.find(':');
+	
+	if ((first == std::string::npos) || (first == 0))
+	{
+		return false;
+	}
+	
+	issuer = credential.substr(0, first);
+	
+	size_t second = credential.find(':', first + 1);
+	
+	std::string cred_str = credential.substr(first + 1, (second == std::string::npos) ? std::string::npos : second - first - 1);
+	
+	if (cred_str.empty())
+	{
+		return false;
+	}
+	
+	credential_id = (unsigned short) atoi(cred_str.c_str());
+	verifier_id = (second == std::string::npos) ? -1 : atoi(credential.substr(second + 1).c_str());
+	
+	return true;
+}
+
+void serve(silvia_session_factory* factory, std::string listen_address)
+{
+	silvia_thread_pool pool;
+	silvia_stdio_server server(factory, &pool);
+	
+	if (!server.listen(listen_address))
+	{
+		fprintf(stderr, "Failed to listen on %s\n", listen_address.c_str());
+	}
+	else
+	{
+		printf("Listening on %s using %lu worker threads\n", listen_address.c_str(), (unsigned long) pool.size()); fflush(stdout);
+		
+		if (!server.run())
+		{
+			fprintf(stderr, "Failed to run the server\n");
+		}
+	}
+}
+
+void scheme_server_loop(std::string scheme_dir, std::string credential, bool force_pin, std::string listen_address)
+{
+	printf("Silvia command-line IRMA verifier %s\n\n", VERSION);
+	
+	std::string issuer;
+	unsigned short credential_id;
+	int verifier_id;
+	
+	if (!parse_credential(credential, issuer, credential_id, verifier_id))
+	{
+		fprintf(stderr, "Invalid credential %s\n", credential.c_str());
+		
+		return;
+	}
+	
+	silvia_scheme_registry registry(scheme_dir);
+	
+	if (!registry.start_watching())
+	{
+		fprintf(stderr, "Changes to %s will not be picked up on this platform\n", scheme_dir.c_str());
+		
+		registry.reload();
+	}
+	
+	scheme_session_factory factory(&registry, issuer, credential_id, verifier_id, force_pin);
+	
+	serve(&factory, listen_address);
+}
+
+void server_loop(std::string issuer_spec, std::string verifier_spec, std::string issuer_pubkey, bool force_pin, std::string listen_address)
+{
+	printf("Silvia command-line IRMA verifier %s\n\n", VERSION);
+	
+	// Read configuration files once for all sessions
+	silvia_verifier_specification* vspec = read_verifier_spec(issuer_spec, verifier_spec);
+	
+	if (vspec == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer and verifier specification\n");
+		
+		return;
+	}
+	
+	silvia_pub_key* pubkey = read_pubkey(issuer_pubkey);
+	
+	if (pubkey == NULL)
+	{
+		fprintf(stderr, "Failed to read issuer public key\n");
+		
+		delete vspec;
+		
+		return;
+	}
+	
+	// Build the tables of the public key before the sessions start;
+	// after this, the sessions only read from the public key
+	pubkey->precompute(*silvia_system_parameters::i());
+	
+	verifier_session_factory factory(pubkey, vspec, force_pin);
+	
+	serve(&factory, listen_address);
+	
+	delete vspec;
+	delete pubkey;
+}
+
+#endif // HAVE_SYS_EPOLL_H
+
 int main(int argc, char* argv[])
 {
 	// Set library parameters
@@ -734,7 +1545,14 @@ int main(int argc, char* argv[])
 	std::string issuer_spec;
 	std::string verifier_spec;
 	std::string issuer_pubkey;
+	std::string cache_file;
+	std::string scheme_dir;
+	std::string credential;
 	bool force_pin = false;
+	std::string listen_address;
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	bool multi_reader = false;
+#endif // WITH_PCSC || WITH_NFC
 	int c = 0;
 #if defined(WITH_PCSC)
 	int channel_type = SILVIA_CHANNEL_PCSC;
@@ -745,13 +1563,13 @@ int main(int argc, char* argv[])
 #endif
 	
 #if defined(WITH_PCSC) && defined(WITH_NFC)
-	while ((c = getopt(argc, argv, "I:V:k:phvSPN")) != -1)
+	while ((c = getopt(argc, argv, "I:V:k:C:D:c:phvSBPNML:")) != -1)
 #elif defined(WITH_PCSC)
-	while ((c = getopt(argc, argv, "I:V:k:phvSP")) != -1)
+	while ((c = getopt(argc, argv, "I:V:k:C:D:c:phvSBPML:")) != -1)
 #elif defined(WITH_NFC)
-	while ((c = getopt(argc, argv, "I:V:k:phvSN")) != -1)
+	while ((c = getopt(argc, argv, "I:V:k:C:D:c:phvSBNML:")) != -1)
 #else
-	while ((c = getopt(argc, argv, "I:V:k:phvS")) != -1)
+	while ((c = getopt(argc, argv, "I:V:k:C:D:c:phvSBL:")) != -1)
 #endif
 	{
 		switch (c)
@@ -771,6 +1589,9 @@ int main(int argc, char* argv[])
 		case 'k':
 			issuer_pubkey = std::string(optarg);
 			break;
+		case 'C':
+			cache_file = std::string(optarg);
+			break;
 		case 'p':
 			force_pin = true;
             break;
@@ -778,6 +1599,9 @@ int main(int argc, char* argv[])
             channel_type = SILVIA_CHANNEL_STDIO;
             parseable_output = true;
             break;
+		case 'B':
+			binary_framing = true;
+			break;
 #if defined(WITH_PCSC)
 		case 'P':
 			channel_type = SILVIA_CHANNEL_PCSC;
@@ -788,10 +1612,64 @@ int main(int argc, char* argv[])
 			channel_type = SILVIA_CHANNEL_NFC;
 			break;
 #endif
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+		case 'M':
+			multi_reader = true;
+			break;
+#endif
+		case 'L':
+			listen_address = std::string(optarg);
+			break;
+		case 'D':
+			scheme_dir = std::string(optarg);
+			break;
+		case 'c':
+			credential = std::string(optarg);
+			break;
 		}
 	}
 	
-	if (issuer_spec.empty())
+	if (!scheme_dir.empty())
+	{
+#ifdef HAVE_SYS_EPOLL_H
+		if (listen_address.empty() || credential.empty())
+		{
+			fprintf(stderr, "A scheme directory requires -c and -L\n");
+			
+			return -1;
+		}
+		
+		scheme_server_loop(scheme_dir, credential, force_pin, listen_address);
+		
+		return 0;
+#else
+		fprintf(stderr, "Server mode is not supported on this platform\n");
+		
+		return -1;
+#endif // HAVE_SYS_EPOLL_H
+	}
+	
+	if (!cache_file.empty())
+	{
+		cache = new silvia_cache();
+		
+		if (!cache->open(cache_file))
+		{
+			if (parseable_output)
+			{
+				printf("error cache-error\n"); fflush(stdout);
+				exit(-3);
+			}
+			else
+			{
+				fprintf(stderr, "Failed to read compiled cache %s\n", cache_file.c_str());
+			}
+			
+			return -1;
+		}
+	}
+	
+	if (issuer_spec.empty() && (cache == NULL))
 	{
         if(parseable_output)
         {
@@ -806,7 +1684,7 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	
-	if (verifier_spec.empty())
+	if (verifier_spec.empty() && (cache == NULL))
 	{
         if(parseable_output)
         {
@@ -821,7 +1699,7 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	
-	if (issuer_pubkey.empty())
+	if (issuer_pubkey.empty() && (cache == NULL))
 	{
         if(parseable_output)
         {
@@ -837,7 +1715,7 @@ int main(int argc, char* argv[])
 	}
 	
 #ifdef WITH_NFC
-	if (channel_type == SILVIA_CHANNEL_NFC)
+	if ((channel_type == SILVIA_CHANNEL_NFC) || multi_reader)
 	{
 		// Handle signals when using NFC; this prevents the NFC reader
 		// from going into an undefined state when the user aborts the
@@ -849,6 +1727,28 @@ int main(int argc, char* argv[])
 	}
 #endif
 	
+	if (!listen_address.empty())
+	{
+#ifdef HAVE_SYS_EPOLL_H
+		server_loop(issuer_spec, verifier_spec, issuer_pubkey, force_pin, listen_address);
+		
+		return 0;
+#else
+		fprintf(stderr, "Server mode is not supported on this platform\n");
+		
+		return -1;
+#endif // HAVE_SYS_EPOLL_H
+	}
+	
+#if defined(WITH_PCSC) || defined(WITH_NFC)
+	if (multi_reader)
+	{
+		multi_reader_loop(issuer_spec, verifier_spec, issuer_pubkey);
+		
+		return 0;
+	}
+#endif // WITH_PCSC || WITH_NFC
+	
 	verifier_loop(issuer_spec, verifier_spec, issuer_pubkey, force_pin, channel_type);
 	
 	return 0;
@@ -0,0 +1,784 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_cache.cpp
+
+ Compiled binary cache for issuer keys and issue/verifier specifications
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_cache.h"
+#include "silvia_fixed_base.h"
+#include <gmpxx.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// File layout; all values are little endian
+//
+// header:   "SLVC" || version (2) || limb bits (2) || section count (4) || reserved (4)
+// sections: type (4) || length (4) || data || padding to a multiple of 8 bytes
+// trailer:  Fletcher-64 checksum (8) over the header and the sections
+#define CACHE_MAGIC		"SLVC"
+#define CACHE_HEADER_SIZE	16
+#define CACHE_TRAILER_SIZE	8
+#define CACHE_ALIGN		8
+
+// Size of the words in which numbers are stored
+#define CACHE_WORD_SIZE		8
+
+static void put_le(std::vector<unsigned char>& out, uint64_t value, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		out.push_back((unsigned char) (value & 0xff));
+		value >>= 8;
+	}
+}
+
+static uint64_t get_le(const unsigned char* in, size_t len)
+{
+	uint64_t value = 0;
+
+	for (size_t i = len; i > 0; i--)
+	{
+		value = (value << 8) | in[i - 1];
+	}
+
+	return value;
+}
+
+// Fletcher-64 checksum over little endian 32-bit words; the size
+// must be a multiple of 4
+static uint64_t checksum(const unsigned char* data, size_t size)
+{
+	const uint64_t mod = 0xffffffffULL;
+	uint64_t sum1 = 0;
+	uint64_t sum2 = 0;
+
+	for (size_t i = 0; i < size; i += 4)
+	{
+		sum1 += get_le(&data[i], 4);
+		if (sum1 >= mod) sum1 -= mod;
+
+		sum2 += sum1;
+		if (sum2 >= mod) sum2 -= mod;
+	}
+
+	return (sum2 << 32) | sum1;
+}
+
+// Today, in days since the epoch
+static int today()
+{
+	return (int) (time(NULL) / 86400);
+}
+
+////////////////////////////////////////////////////////////////////////
+// silvia_cache_writer implementation
+////////////////////////////////////////////////////////////////////////
+
+silvia_cache_writer::silvia_cache_writer()
+{
+	section_start = 0;
+	section_count = 0;
+	has_privkey = false;
+}
+
+void silvia_cache_writer::begin_section(silvia_cache_section_t type)
+{
+	put_u32(type);
+
+	// The length is filled in when the section is complete
+	section_start = sections.size();
+	put_u32(0);
+}
+
+void silvia_cache_writer::end_section()
+{
+	size_t len = sections.size() - section_start - 4;
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		sections[section_start + i] = (unsigned char) ((len >> (i * 8)) & 0xff);
+	}
+
+	while ((sections.size() % CACHE_ALIGN) != 0)
+	{
+		sections.push_back(0x00);
+	}
+
+	section_count++;
+}
+
+void silvia_cache_writer::put_u8(unsigned char value)
+{
+	sections.push_back(value);
+}
+
+void silvia_cache_writer::put_u16(unsigned short value)
+{
+	put_le(sections, value, 2);
+}
+
+void silvia_cache_writer::put_u32(unsigned long value)
+{
+	put_le(sections, value, 4);
+}
+
+void silvia_cache_writer::put_mpz(const mpz_class& value)
+{
+	size_t words = (mpz_sizeinbase(value.get_mpz_t(), 2) + (CACHE_WORD_SIZE * 8) - 1) / (CACHE_WORD_SIZE * 8);
+
+	if (mpz_sgn(value.get_mpz_t()) == 0) words = 0;
+
+	put_u32(words);
+
+	size_t pos = sections.size();
+
+	sections.resize(pos + (words * CACHE_WORD_SIZE));
+
+	if (words > 0)
+	{
+		mpz_export(&sections[pos], NULL, -1, CACHE_WORD_SIZE, -1, 0, value.get_mpz_t());
+	}
+}
+
+void silvia_cache_writer::put_string(const std::string& value)
+{
+	put_u32(value.size());
+
+	sections.insert(sections.end(), value.begin(), value.end());
+}
+
+void silvia_cache_writer::add_pubkey(silvia_pub_key* pubkey, bool tables /* = false */, const silvia_system_parameters* params /* = NULL */)
+{
+	begin_section(SILVIA_CACHE_PUBKEY);
+
+	put_mpz(pubkey->get_n());
+	put_mpz(pubkey->get_S());
+	put_mpz(pubkey->get_Z());
+	put_u32(pubkey->get_R().size());
+
+	for (std::vector<mpz_class>::iterator i = pubkey->get_R().begin(); i != pubkey->get_R().end(); i++)
+	{
+		put_mpz(*i);
+	}
+
+	end_section();
+
+	if (!tables) return;
+
+	if (params != NULL)
+	{
+		pubkey->precompute(*params);
+	}
+	else
+	{
+		pubkey->precompute();
+	}
+
+	begin_section(SILVIA_CACHE_TABLES);
+
+	put_u32(pubkey->get_fixed_base_window());
+	put_u32(pubkey->get_R().size() + 1);
+
+	for (size_t i = 0; i < pubkey->get_R().size() + 1; i++)
+	{
+		silvia_fixed_base* base = (i == 0) ? pubkey->get_fixed_S() : pubkey->get_fixed_R(i - 1);
+
+		put_u32(base->size());
+
+		for (size_t j = 0; j < base->size(); j++)
+		{
+			put_mpz(base->get_power(j));
+		}
+	}
+
+	end_section();
+}
+
+void silvia_cache_writer::add_privkey(silvia_priv_key* privkey)
+{
+	begin_section(SILVIA_CACHE_PRIVKEY);
+
+	put_mpz(privkey->get_p());
+	put_mpz(privkey->get_q());
+
+	end_section();
+
+	has_privkey = true;
+}
+
+void silvia_cache_writer::add_verifier_spec(silvia_verifier_specification* vspec)
+{
+	begin_section(SILVIA_CACHE_VERIFIER_SPEC);
+
+	put_string(vspec->get_verifier_name());
+	put_string(vspec->get_short_msg());
+	put_u32(vspec->get_verifier_id());
+	put_u16(vspec->get_credential_id());
+	put_u32(vspec->get_attribute_names().size());
+
+	for (std::vector<std::string>::iterator i = vspec->get_attribute_names().begin(); i != vspec->get_attribute_names().end(); i++)
+	{
+		put_string(*i);
+	}
+
+	put_u32(vspec->get_D().size());
+
+	for (std::vector<bool>::iterator i = vspec->get_D().begin(); i != vspec->get_D().end(); i++)
+	{
+		put_u8(*i ? 1 : 0);
+	}
+
+	end_section();
+}
+
+void silvia_cache_writer::add_issue_spec(silvia_issue_specification* ispec)
+{
+	begin_section(SILVIA_CACHE_ISSUE_SPEC);
+
+	put_string(ispec->get_credential_name());
+	put_string(ispec->get_issuer_name());
+	put_u16(ispec->get_credential_id());
+	put_u32((unsigned long) (ispec->get_expires() - today()));
+	put_u32(ispec->get_attributes().size());
+
+	for (std::vector<silvia_attribute*>::iterator i = ispec->get_attributes().begin(); i != ispec->get_attributes().end(); i++)
+	{
+		if ((*i)->is_of_type(SILVIA_STRING_ATTR))
+		{
+			put_u8(SILVIA_STRING_ATTR);
+			put_string(((silvia_string_attribute*) *i)->get_value());
+		}
+		else if ((*i)->is_of_type(SILVIA_BOOL_ATTR))
+		{
+			put_u8(SILVIA_BOOL_ATTR);
+			put_mpz((*i)->rep());
+		}
+		else
+		{
+			put_u8(SILVIA_INT_ATTR);
+			put_mpz((*i)->rep());
+		}
+	}
+
+	end_section();
+}
+
+std::vector<unsigned char> silvia_cache_writer::get_data()
+{
+	std::vector<unsigned char> rv;
+
+	rv.resize(4);
+	rv.reserve(CACHE_HEADER_SIZE + sections.size() + CACHE_TRAILER_SIZE);
+
+	memcpy(&rv[0], CACHE_MAGIC, 4);
+	put_le(rv, SILVIA_CACHE_VERSION, 2);
+	put_le(rv, GMP_NUMB_BITS, 2);
+	put_le(rv, section_count, 4);
+	put_le(rv, 0, 4);
+
+	rv.insert(rv.end(), sections.begin(), sections.end());
+
+	put_le(rv, checksum(&rv[0], rv.size()), 8);
+
+	return rv;
+}
+
+bool silvia_cache_writer::write(const std::string file_name)
+{
+	std::vector<unsigned char> cache_data = get_data();
+
+	// Write to a temporary file first and move it in place, so a
+	// process that maps the cache never sees a partially written file
+	std::string tmp_name = file_name + ".tmp";
+
+	// Only the owner may read a cache with a private key; a stale
+	// temporary file is removed so it cannot keep looser permissions
+	unlink(tmp_name.c_str());
+
+	int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, has_privkey ? 0600 : 0644);
+
+	if (fd < 0) return false;
+
+	FILE* out = fdopen(fd, "wb");
+
+	if (out == NULL)
+	{
+		close(fd);
+		unlink(tmp_name.c_str());
+
+		return false;
+	}
+
+	bool rv = (fwrite(&cache_data[0], 1, cache_data.size(), out) == cache_data.size());
+
+	if (fclose(out) != 0) rv = false;
+
+	if (rv)
+	{
+		rv = (rename(tmp_name.c_str(), file_name.c_str()) == 0);
+	}
+
+	if (!rv)
+	{
+		unlink(tmp_name.c_str());
+	}
+
+	return rv;
+}
+
+////////////////////////////////////////////////////////////////////////
+// silvia_cache implementation
+////////////////////////////////////////////////////////////////////////
+
+/**
+ * Reads values from a section; reading beyond the end of the
+ * section sets the failed flag and returns zeroes
+ */
+class silvia_cache_cursor
+{
+public:
+	silvia_cache_cursor(const unsigned char* data, size_t size)
+	{
+		this->data = data;
+		this->size = size;
+		pos = 0;
+		failed = (data == NULL);
+	}
+
+	const unsigned char* get(size_t len)
+	{
+		if (failed || (len > (size - pos)))
+		{
+			failed = true;
+
+			return NULL;
+		}
+
+		const unsigned char* rv = &data[pos];
+
+		pos += len;
+
+		return rv;
+	}
+
+	unsigned long get_u32()
+	{
+		const unsigned char* in = get(4);
+
+		return (in == NULL) ? 0 : (unsigned long) get_le(in, 4);
+	}
+
+	unsigned short get_u16()
+	{
+		const unsigned char* in = get(2);
+
+		return (in == NULL) ? 0 : (unsigned short) get_le(in, 2);
+	}
+
+	unsigned char get_u8()
+	{
+		const unsigned char* in = get(1);
+
+		return (in == NULL) ? 0 : *in;
+	}
+
+	void get_mpz(mpz_class& value)
+	{
+		size_t words = get_u32();
+
+		if (words > (size / CACHE_WORD_SIZE))
+		{
+			failed = true;
+
+			return;
+		}
+
+		const unsigned char* in = get(words * CACHE_WORD_SIZE);
+
+		if (in == NULL) return;
+
+		mpz_import(value.get_mpz_t(), words, -1, CACHE_WORD_SIZE, -1, 0, in);
+	}
+
+	std::string get_string()
+	{
+		size_t len = get_u32();
+		const unsigned char* in = get(len);
+
+		return (in == NULL) ? std::string() : std::string((const char*) in, len);
+	}
+
+	// Limit the number of elements of a list to what can possibly
+	// be in the section, to prevent excessive allocations
+	size_t get_count()
+	{
+		size_t count = get_u32();
+
+		if (count > (size - pos))
+		{
+			failed = true;
+
+			return 0;
+		}
+
+		return count;
+	}
+
+	bool failed;
+
+private:
+	const unsigned char* data;
+	size_t size;
+	size_t pos;
+};
+
+silvia_cache::silvia_cache()
+{
+	map = NULL;
+	map_size = 0;
+
+	close();
+}
+
+silvia_cache::~silvia_cache()
+{
+	close();
+}
+
+bool silvia_cache::open(const std::string file_name)
+{
+	close();
+
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+
+	if (fd < 0) return false;
+
+	struct stat st;
+
+	if ((fstat(fd, &st) != 0) || (st.st_size <= 0))
+	{
+		::close(fd);
+
+		return false;
+	}
+
+	void* file_map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	::close(fd);
+
+	if (file_map == MAP_FAILED) return false;
+
+	if (!open((const unsigned char*) file_map, st.st_size))
+	{
+		munmap(file_map, st.st_size);
+
+		return false;
+	}
+
+	map = file_map;
+	map_size = st.st_size;
+
+	return true;
+}
+
+bool silvia_cache::open(const unsigned char* data, size_t size)
+{
+	close();
+
+	if ((size < (CACHE_HEADER_SIZE + CACHE_TRAILER_SIZE)) || ((size % CACHE_ALIGN) != 0))
+	{
+		return false;
+	}
+
+	if ((memcmp(data, CACHE_MAGIC, 4) != 0) || (get_le(&data[4], 2) != SILVIA_CACHE_VERSION))
+	{
+		return false;
+	}
+
+	size_t end = size - CACHE_TRAILER_SIZE;
+
+	if (checksum(data, end) != get_le(&data[end], CACHE_TRAILER_SIZE))
+	{
+		return false;
+	}
+
+	// The tables are stored in Montgomery form, which depends on the limb size
+	tables_usable = (get_le(&data[6], 2) == GMP_NUMB_BITS);
+
+	size_t count = get_le(&data[8], 4);
+	size_t pos = CACHE_HEADER_SIZE;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if ((end - pos) < 8) return false;
+
+		size_t type = get_le(&data[pos], 4);
+		size_t len = get_le(&data[pos + 4], 4);
+
+		pos += 8;
+
+		if (len > (end - pos)) return false;
+
+		// Unknown sections are skipped
+		if ((type > 0) && (type < SILVIA_CACHE_MAX_SECTION))
+		{
+			section_data[type] = &data[pos];
+			section_size[type] = len;
+		}
+
+		pos += len;
+		pos += (CACHE_ALIGN - (pos % CACHE_ALIGN)) % CACHE_ALIGN;
+	}
+
+	this->data = data;
+	this->size = size;
+
+	return true;
+}
+
+void silvia_cache::close()
+{
+	if (map != NULL)
+	{
+		munmap(map, map_size);
+	}
+
+	map = NULL;
+	map_size = 0;
+	data = NULL;
+	size = 0;
+	tables_usable = false;
+
+	for (size_t i = 0; i < SILVIA_CACHE_MAX_SECTION; i++)
+	{
+		section_data[i] = NULL;
+		section_size[i] = 0;
+	}
+}
+
+bool silvia_cache::has(silvia_cache_section_t type)
+{
+	return (section_data[type] != NULL);
+}
+
+silvia_pub_key* silvia_cache::get_pubkey()
+{
+	silvia_cache_cursor in(section_data[SILVIA_CACHE_PUBKEY], section_size[SILVIA_CACHE_PUBKEY]);
+
+	mpz_class n;
+	mpz_class S;
+	mpz_class Z;
+	std::vector<mpz_class> R;
+
+	in.get_mpz(n);
+	in.get_mpz(S);
+	in.get_mpz(Z);
+
+	R.resize(in.get_count());
+
+	for (std::vector<mpz_class>::iterator i = R.begin(); i != R.end(); i++)
+	{
+		in.get_mpz(*i);
+	}
+
+	if (in.failed) return NULL;
+
+	silvia_pub_key* pubkey = new silvia_pub_key(n, S, Z, R);
+
+	if (tables_usable && has(SILVIA_CACHE_TABLES))
+	{
+		// If the tables cannot be loaded, they will be computed when needed
+		load_tables(pubkey);
+	}
+
+	return pubkey;
+}
+
+bool silvia_cache::load_tables(silvia_pub_key* pubkey)
+{
+	silvia_cache_cursor in(section_data[SILVIA_CACHE_TABLES], section_size[SILVIA_CACHE_TABLES]);
+
+	size_t window = in.get_u32();
+	size_t count = in.get_count();
+
+	if (in.failed || (count != (pubkey->get_R().size() + 1))) return false;
+
+	// A window outside the supported range cannot have been written by
+	// this implementation; the tables are computed when needed instead
+	if ((window == 0) || (window > SILVIA_FIXED_BASE_MAX_WINDOW)) return false;
+
+	// Read all tables before installing any of them
+	std::vector<std::vector<mpz_class> > tables(count);
+
+	for (size_t i = 0; (i < count) && !in.failed; i++)
+	{
+		tables[i].resize(in.get_count());
+
+		for (std::vector<mpz_class>::iterator j = tables[i].begin(); j != tables[i].end(); j++)
+		{
+			in.get_mpz(*j);
+		}
+	}
+
+	if (in.failed) return false;
+
+	// Every table must cover the exponents the protocols use with it
+	size_t S_bits;
+	size_t R_bits;
+
+	silvia_pub_key::get_exponent_bits(*silvia_system_parameters::i(), S_bits, R_bits);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t bits = (i == 0) ? S_bits : R_bits;
+
+		if (tables[i].size() < (bits + window - 1) / window) return false;
+	}
+
+	pubkey->set_fixed_base_window(window);
+
+	pubkey->get_fixed_S()->set_powers(tables[0]);
+
+	for (size_t i = 1; i < count; i++)
+	{
+		pubkey->get_fixed_R(i - 1)->set_powers(tables[i]);
+	}
+
+	return true;
+}
+
+silvia_priv_key* silvia_cache::get_privkey()
+{
+	silvia_cache_cursor in(section_data[SILVIA_CACHE_PRIVKEY], section_size[SILVIA_CACHE_PRIVKEY]);
+
+	mpz_class p;
+	mpz_class q;
+
+	in.get_mpz(p);
+	in.get_mpz(q);
+
+	if (in.failed) return NULL;
+
+	return new silvia_priv_key(p, q);
+}
+
+silvia_verifier_specification* silvia_cache::get_verifier_spec()
+{
+	silvia_cache_cursor in(section_data[SILVIA_CACHE_VERIFIER_SPEC], section_size[SILVIA_CACHE_VERIFIER_SPEC]);
+
+	std::string verifier_name = in.get_string();
+	std::string short_msg = in.get_string();
+	unsigned int verifier_id = in.get_u32();
+	unsigned short credential_id = in.get_u16();
+
+	std::vector<std::string> attribute_names(in.get_count());
+
+	for (std::vector<std::string>::iterator i = attribute_names.begin(); i != attribute_names.end(); i++)
+	{
+		*i = in.get_string();
+	}
+
+	std::vector<bool> D(in.get_count());
+
+	for (size_t i = 0; i < D.size(); i++)
+	{
+		D[i] = (in.get_u8() != 0);
+	}
+
+	if (in.failed) return NULL;
+
+	return new silvia_verifier_specification(verifier_name, short_msg, verifier_id, credential_id, attribute_names, D);
+}
+
+silvia_issue_specification* silvia_cache::get_issue_spec()
+{
+	silvia_cache_cursor in(section_data[SILVIA_CACHE_ISSUE_SPEC], section_size[SILVIA_CACHE_ISSUE_SPEC]);
+
+	std::string credential_name = in.get_string();
+	std::string issuer_name = in.get_string();
+	unsigned short credential_id = in.get_u16();
+	int expires = (int) (int32_t) in.get_u32() + today();
+
+	std::vector<silvia_attribute*> attributes;
+	size_t count = in.get_count();
+
+	for (size_t i = 0; (i < count) && !in.failed; i++)
+	{
+		unsigned char type = in.get_u8();
+
+		switch(type)
+		{
+		case SILVIA_STRING_ATTR:
+			attributes.push_back(new silvia_string_attribute(in.get_string()));
+			break;
+		case SILVIA_BOOL_ATTR:
+			{
+				mpz_class rep;
+
+				in.get_mpz(rep);
+
+				attributes.push_back(new silvia_boolean_attribute(rep != 0));
+			}
+			break;
+		case SILVIA_INT_ATTR:
+			{
+				mpz_class rep;
+
+				in.get_mpz(rep);
+
+				attributes.push_back(new silvia_integer_attribute(rep));
+			}
+			break;
+		default:
+			in.failed = true;
+			break;
+		}
+	}
+
+	if (in.failed)
+	{
+		for (std::vector<silvia_attribute*>::iterator i = attributes.begin(); i != attributes.end(); i++)
+		{
+			delete *i;
+		}
+
+		return NULL;
+	}
+
+	return new silvia_issue_specification(credential_name, issuer_name, credential_id, expires, attributes);
+}
@@ -0,0 +1,235 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_cache.h
+
+ Compiled binary cache for issuer keys and issue/verifier specifications
+ *****************************************************************************/
+
+#ifndef _SILVIA_CACHE_H
+#define _SILVIA_CACHE_H
+
+#include <gmpxx.h>
+#include "silvia_types.h"
+#include "silvia_parameters.h"
+#include "silvia_verifier_spec.h"
+#include "silvia_issue_spec.h"
+#include <string>
+#include <vector>
+
+/**
+ * Version of the cache format
+ */
+#define SILVIA_CACHE_VERSION	1
+
+/**
+ * Section types in a cache file
+ */
+typedef enum
+{
+	SILVIA_CACHE_PUBKEY = 1,	/**< issuer public key */
+	SILVIA_CACHE_PRIVKEY,		/**< issuer private key */
+	SILVIA_CACHE_VERIFIER_SPEC,	/**< verifier specification */
+	SILVIA_CACHE_ISSUE_SPEC,	/**< credential issue specification */
+	SILVIA_CACHE_TABLES,		/**< precomputed tables of the public key */
+	SILVIA_CACHE_MAX_SECTION
+}
+silvia_cache_section_t;
+
+/**
+ * Cache writer class; compiles keys and specifications that were read
+ * from XML into a single binary cache file. The file consists of a
+ * header, a number of sections and a checksum; numbers are stored as
+ * little endian 64-bit words so they can be imported without parsing.
+ */
+class silvia_cache_writer
+{
+public:
+	/**
+	 * Constructor
+	 */
+	silvia_cache_writer();
+
+	/**
+	 * Add an issuer public key
+	 * @param pubkey the public key
+	 * @param tables also store the precomputed tables of the key
+	 * @param params the system parameters to size the tables for
+	 */
+	void add_pubkey(silvia_pub_key* pubkey, bool tables = false, const silvia_system_parameters* params = NULL);
+
+	/**
+	 * Add an issuer private key; a cache with a private key is
+	 * written with permissions for the owner only
+	 * @param privkey the private key
+	 */
+	void add_privkey(silvia_priv_key* privkey);
+
+	/**
+	 * Add a verifier specification
+	 * @param vspec the verifier specification
+	 */
+	void add_verifier_spec(silvia_verifier_specification* vspec);
+
+	/**
+	 * Add a credential issue specification; the expiry date is
+	 * stored relative to today, like in the XML specification
+	 * @param ispec the issue specification
+	 */
+	void add_issue_spec(silvia_issue_specification* ispec);
+
+	/**
+	 * Get the contents of the cache
+	 * @return the cache file contents
+	 */
+	std::vector<unsigned char> get_data();
+
+	/**
+	 * Write the cache to a file
+	 * @param file_name the name of the file
+	 * @return true if the file was written successfully
+	 */
+	bool write(const std::string file_name);
+
+private:
+	// Section handling
+	void begin_section(silvia_cache_section_t type);
+	void end_section();
+
+	// Value encoding
+	void put_u8(unsigned char value);
+	void put_u16(unsigned short value);
+	void put_u32(unsigned long value);
+	void put_mpz(const mpz_class& value);
+	void put_string(const std::string& value);
+
+	// The sections
+	std::vector<unsigned char> sections;
+	size_t section_start;
+	size_t section_count;
+
+	// Does the cache contain a private key?
+	bool has_privkey;
+};
+
+/**
+ * Cache class; maps a compiled cache file into memory and creates
+ * keys and specifications from it
+ */
+class silvia_cache
+{
+public:
+	/**
+	 * Constructor
+	 */
+	silvia_cache();
+
+	/**
+	 * Destructor
+	 */
+	~silvia_cache();
+
+	/**
+	 * Map a cache file into memory and check it
+	 * @param file_name the name of the file
+	 * @return true if the file is a valid cache
+	 */
+	bool open(const std::string file_name);
+
+	/**
+	 * Check cache data in memory; the data must remain valid
+	 * as long as the cache is used
+	 * @param data the cache data
+	 * @param size the size of the data
+	 * @return true if the data is a valid cache
+	 */
+	bool open(const unsigned char* data, size_t size);
+
+	/**
+	 * Release the cache file
+	 */
+	void close();
+
+	/**
+	 * Check if the cache has a section
+	 * @param type the section type
+	 * @return true if the cache has a section of this type
+	 */
+	bool has(silvia_cache_section_t type);
+
+	/**
+	 * Create the issuer public key; precomputed tables are installed
+	 * if the cache has them and they were made on a compatible platform
+	 * @return a new public key object or NULL if the cache has none
+	 */
+	silvia_pub_key* get_pubkey();
+
+	/**
+	 * Create the issuer private key
+	 * @return a new private key object or NULL if the cache has none
+	 */
+	silvia_priv_key* get_privkey();
+
+	/**
+	 * Create the verifier specification
+	 * @return a new verifier specification object or NULL if the cache has none
+	 */
+	silvia_verifier_specification* get_verifier_spec();
+
+	/**
+	 * Create the credential issue specification
+	 * @return a new issue specification object or NULL if the cache has none
+	 */
+	silvia_issue_specification* get_issue_spec();
+
+private:
+	// Prevent copying
+	silvia_cache(const silvia_cache&);
+	silvia_cache& operator=(const silvia_cache&);
+
+	// Install the precomputed tables on a public key
+	bool load_tables(silvia_pub_key* pubkey);
+
+	// The mapped file
+	void* map;
+	size_t map_size;
+
+	// The checked cache data
+	const unsigned char* data;
+	size_t size;
+
+	// Are the precomputed tables usable on this platform?
+	bool tables_usable;
+
+	// The sections
+	const unsigned char* section_data[SILVIA_CACHE_MAX_SECTION];
+	size_t section_size[SILVIA_CACHE_MAX_SECTION];
+};
+
+#endif // !_SILVIA_CACHE_H
@@ -0,0 +1,339 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ cachetests.cpp
+
+ Tests the compiled binary cache
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+#include <time.h>
+#include <unistd.h>
+#include "cachetests.h"
+#include "testvectors.h"
+#include "silvia_cache.h"
+#include "silvia_fixed_base.h"
+#include "silvia_types.h"
+#include "silvia_parameters.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(cache_tests);
+
+void cache_tests::setUp()
+{
+	set_test_parameters();
+}
+
+void cache_tests::tearDown()
+{
+	silvia_system_parameters::i()->reset();
+}
+
+// Issue specification with an attribute of every type
+static silvia_issue_specification* mixed_ispec()
+{
+	std::vector<silvia_attribute*> attributes;
+	
+	attributes.push_back(new silvia_string_attribute("yes"));
+	attributes.push_back(new silvia_integer_attribute(1234));
+	attributes.push_back(new silvia_boolean_attribute(true));
+	
+	return new silvia_issue_specification("ageLower", "MijnOverheid", 0xa, time(NULL) / 86400 + 365, attributes);
+}
+
+// Compile all test objects into a cache
+static std::vector<unsigned char> test_cache(bool tables)
+{
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_priv_key* privkey = test_privkey();
+	silvia_issue_specification* ispec = mixed_ispec();
+	silvia_verifier_specification* vspec = test_vspec();
+	
+	silvia_cache_writer writer;
+	
+	writer.add_pubkey(pubkey, tables);
+	writer.add_privkey(privkey);
+	writer.add_issue_spec(ispec);
+	writer.add_verifier_spec(vspec);
+	
+	delete pubkey;
+	delete privkey;
+	delete ispec;
+	delete vspec;
+	
+	return writer.get_data();
+}
+
+void cache_tests::test_roundtrip()
+{
+	std::vector<unsigned char> data = test_cache(false);
+	
+	silvia_cache cache;
+	
+	CPPUNIT_ASSERT(cache.open(&data[0], data.size()));
+	CPPUNIT_ASSERT(!cache.has(SILVIA_CACHE_TABLES));
+	
+	// Check the public key
+	silvia_pub_key* ref_pubkey = test_pubkey();
+	silvia_pub_key* pubkey = cache.get_pubkey();
+	
+	CPPUNIT_ASSERT(pubkey != NULL);
+	CPPUNIT_ASSERT(pubkey->get_n() == ref_pubkey->get_n());
+	CPPUNIT_ASSERT(pubkey->get_S() == ref_pubkey->get_S());
+	CPPUNIT_ASSERT(pubkey->get_Z() == ref_pubkey->get_Z());
+	CPPUNIT_ASSERT(pubkey->get_R() == ref_pubkey->get_R());
+	
+	delete pubkey;
+	delete ref_pubkey;
+	
+	// Check the private key
+	silvia_priv_key* ref_privkey = test_privkey();
+	silvia_priv_key* privkey = cache.get_privkey();
+	
+	CPPUNIT_ASSERT(privkey != NULL);
+	CPPUNIT_ASSERT(privkey->get_p() == ref_privkey->get_p());
+	CPPUNIT_ASSERT(privkey->get_q() == ref_privkey->get_q());
+	
+	delete privkey;
+	delete ref_privkey;
+	
+	// Check the issue specification
+	silvia_issue_specification* ref_ispec = mixed_ispec();
+	silvia_issue_specification* ispec = cache.get_issue_spec();
+	
+	CPPUNIT_ASSERT(ispec != NULL);
+	CPPUNIT_ASSERT(ispec->get_credential_name() == ref_ispec->get_credential_name());
+	CPPUNIT_ASSERT(ispec->get_issuer_name() == ref_ispec->get_issuer_name());
+	CPPUNIT_ASSERT(ispec->get_credential_id() == ref_ispec->get_credential_id());
+	CPPUNIT_ASSERT(ispec->get_expires() == ref_ispec->get_expires());
+	CPPUNIT_ASSERT(ispec->get_attributes().size() == 3);
+	CPPUNIT_ASSERT(ispec->get_attributes()[0]->is_of_type(SILVIA_STRING_ATTR));
+	CPPUNIT_ASSERT(((silvia_string_attribute*) ispec->get_attributes()[0])->get_value() == "yes");
+	CPPUNIT_ASSERT(ispec->get_attributes()[1]->is_of_type(SILVIA_INT_ATTR));
+	CPPUNIT_ASSERT(ispec->get_attributes()[2]->is_of_type(SILVIA_BOOL_ATTR));
+	
+	for (size_t i = 0; i < 3; i++)
+	{
+		CPPUNIT_ASSERT(ispec->get_attributes()[i]->rep() == ref_ispec->get_attributes()[i]->rep());
+	}
+	
+	delete ispec;
+	delete ref_ispec;
+	
+	// Check the verifier specification
+	silvia_verifier_specification* ref_vspec = test_vspec();
+	silvia_verifier_specification* vspec = cache.get_verifier_spec();
+	
+	CPPUNIT_ASSERT(vspec != NULL);
+	CPPUNIT_ASSERT(vspec->get_verifier_name() == ref_vspec->get_verifier_name());
+	CPPUNIT_ASSERT(vspec->get_short_msg() == ref_vspec->get_short_msg());
+	CPPUNIT_ASSERT(vspec->get_verifier_id() == ref_vspec->get_verifier_id());
+	CPPUNIT_ASSERT(vspec->get_credential_id() == ref_vspec->get_credential_id());
+	CPPUNIT_ASSERT(vspec->get_attribute_names() == ref_vspec->get_attribute_names());
+	CPPUNIT_ASSERT(vspec->get_D() == ref_vspec->get_D());
+	
+	delete vspec;
+	delete ref_vspec;
+	
+	// A cache without a section returns nothing for it
+	silvia_cache_writer writer;
+	silvia_pub_key* only_pubkey = test_pubkey();
+	
+	writer.add_pubkey(only_pubkey);
+	
+	delete only_pubkey;
+	
+	std::vector<unsigned char> pubkey_data = writer.get_data();
+	
+	CPPUNIT_ASSERT(cache.open(&pubkey_data[0], pubkey_data.size()));
+	CPPUNIT_ASSERT(cache.has(SILVIA_CACHE_PUBKEY));
+	CPPUNIT_ASSERT(cache.get_privkey() == NULL);
+	CPPUNIT_ASSERT(cache.get_issue_spec() == NULL);
+	CPPUNIT_ASSERT(cache.get_verifier_spec() == NULL);
+}
+
+void cache_tests::test_tables()
+{
+	std::vector<unsigned char> data = test_cache(true);
+	
+	silvia_cache cache;
+	
+	CPPUNIT_ASSERT(cache.open(&data[0], data.size()));
+	CPPUNIT_ASSERT(cache.has(SILVIA_CACHE_TABLES));
+	
+	silvia_pub_key* ref_pubkey = test_pubkey();
+	silvia_pub_key* pubkey = cache.get_pubkey();
+	
+	CPPUNIT_ASSERT(pubkey != NULL);
+	
+	ref_pubkey->precompute();
+	
+	// The loaded tables must be the same as freshly computed ones
+	CPPUNIT_ASSERT(pubkey->get_fixed_base_window() == ref_pubkey->get_fixed_base_window());
+	CPPUNIT_ASSERT(pubkey->get_fixed_S()->size() == ref_pubkey->get_fixed_S()->size());
+	CPPUNIT_ASSERT(pubkey->get_fixed_S()->size() > 0);
+	
+	for (size_t i = 0; i < pubkey->get_fixed_S()->size(); i++)
+	{
+		CPPUNIT_ASSERT(pubkey->get_fixed_S()->get_power(i) == ref_pubkey->get_fixed_S()->get_power(i));
+	}
+	
+	for (size_t i = 0; i < pubkey->get_R().size(); i++)
+	{
+		CPPUNIT_ASSERT(pubkey->get_fixed_R(i)->size() == ref_pubkey->get_fixed_R(i)->size());
+		CPPUNIT_ASSERT(pubkey->get_fixed_R(i)->get_power(1) == ref_pubkey->get_fixed_R(i)->get_power(1));
+	}
+	
+	// The loaded tables are frozen, so precomputing does not change them
+	size_t S_size = pubkey->get_fixed_S()->size();
+	
+	pubkey->precompute();
+	
+	CPPUNIT_ASSERT(pubkey->get_fixed_S()->size() == S_size);
+	
+	delete pubkey;
+	delete ref_pubkey;
+	
+	// Tables with an unsupported window are not loaded
+	silvia_pub_key* wide_pubkey = test_pubkey();
+	
+	wide_pubkey->set_fixed_base_window(SILVIA_FIXED_BASE_MAX_WINDOW + 1);
+	
+	silvia_cache_writer wide_writer;
+	
+	wide_writer.add_pubkey(wide_pubkey, true);
+	
+	delete wide_pubkey;
+	
+	std::vector<unsigned char> wide_data = wide_writer.get_data();
+	
+	CPPUNIT_ASSERT(cache.open(&wide_data[0], wide_data.size()));
+	CPPUNIT_ASSERT(cache.has(SILVIA_CACHE_TABLES));
+	
+	pubkey = cache.get_pubkey();
+	
+	CPPUNIT_ASSERT(pubkey != NULL);
+	CPPUNIT_ASSERT(pubkey->get_fixed_base_window() == SILVIA_FIXED_BASE_DEFAULT_WINDOW);
+	CPPUNIT_ASSERT(pubkey->get_fixed_S()->size() == 0);
+	
+	delete pubkey;
+	
+	// Tables that are too short for the system parameters are not loaded
+	silvia_system_parameters short_params;
+	
+	short_params.set_l_m(short_params.get_l_m() / 2);
+	
+	silvia_pub_key* short_pubkey = test_pubkey();
+	silvia_cache_writer short_writer;
+	
+	short_writer.add_pubkey(short_pubkey, true, &short_params);
+	
+	delete short_pubkey;
+	
+	std::vector<unsigned char> short_data = short_writer.get_data();
+	
+	CPPUNIT_ASSERT(cache.open(&short_data[0], short_data.size()));
+	CPPUNIT_ASSERT(cache.has(SILVIA_CACHE_TABLES));
+	
+	pubkey = cache.get_pubkey();
+	
+	CPPUNIT_ASSERT(pubkey != NULL);
+	CPPUNIT_ASSERT(pubkey->get_fixed_S()->size() == 0);
+	CPPUNIT_ASSERT(pubkey->get_fixed_R(0)->size() == 0);
+	
+	delete pubkey;
+}
+
+void cache_tests::test_corruption()
+{
+	std::vector<unsigned char> data = test_cache(false);
+	
+	silvia_cache cache;
+	
+	CPPUNIT_ASSERT(cache.open(&data[0], data.size()));
+	
+	// Any changed byte is detected
+	for (size_t i = 0; i < data.size(); i += 97)
+	{
+		std::vector<unsigned char> corrupt = data;
+		
+		corrupt[i] ^= 0x01;
+		
+		CPPUNIT_ASSERT(!cache.open(&corrupt[0], corrupt.size()));
+		CPPUNIT_ASSERT(!cache.has(SILVIA_CACHE_PUBKEY));
+		CPPUNIT_ASSERT(cache.get_pubkey() == NULL);
+	}
+	
+	// Truncated caches are rejected
+	CPPUNIT_ASSERT(!cache.open(&data[0], data.size() - 8));
+	CPPUNIT_ASSERT(!cache.open(&data[0], 16));
+	CPPUNIT_ASSERT(!cache.open(&data[0], 0));
+}
+
+void cache_tests::test_file()
+{
+	char file_name[] = "/tmp/silvia_cachetest_XXXXXX";
+	int fd = mkstemp(file_name);
+	
+	CPPUNIT_ASSERT(fd >= 0);
+	
+	close(fd);
+	
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_cache_writer writer;
+	
+	writer.add_pubkey(pubkey, true);
+	
+	CPPUNIT_ASSERT(writer.write(file_name));
+	
+	silvia_cache cache;
+	
+	CPPUNIT_ASSERT(cache.open(std::string(file_name)));
+	
+	silvia_pub_key* loaded = cache.get_pubkey();
+	
+	CPPUNIT_ASSERT(loaded != NULL);
+	CPPUNIT_ASSERT(loaded->get_n() == pubkey->get_n());
+	CPPUNIT_ASSERT(loaded->get_fixed_S()->size() == pubkey->get_fixed_S()->size());
+	
+	// The key remains usable after the file is released
+	cache.close();
+	
+	CPPUNIT_ASSERT(loaded->get_R() == pubkey->get_R());
+	
+	delete loaded;
+	delete pubkey;
+	
+	unlink(file_name);
+	
+	CPPUNIT_ASSERT(!cache.open(std::string(file_name)));
+}
@@ -54,6 +54,11 @@ void silvia_apdu::append_data(const bytestring& data)
 	this->data += data;
 }
 	
+void silvia_apdu::append_mpz(const mpz_class& value, size_t len)
+{
+	data.append_mpz(value, len);
+}
+	
 void silvia_apdu::set_le(int LE)
 {
 	if (LE < 255)
@@ -74,6 +79,8 @@ bytestring silvia_apdu::get_apdu()
 {
 	bytestring the_apdu;
 	
+	the_apdu.reserve(5 + data.size() + 1);
+	
 	the_apdu += CLA;
 	the_apdu += INS;
 	the_apdu += P1;
@@ -92,3 +99,54 @@ bytestring silvia_apdu::get_apdu()
 	
 	return the_apdu;
 }
+
+/*static*/ bytestring silvia_apdu::verify_pin(const std::string& PIN)
+{
+	assert(PIN.size() <= 8);
+	
+	silvia_apdu verify_pin(0x00, 0x20, 0x00, 0x00);
+	
+	// The PIN is padded with zeroes to 8 bytes
+	bytestring pin_data;
+	pin_data.wipe(8);
+	
+	memcpy(&pin_data[0], PIN.c_str(), PIN.size());
+	
+	verify_pin.append_data(pin_data);
+	
+	return verify_pin.get_apdu();
+}
+
+/*static*/ std::string silvia_apdu::sw_error(unsigned short sw)
+{
+	char error[32];
+	
+	if (sw == 0x63C0)
+	{
+		snprintf(error, 32, "card-blocked");
+	}
+	else if ((sw > 0x63C0) && (sw <= 0x63CF))
+	{
+		snprintf(error, 32, "incorrect-pin %u", sw - 0x63C0);
+	}
+	else
+	{
+		snprintf(error, 32, "card-error 0x%04X", sw);
+	}
+	
+	return error;
+}
+
+/*static*/ unsigned short silvia_apdu::get_sw(const bytestring_view& data_sw)
+{
+	if (data_sw.size() < 2) return 0;
+	
+	return (data_sw[data_sw.size() - 2] << 8) + data_sw[data_sw.size() - 1];
+}
+
+/*static*/ bytestring_view silvia_apdu::get_data(const bytestring_view& data_sw)
+{
+	if (data_sw.size() < 2) return bytestring_view();
+	
+	return data_sw.substr(0, data_sw.size() - 2);
+}
@@ -34,6 +34,7 @@
  
 #include "config.h"
 #include "silvia_bytestring.h"
+#include <gmpxx.h>
 #include <memory>
 #include <string>
  
@@ -61,6 +62,13 @@ public:
 	 */
 	void append_data(const bytestring& data);
 	
+	/**
+	 * Append a value as big-endian data of at least the specified length
+	 * @param value the value
+	 * @param len the length in bytes; shorter values are zero-padded
+	 */
+	void append_mpz(const mpz_class& value, size_t len);
+	
 	/**
 	 * Set expected return length
 	 * @param LE the expected return length (1-256)
@@ -72,6 +80,36 @@ public:
 	 * @return a byte string of the whole APDU
 	 */
 	bytestring get_apdu();
+	
+	/**
+	 * Build the command that verifies the credential PIN of an IRMA card
+	 * @param PIN the PIN (at most 8 characters)
+	 * @return a byte string of the whole APDU
+	 */
+	static bytestring verify_pin(const std::string& PIN);
+	
+	/**
+	 * Describe a status word other than 9000 the way the StdIO protocol
+	 * reports it; 63C0--63CF signal a refused PIN
+	 * @param sw the status word
+	 * @return "card-blocked", "incorrect-pin <attempts>" or "card-error 0x<sw>"
+	 */
+	static std::string sw_error(unsigned short sw);
+	
+	/**
+	 * Get the status word of a response
+	 * @param data_sw the response including the status word
+	 * @return the status word, or 0 if the response is too short
+	 */
+	static unsigned short get_sw(const bytestring_view& data_sw);
+	
+	/**
+	 * Get the data of a response without copying it
+	 * @param data_sw the response including the status word
+	 * @return a view on the data before the status word; the view is
+	 *         only valid as long as the response is not modified
+	 */
+	static bytestring_view get_data(const bytestring_view& data_sw);
 
 private:
 	// APDU values
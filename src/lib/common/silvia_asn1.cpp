@@ -34,7 +34,9 @@
 
 #include "config.h"
 #include "silvia_asn1.h"
+#include "silvia_hash.h"
 #include <stack>
+#include <stdio.h>
 #include <stdlib.h>
 
 ////////////////////////////////////////////////////////////////////////
@@ -128,40 +130,17 @@ std::vector<unsigned char> silvia_asn1_sequence::get_der_encoding()
 
 silvia_asn1_integer::silvia_asn1_integer(mpz_class i)
 {
-	size_t count = 0;
-
-	// Convert integer to big endian byte string
-	unsigned char* mpz_bytes = (unsigned char*) mpz_export(NULL, &count, 1, sizeof(unsigned char), 1, 0, i.get_mpz_t());
-	
-	if (count == 0) return;
-	
-	// Strip leading zeroes
-	size_t index = 0;
-	
-	while ((index < count) && (mpz_bytes[index] == 0x00)) index++;
+	if (mpz_sgn(i.get_mpz_t()) == 0) return;
 	
-	if (index == count)
-	{
-		free(mpz_bytes);
-		return;
-	}
-	
-	count -= index;
+	// Convert integer to big endian byte string; the exported value
+	// has no leading zeroes, prepend 0x00 if necessary to make it unsigned
+	size_t bits = mpz_sizeinbase(i.get_mpz_t(), 2);
+	size_t count = (bits + 7) / 8;
+	size_t prefix = ((bits % 8) == 0) ? 1 : 0;
 	
-	// Prepend 0x00 if necessary, to make it unsigned
-	if (mpz_bytes[index] >= 0x80)
-	{
-		value.resize(count + 1);
-		value[0] = 0x00;
-		memcpy(&value[1], &mpz_bytes[index], count);
-	}
-	else
-	{
-		value.resize(count);
-		memcpy(&value[0], &mpz_bytes[index], count);
-	}
+	value.resize(count + prefix);
 	
-	free(mpz_bytes);
+	mpz_export(&value[prefix], &count, 1, sizeof(unsigned char), 1, 0, i.get_mpz_t());
 }
 
 silvia_asn1_integer::silvia_asn1_integer(std::vector<unsigned char> i)
@@ -202,3 +181,138 @@ std::vector<unsigned char> silvia_asn1_integer::get_der_encoding()
 	
 	return der_enc;
 }
+
+////////////////////////////////////////////////////////////////////////
+// silvia_der_sequence implementation
+////////////////////////////////////////////////////////////////////////
+
+silvia_der_sequence::silvia_der_sequence()
+{
+	count = 0;
+}
+
+void silvia_der_sequence::append(const mpz_class& i)
+{
+	if (count >= MAX_INTEGERS)
+	{
+		// Dropping an integer would silently change the challenge
+		fprintf(stderr, "silvia: more than %u integers in a DER sequence, aborting\n", (unsigned) MAX_INTEGERS);
+		
+		abort();
+	}
+	
+	integers[count++] = &i;
+}
+
+/*static*/ size_t silvia_der_sequence::integer_len(const mpz_class& i)
+{
+	if (mpz_sgn(i.get_mpz_t()) == 0) return 0;
+	
+	size_t bits = mpz_sizeinbase(i.get_mpz_t(), 2);
+	
+	// Add a 0x00 byte if the most significant bit is set
+	return ((bits + 7) / 8) + (((bits % 8) == 0) ? 1 : 0);
+}
+
+// Size of an ASN.1 header (tag and length)
+static size_t header_len(size_t len)
+{
+	size_t rv = 2;
+	
+	if (len >= 128)
+	{
+		while (len > 0)
+		{
+			rv++;
+			len >>= 8;
+		}
+	}
+	
+	return rv;
+}
+
+size_t silvia_der_sequence::content_len() const
+{
+	// The sequence starts with the number of objects it contains
+	size_t len = (count > 0) ? 3 : 2;
+	
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t int_len = integer_len(*integers[i]);
+		
+		len += header_len(int_len) + int_len;
+	}
+	
+	return len;
+}
+
+size_t silvia_der_sequence::get_der_size() const
+{
+	size_t len = content_len();
+	
+	return header_len(len) + len;
+}
+
+/*static*/ void silvia_der_sequence::hash_header(silvia_hash* h, unsigned char tag, size_t len)
+{
+	unsigned char header[2 + sizeof(size_t)];
+	size_t header_size = 0;
+	
+	header[header_size++] = tag;
+	
+	if (len < 128)
+	{
+		// Simple encoding
+		header[header_size++] = (unsigned char) len;
+	}
+	else
+	{
+		// Long encoding
+		size_t len_bytes = header_len(len) - 2;
+		
+		header[header_size++] = (unsigned char) 0x80 + len_bytes;
+		
+		for (size_t i = len_bytes; i > 0; i--)
+		{
+			header[header_size++] = (unsigned char) ((len >> ((i - 1) * 8)) & 0xff);
+		}
+	}
+	
+	h->update(header, header_size);
+}
+
+void silvia_der_sequence::hash(silvia_hash* h) const
+{
+	static const unsigned char zero = 0x00;
+	
+	hash_header(h, 0x30, content_len());	// ASN.1: SEQUENCE
+	
+	// Encode the number of objects in the sequence
+	if (count > 0)
+	{
+		hash_header(h, 0x02, 1);	// ASN.1: INTEGER
+		
+		unsigned char count_byte = (unsigned char) count;
+		
+		h->update(&count_byte, 1);
+	}
+	else
+	{
+		hash_header(h, 0x02, 0);	// ASN.1: INTEGER
+	}
+	
+	// Encode the integers in the sequence
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t int_len = integer_len(*integers[i]);
+		
+		hash_header(h, 0x02, int_len);	// ASN.1: INTEGER
+		
+		if ((int_len > 0) && ((mpz_sizeinbase(integers[i]->get_mpz_t(), 2) % 8) == 0))
+		{
+			h->update(&zero, 1);
+		}
+		
+		h->update(*integers[i]);
+	}
+}
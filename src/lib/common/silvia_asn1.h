@@ -40,6 +40,8 @@
 #include <string>
 #include <vector>
 
+class silvia_hash;
+
 /**
  * Generic ASN.1 object class
  */
@@ -121,5 +123,57 @@ public:
 	virtual std::vector<unsigned char> get_der_encoding();
 };
 
+/**
+ * Streaming DER encoder for a sequence of integers; the lengths are
+ * computed up front and the encoding is written straight into a hash,
+ * without building it in memory first. The encoding is identical to
+ * that of a silvia_asn1_sequence of silvia_asn1_integer objects.
+ */
+class silvia_der_sequence
+{
+public:
+	/**
+	 * Constructor
+	 */
+	silvia_der_sequence();
+	
+	/**
+	 * Append an integer to the sequence; the integer is not copied
+	 * and must remain valid until the sequence has been hashed; the
+	 * process is aborted if the sequence already holds MAX_INTEGERS
+	 * @param i the integer to append
+	 */
+	void append(const mpz_class& i);
+	
+	/**
+	 * Feed the DER encoding of the sequence into a hash
+	 * @param h the hash to update
+	 */
+	void hash(silvia_hash* h) const;
+	
+	/**
+	 * Get the size of the DER encoding
+	 * @return the size of the DER encoding of the sequence in bytes
+	 */
+	size_t get_der_size() const;
+	
+	// The maximum number of integers in a sequence
+	static const size_t MAX_INTEGERS = 8;
+	
+private:
+	// Size of the contents of an integer
+	static size_t integer_len(const mpz_class& i);
+	
+	// Size of the contents of the sequence
+	size_t content_len() const;
+	
+	// Write an ASN.1 header (tag and length) into the hash
+	static void hash_header(silvia_hash* h, unsigned char tag, size_t len);
+	
+	// The integers in the sequence
+	const mpz_class* integers[MAX_INTEGERS];
+	size_t count;
+};
+
 #endif // !_SILVIA_ASN1_H
 
@@ -33,6 +33,7 @@
  *****************************************************************************/
 
 #include <algorithm>
+#include <new>
 #include <string>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,36 +42,182 @@
 #include "silvia_bytestring.h"
 #include "silvia_macros.h"
 
+////////////////////////////////////////////////////////////////////////
+// Byte string view class
+////////////////////////////////////////////////////////////////////////
+
+bytestring_view::bytestring_view()
+{
+	bytes = NULL;
+	len = 0;
+}
+
+bytestring_view::bytestring_view(const unsigned char* bytes, const size_t bytesLen)
+{
+	this->bytes = bytes;
+	len = bytesLen;
+}
+
+bytestring_view::bytestring_view(const bytestring& in)
+{
+	bytes = in.const_byte_str();
+	len = in.size();
+}
+
+bytestring_view bytestring_view::substr(const size_t start, const size_t len /* = SIZE_T_MAX */) const
+{
+	if (start >= this->len)
+	{
+		return bytestring_view();
+	}
+
+	return bytestring_view(&bytes[start], std::min(len, this->len - start));
+}
+
+bytestring_view bytestring_view::split(size_t len)
+{
+	len = std::min(len, this->len);
+
+	bytestring_view rv(bytes, len);
+
+	bytes += len;
+	this->len -= len;
+
+	return rv;
+}
+
+const unsigned char& bytestring_view::operator[](size_t pos) const
+{
+	return bytes[pos];
+}
+
+const unsigned char* bytestring_view::const_byte_str() const
+{
+	return bytes;
+}
+
+mpz_class bytestring_view::mpz_val() const
+{
+	mpz_class rv;
+	
+	if (len > 0)
+	{
+		mpz_import(_Z(rv), len, 1, sizeof(unsigned char), 1, 0, bytes);
+	}
+	
+	return rv;
+}
+
+std::string bytestring_view::hex_str() const
+{
+	static const char hex_digits[] = "0123456789ABCDEF";
+
+	std::string rv;
+	rv.resize(2 * len);
+
+	for (size_t i = 0; i < len; i++)
+	{
+		rv[2 * i] = hex_digits[bytes[i] >> 4];
+		rv[2 * i + 1] = hex_digits[bytes[i] & 0x0f];
+	}
+
+	return rv;
+}
+
+size_t bytestring_view::size() const
+{
+	return len;
+}
+
+bool bytestring_view::operator==(const bytestring_view& compareTo) const
+{
+	if (compareTo.len != len)
+	{
+		return false;
+	}
+
+	return (len == 0) || (memcmp(bytes, compareTo.bytes, len) == 0);
+}
+
+bool bytestring_view::operator!=(const bytestring_view& compareTo) const
+{
+	return !(*this == compareTo);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Byte string class
+////////////////////////////////////////////////////////////////////////
+
+// Value of a hexadecimal digit, or -1
+static int hex_value(char c)
+{
+	if ((c >= '0') && (c <= '9')) return c - '0';
+	if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+
+	return -1;
+}
+
 // Constructors
 bytestring::bytestring()
 {
+	bytes = inline_bytes;
+	len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
 }
 
 bytestring::bytestring(const unsigned char* bytes, const size_t bytesLen)
 {
-	byteString.resize(bytesLen);
+	this->bytes = inline_bytes;
+	len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
+
+	resize(bytesLen);
 
-	memcpy(&byteString[0], bytes, bytesLen);
+	if (bytesLen > 0)
+	{
+		memcpy(this->bytes, bytes, bytesLen);
+	}
 }
 
 bytestring::bytestring(const char* hexString)
 {
-	std::string hex = std::string(hexString);
+	bytes = inline_bytes;
+	len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
 
-	if (hex.size() % 2 != 0)
-	{
-		hex = "0" + hex;
-	}
+	size_t hexLen = strlen(hexString);
 
-	for (size_t i = 0; i < hex.size(); i += 2)
+	resize((hexLen + 1) / 2);
+
+	// An odd number of digits has an implicit leading zero
+	size_t pos = 0;
+
+	for (size_t i = 0; i < len; i++)
 	{
-		std::string byteStr;
-		byteStr += hex[i];
-		byteStr += hex[i+1];
+		int hi = 0;
+
+		if ((i > 0) || (hexLen % 2 == 0))
+		{
+			hi = hex_value(hexString[pos++]);
+		}
 
-		unsigned char byteVal = (unsigned char) strtoul(byteStr.c_str(), NULL, 16);
+		int lo = hex_value(hexString[pos++]);
 
-		this->operator+=(byteVal);
+		// Invalid digits are handled like strtoul would handle them on
+		// the pair of digits
+		if (hi < 0)
+		{
+			bytes[i] = 0;
+		}
+		else if (lo < 0)
+		{
+			bytes[i] = (unsigned char) hi;
+		}
+		else
+		{
+			bytes[i] = (unsigned char) ((hi << 4) + lo);
+		}
 	}
 }
 
@@ -89,52 +236,215 @@ bytestring::bytestring(const unsigned long longValue)
 	// read the storage of a 64-bit version and vice versa under the assumption that the stored
 	// values never exceed 32-bits, which is likely since these values are only used to encode
 	// byte string lengths)
-	unsigned char byteStrIn[8];
+	bytes = inline_bytes;
+	len = 8;
+	capacity = SILVIA_BYTESTRING_INLINE;
 	
 	for (size_t i = 0; i < 8; i++)
 	{
-		byteStrIn[7-i] = (unsigned char) (setValue & 0xFF);
+		bytes[7-i] = (unsigned char) (setValue & 0xFF);
 		setValue >>= 8;
 	}
-
-	byteString.resize(8);
-	memcpy(&byteString[0], byteStrIn, 8);
 }
 
 bytestring::bytestring(const bytestring& in)
 {
-	this->byteString = in.byteString;
+	bytes = inline_bytes;
+	len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
+
+	*this += in;
+}
+
+bytestring::bytestring(const bytestring_view& in)
+{
+	bytes = inline_bytes;
+	len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
+
+	*this += in;
 }
 
 bytestring::bytestring(const mpz_class& mpz_val)
 {
-	size_t count;
-	
-	unsigned char* byte_val = (unsigned char*) mpz_export(NULL, &count, 1, sizeof(unsigned char), 1, 0, _Z(mpz_val));
-	
-	byteString.resize(count);
-	memcpy(&byteString[0], byte_val, count);
-	
-	free(byte_val);
+	bytes = inline_bytes;
+	len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
+
+	// Export directly into the byte string
+	if (mpz_sgn(_Z(mpz_val)) != 0)
+	{
+		size_t count = (mpz_sizeinbase(_Z(mpz_val), 2) + 7) / 8;
+
+		resize(count);
+		
+		mpz_export(bytes, &count, 1, sizeof(unsigned char), 1, 0, _Z(mpz_val));
+	}
+}
+
+bytestring::bytestring(const mpz_class& mpz_val, const size_t len)
+{
+	bytes = inline_bytes;
+	this->len = 0;
+	capacity = SILVIA_BYTESTRING_INLINE;
+
+	append_mpz(mpz_val, len);
+}
+
+bytestring::~bytestring()
+{
+	if (bytes != inline_bytes)
+	{
+		free(bytes);
+	}
+}
+
+// Assignment
+bytestring& bytestring::operator=(const bytestring& in)
+{
+	if (this != &in)
+	{
+		resize(in.len);
+
+		if (len > 0)
+		{
+			memcpy(bytes, in.bytes, len);
+		}
+	}
+
+	return *this;
+}
+
+void bytestring::swap(bytestring& other)
+{
+	if ((bytes != inline_bytes) && (other.bytes != other.inline_bytes))
+	{
+		std::swap(bytes, other.bytes);
+		std::swap(len, other.len);
+		std::swap(capacity, other.capacity);
+	}
+	else
+	{
+		bytestring tmp(other);
+
+		other = *this;
+		*this = tmp;
+	}
 }
 
 // Append data
 bytestring& bytestring::operator+=(const bytestring& append)
 {
-	size_t curLen = byteString.size();
-	size_t toAdd = append.byteString.size();
-	size_t newLen = curLen + toAdd;
+	return *this += bytestring_view(append);
+}
+
+bytestring& bytestring::operator+=(const bytestring_view& append)
+{
+	size_t curLen = len;
+	size_t toAdd = append.size();
+
+	if (toAdd == 0)
+	{
+		return *this;
+	}
+
+	// The data may be part of this byte string
+	if ((append.const_byte_str() >= bytes) && (append.const_byte_str() < bytes + len) && (curLen + toAdd > capacity))
+	{
+		bytestring copy(append);
+
+		return *this += copy;
+	}
 
-	byteString.resize(newLen);
+	resize(curLen + toAdd);
 
-	memcpy(&byteString[curLen], &append.byteString[0], toAdd);
+	memmove(&bytes[curLen], append.const_byte_str(), toAdd);
 
 	return *this;
 }
 
 bytestring& bytestring::operator+=(const unsigned char byte)
 {
-	byteString.push_back(byte);
+	resize(len + 1);
+
+	bytes[len - 1] = byte;
+
+	return *this;
+}
+
+bytestring& bytestring::append_mpz(const mpz_class& mpz_val, const size_t len)
+{
+	size_t count = (mpz_sgn(_Z(mpz_val)) == 0) ? 0 : (mpz_sizeinbase(_Z(mpz_val), 2) + 7) / 8;
+	size_t width = std::max(count, len);
+	size_t curLen = this->len;
+
+	// New bytes are zero, so only the value itself has to be written
+	resize(curLen + width);
+
+	if (count > 0)
+	{
+		mpz_export(&bytes[curLen + width - count], &count, 1, sizeof(unsigned char), 1, 0, _Z(mpz_val));
+	}
+
+	return *this;
+}
+
+bytestring& bytestring::append_uint(const unsigned long value, const size_t len)
+{
+	size_t curLen = this->len;
+
+	resize(curLen + len);
+
+	unsigned long remaining = value;
+
+	for (size_t i = 0; (i < len) && (i < sizeof(unsigned long)); i++)
+	{
+		bytes[curLen + len - 1 - i] = (unsigned char) (remaining & 0xff);
+		remaining >>= 8;
+	}
+
+	return *this;
+}
+
+// Prepend data
+bytestring& bytestring::prepend(const bytestring_view& data)
+{
+	size_t toAdd = data.size();
+
+	if (toAdd == 0)
+	{
+		return *this;
+	}
+
+	if ((data.const_byte_str() >= bytes) && (data.const_byte_str() < bytes + len))
+	{
+		bytestring copy(data);
+
+		return prepend(copy);
+	}
+
+	size_t curLen = len;
+
+	resize(curLen + toAdd);
+
+	memmove(&bytes[toAdd], bytes, curLen);
+	memcpy(bytes, data.const_byte_str(), toAdd);
+
+	return *this;
+}
+
+bytestring& bytestring::pad(const size_t newSize)
+{
+	if (newSize > len)
+	{
+		size_t curLen = len;
+		size_t toAdd = newSize - len;
+
+		resize(newSize);
+
+		memmove(&bytes[toAdd], bytes, curLen);
+		memset(bytes, 0x00, toAdd);
+	}
 
 	return *this;
 }
@@ -146,7 +456,7 @@ bytestring& bytestring::operator^=(const bytestring& rhs)
 
 	for (size_t i = 0; i < xorLen; i++)
 	{
-		byteString[i] ^= rhs.const_byte_str()[i];
+		bytes[i] ^= rhs.bytes[i];
 	}
 
 	return *this;
@@ -155,22 +465,20 @@ bytestring& bytestring::operator^=(const bytestring& rhs)
 // Return a substring
 bytestring bytestring::substr(const size_t start, const size_t len /* = SIZE_T_MAX */) const
 {
-	size_t retLen = std::min(len, byteString.size() - start);
+	return bytestring(view(start, len));
+}
 
-	if (start >= byteString.size())
-	{
-		return bytestring();
-	}
-	else
-	{
-		return bytestring(&byteString[start], retLen);
-	}
+bytestring_view bytestring::view(const size_t start /* = 0 */, const size_t len /* = SIZE_T_MAX */) const
+{
+	return bytestring_view(bytes, this->len).substr(start, len);
 }
 
 // Add data
 bytestring operator+(const bytestring& lhs, const bytestring& rhs)
 {
-	bytestring rv = lhs;
+	bytestring rv;
+	rv.reserve(lhs.size() + rhs.size());
+	rv += lhs;
 	rv += rhs;
 
 	return rv;
@@ -178,7 +486,9 @@ bytestring operator+(const bytestring& lhs, const bytestring& rhs)
 
 bytestring operator+(const unsigned char lhs, const bytestring& rhs)
 {
-	bytestring rv(&lhs, 1);
+	bytestring rv;
+	rv.reserve(1 + rhs.size());
+	rv += lhs;
 	rv += rhs;
 
 	return rv;
@@ -186,7 +496,9 @@ bytestring operator+(const unsigned char lhs, const bytestring& rhs)
 
 bytestring operator+(const bytestring& lhs, const unsigned char rhs)
 {
-	bytestring rv = lhs;
+	bytestring rv;
+	rv.reserve(lhs.size() + 1);
+	rv += lhs;
 	rv += rhs;
 
 	return rv;
@@ -195,45 +507,36 @@ bytestring operator+(const bytestring& lhs, const unsigned char rhs)
 // Array operator
 unsigned char& bytestring::operator[](size_t pos)
 {
-	return byteString[pos];
+	return bytes[pos];
+}
+
+const unsigned char& bytestring::operator[](size_t pos) const
+{
+	return bytes[pos];
 }
 
 // Return the byte string data
 unsigned char* bytestring::byte_str()
 {
-	return &byteString[0];
+	return bytes;
 }
 
 // Return as GNU MP integer
-mpz_class bytestring::mpz_val()
+mpz_class bytestring::mpz_val() const
 {
-	mpz_class rv;
-	
-	mpz_import(_Z(rv), byteString.size(), 1, sizeof(unsigned char), 1, 0, &byteString[0]);
-	
-	return rv;
+	return view().mpz_val();
 }
 
 // Return the const byte string
 const unsigned char* bytestring::const_byte_str() const
 {
-	return (const unsigned char*) &byteString[0];
+	return bytes;
 }
 
 // Return a hexadecimal character representation of the string
 std::string bytestring::hex_str() const
 {
-	std::string rv;
-	char hex[3];
-
-	for (size_t i = 0; i < byteString.size(); i++)
-	{
-		sprintf(hex, "%02X", byteString[i]);
-
-		rv += hex;
-	}
-
-	return rv;
+	return view().hex_str();
 }
 
 // Split of the specified part of the string as a separate byte string
@@ -241,17 +544,14 @@ bytestring bytestring::split(size_t len)
 {
 	bytestring rv = substr(0, len);
 
-	size_t newSize = (byteString.size() > len) ? (byteString.size() - len) : 0;
+	size_t newSize = (this->len > len) ? (this->len - len) : 0;
 
 	if (newSize > 0)
 	{
-		for (size_t i = 0; i < newSize; i++)
-		{
-			byteString[i] = byteString[i + len];
-		}
+		memmove(bytes, &bytes[len], newSize);
 	}
 
-	byteString.resize(newSize);
+	resize(newSize);
 
 	return rv;
 }
@@ -259,13 +559,13 @@ bytestring bytestring::split(size_t len)
 // The size of the byte string in bits
 size_t bytestring::bits() const
 {
-	size_t bits = byteString.size() * 8;
+	size_t bits = len * 8;
 
 	if (bits == 0) return 0;
 
-	for (size_t i = 0; i < byteString.size(); i++)
+	for (size_t i = 0; i < len; i++)
 	{
-		unsigned char byte = byteString[i];
+		unsigned char byte = bytes[i];
 
 		for (unsigned char mask = 0x80; mask > 0; mask >>= 1)
 		{
@@ -286,52 +586,78 @@ size_t bytestring::bits() const
 // The size of the byte string in bytes
 size_t bytestring::size() const
 {
-	return byteString.size();
+	return len;
 }
 
 void bytestring::resize(const size_t newSize)
 {
-	byteString.resize(newSize);
+	reserve(newSize);
+
+	// New bytes are zero, like those of a resized std::vector
+	if (newSize > len)
+	{
+		memset(&bytes[len], 0x00, newSize - len);
+	}
+
+	len = newSize;
+}
+
+void bytestring::reserve(const size_t newCapacity)
+{
+	if (newCapacity <= capacity)
+	{
+		return;
+	}
+
+	// Grow geometrically so appending byte by byte stays linear
+	size_t allocate = std::max(newCapacity, 2 * capacity);
+
+	unsigned char* newBytes = (unsigned char*) malloc(allocate);
+
+	if (newBytes == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	if (len > 0)
+	{
+		memcpy(newBytes, bytes, len);
+	}
+
+	if (bytes != inline_bytes)
+	{
+		free(bytes);
+	}
+
+	bytes = newBytes;
+	capacity = allocate;
 }
 
 void bytestring::wipe(const size_t newSize /* = 0 */)
 {
 	this->resize(newSize);
 
-	memset(&byteString[0], 0x00, byteString.size());
+	memset(bytes, 0x00, len);
 }
 
 // Comparison
 bool bytestring::operator==(const bytestring& compareTo) const
 {
-	if (compareTo.size() != this->size())
-	{
-		return false;
-	}
-
-	return (memcmp(&byteString[0], &compareTo.byteString[0], this->size()) == 0);
+	return view() == compareTo.view();
 }
 
 bool bytestring::operator!=(const bytestring& compareTo) const
 {
-	if (compareTo.size() != this->size())
-	{
-		return true;
-	}
-
-	return (memcmp(&byteString[0], &compareTo.byteString[0], this->size()) != 0);
+	return view() != compareTo.view();
 }
 
 // XOR data
 bytestring operator^(const bytestring& lhs, const bytestring& rhs)
 {
-	size_t xorLen = std::min(lhs.size(), rhs.size());
-	bytestring rv;
+	bytestring rv(lhs);
 
-	for (size_t i = 0; i < xorLen; i++)
-	{
-		rv += lhs.const_byte_str()[i] ^ rhs.const_byte_str()[i];
-	}
+	rv.resize(std::min(lhs.size(), rhs.size()));
+	rv ^= rhs;
 
 	return rv;
 }
@@ -46,6 +46,55 @@
 #define SIZE_T_MAX ((size_t) -1)
 #endif // !SIZE_T_MAX
 
+// Byte strings up to this size are stored inside the object; this covers
+// short APDUs (5 + 255 + 1 bytes) and their responses (256 + 2 bytes)
+#define SILVIA_BYTESTRING_INLINE	264
+
+class bytestring;
+
+// A non-owning view on (part of) a byte string; the view is only valid as
+// long as the byte string it was taken from is not modified or destroyed
+class bytestring_view
+{
+public:
+	// Constructors
+	bytestring_view();
+
+	bytestring_view(const unsigned char* bytes, const size_t bytesLen);
+
+	bytestring_view(const bytestring& in);
+
+	// Return a sub-view
+	bytestring_view substr(const size_t start, const size_t len = SIZE_T_MAX) const;
+
+	// Split off the specified part of the view as a separate view; this
+	// view is advanced past it
+	bytestring_view split(size_t len);
+
+	// Array operator
+	const unsigned char& operator[](size_t pos) const;
+
+	// Return the const byte string
+	const unsigned char* const_byte_str() const;
+
+	// Return as GNU MP integer
+	mpz_class mpz_val() const;
+
+	// Return a hexadecimal character representation of the string
+	std::string hex_str() const;
+
+	// Return the size in bytes
+	size_t size() const;
+
+	// Comparison
+	bool operator==(const bytestring_view& compareTo) const;
+	bool operator!=(const bytestring_view& compareTo) const;
+
+private:
+	const unsigned char* bytes;
+	size_t len;
+};
+
 class bytestring
 {
 public:
@@ -60,26 +109,58 @@ public:
 
 	bytestring(const bytestring& in);
 	
+	bytestring(const bytestring_view& in);
+	
 	bytestring(const mpz_class& mpz_val);
 
+	// Big-endian representation of at least the specified number of
+	// bytes, zero-padded on the left
+	bytestring(const mpz_class& mpz_val, const size_t len);
+
 	// Destructor
-	virtual ~bytestring() { }
+	virtual ~bytestring();
+
+	// Assignment
+	bytestring& operator=(const bytestring& in);
+
+	// Exchange the contents with another byte string; does not copy
+	// data that is stored outside the object
+	void swap(bytestring& other);
 
 	// Append data
 	bytestring& operator+=(const bytestring& append);
+	bytestring& operator+=(const bytestring_view& append);
 	bytestring& operator+=(const unsigned char byte);
 
+	// Append the big-endian representation of a value in at least the
+	// specified number of bytes, zero-padded on the left
+	bytestring& append_mpz(const mpz_class& mpz_val, const size_t len);
+
+	// Append the big-endian representation of a value in exactly the
+	// specified number of bytes; higher order bytes are discarded
+	bytestring& append_uint(const unsigned long value, const size_t len);
+
+	// Prepend data
+	bytestring& prepend(const bytestring_view& data);
+
+	// Prepend zero bytes up to the specified size
+	bytestring& pad(const size_t newSize);
+
 	// Return a substring
 	bytestring substr(const size_t start, const size_t len = SIZE_T_MAX) const;
 
+	// Return a view on a substring
+	bytestring_view view(const size_t start = 0, const size_t len = SIZE_T_MAX) const;
+
 	// Array operator
 	unsigned char& operator[](size_t pos);
+	const unsigned char& operator[](size_t pos) const;
 
 	// Return the byte string
 	unsigned char* byte_str();
 	
 	// Return as GNU MP integer
-	mpz_class mpz_val();
+	mpz_class mpz_val() const;
 
 	// Return the const byte string
 	const unsigned char* const_byte_str() const;
@@ -99,6 +180,9 @@ public:
 	// Resize
 	void resize(const size_t newSize);
 
+	// Reserve space for the specified number of bytes
+	void reserve(const size_t newCapacity);
+
 	// Wipe
 	void wipe(const size_t newSize = 0);
 
@@ -110,7 +194,11 @@ public:
 	bytestring& operator^=(const bytestring& rhs);
 
 private:
-	std::vector<unsigned char> byteString;
+	// The data; points to inline_bytes or to a heap allocation
+	unsigned char* bytes;
+	size_t len;
+	size_t capacity;
+	unsigned char inline_bytes[SILVIA_BYTESTRING_INLINE];
 };
 
 // Add data
@@ -122,4 +210,3 @@ bytestring operator+(const bytestring& lhs, const unsigned char rhs);
 bytestring operator^(const bytestring& lhs, const bytestring& rhs);
 
 #endif // !_SILVIA_BYTESTRING_H
-
@@ -0,0 +1,73 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_card_channel.cpp
+
+ Abstract base class for card channels
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_card_channel.h"
+#include "silvia_apdu.h"
+#include "silvia_timer.h"
+
+bool silvia_card_channel::transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings /* = NULL */)
+{
+	silvia_timer timer;
+
+	data_sw.reserve(data_sw.size() + APDUs.size());
+
+	for (std::vector<bytestring>::const_iterator i = APDUs.begin(); i != APDUs.end(); i++)
+	{
+		data_sw.push_back(bytestring());
+
+		timer.mark();
+
+		// A response without a status word is a communication failure
+		if (!transmit(*i, data_sw.back()) || (data_sw.back().size() < 2))
+		{
+			data_sw.pop_back();
+
+			return false;
+		}
+
+		if (timings != NULL)
+		{
+			timings->push_back(timer.elapsed());
+		}
+
+		// Stop at the first status word other than 9000
+		if (silvia_apdu::get_sw(data_sw.back()) != 0x9000)
+		{
+			break;
+		}
+	}
+
+	return true;
+}
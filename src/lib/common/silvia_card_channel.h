@@ -36,6 +36,7 @@
 #define _SILVIA_CARD_CHANNEL_H
 
 #include <string>
+#include <vector>
 #include "silvia_bytestring.h"
 
 /**
@@ -50,6 +51,11 @@
 class silvia_card_channel
 {
 public:
+	/**
+	 * Destructor
+	 */
+	virtual ~silvia_card_channel() { }
+	
 	/**
 	 * Get the channel type
 	 * @return the channel type
@@ -69,7 +75,7 @@ public:
 	 * @param sw The return status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data, unsigned short& sw) = 0;
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw) = 0;
 	
 	/**
 	 * Transmit an APDU and receive return data
@@ -77,7 +83,19 @@ public:
 	 * @param data_sw The return data including the status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data_sw) = 0;
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw) = 0;
+	
+	/**
+	 * Transmit a batch of APDUs and receive the return data; the exchange
+	 * stops after the first APDU for which the card returns a status word
+	 * other than 9000
+	 * @param APDUs The APDUs to transmit
+	 * @param data_sw The return data including the status word of every APDU that was exchanged
+	 * @param timings The duration of every APDU exchange in nanoseconds (optional)
+	 * @return true if all APDU exchanges completed successfully, regardless of the status words;
+	 *         a response shorter than a status word counts as a failed exchange
+	 */
+	virtual bool transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings = NULL);
 	
 	/**
 	 * Get the card reader name in which the card resides
@@ -0,0 +1,126 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_fixed_base.cpp
+
+ Precomputed powers for exponentiation with a fixed base
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_fixed_base.h"
+#include "silvia_macros.h"
+#include <gmpxx.h>
+#include <vector>
+
+silvia_fixed_base::silvia_fixed_base(const mpz_class& g, const mpz_class& n, size_t w) : mod(n)
+{
+	this->w = w;
+
+	frozen = false;
+
+	mpz_mod(_Z(this->g), _Z(g), _Z(n));
+}
+
+silvia_fixed_base::silvia_fixed_base(const mpz_class& g, const silvia_modulus& mod, size_t w) : mod(mod)
+{
+	this->w = w;
+
+	frozen = false;
+
+	mpz_mod(_Z(this->g), _Z(g), _Z(mod.get_n()));
+}
+
+const mpz_class& silvia_fixed_base::get_base()
+{
+	return g;
+}
+
+size_t silvia_fixed_base::get_window()
+{
+	return w;
+}
+
+void silvia_fixed_base::extend(size_t bits)
+{
+	if ((w == 0) || frozen) return;
+
+	if (powers.empty())
+	{
+		mpz_class g_mont;
+
+		mod.to_mont(g_mont, g);
+
+		powers.push_back(g_mont);
+	}
+
+	while (powers.size() * w < bits)
+	{
+		mpz_class next = powers.back();
+
+		for (size_t i = 0; i < w; i++)
+		{
+			mod.mul(next, next, next);
+		}
+
+		powers.push_back(next);
+	}
+}
+
+bool silvia_fixed_base::covers(size_t bits)
+{
+	return (w > 0) && (powers.size() * w >= bits);
+}
+
+void silvia_fixed_base::freeze()
+{
+	frozen = true;
+}
+
+bool silvia_fixed_base::is_frozen()
+{
+	return frozen;
+}
+
+const mpz_class& silvia_fixed_base::get_power(size_t i)
+{
+	return powers[i];
+}
+
+size_t silvia_fixed_base::size()
+{
+	return powers.size();
+}
+
+
+void silvia_fixed_base::set_powers(std::vector<mpz_class>& powers)
+{
+	this->powers.swap(powers);
+
+	frozen = true;
+}
@@ -0,0 +1,153 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_fixed_base.h
+
+ Precomputed powers for exponentiation with a fixed base
+ *****************************************************************************/
+
+#ifndef _SILVIA_FIXED_BASE_H
+#define _SILVIA_FIXED_BASE_H
+
+#include <gmpxx.h>
+#include <vector>
+#include "silvia_modulus.h"
+
+/**
+ * Default window size for fixed base tables
+ */
+#define SILVIA_FIXED_BASE_DEFAULT_WINDOW	6
+
+/**
+ * Largest supported window size for fixed base tables; combining the
+ * powers takes 2^w buckets
+ */
+#define SILVIA_FIXED_BASE_MAX_WINDOW		16
+
+/**
+ * Fixed base class; holds the powers g^(2^(w*i)) mod n of a base g
+ * that is used for many exponentiations. The table is extended to
+ * cover the longest exponent that will be used and then frozen; only
+ * frozen tables are used for exponentiations, so a table is read-only
+ * once it is in use and can be shared by threads.
+ */
+class silvia_fixed_base
+{
+public:
+	/**
+	 * Constructor
+	 * @param g the base
+	 * @param n the modulus
+	 * @param w the window size in bits; 0 disables precomputation
+	 */
+	silvia_fixed_base(const mpz_class& g, const mpz_class& n, size_t w);
+
+	/**
+	 * Constructor
+	 * @param g the base
+	 * @param mod the modulus context
+	 * @param w the window size in bits; 0 disables precomputation
+	 */
+	silvia_fixed_base(const mpz_class& g, const silvia_modulus& mod, size_t w);
+
+	/**
+	 * Get the base
+	 * @return the base g
+	 */
+	const mpz_class& get_base();
+
+	/**
+	 * Get the window size
+	 * @return the window size in bits (0 if precomputation is disabled)
+	 */
+	size_t get_window();
+
+	/**
+	 * Make sure the table covers exponents of the specified length;
+	 * does nothing if the table is frozen
+	 * @param bits the exponent length in bits
+	 */
+	void extend(size_t bits);
+
+	/**
+	 * Check if the table covers exponents of the specified length
+	 * @param bits the exponent length in bits
+	 * @return true if the table covers exponents of this length
+	 */
+	bool covers(size_t bits);
+
+	/**
+	 * Freeze the table; it will not be extended any further
+	 */
+	void freeze();
+
+	/**
+	 * Check if the table is frozen
+	 * @return true if the table is frozen
+	 */
+	bool is_frozen();
+
+	/**
+	 * Get a precomputed power; the table must have been extended far enough
+	 * @param i which power to get
+	 * @return g^(2^(w*i)) mod n in Montgomery form
+	 */
+	const mpz_class& get_power(size_t i);
+
+	/**
+	 * Get the number of precomputed powers
+	 * @return the number of powers in the table
+	 */
+	size_t size();
+
+	/**
+	 * Replace the table by powers that were computed before, e.g.
+	 * read from a compiled key cache, and freeze it; the contents
+	 * of the supplied vector are taken over
+	 * @param powers the powers g^(2^(w*i)) mod n in Montgomery form
+	 */
+	void set_powers(std::vector<mpz_class>& powers);
+
+private:
+	// The base and the modulus
+	mpz_class g;
+	silvia_modulus mod;
+
+	// The window size
+	size_t w;
+
+	// Is the table frozen?
+	bool frozen;
+
+	// The powers g^(2^(w*i)) in Montgomery form
+	std::vector<mpz_class> powers;
+};
+
+#endif // !_SILVIA_FIXED_BASE_H
+
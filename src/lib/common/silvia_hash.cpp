@@ -35,10 +35,59 @@
 #include "config.h"
 #include "silvia_hash.h"
 #include <vector>
-#include <stack>
+
+// The key for the per-thread instances
+/*static*/ pthread_key_t silvia_hash::_key;
+/*static*/ pthread_once_t silvia_hash::_key_once = PTHREAD_ONCE_INIT;
+
+/*static*/ void silvia_hash::init_key()
+{
+	pthread_key_create(&_key, delete_instances);
+}
+
+/*static*/ void silvia_hash::delete_instances(void* instances)
+{
+	std::vector<silvia_hash*>* thread_hashes = (std::vector<silvia_hash*>*) instances;
+
+	for (std::vector<silvia_hash*>::iterator i = thread_hashes->begin(); i != thread_hashes->end(); i++)
+	{
+		delete *i;
+	}
+
+	delete thread_hashes;
+}
+
+/*static*/ silvia_hash* silvia_hash::i(const std::string& type)
+{
+	pthread_once(&_key_once, init_key);
+
+	std::vector<silvia_hash*>* thread_hashes = (std::vector<silvia_hash*>*) pthread_getspecific(_key);
+
+	if (thread_hashes == NULL)
+	{
+		thread_hashes = new std::vector<silvia_hash*>();
+
+		pthread_setspecific(_key, thread_hashes);
+	}
+
+	for (std::vector<silvia_hash*>::iterator i = thread_hashes->begin(); i != thread_hashes->end(); i++)
+	{
+		if ((*i)->type == type)
+		{
+			return *i;
+		}
+	}
+
+	thread_hashes->push_back(new silvia_hash(type));
+
+	return thread_hashes->back();
+}
 
 silvia_hash::silvia_hash(const std::string type)
 {
+	this->type = type;
+	hash_ctx = EVP_MD_CTX_new();
+
 	if (type == "sha1")
 	{
 		hash = (EVP_MD*) EVP_sha1();	
@@ -54,60 +103,73 @@ silvia_hash::silvia_hash(const std::string type)
 	else
 	{
 		// TODO: throw an exception!
-		return;
+		hash = NULL;
 	}
-
-	dirty = false;
 }
 
 silvia_hash::~silvia_hash()
 {
-	if (dirty) EVP_MD_CTX_cleanup(&hash_ctx);
+	EVP_MD_CTX_free(hash_ctx);
 }
 
 void silvia_hash::init()
 {
-	EVP_DigestInit(&hash_ctx, hash);
-	dirty = true;
+	EVP_DigestInit_ex(hash_ctx, hash, NULL);
 }
 
 void silvia_hash::update(const unsigned char* data, size_t size)
 {
-	EVP_DigestUpdate(&hash_ctx, (unsigned char*) data, size);
+	EVP_DigestUpdate(hash_ctx, data, size);
 }
 
-void silvia_hash::update(const std::vector<unsigned char> data)
+void silvia_hash::update(const std::vector<unsigned char>& data)
 {
+	if (data.empty()) return;
+
 	this->update(&data[0], data.size());
 }
 
-void silvia_hash::update(mpz_class data)
+void silvia_hash::update(const mpz_class& data)
 {
-	size_t count = 0;
-
-	// Output data as big endian byte string
-	unsigned char* mpz_bytes = (unsigned char*) mpz_export(NULL, &count, 1, sizeof(unsigned char), 1, 0, data.get_mpz_t());
-	
-	this->update(mpz_bytes, count);
-	
-	free(mpz_bytes);
+	// Output data as big endian byte string, one limb at a time, so
+	// the integer never has to be exported to a separate buffer
+	unsigned char limb_bytes[sizeof(mp_limb_t)];
+	size_t limbs = mpz_size(data.get_mpz_t());
+	bool leading = true;
+
+	for (size_t i = limbs; i > 0; i--)
+	{
+		mp_limb_t limb = mpz_getlimbn(data.get_mpz_t(), i - 1);
+
+		for (size_t j = sizeof(mp_limb_t); j > 0; j--)
+		{
+			limb_bytes[j - 1] = (unsigned char) (limb & 0xff);
+			limb >>= 8;
+		}
+
+		size_t skip = 0;
+
+		if (leading)
+		{
+			while ((skip < sizeof(mp_limb_t)) && (limb_bytes[skip] == 0x00)) skip++;
+
+			leading = false;
+		}
+
+		this->update(&limb_bytes[skip], sizeof(mp_limb_t) - skip);
+	}
 }
 
 mpz_class silvia_hash::final()
 {
-	std::vector<unsigned char> hash_data;
-	hash_data.resize(64); // enough to hold a SHA512 hash
+	unsigned char hash_data[EVP_MAX_MD_SIZE];
+	unsigned int out_len = EVP_MAX_MD_SIZE;
 
-	unsigned int out_len = 64;
-
-	EVP_DigestFinal(&hash_ctx, &hash_data[0], &out_len);
-	
-	dirty = false;
+	EVP_DigestFinal_ex(hash_ctx, hash_data, &out_len);
 
 	mpz_class rv;
 
-	mpz_import(rv.get_mpz_t(), out_len, 1, sizeof(unsigned char), 1, 0, &hash_data[0]);
+	mpz_import(rv.get_mpz_t(), out_len, 1, sizeof(unsigned char), 1, 0, hash_data);
 
 	return rv;
 }
-
@@ -38,11 +38,13 @@
 #include "config.h"
 #include <gmpxx.h>
 #include <openssl/evp.h>
+#include <pthread.h>
 #include <string>
 #include <vector>
 
 /**
- * Hash class
+ * Hash class; the digest context is allocated once and reused for
+ * every hash computed with the same instance
  */
 class silvia_hash
 {
@@ -58,6 +60,13 @@ public:
 	 */
 	~silvia_hash();
 
+	/**
+	 * Get the reusable instance of a hash type for the calling thread
+	 * @param type the hash type; can be "sha1", "sha256" or "sha512"
+	 * @return the instance for the calling thread
+	 */
+	static silvia_hash* i(const std::string& type);
+
 	/**
 	 * Initialise hashing
 	 */
@@ -74,13 +83,14 @@ public:
 	 * Hash the supplied data
 	 * @param data the data to hash
 	 */
-	void update(const std::vector<unsigned char> data);
+	void update(const std::vector<unsigned char>& data);
 
 	/**
-	 * Hash the supplied data
+	 * Hash the supplied data; the magnitude of the integer is
+	 * hashed as a big endian byte string without leading zeroes
 	 * @param data the data to hash
 	 */
-	void update(mpz_class data);
+	void update(const mpz_class& data);
 
 	/**
 	 * Finish hashing
@@ -88,9 +98,23 @@ public:
 	mpz_class final();
 
 private:
-	EVP_MD_CTX hash_ctx;
+	// Prevent copying
+	silvia_hash(const silvia_hash&);
+	silvia_hash& operator=(const silvia_hash&);
+
+	// Create the key for the per-thread instances
+	static void init_key();
+
+	// Delete the instances of a thread when it exits
+	static void delete_instances(void* instances);
+
+	// The key for the per-thread instances
+	static pthread_key_t _key;
+	static pthread_once_t _key_once;
+
+	std::string type;
+	EVP_MD_CTX* hash_ctx;
 	EVP_MD* hash;
-	bool dirty;
 };
 
 #endif // !_SILVIA_HASH_H
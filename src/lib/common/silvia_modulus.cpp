@@ -0,0 +1,180 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_modulus.cpp
+
+ Montgomery arithmetic context for a fixed modulus
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_modulus.h"
+#include "silvia_macros.h"
+#include <gmpxx.h>
+
+silvia_modulus::silvia_modulus(const mpz_class& n)
+{
+	this->n = n;
+
+	limbs = mpz_size(_Z(n));
+	montgomery = (mpz_odd_p(_Z(n)) != 0) && (mpz_sgn(_Z(n)) > 0);
+	n_inv = 0;
+
+	if (!montgomery)
+	{
+		R_mod_n = 1;
+		mpz_mod(_Z(R_mod_n), _Z(R_mod_n), _Z(n));
+
+		return;
+	}
+
+	// Compute n^-1 mod 2^GMP_NUMB_BITS by Newton iteration; every
+	// step doubles the number of correct bits, starting from 1
+	mp_limb_t n_0 = mpz_getlimbn(_Z(n), 0);
+	mp_limb_t inv = 1;
+
+	for (size_t bits = 1; bits < GMP_NUMB_BITS; bits *= 2)
+	{
+		inv *= 2 - n_0 * inv;
+	}
+
+	n_inv = -inv;
+
+	mpz_setbit(_Z(R_mod_n), limbs * GMP_NUMB_BITS);
+	mpz_mod(_Z(R_mod_n), _Z(R_mod_n), _Z(n));
+
+	mpz_setbit(_Z(R2_mod_n), 2 * limbs * GMP_NUMB_BITS);
+	mpz_mod(_Z(R2_mod_n), _Z(R2_mod_n), _Z(n));
+}
+
+const mpz_class& silvia_modulus::get_n() const
+{
+	return n;
+}
+
+void silvia_modulus::redc(mpz_class& t) const
+{
+	// Add multiples of n to clear the low limbs one at a time; the
+	// carry of each step is stored in the limb that was cleared
+	size_t t_size = mpz_size(_Z(t));
+	mp_limb_t* tp = mpz_limbs_modify(_Z(t), 2 * limbs);
+	const mp_limb_t* np = mpz_limbs_read(_Z(n));
+
+	for (size_t i = t_size; i < 2 * limbs; i++)
+	{
+		tp[i] = 0;
+	}
+
+	for (size_t i = 0; i < limbs; i++)
+	{
+		mp_limb_t q = tp[i] * n_inv;
+
+		tp[i] = mpn_addmul_1(tp + i, np, limbs, q);
+	}
+
+	// The result is the high half plus the saved carries; it is less
+	// than R + n, so one subtraction brings it below R
+	if (mpn_add_n(tp, tp + limbs, tp, limbs) != 0)
+	{
+		mpn_sub_n(tp, tp, np, limbs);
+	}
+
+	mpz_limbs_finish(_Z(t), limbs);
+}
+
+void silvia_modulus::to_mont(mpz_class& r, const mpz_class& a) const
+{
+	mpz_mod(_Z(r), _Z(a), _Z(n));
+
+	if (montgomery)
+	{
+		mul(r, r, R2_mod_n);
+	}
+}
+
+void silvia_modulus::from_mont(mpz_class& r, const mpz_class& a) const
+{
+	r = a;
+
+	if (montgomery)
+	{
+		redc(r);
+	}
+
+	if (mpz_cmp(_Z(r), _Z(n)) >= 0)
+	{
+		mpz_mod(_Z(r), _Z(r), _Z(n));
+	}
+}
+
+void silvia_modulus::mul(mpz_class& r, const mpz_class& a, const mpz_class& b) const
+{
+	mpz_mul(_Z(r), _Z(a), _Z(b));
+
+	if (montgomery)
+	{
+		redc(r);
+	}
+	else
+	{
+		mpz_mod(_Z(r), _Z(r), _Z(n));
+	}
+}
+
+const mpz_class& silvia_modulus::one() const
+{
+	return R_mod_n;
+}
+
+mpz_class silvia_modulus::mulmod(const mpz_class& a, const mpz_class& b) const
+{
+	// A single product does not pay for the conversions
+	mpz_class r;
+
+	mpz_mul(_Z(r), _Z(a), _Z(b));
+	mpz_mod(_Z(r), _Z(r), _Z(n));
+
+	return r;
+}
+
+mpz_class silvia_modulus::powm(const mpz_class& b, const mpz_class& e) const
+{
+	// GMP already performs single exponentiations in Montgomery form
+	// at the mpn level, which is faster than doing it here
+	mpz_class r;
+
+	if ((mpz_sgn(_Z(e)) < 0) && (mpz_invert(_Z(r), _Z(b), _Z(n)) == 0))
+	{
+		return mpz_class(0);
+	}
+
+	mpz_powm(_Z(r), _Z(b), _Z(e), _Z(n));
+
+	return r;
+}
+
@@ -0,0 +1,133 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_modulus.h
+
+ Montgomery arithmetic context for a fixed modulus
+ *****************************************************************************/
+
+#ifndef _SILVIA_MODULUS_H
+#define _SILVIA_MODULUS_H
+
+#include <gmpxx.h>
+
+/**
+ * Modulus class; holds the setup for Montgomery multiplication modulo
+ * an odd n, so that it is computed only once per key. Values in
+ * Montgomery form represent a as a*R mod n, with R = 2^(limbs(n) *
+ * GMP_NUMB_BITS); they are kept below R but are not necessarily fully
+ * reduced until they are converted back. An even modulus is supported
+ * by falling back to plain division-based reduction, in which case the
+ * Montgomery form of a value is the value itself.
+ *
+ * All methods are const and use no shared scratch space, so a modulus
+ * can be used by multiple threads simultaneously.
+ */
+class silvia_modulus
+{
+public:
+	/**
+	 * Constructor
+	 * @param n the modulus
+	 */
+	silvia_modulus(const mpz_class& n);
+
+	/**
+	 * Get the modulus
+	 * @return the modulus n
+	 */
+	const mpz_class& get_n() const;
+
+	/**
+	 * Convert a value to Montgomery form
+	 * @param r receives a*R mod n
+	 * @param a the value to convert; may be negative or larger than n
+	 */
+	void to_mont(mpz_class& r, const mpz_class& a) const;
+
+	/**
+	 * Convert a value from Montgomery form
+	 * @param r receives the fully reduced value a*R^-1 mod n
+	 * @param a the value in Montgomery form
+	 */
+	void from_mont(mpz_class& r, const mpz_class& a) const;
+
+	/**
+	 * Montgomery multiplication; r may be the same as a or b
+	 * @param r receives a*b*R^-1 mod n
+	 * @param a the first factor in Montgomery form
+	 * @param b the second factor in Montgomery form
+	 */
+	void mul(mpz_class& r, const mpz_class& a, const mpz_class& b) const;
+
+	/**
+	 * Get the Montgomery form of 1
+	 * @return R mod n
+	 */
+	const mpz_class& one() const;
+
+	/**
+	 * Multiply two values in normal form
+	 * @param a the first factor
+	 * @param b the second factor
+	 * @return a*b mod n
+	 */
+	mpz_class mulmod(const mpz_class& a, const mpz_class& b) const;
+
+	/**
+	 * Modular exponentiation in normal form
+	 * @param b the base
+	 * @param e the exponent; may be negative
+	 * @return b^e mod n, or 0 if e is negative and b has no inverse mod n
+	 */
+	mpz_class powm(const mpz_class& b, const mpz_class& e) const;
+
+private:
+	// Montgomery reduction of t < R^2 in place
+	void redc(mpz_class& t) const;
+
+	// The modulus
+	mpz_class n;
+
+	// Number of limbs of n
+	size_t limbs;
+
+	// True if Montgomery multiplication is used (n is odd)
+	bool montgomery;
+
+	// -n^-1 mod 2^GMP_NUMB_BITS
+	mp_limb_t n_inv;
+
+	// R mod n and R^2 mod n
+	mpz_class R_mod_n;
+	mpz_class R2_mod_n;
+};
+
+#endif // !_SILVIA_MODULUS_H
+
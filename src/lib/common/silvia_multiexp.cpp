@@ -0,0 +1,516 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_multiexp.cpp
+
+ Simultaneous multi-exponentiation modulo n
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_multiexp.h"
+#include "silvia_macros.h"
+#include <gmpxx.h>
+#include <vector>
+#include <algorithm>
+
+silvia_multiexp::silvia_multiexp(const mpz_class& n) : mod(n)
+{
+	max_bits = 0;
+}
+
+silvia_multiexp::silvia_multiexp(const silvia_modulus& mod) : mod(mod)
+{
+	max_bits = 0;
+}
+
+bool silvia_multiexp::add(const mpz_class& b, const mpz_class& x)
+{
+	if (mpz_sgn(_Z(x)) == 0)
+	{
+		// b^0 = 1, nothing to factor in
+		return true;
+	}
+
+	mpz_class base;
+	mpz_class exp;
+
+	if (mpz_sgn(_Z(x)) < 0)
+	{
+		// b^-x = (b^-1)^x
+		if (mpz_invert(_Z(base), _Z(b), _Z(mod.get_n())) == 0)
+		{
+			return false;
+		}
+
+		mpz_neg(_Z(exp), _Z(x));
+	}
+	else
+	{
+		base = b;
+		exp = x;
+	}
+
+	mod.to_mont(base, base);
+
+	size_t bits = mpz_sizeinbase(_Z(exp), 2);
+
+	if (bits > max_bits) max_bits = bits;
+
+	bases.push_back(base);
+	exps.push_back(exp);
+
+	return true;
+}
+
+bool silvia_multiexp::add(silvia_fixed_base* b, const mpz_class& x)
+{
+	if (mpz_sgn(_Z(x)) == 0)
+	{
+		return true;
+	}
+
+	size_t bits = mpz_sizeinbase(_Z(x), 2);
+
+	// The table is never changed here, since the base may be shared
+	// between threads; tables that have not been frozen are not used
+	if ((mpz_sgn(_Z(x)) < 0) || !b->is_frozen() || !b->covers(bits))
+	{
+		// No precomputed powers available for this base or its inverse,
+		// or the exponent is longer than the frozen table
+		return add(b->get_base(), x);
+	}
+
+	fixed_bases.push_back(b);
+	fixed_exps.push_back(x);
+
+	return true;
+}
+
+mpz_class silvia_multiexp::compute(silvia_multiexp_alg_t alg /* = SILVIA_MULTIEXP_AUTO */)
+{
+	// All intermediate values are in Montgomery form; the result is
+	// only converted back at the end
+	mpz_class result;
+
+	if (bases.empty())
+	{
+		compute_fixed(result);
+
+		mod.from_mont(result, result);
+
+		return result;
+	}
+
+	size_t c = 0;
+
+	switch(alg)
+	{
+	case SILVIA_MULTIEXP_STRAUS:
+		compute_straus(result);
+		break;
+	case SILVIA_MULTIEXP_PIPPENGER:
+		pippenger_cost(c);
+		compute_pippenger(result, c);
+		break;
+	default:
+		if (pippenger_cost(c) < straus_cost())
+		{
+			compute_pippenger(result, c);
+		}
+		else
+		{
+			compute_straus(result);
+		}
+		break;
+	}
+
+	if (!fixed_bases.empty())
+	{
+		mpz_class fixed_result;
+
+		compute_fixed(fixed_result);
+
+		mod.mul(result, result, fixed_result);
+	}
+
+	mod.from_mont(result, result);
+
+	return result;
+}
+
+void silvia_multiexp::clear()
+{
+	bases.clear();
+	exps.clear();
+	fixed_bases.clear();
+	fixed_exps.clear();
+	max_bits = 0;
+}
+
+size_t silvia_multiexp::size()
+{
+	return bases.size() + fixed_bases.size();
+}
+
+/*static*/ size_t silvia_multiexp::straus_window(size_t bits)
+{
+	// Same trade-off between table size and multiplications as
+	// used by OpenSSL for single exponentiations
+	if (bits > 671) return 6;
+	if (bits > 239) return 5;
+	if (bits > 79) return 4;
+	if (bits > 23) return 3;
+
+	return 1;
+}
+
+size_t silvia_multiexp::straus_cost()
+{
+	// One squaring per bit of the longest exponent plus, for
+	// each base, the table and one multiplication per window
+	size_t cost = max_bits;
+
+	for (std::vector<mpz_class>::iterator i = exps.begin(); i != exps.end(); i++)
+	{
+		size_t bits = mpz_sizeinbase(_Z((*i)), 2);
+		size_t w = straus_window(bits);
+
+		cost += (1 << (w - 1)) + (bits / (w + 1));
+	}
+
+	return cost;
+}
+
+size_t silvia_multiexp::pippenger_cost(size_t& best_c)
+{
+	size_t best_cost = 0;
+
+	best_c = 1;
+
+	for (size_t c = 1; c <= 16; c++)
+	{
+		size_t windows = (max_bits + c - 1) / c;
+
+		// Squarings and bucket aggregation for each window
+		size_t cost = windows * (c + (1 << (c + 1)));
+
+		// One bucket multiplication per non-zero digit
+		for (std::vector<mpz_class>::iterator i = exps.begin(); i != exps.end(); i++)
+		{
+			cost += (mpz_sizeinbase(_Z((*i)), 2) + c - 1) / c;
+		}
+
+		if ((c == 1) || (cost < best_cost))
+		{
+			best_cost = cost;
+			best_c = c;
+		}
+	}
+
+	return best_cost;
+}
+
+void silvia_multiexp::compute_straus(mpz_class& result)
+{
+	// A window of an exponent ends at bit <pos> and multiplies in
+	// entry <idx> of the table of odd powers of the base
+	struct window
+	{
+		size_t pos;
+		size_t idx;
+	};
+
+	std::vector<std::vector<mpz_class> > tables(bases.size());
+	std::vector<std::vector<window> > windows(bases.size());
+	std::vector<size_t> next(bases.size(), 0);
+
+	for (size_t i = 0; i < bases.size(); i++)
+	{
+		mpz_srcptr x = _Z(exps[i]);
+		size_t bits = mpz_sizeinbase(x, 2);
+		size_t w = straus_window(bits);
+
+		// Compute the table b, b^3, b^5, ..., b^(2^w - 1)
+		tables[i].resize(1 << (w - 1));
+		tables[i][0] = bases[i];
+
+		if (w > 1)
+		{
+			mpz_class b_2;
+			mod.mul(b_2, bases[i], bases[i]);
+
+			for (size_t j = 1; j < tables[i].size(); j++)
+			{
+				mod.mul(tables[i][j], tables[i][j - 1], b_2);
+			}
+		}
+
+		// Split the exponent in windows that start and end with a 1-bit
+		long bit = (long) bits - 1;
+
+		while (bit >= 0)
+		{
+			if (mpz_tstbit(x, bit) == 0)
+			{
+				bit--;
+				continue;
+			}
+
+			long low = bit - (long) w + 1;
+
+			if (low < 0) low = 0;
+
+			while (mpz_tstbit(x, low) == 0) low++;
+
+			size_t value = 0;
+
+			for (long j = bit; j >= low; j--)
+			{
+				value = (value << 1) | mpz_tstbit(x, j);
+			}
+
+			window win = { (size_t) low, value >> 1 };
+			windows[i].push_back(win);
+
+			bit = low - 1;
+		}
+	}
+
+	// Process all exponents simultaneously from the most significant bit
+	bool is_one = true;
+
+	for (long bit = (long) max_bits - 1; bit >= 0; bit--)
+	{
+		if (!is_one)
+		{
+			mod.mul(result, result, result);
+		}
+
+		for (size_t i = 0; i < bases.size(); i++)
+		{
+			if ((next[i] < windows[i].size()) && (windows[i][next[i]].pos == (size_t) bit))
+			{
+				mpz_class& factor = tables[i][windows[i][next[i]].idx];
+
+				if (is_one)
+				{
+					result = factor;
+					is_one = false;
+				}
+				else
+				{
+					mod.mul(result, result, factor);
+				}
+
+				next[i]++;
+			}
+		}
+	}
+
+	if (is_one) result = mod.one();
+}
+
+void silvia_multiexp::compute_pippenger(mpz_class& result, size_t c)
+{
+	size_t num_windows = (max_bits + c - 1) / c;
+	std::vector<mpz_class> buckets(1 << c);
+	std::vector<bool> used(1 << c);
+	bool is_one = true;
+
+	for (long win = (long) num_windows - 1; win >= 0; win--)
+	{
+		if (!is_one)
+		{
+			for (size_t j = 0; j < c; j++)
+			{
+				mod.mul(result, result, result);
+			}
+		}
+
+		// Sort the bases in buckets by their digit in this window
+		std::fill(used.begin(), used.end(), false);
+
+		for (size_t i = 0; i < bases.size(); i++)
+		{
+			size_t digit = 0;
+
+			for (long j = (long) ((win + 1) * c) - 1; j >= (long) (win * c); j--)
+			{
+				digit = (digit << 1) | mpz_tstbit(_Z(exps[i]), j);
+			}
+
+			if (digit == 0) continue;
+
+			if (used[digit])
+			{
+				mod.mul(buckets[digit], buckets[digit], bases[i]);
+			}
+			else
+			{
+				buckets[digit] = bases[i];
+				used[digit] = true;
+			}
+		}
+
+		// Compute prod(bucket[d]^d) using running products
+		mpz_class running;
+		mpz_class window_prod;
+		bool running_one = true;
+		bool window_one = true;
+
+		for (size_t d = buckets.size() - 1; d > 0; d--)
+		{
+			if (used[d])
+			{
+				if (running_one)
+				{
+					running = buckets[d];
+					running_one = false;
+				}
+				else
+				{
+					mod.mul(running, running, buckets[d]);
+				}
+			}
+
+			if (running_one) continue;
+
+			if (window_one)
+			{
+				window_prod = running;
+				window_one = false;
+			}
+			else
+			{
+				mod.mul(window_prod, window_prod, running);
+			}
+		}
+
+		if (window_one) continue;
+
+		if (is_one)
+		{
+			result = window_prod;
+			is_one = false;
+		}
+		else
+		{
+			mod.mul(result, result, window_prod);
+		}
+	}
+
+	if (is_one) result = mod.one();
+}
+
+void silvia_multiexp::compute_fixed(mpz_class& result)
+{
+	// Write each exponent x as sum(d_i * 2^(w*i)) so that b^x is the
+	// product of the precomputed powers b_i = b^(2^(w*i)) raised to
+	// the digits d_i. The powers are sorted in buckets by their digit
+	// and the buckets are combined as in Pippenger's method; factors
+	// with the same window size share the buckets.
+	std::vector<bool> done(fixed_bases.size(), false);
+	bool is_one = true;
+
+	for (size_t first = 0; first < fixed_bases.size(); first++)
+	{
+		if (done[first]) continue;
+
+		size_t w = fixed_bases[first]->get_window();
+		std::vector<mpz_class> buckets(1 << w);
+		std::vector<bool> used(1 << w, false);
+
+		for (size_t i = first; i < fixed_bases.size(); i++)
+		{
+			if (done[i] || (fixed_bases[i]->get_window() != w)) continue;
+
+			mpz_srcptr x = _Z(fixed_exps[i]);
+			size_t bits = mpz_sizeinbase(x, 2);
+
+			for (size_t power = 0; power * w < bits; power++)
+			{
+				size_t digit = 0;
+
+				for (long j = (long) ((power + 1) * w) - 1; j >= (long) (power * w); j--)
+				{
+					digit = (digit << 1) | mpz_tstbit(x, j);
+				}
+
+				if (digit == 0) continue;
+
+				if (used[digit])
+				{
+					mod.mul(buckets[digit], buckets[digit], fixed_bases[i]->get_power(power));
+				}
+				else
+				{
+					buckets[digit] = fixed_bases[i]->get_power(power);
+					used[digit] = true;
+				}
+			}
+
+			done[i] = true;
+		}
+
+		// Compute prod(bucket[d]^d) using running products
+		mpz_class running;
+		bool running_one = true;
+
+		for (size_t d = buckets.size() - 1; d > 0; d--)
+		{
+			if (used[d])
+			{
+				if (running_one)
+				{
+					running = buckets[d];
+					running_one = false;
+				}
+				else
+				{
+					mod.mul(running, running, buckets[d]);
+				}
+			}
+
+			if (running_one) continue;
+
+			if (is_one)
+			{
+				result = running;
+				is_one = false;
+			}
+			else
+			{
+				mod.mul(result, result, running);
+			}
+		}
+	}
+
+	if (is_one) result = mod.one();
+}
+
@@ -0,0 +1,143 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_multiexp.h
+
+ Simultaneous multi-exponentiation modulo n
+ *****************************************************************************/
+
+#ifndef _SILVIA_MULTIEXP_H
+#define _SILVIA_MULTIEXP_H
+
+#include "config.h"
+#include <gmpxx.h>
+#include <vector>
+#include "silvia_fixed_base.h"
+#include "silvia_modulus.h"
+
+/**
+ * Multi-exponentiation algorithms
+ */
+typedef enum
+{
+	SILVIA_MULTIEXP_AUTO,		/**< select the cheapest algorithm for the input */
+	SILVIA_MULTIEXP_STRAUS,		/**< interleaved sliding windows (Straus) */
+	SILVIA_MULTIEXP_PIPPENGER	/**< bucketed windows (Pippenger) */
+}
+silvia_multiexp_alg_t;
+
+/**
+ * Multi-exponentiation class; computes prod(b_j^x_j) mod n in a
+ * single pass, sharing the squarings between all bases. Factors with
+ * a fixed base use its precomputed powers and need no squarings. All
+ * intermediate values are kept in Montgomery form.
+ */
+class silvia_multiexp
+{
+public:
+	/**
+	 * Constructor
+	 * @param n the modulus
+	 */
+	silvia_multiexp(const mpz_class& n);
+
+	/**
+	 * Constructor
+	 * @param mod the modulus context to use (e.g. the one of a public key)
+	 */
+	silvia_multiexp(const silvia_modulus& mod);
+
+	/**
+	 * Add a factor b^x to the product
+	 * @param b the base
+	 * @param x the exponent; may be negative
+	 * @return false if x is negative and b has no inverse mod n
+	 */
+	bool add(const mpz_class& b, const mpz_class& x);
+
+	/**
+	 * Add a factor b^x with a fixed base to the product
+	 * @param b the fixed base; its precomputed powers are only used if the table is frozen
+	 * @param x the exponent; may be negative
+	 * @return false if x is negative and b has no inverse mod n
+	 */
+	bool add(silvia_fixed_base* b, const mpz_class& x);
+
+	/**
+	 * Compute the product of all factors added so far
+	 * @param alg the algorithm to use for factors with a variable base (for testing only)
+	 * @return prod(b_j^x_j) mod n
+	 */
+	mpz_class compute(silvia_multiexp_alg_t alg = SILVIA_MULTIEXP_AUTO);
+
+	/**
+	 * Remove all factors
+	 */
+	void clear();
+
+	/**
+	 * Get the number of factors
+	 * @return the number of factors that will be multiplied
+	 */
+	size_t size();
+
+private:
+	// Interleaved sliding window exponentiation
+	void compute_straus(mpz_class& result);
+
+	// Bucketed window exponentiation
+	void compute_pippenger(mpz_class& result, size_t c);
+
+	// Exponentiation using the precomputed powers of fixed bases
+	void compute_fixed(mpz_class& result);
+
+	// Estimated number of multiplications for each algorithm
+	size_t straus_cost();
+	size_t pippenger_cost(size_t& best_c);
+
+	// Get the window size for an exponent of the specified length
+	static size_t straus_window(size_t bits);
+
+	// The modulus
+	silvia_modulus mod;
+
+	// The factors; bases are in Montgomery form, exponents are non-negative
+	std::vector<mpz_class> bases;
+	std::vector<mpz_class> exps;
+
+	// The factors with a fixed base
+	std::vector<silvia_fixed_base*> fixed_bases;
+	std::vector<mpz_class> fixed_exps;
+
+	// The length of the longest exponent with a variable base
+	size_t max_bits;
+};
+
+#endif // !_SILVIA_MULTIEXP_H
+
@@ -37,13 +37,16 @@
 
 // The one-and-only instance
 /*static*/ std::auto_ptr<silvia_system_parameters> silvia_system_parameters::_i(NULL);
+/*static*/ pthread_once_t silvia_system_parameters::_i_once = PTHREAD_ONCE_INIT;
+
+/*static*/ void silvia_system_parameters::init_i()
+{
+	_i = std::auto_ptr<silvia_system_parameters>(new silvia_system_parameters());
+}
 
 /*static*/ silvia_system_parameters* silvia_system_parameters::i()
 {
-	if (_i.get() == NULL)
-	{
-		_i = std::auto_ptr<silvia_system_parameters>(new silvia_system_parameters());
-	}
+	pthread_once(&_i_once, init_i);
 
 	return _i.get();
 }
@@ -58,7 +61,7 @@ void silvia_system_parameters::set_l_n(size_t l_n)
 	this->l_n = l_n;
 }
 
-size_t silvia_system_parameters::get_l_n()
+size_t silvia_system_parameters::get_l_n() const
 {
 	return l_n;
 }
@@ -68,7 +71,7 @@ void silvia_system_parameters::set_l_m(size_t l_m)
 	this->l_m = l_m;
 }
 
-size_t silvia_system_parameters::get_l_m()
+size_t silvia_system_parameters::get_l_m() const
 {
 	return l_m;
 }
@@ -78,7 +81,7 @@ void silvia_system_parameters::set_l_e(size_t l_e)
 	this->l_e = l_e;
 }
 
-size_t silvia_system_parameters::get_l_e()
+size_t silvia_system_parameters::get_l_e() const
 {
 	return l_e;
 }
@@ -88,7 +91,7 @@ void silvia_system_parameters::set_l_e_prime(size_t l_e_prime)
 	this->l_e_prime = l_e_prime;
 }
 
-size_t silvia_system_parameters::get_l_e_prime()
+size_t silvia_system_parameters::get_l_e_prime() const
 {
 	return l_e_prime;
 }
@@ -98,7 +101,7 @@ void silvia_system_parameters::set_l_v(size_t l_v)
 	this->l_v = l_v;
 }
 
-size_t silvia_system_parameters::get_l_v()
+size_t silvia_system_parameters::get_l_v() const
 {
 	return l_v;
 }
@@ -108,7 +111,7 @@ void silvia_system_parameters::set_l_statzk(size_t l_statzk)
 	this->l_statzk = l_statzk;
 }
 
-size_t silvia_system_parameters::get_l_statzk()
+size_t silvia_system_parameters::get_l_statzk() const
 {
 	return l_statzk;
 }
@@ -118,7 +121,7 @@ void silvia_system_parameters::set_l_H(size_t l_H)
 	this->l_H = l_H;
 }
 
-size_t silvia_system_parameters::get_l_H()
+size_t silvia_system_parameters::get_l_H() const
 {
 	return l_H;
 }
@@ -128,7 +131,7 @@ void silvia_system_parameters::set_hash_type(std::string hash_type)
 	this->hash_type = hash_type;
 }
 	
-std::string silvia_system_parameters::get_hash_type()
+std::string silvia_system_parameters::get_hash_type() const
 {
 	return hash_type;
 }
@@ -139,12 +142,12 @@ void silvia_system_parameters::set_l_pt(size_t l_pt)
 	this->rabin_miller_its = (l_pt / 2) + (l_pt % 2); // round up
 }
 	
-size_t silvia_system_parameters::get_l_pt()
+size_t silvia_system_parameters::get_l_pt() const
 {
 	return l_pt;
 }
 	
-size_t silvia_system_parameters::get_rabin_miller_its()
+size_t silvia_system_parameters::get_rabin_miller_its() const
 {
 	return rabin_miller_its;
 }
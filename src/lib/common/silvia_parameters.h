@@ -36,20 +36,27 @@
 #include <memory>
 #include <string>
 #include <stdlib.h>
+#include <pthread.h>
 
 #define SYSPAR(par) silvia_system_parameters::i()->get_##par()
 
 #define SYSPAR_BYTES(par) ((silvia_system_parameters::i()->get_##par() / 8) + ((silvia_system_parameters::i()->get_##par() % 8) != 0 ? 1 : 0))
 
 /**
- * System parameters (singleton)
+ * System parameters; the process-wide instance is returned by i(), but
+ * copies can be made to give a runtime context its own parameters
  */
 class silvia_system_parameters
 {
 public:
 	/**
-	 * Get the one-and-only instance
-	 * @return the one-and-only instance
+	 * Constructor; initialises the parameters to their default values
+	 */
+	silvia_system_parameters();
+
+	/**
+	 * Get the process-wide instance
+	 * @return the process-wide instance
 	 */
 	static silvia_system_parameters* i();
 
@@ -63,7 +70,7 @@ public:
 	 * Get l_n
 	 * @return the value for l_n
 	 */
-	size_t get_l_n();
+	size_t get_l_n() const;
 
 	/**
 	 * Set l_m
@@ -75,7 +82,7 @@ public:
 	 * Get l_m
 	 * @return the value for l_m
 	 */
-	size_t get_l_m();
+	size_t get_l_m() const;
 
 	/**
 	 * Set l_e
@@ -87,7 +94,7 @@ public:
 	 * Get l_e
 	 * @return the value for l_e
 	 */
-	size_t get_l_e();
+	size_t get_l_e() const;
 
 	/**
 	 * Set l_prime_e
@@ -99,7 +106,7 @@ public:
 	 * Get l_prime_e
 	 * @return the value for l_e'
 	 */
-	size_t get_l_e_prime();
+	size_t get_l_e_prime() const;
 
 	/**
 	 * Set l_v
@@ -111,7 +118,7 @@ public:
 	 * Get l_v
 	 * @return the value for l_v
 	 */
-	size_t get_l_v();
+	size_t get_l_v() const;
 
 	/**
 	 * Set l_statzk
@@ -123,7 +130,7 @@ public:
 	 * Get l_statzk
 	 * @return the value for l_statzk
 	 */
-	size_t get_l_statzk();
+	size_t get_l_statzk() const;
 
 	/**
 	 * Set l_H
@@ -135,7 +142,7 @@ public:
 	 * Get l_H
 	 * @return the value for l_H
 	 */
-	size_t get_l_H();
+	size_t get_l_H() const;
 	
 	/**
 	 * Set the hash type
@@ -147,7 +154,7 @@ public:
 	 * Get the hash type
 	 * @return the hash type to use
 	 */
-	std::string get_hash_type();
+	std::string get_hash_type() const;
 	
 	/**
 	 * Set the primality test error boundary; influences the number of
@@ -163,7 +170,7 @@ public:
 	 * p, q and e.
 	 * @return the primality test error boundary
 	 */
-	size_t get_l_pt();
+	size_t get_l_pt() const;
 	
 	/**
 	 * Returns the number of invocations of the Rabin-Miller primality
@@ -172,7 +179,7 @@ public:
 	 * test should be invoked to satisfy the error bound set for
 	 * prime generation.
 	 */
-	size_t get_rabin_miller_its();
+	size_t get_rabin_miller_its() const;
 	
 	/**
 	 * Reset system parameters to default values
@@ -180,11 +187,12 @@ public:
 	void reset();
 
 private:
-	// Constructor
-	silvia_system_parameters();
+	// Create the process-wide instance
+	static void init_i();
 
-	// The one-and-only instance
+	// The process-wide instance
 	static std::auto_ptr<silvia_system_parameters> _i;
+	static pthread_once_t _i_once;
 
 	// The system parameters
 	size_t l_n;
@@ -35,77 +35,228 @@
 #include "config.h"
 #include "silvia_rand.h"
 #include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
 #include "silvia_macros.h"
 
-// The one-and-only instance
-/*static*/ std::auto_ptr<silvia_rng> silvia_rng::_i(NULL);
+// The DRBG is rekeyed with the first bytes of every refill; these are
+// the AES-256 key and the initial counter block
+#define DRBG_KEY_SIZE		32
+#define DRBG_SEED_SIZE		48
+
+// The key for the per-thread instances
+/*static*/ pthread_key_t silvia_rng::_key;
+/*static*/ pthread_once_t silvia_rng::_key_once = PTHREAD_ONCE_INIT;
+
+/*static*/ void silvia_rng::init_key()
+{
+	pthread_key_create(&_key, delete_instance);
+}
+
+/*static*/ void silvia_rng::delete_instance(void* instance)
+{
+	delete (silvia_rng*) instance;
+}
 
 /*static*/ silvia_rng* silvia_rng::i()
 {
-	if (_i.get() == NULL)
+	pthread_once(&_key_once, init_key);
+
+	silvia_rng* instance = (silvia_rng*) pthread_getspecific(_key);
+
+	if (instance == NULL)
 	{
-		_i = std::auto_ptr<silvia_rng>(new silvia_rng());
+		instance = new silvia_rng();
+
+		pthread_setspecific(_key, instance);
 	}
 
-	return _i.get();
+	return instance;
 }
 
 silvia_rng::silvia_rng()
 {
-	// FIXME: init OpenSSL?
+	mode = SILVIA_RNG_DRBG;
+	drbg_ctx = EVP_CIPHER_CTX_new();
+	seeded = false;
+	seed_pid = 0;
+	refills = 0;
+	buffer.resize(SILVIA_RNG_BUFFER_SIZE);
+	buffer_pos = buffer.size();
 }
 
-mpz_class silvia_rng::get_random(size_t n)
+silvia_rng::~silvia_rng()
+{
+	OPENSSL_cleanse(&buffer[0], buffer.size());
+
+	EVP_CIPHER_CTX_free(drbg_ctx);
+}
+
+void silvia_rng::set_mode(silvia_rng_mode_t mode)
+{
+	this->mode = mode;
+}
+
+silvia_rng_mode_t silvia_rng::get_mode()
+{
+	return mode;
+}
+
+bool silvia_rng::reseed()
 {
-	// If n is a multiple of 8, use the simple way
-	if (n % 8 == 0)
+	unsigned char seed[DRBG_SEED_SIZE];
+
+	// A failure indicates a lack of proper entropy
+	if (RAND_bytes(seed, DRBG_SEED_SIZE) != 1)
 	{
-		std::vector<unsigned char> rand_val;
-		rand_val.resize(n/8);
+		return false;
+	}
+
+	bool rv = (EVP_EncryptInit_ex(drbg_ctx, EVP_aes_256_ctr(), NULL, seed, seed + DRBG_KEY_SIZE) == 1);
 
-		// FIXME: we should really check the return value of
-		//        RAND_bytes as failure indicates a lack of proper
-		//        entropy
-		RAND_bytes(&rand_val[0], n / 8);
+	OPENSSL_cleanse(seed, DRBG_SEED_SIZE);
 
-		// Now convert it to MPZ
-		mpz_class rand;
+	seeded = rv;
+	seed_pid = getpid();
+	refills = 0;
 
-		mpz_import(_Z(rand), n / 8, 1, sizeof(unsigned char), 0, 0, &rand_val[0]);
+	return rv;
+}
 
-		return rand;
+bool silvia_rng::refill()
+{
+	// Reseed periodically, and in a forked child so that it does not
+	// produce the same output as its parent
+	if (!seeded || (refills >= SILVIA_RNG_RESEED_INTERVAL) || (seed_pid != getpid()))
+	{
+		if (!reseed()) return false;
+	}
+
+	// The key stream is the encryption of an all-zero buffer
+	int out_len = 0;
+
+	memset(&buffer[0], 0, buffer.size());
+
+	if ((EVP_EncryptUpdate(drbg_ctx, &buffer[0], &out_len, &buffer[0], buffer.size()) != 1) ||
+	    (out_len != (int) buffer.size()))
+	{
+		seeded = false;
+
+		return false;
+	}
+
+	// Rekey with the first bytes of the output and wipe them, so that
+	// earlier output cannot be recovered from the state
+	if (EVP_EncryptInit_ex(drbg_ctx, NULL, NULL, &buffer[0], &buffer[DRBG_KEY_SIZE]) != 1)
+	{
+		seeded = false;
+
+		return false;
+	}
+
+	OPENSSL_cleanse(&buffer[0], DRBG_SEED_SIZE);
+
+	buffer_pos = DRBG_SEED_SIZE;
+	refills++;
+
+	return true;
+}
+
+void silvia_rng::get_bytes(unsigned char* buf, size_t len)
+{
+	bool ok = true;
+
+	if (mode == SILVIA_RNG_OPENSSL)
+	{
+		ok = (RAND_bytes(buf, len) == 1);
 	}
 	else
 	{
-		size_t num_bytes = (n / 8) + 1;
+		// In a forked child, the buffered output is shared with the
+		// parent; discard it and reseed before handing out anything
+		if (seeded && (seed_pid != getpid()))
+		{
+			OPENSSL_cleanse(&buffer[0], buffer.size());
 
-		// Compute the mask
-		size_t mask_bits = n % 8;
-		unsigned char mask = 0;
+			buffer_pos = buffer.size();
+			seeded = false;
+		}
 
-		while (mask_bits--)
+		while (ok && (len > 0))
 		{
-			mask = mask << 1;
-			mask = mask + 0x01;
+			if (buffer_pos == buffer.size())
+			{
+				ok = refill();
+
+				if (!ok) break;
+			}
+
+			size_t copy_len = buffer.size() - buffer_pos;
+
+			if (copy_len > len) copy_len = len;
+
+			memcpy(buf, &buffer[buffer_pos], copy_len);
+
+			// Output is never handed out twice
+			OPENSSL_cleanse(&buffer[buffer_pos], copy_len);
+
+			buffer_pos += copy_len;
+			buf += copy_len;
+			len -= copy_len;
 		}
+	}
 
-		std::vector<unsigned char> rand_val;
-		rand_val.resize(num_bytes);
+	if (!ok)
+	{
+		// Without proper entropy no secure protocol run is possible
+		fprintf(stderr, "silvia: random number generator failure, aborting\n");
 
-		// FIXME: we should really check the return value of
-		//        RAND_bytes as failure indicates a lack of proper
-		//        entropy
-		RAND_bytes(&rand_val[0], num_bytes);
+		abort();
+	}
+}
 
-		rand_val[0] &= mask;
+void silvia_rng::get_random(mpz_class& r, size_t n)
+{
+	if (n == 0)
+	{
+		r = 0;
+
+		return;
+	}
 
-		// Now convert it to MPZ
-		mpz_class rand;
+	size_t limbs = (n + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+	mp_limb_t* rp = mpz_limbs_write(_Z(r), limbs);
 
-		mpz_import(_Z(rand), num_bytes, 1, sizeof(unsigned char), 0, 0, &rand_val[0]);
+	get_bytes((unsigned char*) rp, limbs * sizeof(mp_limb_t));
 
-		return rand;
+	// Clear the excess bits of the most significant limb
+	if ((n % GMP_NUMB_BITS) != 0)
+	{
+		rp[limbs - 1] &= (((mp_limb_t) 1) << (n % GMP_NUMB_BITS)) - 1;
 	}
+
+	mpz_limbs_finish(_Z(r), limbs);
+}
+
+mpz_class silvia_rng::get_random(size_t n)
+{
+	mpz_class rand;
+
+	get_random(rand, n);
+
+	return rand;
 }
 
+void silvia_rng::get_random(std::vector<mpz_class>& r, const std::vector<size_t>& n)
+{
+	r.resize(n.size());
+
+	for (size_t i = 0; i < n.size(); i++)
+	{
+		get_random(r[i], n[i]);
+	}
+}
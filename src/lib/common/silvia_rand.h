@@ -36,24 +36,67 @@
 #define _SILVIA_RAND_H
 
 #include "config.h"
-#include <memory>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sys/types.h>
 #include <gmpxx.h>
+#include <vector>
+#include <openssl/evp.h>
 
-// FIXME: implement seeding!
+/**
+ * Random number generator modes
+ */
+typedef enum
+{
+	SILVIA_RNG_DRBG,		/**< buffered AES-256-CTR DRBG seeded from OpenSSL (default) */
+	SILVIA_RNG_OPENSSL		/**< call RAND_bytes for every request */
+}
+silvia_rng_mode_t;
+
+/**
+ * Size of the DRBG output buffer in bytes
+ */
+#define SILVIA_RNG_BUFFER_SIZE		4096
+
+/**
+ * Number of buffer refills after which the DRBG is reseeded from OpenSSL
+ */
+#define SILVIA_RNG_RESEED_INTERVAL	256
 
 /**
- * System parameters (singleton)
+ * Random number generator; every thread has its own instance. By
+ * default, random numbers are taken from a buffered AES-256-CTR DRBG
+ * that is seeded from the OpenSSL RNG, reseeded periodically and after
+ * a fork, and rekeyed from its own output after every refill. If the
+ * OpenSSL RNG fails to provide seed material, the process is aborted
+ * rather than continuing with weak randomness.
  */
 class silvia_rng
 {
 public:
 	/**
-	 * Get the one-and-only instance
-	 * @return the one-and-only instance
+	 * Get the instance for the calling thread
+	 * @return the instance for the calling thread
 	 */
 	static silvia_rng* i();
 
+	/**
+	 * Destructor
+	 */
+	~silvia_rng();
+
+	/**
+	 * Select the source of random numbers for this thread
+	 * @param mode the new mode
+	 */
+	void set_mode(silvia_rng_mode_t mode);
+
+	/**
+	 * Get the source of random numbers for this thread
+	 * @return the current mode
+	 */
+	silvia_rng_mode_t get_mode();
+
 	/**
 	 * Generate an n-bit random number
 	 * @param n the number of bits to generate
@@ -61,12 +104,56 @@ public:
 	 */
 	mpz_class get_random(size_t n);
 
+	/**
+	 * Generate an n-bit random number in place; the random bits are
+	 * written directly into the limbs of r
+	 * @param r receives an n-bit random number
+	 * @param n the number of bits to generate
+	 */
+	void get_random(mpz_class& r, size_t n);
+
+	/**
+	 * Generate a batch of random numbers
+	 * @param r receives the random numbers; it is resized to the number of requested lengths
+	 * @param n the number of bits to generate for each random number
+	 */
+	void get_random(std::vector<mpz_class>& r, const std::vector<size_t>& n);
+
 private:
 	// Constructor
 	silvia_rng();
 
-	// The one-and-only instance
-	static std::auto_ptr<silvia_rng> _i;
+	// Copying is not allowed
+	silvia_rng(const silvia_rng&);
+	silvia_rng& operator=(const silvia_rng&);
+
+	// Fill a buffer with random bytes; aborts on entropy failure
+	void get_bytes(unsigned char* buf, size_t len);
+
+	// Seed the DRBG from OpenSSL
+	bool reseed();
+
+	// Refill the output buffer of the DRBG
+	bool refill();
+
+	// Create the key for the per-thread instances
+	static void init_key();
+
+	// Delete the instance of a thread when it exits
+	static void delete_instance(void* instance);
+
+	// The key for the per-thread instances
+	static pthread_key_t _key;
+	static pthread_once_t _key_once;
+
+	// DRBG state
+	silvia_rng_mode_t mode;
+	EVP_CIPHER_CTX* drbg_ctx;
+	bool seeded;
+	pid_t seed_pid;
+	size_t refills;
+	std::vector<unsigned char> buffer;
+	size_t buffer_pos;
 };
 
 #endif // !_SILVIA_RAND_H
@@ -0,0 +1,95 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_runtime.h
+
+ Runtime context for the protocol engines
+ *****************************************************************************/
+
+#ifndef _SILVIA_RUNTIME_H
+#define _SILVIA_RUNTIME_H
+
+#include "silvia_parameters.h"
+
+class silvia_rng;
+class silvia_hash;
+
+/**
+ * Get a system parameter from the runtime context of a protocol engine
+ */
+#define RTPAR(par) runtime.get_params().get_##par()
+
+/**
+ * Runtime context class; holds the system parameters, the random
+ * number generator and the hash used by the prover, verifier and issuer
+ * engines.
+ * The parameters are a private copy that cannot be changed after the
+ * context has been created, so a context can be shared between engines
+ * running on different threads; each thread draws its random numbers
+ * from its own generator.
+ */
+class silvia_runtime
+{
+public:
+	/**
+	 * Constructor; copies the current process-wide system parameters
+	 */
+	silvia_runtime();
+
+	/**
+	 * Constructor
+	 * @param params the system parameters to use
+	 */
+	silvia_runtime(const silvia_system_parameters& params);
+
+	/**
+	 * Get the system parameters
+	 * @return the system parameters of this context
+	 */
+	const silvia_system_parameters& get_params() const;
+
+	/**
+	 * Get the random number generator for the calling thread
+	 * @return the random number generator for the calling thread
+	 */
+	silvia_rng* get_rng() const;
+
+	/**
+	 * Get the reusable hash of the configured type for the calling thread
+	 * @return the hash for the calling thread
+	 */
+	silvia_hash* get_hash() const;
+
+private:
+	// The system parameters
+	silvia_system_parameters params;
+};
+
+#endif // !_SILVIA_RUNTIME_H
+
@@ -0,0 +1,551 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_session.cpp
+
+ Non-blocking card sessions driven by an event loop
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_session.h"
+#include "silvia_apdu.h"
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+////////////////////////////////////////////////////////////////////////
+// Session class
+////////////////////////////////////////////////////////////////////////
+
+silvia_session::silvia_session(const std::string PIN /* = "" */)
+{
+	assert(PIN.size() <= 8);
+	
+	this->PIN = PIN;
+	state = SILVIA_SESSION_RUNNING;
+	verifying_pin = false;
+	awaiting_pin = false;
+	pin_required = false;
+	pin_retry = false;
+	pin_status = 0;
+}
+
+silvia_session::~silvia_session()
+{
+}
+
+silvia_session_state_t silvia_session::get_state()
+{
+	return state;
+}
+
+const std::vector<bytestring>& silvia_session::get_commands()
+{
+	return outgoing;
+}
+
+void silvia_session::take_messages(std::vector<std::string>& messages)
+{
+	messages.clear();
+	messages.swap(this->messages);
+}
+
+unsigned short silvia_session::get_pin_status()
+{
+	return pin_status;
+}
+
+bool silvia_session::accept_status(unsigned short sw)
+{
+	return (sw == 0x9000);
+}
+
+void silvia_session::add_message(const std::string& message)
+{
+	messages.push_back(message);
+}
+
+void silvia_session::require_pin()
+{
+	pin_required = true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Session loop class
+////////////////////////////////////////////////////////////////////////
+
+class silvia_session_loop::round_job : public silvia_job
+{
+public:
+	round_job(silvia_session_loop* loop, silvia_session* session)
+	{
+		this->loop = loop;
+		this->session = session;
+	}
+	
+	virtual void run()
+	{
+		std::vector<bytestring> commands;
+		
+		session->pin_required = false;
+		session->pin_retry = false;
+		session->state = session->next_round(session->round_results, commands);
+		
+		session->round_results.clear();
+		session->outgoing = commands;
+		session->round_commands.swap(commands);
+		
+		if ((session->state == SILVIA_SESSION_RUNNING) && session->round_commands.empty())
+		{
+			session->state = SILVIA_SESSION_FAILED;
+		}
+		
+		if ((session->state == SILVIA_SESSION_RUNNING) && session->pin_required)
+		{
+			// The first command is not retried after this verification
+			session->pin_retry = true;
+			
+			verify_pin(session);
+		}
+		
+		loop->round_finished(session);
+		
+		delete this;
+	}
+
+private:
+	silvia_session_loop* loop;
+	silvia_session* session;
+};
+
+static bool set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	
+	if (flags < 0)
+	{
+		return false;
+	}
+	
+	return (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+silvia_session_loop::silvia_session_loop(silvia_session_handler* handler, silvia_thread_pool* pool /* = NULL */)
+{
+	this->handler = handler;
+	
+	if (pool == NULL)
+	{
+		this->pool = new silvia_thread_pool();
+		own_pool = true;
+	}
+	else
+	{
+		this->pool = pool;
+		own_pool = false;
+	}
+	
+	sessions = 0;
+	computing = 0;
+	
+	pthread_mutex_init(&ready_lock, NULL);
+	pthread_cond_init(&ready_cond, NULL);
+	
+	if (pipe(notify_pipe) != 0)
+	{
+		notify_pipe[0] = notify_pipe[1] = -1;
+	}
+	else
+	{
+		set_nonblocking(notify_pipe[0]);
+		set_nonblocking(notify_pipe[1]);
+	}
+}
+
+silvia_session_loop::~silvia_session_loop()
+{
+	// Wait for the rounds that are being computed
+	for (;;)
+	{
+		pthread_mutex_lock(&ready_lock);
+		
+		size_t still_computing = computing;
+		
+		pthread_mutex_unlock(&ready_lock);
+		
+		if (still_computing == 0)
+		{
+			break;
+		}
+		
+		dispatch(true);
+	}
+	
+	if (own_pool)
+	{
+		delete pool;
+	}
+	
+	if (notify_pipe[0] >= 0)
+	{
+		close(notify_pipe[0]);
+		close(notify_pipe[1]);
+	}
+	
+	pthread_cond_destroy(&ready_cond);
+	pthread_mutex_destroy(&ready_lock);
+}
+
+void silvia_session_loop::start(silvia_session* session)
+{
+	assert(session->state == SILVIA_SESSION_RUNNING);
+	
+	sessions++;
+	
+	session->round_commands.clear();
+	session->round_results.clear();
+	session->messages.clear();
+	session->verifying_pin = false;
+	session->awaiting_pin = false;
+	session->pin_retry = false;
+	session->pin_status = 0;
+	
+	start_round(session);
+}
+
+void silvia_session_loop::deliver(silvia_session* session, const std::vector<bytestring>& responses)
+{
+	assert(session->state == SILVIA_SESSION_RUNNING);
+	assert(!session->awaiting_pin);
+	
+	session->outgoing.clear();
+	
+	if (session->verifying_pin)
+	{
+		session->verifying_pin = false;
+		session->pin_required = false;
+		
+		if ((responses.size() != 1) || (responses[0].size() < 2))
+		{
+			session->state = SILVIA_SESSION_FAILED;
+			
+			post(session);
+			
+			return;
+		}
+		
+		session->pin_status = silvia_apdu::get_sw(responses[0]);
+		
+		if (session->pin_status != 0x9000)
+		{
+			session->state = SILVIA_SESSION_FAILED;
+			
+			post(session);
+			
+			return;
+		}
+	}
+	else
+	{
+		// The first response answers a command that was resent after
+		// the PIN was verified
+		bool retried = session->pin_retry;
+		
+		session->pin_retry = false;
+		
+		for (std::vector<bytestring>::const_iterator i = responses.begin(); i != responses.end(); i++)
+		{
+			if ((i->size() < 2) || (session->round_results.size() == session->round_commands.size()))
+			{
+				session->state = SILVIA_SESSION_FAILED;
+				
+				post(session);
+				
+				return;
+			}
+			
+			session->round_results.push_back(*i);
+		}
+		
+		if (responses.empty())
+		{
+			session->state = SILVIA_SESSION_FAILED;
+			
+			post(session);
+			
+			return;
+		}
+		
+		unsigned short sw = silvia_apdu::get_sw(session->round_results.back());
+		
+		if (sw != 0x9000)
+		{
+			// The card stopped at a status word other than 9000; the
+			// PIN is verified once per command, so if the card still
+			// refuses the resent command, the round ends there
+			if ((sw == 0x6982) && !(retried && (responses.size() == 1)))
+			{
+				// Verify the PIN, then resend the command
+				session->round_results.pop_back();
+				session->pin_retry = true;
+				
+				verify_pin(session);
+				
+				post(session);
+				
+				return;
+			}
+			
+			if ((session->round_results.size() < session->round_commands.size()) && !session->accept_status(sw))
+			{
+				// The round ends early; the session decides what happens next
+				start_round(session);
+				
+				return;
+			}
+		}
+	}
+	
+	continue_round(session);
+}
+
+void silvia_session_loop::supply_pin(silvia_session* session, const std::string& PIN)
+{
+	assert(session->state == SILVIA_SESSION_RUNNING);
+	assert(session->awaiting_pin);
+	assert(PIN.size() <= 8);
+	
+	session->awaiting_pin = false;
+	session->pin_required = false;
+	
+	if (PIN.empty())
+	{
+		// The application has verified the PIN itself
+		continue_round(session);
+		
+		return;
+	}
+	
+	session->verifying_pin = true;
+	session->outgoing.push_back(silvia_apdu::verify_pin(PIN));
+	
+	post(session);
+}
+
+void silvia_session_loop::fail(silvia_session* session)
+{
+	assert(session->state == SILVIA_SESSION_RUNNING);
+	
+	session->outgoing.clear();
+	session->verifying_pin = false;
+	session->awaiting_pin = false;
+	session->pin_retry = false;
+	session->state = SILVIA_SESSION_FAILED;
+	
+	post(session);
+}
+
+size_t silvia_session_loop::dispatch(bool block /* = false */)
+{
+	std::deque<silvia_session*> dispatch_sessions;
+	
+	for (;;)
+	{
+		// Drain the notification pipe before looking at the queue
+		char drain[64];
+		
+		while ((notify_pipe[0] >= 0) && (read(notify_pipe[0], drain, sizeof(drain)) > 0));
+		
+		pthread_mutex_lock(&ready_lock);
+		
+		if (notify_pipe[0] < 0)
+		{
+			// Without a notification pipe, wait on the condition
+			while (block && ready.empty() && (computing > 0))
+			{
+				pthread_cond_wait(&ready_cond, &ready_lock);
+			}
+		}
+		
+		dispatch_sessions.swap(ready);
+		
+		bool wait = block && dispatch_sessions.empty() && (computing > 0);
+		
+		pthread_mutex_unlock(&ready_lock);
+		
+		if (!wait || (notify_pipe[0] < 0))
+		{
+			break;
+		}
+		
+		struct pollfd pfd;
+		
+		pfd.fd = notify_pipe[0];
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		
+		poll(&pfd, 1, -1);
+	}
+	
+	for (std::deque<silvia_session*>::iterator i = dispatch_sessions.begin(); i != dispatch_sessions.end(); i++)
+	{
+		if (((*i)->state == SILVIA_SESSION_RUNNING) && (*i)->awaiting_pin)
+		{
+			if (!handler->request_pin(*i))
+			{
+				no_pin(*i);
+			}
+		}
+		else if ((*i)->state == SILVIA_SESSION_RUNNING)
+		{
+			handler->send(*i, (*i)->outgoing);
+		}
+		else
+		{
+			sessions--;
+			
+			handler->finished(*i);
+		}
+	}
+	
+	return dispatch_sessions.size();
+}
+
+int silvia_session_loop::get_notify_fd()
+{
+	return notify_pipe[0];
+}
+
+size_t silvia_session_loop::get_session_count()
+{
+	return sessions;
+}
+
+void silvia_session_loop::start_round(silvia_session* session)
+{
+	pthread_mutex_lock(&ready_lock);
+	
+	computing++;
+	
+	pthread_mutex_unlock(&ready_lock);
+	
+	pool->submit(new round_job(this, session));
+}
+
+void silvia_session_loop::continue_round(silvia_session* session)
+{
+	if (session->round_results.size() < session->round_commands.size())
+	{
+		// Send the remainder of the round
+		session->outgoing.assign(session->round_commands.begin() + session->round_results.size(), session->round_commands.end());
+		
+		post(session);
+	}
+	else
+	{
+		start_round(session);
+	}
+}
+
+/*static*/ void silvia_session_loop::verify_pin(silvia_session* session)
+{
+	session->outgoing.clear();
+	
+	if (session->PIN.empty())
+	{
+		session->awaiting_pin = true;
+	}
+	else
+	{
+		session->verifying_pin = true;
+		session->outgoing.push_back(silvia_apdu::verify_pin(session->PIN));
+	}
+}
+
+void silvia_session_loop::no_pin(silvia_session* session)
+{
+	session->awaiting_pin = false;
+	
+	if (!session->pin_required)
+	{
+		// The round ends at the command that the card refused
+		session->round_results.push_back("6982");
+		
+		start_round(session);
+	}
+	else
+	{
+		// The round cannot start without the PIN
+		session->state = SILVIA_SESSION_FAILED;
+		
+		post(session);
+	}
+}
+
+void silvia_session_loop::post(silvia_session* session)
+{
+	pthread_mutex_lock(&ready_lock);
+	
+	ready.push_back(session);
+	
+	pthread_cond_broadcast(&ready_cond);
+	pthread_mutex_unlock(&ready_lock);
+	
+	notify();
+}
+
+void silvia_session_loop::round_finished(silvia_session* session)
+{
+	pthread_mutex_lock(&ready_lock);
+	
+	computing--;
+	ready.push_back(session);
+	
+	pthread_cond_broadcast(&ready_cond);
+	pthread_mutex_unlock(&ready_lock);
+	
+	notify();
+}
+
+void silvia_session_loop::notify()
+{
+	if (notify_pipe[1] >= 0)
+	{
+		// A full pipe means the loop is already being notified
+		char c = 0;
+		
+		if (write(notify_pipe[1], &c, 1) < 0)
+		{
+			return;
+		}
+	}
+}
+
@@ -0,0 +1,347 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_session.h
+
+ Non-blocking card sessions driven by an event loop
+ *****************************************************************************/
+
+#ifndef _SILVIA_SESSION_H
+#define _SILVIA_SESSION_H
+
+#include "silvia_bytestring.h"
+#include "silvia_thread_pool.h"
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+/**
+ * Session states
+ */
+typedef enum
+{
+	SILVIA_SESSION_RUNNING,		/**< the session is exchanging commands with the card */
+	SILVIA_SESSION_SUCCEEDED,	/**< the session has finished successfully */
+	SILVIA_SESSION_FAILED		/**< the session has failed */
+}
+silvia_session_state_t;
+
+class silvia_session_loop;
+
+/**
+ * Session base class; a session drives the exchange with one card in
+ * rounds of commands. The protocol logic of a round runs on the worker
+ * pool of a session loop, the exchange of the commands is left to the
+ * application. A status word 6982 makes the loop verify the PIN and then
+ * resend the command.
+ */
+class silvia_session
+{
+public:
+	/**
+	 * Constructor
+	 * @param PIN the PIN to verify when the card returns 6982 (optional; without a PIN, the application is asked for it, see silvia_session_handler::request_pin())
+	 */
+	silvia_session(const std::string PIN = "");
+	
+	/**
+	 * Destructor
+	 */
+	virtual ~silvia_session();
+	
+	/**
+	 * Get the session state
+	 * @return the session state
+	 */
+	silvia_session_state_t get_state();
+	
+	/**
+	 * Get the commands that the application must send to the card; valid
+	 * from the moment the loop hands the session to the application until
+	 * the responses are delivered
+	 * @return the commands to send
+	 */
+	const std::vector<bytestring>& get_commands();
+	
+	/**
+	 * Take the messages that the session produced for the application
+	 * @param messages receives the messages in the order they were produced
+	 */
+	void take_messages(std::vector<std::string>& messages);
+	
+	/**
+	 * Get the status word of the last PIN verification
+	 * @return the status word, or 0 if the card did not answer a PIN verification
+	 */
+	unsigned short get_pin_status();
+	
+protected:
+	/**
+	 * Process the responses of the previous round and produce the next
+	 * round; this is called on a worker thread
+	 * @param results the responses including the status words of the previous round (empty for the first round)
+	 * @param commands the commands of the next round
+	 * @return SILVIA_SESSION_RUNNING if there is a next round, otherwise the outcome of the session
+	 */
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands) = 0;
+	
+	/**
+	 * Check if a round continues after a status word other than 9000
+	 * @param sw the status word
+	 * @return true if the round continues
+	 */
+	virtual bool accept_status(unsigned short sw);
+	
+	/**
+	 * Produce a message for the application; for use in next_round()
+	 * @param message the message
+	 */
+	void add_message(const std::string& message);
+	
+	/**
+	 * Verify the PIN before the commands of the round that next_round()
+	 * is producing
+	 */
+	void require_pin();
+	
+private:
+	// Copying is not allowed
+	silvia_session(const silvia_session&);
+	silvia_session& operator=(const silvia_session&);
+	
+	friend class silvia_session_loop;
+	
+	// The PIN
+	std::string PIN;
+	
+	// State
+	silvia_session_state_t state;
+	
+	// The commands of the current round and the responses so far
+	std::vector<bytestring> round_commands;
+	std::vector<bytestring> round_results;
+	
+	// The commands that are with the application
+	std::vector<bytestring> outgoing;
+	
+	// Messages for the application
+	std::vector<std::string> messages;
+	
+	// Is the PIN being verified, or requested from the application?
+	bool verifying_pin;
+	bool awaiting_pin;
+	
+	// Must the PIN be verified before the commands of the round?
+	bool pin_required;
+	
+	// Is a command being resent after PIN verification?
+	bool pin_retry;
+	
+	// The status word of the last PIN verification
+	unsigned short pin_status;
+};
+
+/**
+ * Session factory interface
+ */
+class silvia_session_factory
+{
+public:
+	/**
+	 * Destructor
+	 */
+	virtual ~silvia_session_factory() { }
+	
+	/**
+	 * Create a session
+	 * @return a new session (the caller takes ownership)
+	 */
+	virtual silvia_session* create_session() = 0;
+};
+
+/**
+ * Session handler interface; implemented by the application to transport
+ * the commands of a session to its card. The handler is only called from
+ * silvia_session_loop::dispatch().
+ */
+class silvia_session_handler
+{
+public:
+	/**
+	 * Destructor
+	 */
+	virtual ~silvia_session_handler() { }
+	
+	/**
+	 * Send the commands of a session to its card; the application
+	 * delivers the responses with silvia_session_loop::deliver() once they
+	 * arrive, which must not happen from within this call
+	 * @param session the session
+	 * @param commands the commands to send
+	 */
+	virtual void send(silvia_session* session, const std::vector<bytestring>& commands) = 0;
+	
+	/**
+	 * Ask the application for the PIN of a session that has none; the
+	 * application supplies it with silvia_session_loop::supply_pin()
+	 * once it is known, which must not happen from within this call
+	 * @param session the session
+	 * @return false if the application cannot supply the PIN; a round that is waiting for the PIN then ends at the refused command, a round that requires the PIN fails the session
+	 */
+	virtual bool request_pin(silvia_session* session) { return false; }
+	
+	/**
+	 * Called when a session has finished; the application regains
+	 * ownership of the session
+	 * @param session the session (see get_state() for the outcome)
+	 */
+	virtual void finished(silvia_session* session) = 0;
+};
+
+/**
+ * Session loop; drives many sessions from a single application thread
+ * without blocking on cards, and runs the protocol logic (which includes
+ * the cryptography) on a worker pool. All methods except
+ * get_notify_fd() must be called from the same thread.
+ */
+class silvia_session_loop
+{
+public:
+	/**
+	 * Constructor
+	 * @param handler the session handler
+	 * @param pool the worker pool for the session rounds (optional, by default a pool with one thread per CPU is used)
+	 */
+	silvia_session_loop(silvia_session_handler* handler, silvia_thread_pool* pool = NULL);
+	
+	/**
+	 * Destructor; waits for rounds that are being computed
+	 */
+	~silvia_session_loop();
+	
+	/**
+	 * Start a session
+	 * @param session the session (the application retains ownership)
+	 */
+	void start(silvia_session* session);
+	
+	/**
+	 * Deliver the responses to the commands of a session; like
+	 * silvia_card_channel::transmit_batch(), the responses may stop at
+	 * the first status word other than 9000
+	 * @param session the session
+	 * @param responses the responses including the status words
+	 */
+	void deliver(silvia_session* session, const std::vector<bytestring>& responses);
+	
+	/**
+	 * Supply the PIN for a session after silvia_session_handler::request_pin()
+	 * @param session the session
+	 * @param PIN the PIN to verify, or an empty string if the application has verified the PIN itself
+	 */
+	void supply_pin(silvia_session* session, const std::string& PIN);
+	
+	/**
+	 * Fail a session that is with the application, e.g. because the card
+	 * was removed
+	 * @param session the session
+	 */
+	void fail(silvia_session* session);
+	
+	/**
+	 * Hand the sessions that are ready to the handler
+	 * @param block wait for at least one session if rounds are being computed
+	 * @return the number of sessions handed to the handler
+	 */
+	size_t dispatch(bool block = false);
+	
+	/**
+	 * Get a descriptor that becomes readable when dispatch() has work;
+	 * for integration in an application event loop
+	 * @return the descriptor
+	 */
+	int get_notify_fd();
+	
+	/**
+	 * Get the number of sessions that have not finished
+	 * @return the number of active sessions
+	 */
+	size_t get_session_count();
+
+private:
+	// Copying is not allowed
+	silvia_session_loop(const silvia_session_loop&);
+	silvia_session_loop& operator=(const silvia_session_loop&);
+	
+	// Job that computes a session round on the worker pool
+	class round_job;
+	
+	// Start computing the next round of a session
+	void start_round(silvia_session* session);
+	
+	// Send the remainder of the round or start the next round
+	void continue_round(silvia_session* session);
+	
+	// Verify the PIN of a session or request it from the application
+	static void verify_pin(silvia_session* session);
+	
+	// Handle a session for which the application has no PIN
+	void no_pin(silvia_session* session);
+	
+	// Queue a session for dispatch
+	void post(silvia_session* session);
+	
+	// Called by round jobs when they have finished
+	void round_finished(silvia_session* session);
+	
+	// Wake up the application event loop
+	void notify();
+	
+	// The handler and worker pool
+	silvia_session_handler* handler;
+	silvia_thread_pool* pool;
+	bool own_pool;
+	
+	// The number of active sessions and of rounds being computed
+	size_t sessions;
+	size_t computing;
+	
+	// Sessions that are ready for dispatch; the condition is signalled
+	// when one is added, for waiting without a notification pipe
+	pthread_mutex_t ready_lock;
+	pthread_cond_t ready_cond;
+	std::deque<silvia_session*> ready;
+	
+	// Notification pipe
+	int notify_pipe[2];
+};
+
+#endif // !_SILVIA_SESSION_H
+
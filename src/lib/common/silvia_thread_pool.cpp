@@ -0,0 +1,295 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_thread_pool.cpp
+
+ Work-stealing thread pool
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_thread_pool.h"
+#include <pthread.h>
+#include <assert.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+
+silvia_job_countdown::silvia_job_countdown(size_t count)
+{
+	this->count = count;
+
+	pthread_mutex_init(&count_lock, NULL);
+	pthread_cond_init(&count_cond, NULL);
+}
+
+silvia_job_countdown::~silvia_job_countdown()
+{
+	pthread_cond_destroy(&count_cond);
+	pthread_mutex_destroy(&count_lock);
+}
+
+void silvia_job_countdown::done()
+{
+	pthread_mutex_lock(&count_lock);
+
+	if (--count == 0)
+	{
+		pthread_cond_broadcast(&count_cond);
+	}
+
+	pthread_mutex_unlock(&count_lock);
+}
+
+void silvia_job_countdown::wait()
+{
+	pthread_mutex_lock(&count_lock);
+
+	while (count > 0)
+	{
+		pthread_cond_wait(&count_cond, &count_lock);
+	}
+
+	pthread_mutex_unlock(&count_lock);
+}
+
+silvia_thread_pool::silvia_thread_pool(size_t num_threads /* = 0 */)
+{
+	if (num_threads == 0)
+	{
+		num_threads = num_cpus();
+	}
+
+	queued = 0;
+	pending = 0;
+	sleeping = 0;
+	next_worker = 0;
+	stopping = false;
+
+	pthread_mutex_init(&pool_lock, NULL);
+	pthread_cond_init(&work_cond, NULL);
+	pthread_cond_init(&done_cond, NULL);
+
+	for (size_t i = 0; i < num_threads; i++)
+	{
+		worker* w = new worker();
+
+		w->pool = this;
+		w->index = i;
+		pthread_mutex_init(&w->queue_lock, NULL);
+
+		workers.push_back(w);
+	}
+
+	// Only start the threads once all queues exist, since workers
+	// may immediately start looking for jobs to steal
+	for (std::vector<worker*>::iterator i = workers.begin(); i != workers.end(); i++)
+	{
+		pthread_create(&(*i)->thread, NULL, worker_main, *i);
+	}
+}
+
+silvia_thread_pool::~silvia_thread_pool()
+{
+	pthread_mutex_lock(&pool_lock);
+
+	stopping = true;
+
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (std::vector<worker*>::iterator i = workers.begin(); i != workers.end(); i++)
+	{
+		pthread_join((*i)->thread, NULL);
+	}
+
+	for (std::vector<worker*>::iterator i = workers.begin(); i != workers.end(); i++)
+	{
+		pthread_mutex_destroy(&(*i)->queue_lock);
+
+		delete *i;
+	}
+
+	pthread_cond_destroy(&done_cond);
+	pthread_cond_destroy(&work_cond);
+	pthread_mutex_destroy(&pool_lock);
+}
+
+void silvia_thread_pool::submit(silvia_job* job)
+{
+	__sync_fetch_and_add(&pending, 1);
+
+	// Distribute jobs over the worker queues round-robin; only the
+	// queue of the chosen worker is locked
+	worker* w = workers[__sync_fetch_and_add(&next_worker, 1) % workers.size()];
+
+	pthread_mutex_lock(&w->queue_lock);
+	w->queue.push_back(job);
+	pthread_mutex_unlock(&w->queue_lock);
+
+	// The job is counted only once it is in a queue, so a worker that
+	// claims a count always finds a job
+	__sync_fetch_and_add(&queued, 1);
+
+	// The pool lock is only needed to wake a sleeping worker
+	if (__sync_fetch_and_add(&sleeping, 0) > 0)
+	{
+		pthread_mutex_lock(&pool_lock);
+		pthread_cond_signal(&work_cond);
+		pthread_mutex_unlock(&pool_lock);
+	}
+}
+
+void silvia_thread_pool::wait()
+{
+	pthread_mutex_lock(&pool_lock);
+
+	while (__sync_fetch_and_add(&pending, 0) > 0)
+	{
+		pthread_cond_wait(&done_cond, &pool_lock);
+	}
+
+	pthread_mutex_unlock(&pool_lock);
+}
+
+size_t silvia_thread_pool::size()
+{
+	return workers.size();
+}
+
+/*static*/ size_t silvia_thread_pool::num_cpus()
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (cpus > 0) ? (size_t) cpus : 1;
+}
+
+bool silvia_thread_pool::claim_job()
+{
+	size_t count = __sync_fetch_and_add(&queued, 0);
+
+	while (count > 0)
+	{
+		size_t prev = __sync_val_compare_and_swap(&queued, count, count - 1);
+
+		if (prev == count) return true;
+
+		count = prev;
+	}
+
+	return false;
+}
+
+silvia_job* silvia_thread_pool::take_job(size_t index)
+{
+	silvia_job* job = NULL;
+
+	// Take the oldest job from the own queue
+	worker* own = workers[index];
+
+	pthread_mutex_lock(&own->queue_lock);
+
+	if (!own->queue.empty())
+	{
+		job = own->queue.front();
+		own->queue.pop_front();
+	}
+
+	pthread_mutex_unlock(&own->queue_lock);
+
+	// Steal the newest job from one of the other workers, holding only
+	// the lock of the victim's queue
+	for (size_t i = 1; (job == NULL) && (i < workers.size()); i++)
+	{
+		worker* victim = workers[(index + i) % workers.size()];
+
+		pthread_mutex_lock(&victim->queue_lock);
+
+		if (!victim->queue.empty())
+		{
+			job = victim->queue.back();
+			victim->queue.pop_back();
+		}
+
+		pthread_mutex_unlock(&victim->queue_lock);
+	}
+
+	return job;
+}
+
+/*static*/ void* silvia_thread_pool::worker_main(void* arg)
+{
+	worker* w = (worker*) arg;
+	silvia_thread_pool* pool = w->pool;
+
+	while (true)
+	{
+		if (pool->claim_job())
+		{
+			// A claimed job is in one of the queues; a scan can miss
+			// a job that is pushed behind it, so scan until it is found
+			silvia_job* job = NULL;
+
+			while ((job = pool->take_job(w->index)) == NULL);
+
+			job->run();
+
+			if (__sync_sub_and_fetch(&pool->pending, 1) == 0)
+			{
+				pthread_mutex_lock(&pool->pool_lock);
+				pthread_cond_broadcast(&pool->done_cond);
+				pthread_mutex_unlock(&pool->pool_lock);
+			}
+
+			continue;
+		}
+
+		// Nothing to do; announce that this worker sleeps before
+		// checking the count again, so a submitter that does not see
+		// the sleeper has already made its job visible
+		pthread_mutex_lock(&pool->pool_lock);
+
+		__sync_fetch_and_add(&pool->sleeping, 1);
+
+		while ((__sync_fetch_and_add(&pool->queued, 0) == 0) && !pool->stopping)
+		{
+			pthread_cond_wait(&pool->work_cond, &pool->pool_lock);
+		}
+
+		__sync_fetch_and_sub(&pool->sleeping, 1);
+
+		bool done = pool->stopping && (__sync_fetch_and_add(&pool->queued, 0) == 0);
+
+		pthread_mutex_unlock(&pool->pool_lock);
+
+		// Stopping and no more work to do
+		if (done) break;
+	}
+
+	return NULL;
+}
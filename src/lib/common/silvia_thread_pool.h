@@ -0,0 +1,185 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_thread_pool.h
+
+ Work-stealing thread pool
+ *****************************************************************************/
+
+#ifndef _SILVIA_THREAD_POOL_H
+#define _SILVIA_THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <deque>
+#include <vector>
+
+/**
+ * Job interface; implement run() to execute work on the thread pool
+ */
+class silvia_job
+{
+public:
+	/**
+	 * Destructor
+	 */
+	virtual ~silvia_job() { }
+
+	/**
+	 * Execute the job
+	 */
+	virtual void run() = 0;
+};
+
+/**
+ * Countdown for a group of jobs; every job of the group calls done() as
+ * the last thing it does, so the submitter can wait for its own jobs on
+ * a pool that also runs other work
+ */
+class silvia_job_countdown
+{
+public:
+	/**
+	 * Constructor
+	 * @param count the number of jobs in the group
+	 */
+	silvia_job_countdown(size_t count);
+
+	/**
+	 * Destructor
+	 */
+	~silvia_job_countdown();
+
+	/**
+	 * Signal that a job of the group has finished
+	 */
+	void done();
+
+	/**
+	 * Wait until all jobs of the group have finished
+	 */
+	void wait();
+
+private:
+	// Copying is not allowed
+	silvia_job_countdown(const silvia_job_countdown&);
+	silvia_job_countdown& operator=(const silvia_job_countdown&);
+
+	size_t count;
+	pthread_mutex_t count_lock;
+	pthread_cond_t count_cond;
+};
+
+/**
+ * Thread pool class; every worker has its own job queue and workers
+ * that run out of jobs steal from the queues of the other workers
+ */
+class silvia_thread_pool
+{
+public:
+	/**
+	 * Constructor
+	 * @param num_threads the number of worker threads; 0 starts one worker per CPU
+	 */
+	silvia_thread_pool(size_t num_threads = 0);
+
+	/**
+	 * Destructor; finishes all submitted jobs before returning
+	 */
+	~silvia_thread_pool();
+
+	/**
+	 * Submit a job; the caller retains ownership of the job and must
+	 * keep it alive until it has been executed. The pool does not touch
+	 * a job after its run() method returns, so a job may delete itself.
+	 * @param job the job to execute
+	 */
+	void submit(silvia_job* job);
+
+	/**
+	 * Wait until all submitted jobs have been executed, including those
+	 * of other submitters; use a silvia_job_countdown to wait for a
+	 * group of jobs on a shared pool
+	 */
+	void wait();
+
+	/**
+	 * Get the number of worker threads
+	 * @return the number of worker threads
+	 */
+	size_t size();
+
+	/**
+	 * Get the number of CPUs in the system
+	 * @return the number of online CPUs (at least 1)
+	 */
+	static size_t num_cpus();
+
+private:
+	// Copying is not allowed
+	silvia_thread_pool(const silvia_thread_pool&);
+	silvia_thread_pool& operator=(const silvia_thread_pool&);
+
+	// Worker state
+	struct worker
+	{
+		silvia_thread_pool* pool;
+		size_t index;
+		pthread_t thread;
+		pthread_mutex_t queue_lock;
+		std::deque<silvia_job*> queue;
+	};
+
+	// Worker thread main loop
+	static void* worker_main(void* arg);
+
+	// Claim one of the queued jobs by decrementing the queued count
+	bool claim_job();
+
+	// Take a job from the own queue or steal one from another worker;
+	// returns NULL if all queues are empty
+	silvia_job* take_job(size_t index);
+
+	// The workers
+	std::vector<worker*> workers;
+
+	// Pool state; the pool lock only guards sleeping and waking, the
+	// counters are updated atomically
+	pthread_mutex_t pool_lock;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	size_t queued;
+	size_t pending;
+	size_t sleeping;
+	size_t next_worker;
+	bool stopping;
+};
+
+#endif // !_SILVIA_THREAD_POOL_H
+
@@ -143,7 +143,7 @@ void silvia_timer::mark()
 	
 unsigned long long silvia_timer::elapsed()
 {
-	static struct timespec now;
+	struct timespec now;
 	
 	clock_gettime(CLOCK_MONOTONIC, &now);
 	
@@ -43,16 +43,25 @@
 // Issuer public key implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-silvia_pub_key::silvia_pub_key(mpz_class n, mpz_class S, mpz_class Z, std::vector<mpz_class> R)
+silvia_pub_key::silvia_pub_key(mpz_class n, mpz_class S, mpz_class Z, std::vector<mpz_class> R) : modulus(n)
 {
 	this->n = n;
 	this->S = S;
 	this->Z = Z;
 	this->R = R;
+
+	fixed_base_window = SILVIA_FIXED_BASE_DEFAULT_WINDOW;
+
+	create_fixed_bases();
+
+	pthread_mutex_init(&fixed_lock, NULL);
 }
 
 silvia_pub_key::~silvia_pub_key()
 {
+	clear_fixed_bases();
+
+	pthread_mutex_destroy(&fixed_lock);
 }
 
 mpz_class& silvia_pub_key::get_n()
@@ -75,6 +84,100 @@ std::vector<mpz_class>& silvia_pub_key::get_R()
 	return R;
 }
 
+const silvia_modulus& silvia_pub_key::get_modulus()
+{
+	return modulus;
+}
+
+void silvia_pub_key::set_fixed_base_window(size_t w)
+{
+	if (w != fixed_base_window)
+	{
+		clear_fixed_bases();
+
+		fixed_base_window = w;
+
+		create_fixed_bases();
+	}
+}
+
+size_t silvia_pub_key::get_fixed_base_window()
+{
+	return fixed_base_window;
+}
+
+void silvia_pub_key::precompute()
+{
+	precompute(*silvia_system_parameters::i());
+}
+
+void silvia_pub_key::precompute(const silvia_system_parameters& params)
+{
+	size_t S_bits;
+	size_t R_bits;
+
+	get_exponent_bits(params, S_bits, R_bits);
+
+	// Tables that are already frozen are left as they are, so this
+	// can be called again on a key that is shared between threads
+	pthread_mutex_lock(&fixed_lock);
+
+	for (size_t i = 0; i < R.size() + 1; i++)
+	{
+		silvia_fixed_base* base = (i == 0) ? fixed_S : fixed_R[i - 1];
+
+		if (base->is_frozen()) continue;
+
+		base->extend((i == 0) ? S_bits : R_bits);
+		base->freeze();
+	}
+
+	pthread_mutex_unlock(&fixed_lock);
+}
+
+/*static*/ void silvia_pub_key::get_exponent_bits(const silvia_system_parameters& params, size_t& S_bits, size_t& R_bits)
+{
+	// The longest exponent for S is v'^ in a proof, for the R values
+	// it is a_i^ in a proof
+	S_bits = params.get_l_v() + params.get_l_statzk() + params.get_l_H() + 2;
+	R_bits = params.get_l_m() + params.get_l_statzk() + params.get_l_H() + 2;
+}
+
+silvia_fixed_base* silvia_pub_key::get_fixed_S()
+{
+	return fixed_S;
+}
+
+silvia_fixed_base* silvia_pub_key::get_fixed_R(size_t i)
+{
+	return fixed_R[i];
+}
+
+void silvia_pub_key::create_fixed_bases()
+{
+	fixed_S = new silvia_fixed_base(S, modulus, fixed_base_window);
+
+	fixed_R.clear();
+
+	for (std::vector<mpz_class>::iterator i = R.begin(); i != R.end(); i++)
+	{
+		fixed_R.push_back(new silvia_fixed_base(*i, modulus, fixed_base_window));
+	}
+}
+
+void silvia_pub_key::clear_fixed_bases()
+{
+	delete fixed_S;
+	fixed_S = NULL;
+
+	for (std::vector<silvia_fixed_base*>::iterator i = fixed_R.begin(); i != fixed_R.end(); i++)
+	{
+		delete *i;
+	}
+
+	fixed_R.clear();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Issuer private key implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -93,6 +196,12 @@ silvia_priv_key::silvia_priv_key(mpz_class p, mpz_class q)
 	
 	// Compute n'
 	n_prime = p_prime * q_prime;
+
+	// Precompute the values for CRT exponentiation
+	p_minus_1 = p - 1;
+	q_minus_1 = q - 1;
+
+	mpz_invert(q_inv_p.get_mpz_t(), q.get_mpz_t(), p.get_mpz_t());
 }
 
 silvia_priv_key::~silvia_priv_key()
@@ -124,6 +233,35 @@ mpz_class& silvia_priv_key::get_n_prime()
 	return n_prime;
 }
 
+mpz_class silvia_priv_key::powm_crt(const mpz_class& base, const mpz_class& exp) const
+{
+	// Reduce the exponent modulo p-1 and q-1; mpz_mod always yields a
+	// non-negative result, so negative exponents are handled as well
+	mpz_class exp_p;
+	mpz_class exp_q;
+
+	mpz_mod(exp_p.get_mpz_t(), exp.get_mpz_t(), p_minus_1.get_mpz_t());
+	mpz_mod(exp_q.get_mpz_t(), exp.get_mpz_t(), q_minus_1.get_mpz_t());
+
+	// Compute m_p = base^exp mod p and m_q = base^exp mod q
+	mpz_class m_p;
+	mpz_class m_q;
+
+	mpz_mod(m_p.get_mpz_t(), base.get_mpz_t(), p.get_mpz_t());
+	mpz_powm(m_p.get_mpz_t(), m_p.get_mpz_t(), exp_p.get_mpz_t(), p.get_mpz_t());
+
+	mpz_mod(m_q.get_mpz_t(), base.get_mpz_t(), q.get_mpz_t());
+	mpz_powm(m_q.get_mpz_t(), m_q.get_mpz_t(), exp_q.get_mpz_t(), q.get_mpz_t());
+
+	// Recombine using Garner's method: h = (m_p - m_q) * q^-1 mod p,
+	// result = m_q + h * q
+	mpz_class h = m_p - m_q;
+	h *= q_inv_p;
+	mpz_mod(h.get_mpz_t(), h.get_mpz_t(), p.get_mpz_t());
+
+	return m_q + (h * q);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Attribute class implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -146,11 +284,7 @@ std::string silvia_attribute::int_rep()
 
 bytestring silvia_attribute::bs_rep()
 {
-	bytestring rv(attr_rep);
-	
-	while (rv.size() < (SYSPAR(l_m)/8)) rv = "00" + rv;
-	
-	return rv;
+	return bytestring(attr_rep, SYSPAR(l_m)/8);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -36,13 +36,23 @@
 #define _SILVIA_TYPES_H
 
 #include <gmpxx.h>
+#include <pthread.h>
 #include <vector>
 #include <string>
+#include "silvia_fixed_base.h"
+#include "silvia_modulus.h"
+#include "silvia_parameters.h"
 
 class bytestring;
 
 /**
- * Issuer public key
+ * Issuer public key; multi-exponentiations with S and the R values
+ * use precomputed tables once precompute() has built them (Z is only
+ * raised to negative exponents, so it has no table). A key may
+ * only be shared between threads after precompute() has been called,
+ * or after it was read from a compiled cache with tables. A shared key
+ * is only read, apart from further calls to precompute(), which leave
+ * the frozen tables as they are.
  */
 class silvia_pub_key
 {
@@ -84,13 +94,97 @@ public:
 	 * @return a reference to a std::vector with the R values
 	 */
 	std::vector<mpz_class>& get_R();
+
+	/**
+	 * Get the Montgomery context for the modulus
+	 * @return a reference to the modulus context
+	 */
+	const silvia_modulus& get_modulus();
+
+	/**
+	 * Set the window size for the precomputed tables of S and the
+	 * R values. The tables are built by precompute(). A table
+	 * stores one power of the base for every w bits of exponent, so a
+	 * smaller window uses more memory, but each exponentiation costs
+	 * 2^(w+1) extra multiplications to combine the powers. The default
+	 * is SILVIA_FIXED_BASE_DEFAULT_WINDOW; 0 disables precomputation.
+	 * This discards the tables, including those returned earlier by
+	 * get_fixed_S() and get_fixed_R(), so it may only
+	 * be called before the key is shared.
+	 * @param w the window size in bits
+	 */
+	void set_fixed_base_window(size_t w);
+
+	/**
+	 * Get the window size for the precomputed tables
+	 * @return the window size in bits (0 if precomputation is disabled)
+	 */
+	size_t get_fixed_base_window();
+
+	/**
+	 * Build the precomputed tables for all bases up front, covering
+	 * the longest exponents used by the protocols under the current
+	 * system parameters. The tables are frozen afterwards, so the key
+	 * can be shared read-only between threads.
+	 */
+	void precompute();
+
+	/**
+	 * Build the precomputed tables for all bases up front, covering
+	 * the longest exponents used by the protocols under the specified
+	 * system parameters; see precompute()
+	 * @param params the system parameters
+	 */
+	void precompute(const silvia_system_parameters& params);
+
+	/**
+	 * Get the length of the longest exponents used with S and the
+	 * R values by the protocols under the specified system parameters;
+	 * these are the lengths the precomputed tables cover
+	 * @param params the system parameters
+	 * @param S_bits receives the exponent length for S
+	 * @param R_bits receives the exponent length for the R values
+	 */
+	static void get_exponent_bits(const silvia_system_parameters& params, size_t& S_bits, size_t& R_bits);
+
+	/**
+	 * Get the fixed base for S
+	 * @return the fixed base for S
+	 */
+	silvia_fixed_base* get_fixed_S();
+
+	/**
+	 * Get the fixed base for one of the R values
+	 * @param i which R value to get the fixed base for
+	 * @return the fixed base for R_i
+	 */
+	silvia_fixed_base* get_fixed_R(size_t i);
 	
 private:
+	// Copying is not allowed because of the precomputed tables
+	silvia_pub_key(const silvia_pub_key&);
+	silvia_pub_key& operator=(const silvia_pub_key&);
+
+	// Discard the precomputed tables
+	void clear_fixed_bases();
+
+	// Create empty tables for all bases with the current window
+	void create_fixed_bases();
+
 	// Public key values
 	mpz_class		n;
 	mpz_class 		S;
 	mpz_class		Z;
 	std::vector<mpz_class>	R;
+
+	// Montgomery context for n
+	silvia_modulus		modulus;
+
+	// Precomputed tables for the fixed bases
+	size_t				fixed_base_window;
+	silvia_fixed_base*		fixed_S;
+	std::vector<silvia_fixed_base*>	fixed_R;
+	pthread_mutex_t			fixed_lock;
 };
 
 /**
@@ -141,6 +235,17 @@ public:
 	 */
 	mpz_class& get_n_prime();
 
+	/**
+	 * Compute base^exp mod pq using the Chinese Remainder Theorem; the
+	 * exponentiation is split into two half-size exponentiations modulo
+	 * p and q with reduced exponents, which are recombined using Garner's
+	 * method
+	 * @param base the base
+	 * @param exp the exponent
+	 * @return base^exp mod pq
+	 */
+	mpz_class powm_crt(const mpz_class& base, const mpz_class& exp) const;
+
 private:
 	// Private key values
 	mpz_class	p;
@@ -148,6 +253,11 @@ private:
 	mpz_class	p_prime;
 	mpz_class	q_prime;
 	mpz_class	n_prime;
+
+	// CRT values
+	mpz_class	p_minus_1;
+	mpz_class	q_minus_1;
+	mpz_class	q_inv_p;
 };
 
 /**
@@ -39,6 +39,7 @@
 #include <string.h>
 #include "bytestringtests.h"
 #include "silvia_bytestring.h"
+#include "silvia_apdu.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(bytestring_tests);
 
@@ -281,3 +282,194 @@ void bytestring_tests::testMPZ()
 	CPPUNIT_ASSERT(b1.mpz_val() == mpz_class("0x123456789"));
 	CPPUNIT_ASSERT(b2.mpz_val() == mpz_class("0x9876543210"));
 }
+
+// Check if the data of a byte string is stored inside the object
+static bool is_inline(const bytestring& b)
+{
+	const unsigned char* object = (const unsigned char*) &b;
+
+	return (b.const_byte_str() >= object) && (b.const_byte_str() < object + sizeof(bytestring));
+}
+
+void bytestring_tests::testStorage()
+{
+	// APDU-sized data is stored inline, also when built byte by byte
+	bytestring b("00A4040009F849524D416361726400");
+	bytestring b1;
+
+	for (size_t i = 0; i < SILVIA_BYTESTRING_INLINE; i++)
+	{
+		b1 += (unsigned char) i;
+	}
+
+	CPPUNIT_ASSERT(is_inline(b));
+	CPPUNIT_ASSERT(is_inline(b1));
+	CPPUNIT_ASSERT(is_inline(b1.substr(2)));
+	CPPUNIT_ASSERT(is_inline(b + b1.substr(0, 128)));
+
+	// Larger data moves to the heap and keeps its contents
+	bytestring b2 = b1;
+
+	b2 += b1;
+
+	CPPUNIT_ASSERT(!is_inline(b2));
+	CPPUNIT_ASSERT(b2.size() == 2 * SILVIA_BYTESTRING_INLINE);
+	CPPUNIT_ASSERT(b2.substr(0, SILVIA_BYTESTRING_INLINE) == b1);
+	CPPUNIT_ASSERT(b2.substr(SILVIA_BYTESTRING_INLINE) == b1);
+
+	// Appending a part of the byte string to itself
+	bytestring b3 = b1;
+
+	b3 += b3.view(0, 16);
+
+	CPPUNIT_ASSERT(b3.size() == SILVIA_BYTESTRING_INLINE + 16);
+	CPPUNIT_ASSERT(b3.substr(SILVIA_BYTESTRING_INLINE) == b1.substr(0, 16));
+
+	// Swapping heap data does not copy it
+	const unsigned char* data = b2.const_byte_str();
+	bytestring b4 = b3;
+
+	b4.swap(b2);
+
+	CPPUNIT_ASSERT(b4.const_byte_str() == data);
+	CPPUNIT_ASSERT(b4.size() == 2 * SILVIA_BYTESTRING_INLINE);
+	CPPUNIT_ASSERT(b2 == b3);
+
+	// Swapping inline data
+	bytestring b5("AABB");
+	bytestring b6("CCDDEE");
+
+	b5.swap(b6);
+
+	CPPUNIT_ASSERT(b5 == bytestring("CCDDEE"));
+	CPPUNIT_ASSERT(b6 == bytestring("AABB"));
+
+	// Assignment and resizing
+	b5 = b2;
+
+	CPPUNIT_ASSERT(b5 == b3);
+
+	b5.resize(2);
+	b5.resize(4);
+
+	CPPUNIT_ASSERT(b5 == bytestring("00010000"));
+
+	// The empty byte string
+	bytestring b7("");
+
+	CPPUNIT_ASSERT(b7.size() == 0);
+	CPPUNIT_ASSERT(b7 == bytestring());
+	CPPUNIT_ASSERT(bytestring(mpz_class(0)).size() == 0);
+}
+
+void bytestring_tests::testViews()
+{
+	bytestring b("0102030405060708090A0B0C0D0E0F109000");
+
+	// A view refers to the data of the byte string
+	bytestring_view v = b.view(0, b.size() - 2);
+
+	CPPUNIT_ASSERT(v.size() == 16);
+	CPPUNIT_ASSERT(v.const_byte_str() == b.const_byte_str());
+	CPPUNIT_ASSERT(v.mpz_val() == mpz_class("0x0102030405060708090A0B0C0D0E0F10"));
+	CPPUNIT_ASSERT(v.hex_str() == "0102030405060708090A0B0C0D0E0F10");
+
+	// Sub-views
+	bytestring_view sw = b.view(b.size() - 2);
+
+	CPPUNIT_ASSERT(sw == bytestring("9000"));
+	CPPUNIT_ASSERT(sw != bytestring("6982"));
+	CPPUNIT_ASSERT(v.substr(14) == bytestring("0F10"));
+	CPPUNIT_ASSERT(v.substr(14, 1)[0] == 0x0F);
+	CPPUNIT_ASSERT(v.substr(16).size() == 0);
+	CPPUNIT_ASSERT(b.view(100).size() == 0);
+
+	// Views convert to byte strings
+	bytestring b1 = v.substr(0, 4);
+
+	CPPUNIT_ASSERT(b1 == bytestring("01020304"));
+
+	// Splitting a view advances it without copying
+	bytestring_view rest = b.view();
+	bytestring_view first = rest.split(4);
+
+	CPPUNIT_ASSERT(first == bytestring("01020304"));
+	CPPUNIT_ASSERT(first.const_byte_str() == b.const_byte_str());
+	CPPUNIT_ASSERT(rest.size() == b.size() - 4);
+	CPPUNIT_ASSERT(rest.const_byte_str() == b.const_byte_str() + 4);
+	CPPUNIT_ASSERT(rest.split(100).size() == b.size() - 4);
+	CPPUNIT_ASSERT(rest.size() == 0);
+	CPPUNIT_ASSERT(rest.split(1).size() == 0);
+
+	// Responses are parsed through views
+	CPPUNIT_ASSERT(silvia_apdu::get_sw(b) == 0x9000);
+	CPPUNIT_ASSERT(silvia_apdu::get_data(b) == v);
+	CPPUNIT_ASSERT(silvia_apdu::get_data(b).const_byte_str() == b.const_byte_str());
+	CPPUNIT_ASSERT(silvia_apdu::get_sw(bytestring("6982")) == 0x6982);
+	CPPUNIT_ASSERT(silvia_apdu::get_data(bytestring("6982")).size() == 0);
+	CPPUNIT_ASSERT(silvia_apdu::get_sw(bytestring("90")) == 0);
+	CPPUNIT_ASSERT(silvia_apdu::get_data(bytestring("90")).size() == 0);
+}
+
+void bytestring_tests::testPrependPad()
+{
+	bytestring b("0304");
+
+	b.prepend(bytestring("0102"));
+
+	CPPUNIT_ASSERT(b == bytestring("01020304"));
+
+	// Prepending a part of the byte string to itself
+	b.prepend(b.view(2));
+
+	CPPUNIT_ASSERT(b == bytestring("030401020304"));
+
+	// Padding prepends zero bytes
+	bytestring b1("ABCD");
+
+	b1.pad(5);
+
+	CPPUNIT_ASSERT(b1 == bytestring("000000ABCD"));
+
+	b1.pad(3);
+
+	CPPUNIT_ASSERT(b1 == bytestring("000000ABCD"));
+
+	// Padding beyond the inline storage
+	bytestring b2(mpz_class("0x1234"));
+
+	b2.pad(1000);
+
+	CPPUNIT_ASSERT(b2.size() == 1000);
+	CPPUNIT_ASSERT(b2.mpz_val() == mpz_class("0x1234"));
+	CPPUNIT_ASSERT(b2.bits() == 13);
+}
+
+
+void bytestring_tests::testFixedWidth()
+{
+	// Fixed width conversion pads on the left
+	mpz_class v("0x1234");
+
+	CPPUNIT_ASSERT(bytestring(v, 4) == bytestring("00001234"));
+	CPPUNIT_ASSERT(bytestring(v, 1) == bytestring("1234"));
+	CPPUNIT_ASSERT(bytestring(mpz_class(0), 3) == bytestring("000000"));
+
+	// The result is the same as the hexadecimal conversion plus padding
+	mpz_class big("0x0102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F");
+	bytestring b1(big);
+
+	b1.pad(300);
+
+	CPPUNIT_ASSERT(bytestring(big, 300) == b1);
+	CPPUNIT_ASSERT(bytestring(big, 300).mpz_val() == big);
+
+	// Appending values
+	bytestring b2("AA");
+
+	b2.append_mpz(v, 3);
+	b2.append_uint(0x1234, 4);
+	b2.append_uint(0xABCDEF, 2);
+
+	CPPUNIT_ASSERT(b2 == bytestring("AA00123400001234CDEF"));
+}
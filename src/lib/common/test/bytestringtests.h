@@ -49,6 +49,10 @@ class bytestring_tests : public CppUnit::TestFixture
 	CPPUNIT_TEST(testSplitting);
 	CPPUNIT_TEST(testBits);
 	CPPUNIT_TEST(testMPZ);
+	CPPUNIT_TEST(testStorage);
+	CPPUNIT_TEST(testViews);
+	CPPUNIT_TEST(testPrependPad);
+	CPPUNIT_TEST(testFixedWidth);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -61,6 +65,10 @@ public:
 	void testSplitting();
 	void testBits();
 	void testMPZ();
+	void testStorage();
+	void testViews();
+	void testPrependPad();
+	void testFixedWidth();
 
 	void setUp();
 	void tearDown();
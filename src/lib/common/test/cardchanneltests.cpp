@@ -0,0 +1,173 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ cardchanneltests.cpp
+
+ Tests the card channel base class
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <vector>
+#include "cardchanneltests.h"
+#include "silvia_card_channel.h"
+#include "silvia_bytestring.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(card_channel_tests);
+
+// Card channel that answers every APDU with a scripted response
+class scripted_card : public silvia_card_channel
+{
+public:
+	scripted_card(const std::vector<bytestring>& responses)
+	{
+		this->responses = responses;
+		exchanged = 0;
+	}
+
+	virtual int get_type()
+	{
+		return 0;
+	}
+
+	virtual bool status()
+	{
+		return true;
+	}
+
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw)
+	{
+		if (!transmit(APDU, data)) return false;
+
+		sw = (data[data.size() - 2] << 8) + data[data.size() - 1];
+		data.resize(data.size() - 2);
+
+		return true;
+	}
+
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw)
+	{
+		if (exchanged >= responses.size()) return false;
+
+		data_sw = responses[exchanged++];
+
+		return true;
+	}
+
+	virtual std::string get_reader_name()
+	{
+		return "scripted";
+	}
+
+	size_t exchanged;
+
+private:
+	std::vector<bytestring> responses;
+};
+
+void card_channel_tests::setUp()
+{
+}
+
+void card_channel_tests::tearDown()
+{
+}
+
+void card_channel_tests::test_transmit_batch()
+{
+	std::vector<bytestring> commands;
+
+	commands.push_back("00A4040009F8496D616763617264");
+	commands.push_back("802000000A");
+	commands.push_back("802100000A");
+	commands.push_back("802200000A");
+
+	std::vector<bytestring> responses;
+
+	responses.push_back("0102039000");
+	responses.push_back("9000");
+	responses.push_back("0A0B0C9000");
+	responses.push_back("9000");
+
+	// All APDUs are exchanged when the card returns 9000 for each of them
+	scripted_card card(responses);
+	std::vector<bytestring> results;
+	std::vector<unsigned long long> timings;
+
+	CPPUNIT_ASSERT(card.transmit_batch(commands, results, &timings));
+	CPPUNIT_ASSERT(card.exchanged == 4);
+	CPPUNIT_ASSERT(results.size() == 4);
+	CPPUNIT_ASSERT(timings.size() == 4);
+	CPPUNIT_ASSERT(results[0] == "0102039000");
+	CPPUNIT_ASSERT(results[2] == "0A0B0C9000");
+
+	// The exchange stops at the first status word other than 9000
+	responses[1] = "6982";
+
+	scripted_card pin_card(responses);
+
+	results.clear();
+
+	CPPUNIT_ASSERT(pin_card.transmit_batch(commands, results));
+	CPPUNIT_ASSERT(pin_card.exchanged == 2);
+	CPPUNIT_ASSERT(results.size() == 2);
+	CPPUNIT_ASSERT(results[1] == "6982");
+}
+
+void card_channel_tests::test_transmit_batch_error()
+{
+	std::vector<bytestring> commands;
+
+	commands.push_back("802000000A");
+	commands.push_back("802100000A");
+	commands.push_back("802200000A");
+
+	std::vector<bytestring> responses;
+
+	responses.push_back("9000");
+
+	// A failing exchange is reported, the successful exchanges are kept
+	scripted_card card(responses);
+	std::vector<bytestring> results;
+
+	CPPUNIT_ASSERT(!card.transmit_batch(commands, results));
+	CPPUNIT_ASSERT(results.size() == 1);
+	CPPUNIT_ASSERT(results[0] == "9000");
+
+	// A response without a status word fails the exchange
+	responses.push_back("90");
+
+	scripted_card short_card(responses);
+
+	results.clear();
+
+	CPPUNIT_ASSERT(!short_card.transmit_batch(commands, results));
+	CPPUNIT_ASSERT(short_card.exchanged == 2);
+	CPPUNIT_ASSERT(results.size() == 1);
+}
@@ -37,6 +37,7 @@
 #include <string>
 #include "hashtests.h"
 #include "silvia_hash.h"
+#include "silvia_asn1.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(hash_tests);
 
@@ -79,3 +80,95 @@ void hash_tests::test_hashing()
 	CPPUNIT_ASSERT(sha512result == mpz_class("0x0f8e2526d058028c500bb0b9516c0f95fb04818497199fff17be16732a1e3de78c2831a40ab14d91a1b11e018d71a4a1ded8cbbb12bc9ee319db163c485f8660"));
 }
 
+
+void hash_tests::test_reuse()
+{
+	// Each thread has one reusable instance per hash type
+	silvia_hash* sha256 = silvia_hash::i("sha256");
+
+	CPPUNIT_ASSERT(sha256 == silvia_hash::i("sha256"));
+	CPPUNIT_ASSERT(sha256 != silvia_hash::i("sha1"));
+
+	// Reusing the context gives the same result every time
+	mpz_class ABCDE("0x4142434445");
+	std::string test = "Silvia is a friend of IRMA";
+
+	for (int i = 0; i < 3; i++)
+	{
+		sha256->init();
+		sha256->update((const unsigned char*) test.c_str(), test.size());
+		sha256->update(ABCDE);
+
+		CPPUNIT_ASSERT(sha256->final() == mpz_class("0x84d07815b7d8275ed4ea26e8ef1fb16987793d89a468ffa1bef3a8564e6d8a85"));
+	}
+}
+
+void hash_tests::test_der_streaming()
+{
+	// Check the streamed encoding against a known encoding
+	mpz_class small("0x7F");
+	mpz_class top_bit("0x80");
+	mpz_class zero(0);
+
+	std::vector<unsigned char> known;
+	const unsigned char known_bytes[] = { 0x30, 0x0C, 0x02, 0x01, 0x03, 0x02, 0x01, 0x7F, 0x02, 0x02, 0x00, 0x80, 0x02, 0x00 };
+	known.insert(known.end(), known_bytes, known_bytes + sizeof(known_bytes));
+
+	silvia_der_sequence known_seq;
+	known_seq.append(small);
+	known_seq.append(top_bit);
+	known_seq.append(zero);
+
+	CPPUNIT_ASSERT(known_seq.get_der_size() == known.size());
+
+	silvia_hash* h = silvia_hash::i("sha256");
+
+	h->init();
+	h->update(known);
+	mpz_class known_hash = h->final();
+
+	h->init();
+	known_seq.hash(h);
+
+	CPPUNIT_ASSERT(h->final() == known_hash);
+
+	// Check the streamed encoding against the ASN.1 classes for
+	// values that need the long length encoding
+	mpz_class values[5];
+
+	mpz_ui_pow_ui(values[0].get_mpz_t(), 2, 2047);		// top bit set, 0x00 prepended
+	mpz_ui_pow_ui(values[1].get_mpz_t(), 3, 1000);
+	values[2] = values[1] * values[1] * values[1];		// more than 255 bytes
+	values[3] = mpz_class("0x0123456789ABCDEF");
+	values[4] = 1;
+
+	silvia_asn1_sequence asn1_seq;
+	silvia_der_sequence der_seq;
+
+	std::vector<silvia_asn1_integer*> asn1_ints;
+
+	for (int i = 0; i < 5; i++)
+	{
+		asn1_ints.push_back(new silvia_asn1_integer(values[i]));
+		asn1_seq.append(asn1_ints.back());
+		der_seq.append(values[i]);
+	}
+
+	std::vector<unsigned char> encoding = asn1_seq.get_der_encoding();
+
+	CPPUNIT_ASSERT(der_seq.get_der_size() == encoding.size());
+
+	h->init();
+	h->update(encoding);
+	mpz_class asn1_hash = h->final();
+
+	h->init();
+	der_seq.hash(h);
+
+	CPPUNIT_ASSERT(h->final() == asn1_hash);
+
+	for (std::vector<silvia_asn1_integer*>::iterator i = asn1_ints.begin(); i != asn1_ints.end(); i++)
+	{
+		delete *i;
+	}
+}
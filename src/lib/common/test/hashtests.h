@@ -42,10 +42,14 @@ class hash_tests : public CppUnit::TestFixture
 {
 	CPPUNIT_TEST_SUITE(hash_tests);
 	CPPUNIT_TEST(test_hashing);
+	CPPUNIT_TEST(test_reuse);
+	CPPUNIT_TEST(test_der_streaming);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void test_hashing();
+	void test_reuse();
+	void test_der_streaming();
 
 	void setUp();
 	void tearDown();
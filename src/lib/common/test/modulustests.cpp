@@ -0,0 +1,187 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ modulustests.cpp
+
+ Tests the Montgomery modulus context
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <gmpxx.h>
+#include "modulustests.h"
+#include "silvia_modulus.h"
+#include "silvia_multiexp.h"
+#include "silvia_rand.h"
+#include "silvia_macros.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(modulus_tests);
+
+void modulus_tests::setUp()
+{
+}
+
+void modulus_tests::tearDown()
+{
+}
+
+// Check conversion and multiplication against plain mpz arithmetic
+static void check_mul(const mpz_class& n, size_t count)
+{
+	silvia_modulus mod(n);
+
+	CPPUNIT_ASSERT(mod.get_n() == n);
+
+	mpz_class one;
+	mod.from_mont(one, mod.one());
+
+	CPPUNIT_ASSERT(one == (n == 1 ? 0 : 1));
+
+	size_t bits = mpz_sizeinbase(_Z(n), 2);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		// Include negative values and values larger than n
+		mpz_class a = silvia_rng::i()->get_random(bits + 64) - silvia_rng::i()->get_random(bits);
+		mpz_class b = silvia_rng::i()->get_random(bits);
+
+		mpz_class a_mont;
+		mpz_class b_mont;
+		mod.to_mont(a_mont, a);
+		mod.to_mont(b_mont, b);
+
+		mpz_class a_back;
+		mod.from_mont(a_back, a_mont);
+
+		mpz_class expected;
+		mpz_mod(_Z(expected), _Z(a), _Z(n));
+
+		CPPUNIT_ASSERT(a_back == expected);
+
+		// Chain a number of products, as the exponentiations do
+		mpz_class r_mont = a_mont;
+
+		for (size_t j = 0; j < 8; j++)
+		{
+			mod.mul(r_mont, r_mont, b_mont);
+			mod.mul(r_mont, r_mont, r_mont);
+
+			expected = expected * b;
+			expected = expected * expected;
+			mpz_mod(_Z(expected), _Z(expected), _Z(n));
+		}
+
+		mpz_class r;
+		mod.from_mont(r, r_mont);
+
+		CPPUNIT_ASSERT(r == expected);
+
+		expected = a * b;
+		mpz_mod(_Z(expected), _Z(expected), _Z(n));
+
+		CPPUNIT_ASSERT(mod.mulmod(a, b) == expected);
+	}
+}
+
+void modulus_tests::test_modulus()
+{
+	size_t sizes[] = { 3, 64, 65, 512, 1024, 2048 };
+
+	for (size_t t = 0; t < sizeof(sizes) / sizeof(size_t); t++)
+	{
+		mpz_class n = silvia_rng::i()->get_random(sizes[t]);
+		mpz_setbit(_Z(n), sizes[t] - 1);
+		mpz_setbit(_Z(n), 0);
+
+		check_mul(n, 50);
+	}
+
+	// Moduli that fill all bits of their limbs
+	mpz_class n = 1;
+	n <<= 1024;
+	n -= 1;
+
+	check_mul(n, 50);
+}
+
+void modulus_tests::test_modulus_even()
+{
+	mpz_class n = silvia_rng::i()->get_random(1024);
+	mpz_setbit(_Z(n), 1023);
+	mpz_clrbit(_Z(n), 0);
+
+	check_mul(n, 50);
+
+	// Multi-exponentiation falls back to plain reduction
+	mpz_class b = silvia_rng::i()->get_random(1024);
+	mpz_class x = silvia_rng::i()->get_random(600);
+
+	silvia_multiexp me(n);
+
+	CPPUNIT_ASSERT(me.add(b, x));
+
+	mpz_class expected;
+	mpz_powm(_Z(expected), _Z(b), _Z(x), _Z(n));
+
+	CPPUNIT_ASSERT(me.compute() == expected);
+}
+
+void modulus_tests::test_modulus_powm()
+{
+	mpz_class p = silvia_rng::i()->get_random(1024);
+	mpz_nextprime(_Z(p), _Z(p));
+
+	silvia_modulus mod(p);
+
+	for (size_t i = 0; i < 10; i++)
+	{
+		mpz_class b = silvia_rng::i()->get_random(1024);
+		mpz_class e = silvia_rng::i()->get_random(1 + i * 200);
+
+		mpz_class expected;
+		mpz_powm(_Z(expected), _Z(b), _Z(e), _Z(p));
+
+		CPPUNIT_ASSERT(mod.powm(b, e) == expected);
+
+		// Negative exponents use the inverse of the base
+		mpz_class e_neg = -e;
+		mpz_class b_inv;
+		mpz_invert(_Z(b_inv), _Z(b), _Z(p));
+		mpz_powm(_Z(expected), _Z(b_inv), _Z(e), _Z(p));
+
+		CPPUNIT_ASSERT(mod.powm(b, e_neg) == expected);
+	}
+
+	// No inverse
+	mpz_class zero = 0;
+	mpz_class minus_one = -1;
+
+	CPPUNIT_ASSERT(mod.powm(zero, minus_one) == 0);
+}
+
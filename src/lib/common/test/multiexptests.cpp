@@ -0,0 +1,322 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ multiexptests.cpp
+
+ Tests the multi-exponentiation implementation
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <gmpxx.h>
+#include <vector>
+#include "multiexptests.h"
+#include "silvia_multiexp.h"
+#include "silvia_rand.h"
+#include "silvia_timer.h"
+#include "silvia_macros.h"
+#include "silvia_types.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(multiexp_tests);
+
+void multiexp_tests::setUp()
+{
+}
+
+void multiexp_tests::tearDown()
+{
+}
+
+// Compute the product of the factors the slow way
+static mpz_class naive_multiexp(const mpz_class& n, std::vector<mpz_class>& b, std::vector<mpz_class>& x)
+{
+	mpz_class result = 1;
+
+	for (size_t i = 0; i < b.size(); i++)
+	{
+		mpz_class factor;
+		mpz_powm(_Z(factor), _Z(b[i]), _Z(x[i]), _Z(n));
+
+		result *= factor;
+		mpz_mod(_Z(result), _Z(result), _Z(n));
+	}
+
+	return result;
+}
+
+void multiexp_tests::test_multiexp()
+{
+	mpz_class n = silvia_rng::i()->get_random(1024);
+	mpz_setbit(_Z(n), 1023);
+	mpz_setbit(_Z(n), 0);
+
+	size_t counts[] = { 1, 2, 3, 5, 10, 40, 100 };
+
+	for (size_t t = 0; t < sizeof(counts) / sizeof(size_t); t++)
+	{
+		std::vector<mpz_class> b;
+		std::vector<mpz_class> x;
+
+		silvia_multiexp me(n);
+
+		for (size_t i = 0; i < counts[t]; i++)
+		{
+			// Vary the exponent sizes and include some zero exponents
+			b.push_back(silvia_rng::i()->get_random(1100));
+			x.push_back((i % 7 == 6) ? mpz_class(0) : silvia_rng::i()->get_random(1 + (i * 97) % 1200));
+
+			CPPUNIT_ASSERT(me.add(b[i], x[i]));
+		}
+
+		mpz_class expected = naive_multiexp(n, b, x);
+
+		CPPUNIT_ASSERT(me.compute() == expected);
+		CPPUNIT_ASSERT(me.compute(SILVIA_MULTIEXP_STRAUS) == expected);
+		CPPUNIT_ASSERT(me.compute(SILVIA_MULTIEXP_PIPPENGER) == expected);
+	}
+
+	// The empty product is 1
+	silvia_multiexp empty(n);
+
+	CPPUNIT_ASSERT(empty.compute() == 1);
+}
+
+void multiexp_tests::test_multiexp_negative()
+{
+	// Use a prime modulus so all bases are invertible
+	mpz_class p = silvia_rng::i()->get_random(512);
+	mpz_nextprime(_Z(p), _Z(p));
+
+	std::vector<mpz_class> b;
+	std::vector<mpz_class> x;
+
+	silvia_multiexp me(p);
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		b.push_back(silvia_rng::i()->get_random(500) + 1);
+		x.push_back(silvia_rng::i()->get_random(300));
+
+		if (i % 2 == 1) x[i] = -x[i];
+
+		CPPUNIT_ASSERT(me.add(b[i], x[i]));
+	}
+
+	mpz_class expected = naive_multiexp(p, b, x);
+
+	CPPUNIT_ASSERT(me.compute(SILVIA_MULTIEXP_STRAUS) == expected);
+	CPPUNIT_ASSERT(me.compute(SILVIA_MULTIEXP_PIPPENGER) == expected);
+
+	// A base without an inverse cannot have a negative exponent
+	mpz_class zero = 0;
+	mpz_class minus_one = -1;
+
+	CPPUNIT_ASSERT(me.add(zero, minus_one) == false);
+	CPPUNIT_ASSERT(me.size() == 6);
+}
+
+// Check multi-exponentiations that mix fixed and variable bases
+static void check_fixed_base_multiexp(silvia_pub_key& pubkey)
+{
+	mpz_class& n = pubkey.get_n();
+
+	for (size_t bits = 100; bits <= 2100; bits += 1000)
+	{
+		std::vector<mpz_class> b;
+		std::vector<mpz_class> x;
+
+		silvia_multiexp me(n);
+
+		b.push_back(pubkey.get_S());
+		x.push_back(silvia_rng::i()->get_random(bits));
+		CPPUNIT_ASSERT(me.add(pubkey.get_fixed_S(), x.back()));
+
+		for (size_t i = 0; i < pubkey.get_R().size(); i++)
+		{
+			b.push_back(pubkey.get_R()[i]);
+			x.push_back(silvia_rng::i()->get_random(bits / 2));
+			CPPUNIT_ASSERT(me.add(pubkey.get_fixed_R(i), x.back()));
+		}
+
+		b.push_back(silvia_rng::i()->get_random(1024));
+		x.push_back(silvia_rng::i()->get_random(300));
+		CPPUNIT_ASSERT(me.add(b.back(), x.back()));
+
+		CPPUNIT_ASSERT(me.compute() == naive_multiexp(n, b, x));
+	}
+
+	// Only fixed bases
+	silvia_multiexp me(n);
+	mpz_class x = silvia_rng::i()->get_random(500);
+	mpz_class expected;
+
+	mpz_powm(_Z(expected), _Z(pubkey.get_S()), _Z(x), _Z(n));
+
+	CPPUNIT_ASSERT(me.add(pubkey.get_fixed_S(), x));
+	CPPUNIT_ASSERT(me.compute() == expected);
+}
+
+void multiexp_tests::test_multiexp_fixed_base()
+{
+	mpz_class n = silvia_rng::i()->get_random(1024);
+	mpz_setbit(_Z(n), 1023);
+	mpz_setbit(_Z(n), 0);
+
+	std::vector<mpz_class> R;
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		R.push_back(silvia_rng::i()->get_random(1024));
+	}
+
+	silvia_pub_key pubkey(n, silvia_rng::i()->get_random(1024), silvia_rng::i()->get_random(1024), R);
+
+	CPPUNIT_ASSERT(pubkey.get_fixed_base_window() == SILVIA_FIXED_BASE_DEFAULT_WINDOW);
+
+	size_t windows[] = { 0, 1, 3, SILVIA_FIXED_BASE_DEFAULT_WINDOW, 8 };
+
+	size_t S_bits;
+	size_t R_bits;
+
+	silvia_pub_key::get_exponent_bits(*silvia_system_parameters::i(), S_bits, R_bits);
+
+	for (size_t t = 0; t < sizeof(windows) / sizeof(size_t); t++)
+	{
+		pubkey.set_fixed_base_window(windows[t]);
+
+		CPPUNIT_ASSERT(pubkey.get_fixed_S()->get_window() == windows[t]);
+
+		// Without precomputation, the key is not changed
+		check_fixed_base_multiexp(pubkey);
+
+		CPPUNIT_ASSERT(pubkey.get_fixed_S()->size() == 0);
+		CPPUNIT_ASSERT(pubkey.get_fixed_R(0)->size() == 0);
+
+		// With precomputation, the frozen tables are used
+		pubkey.precompute();
+
+		check_fixed_base_multiexp(pubkey);
+
+		if (windows[t] > 0)
+		{
+			CPPUNIT_ASSERT(pubkey.get_fixed_S()->covers(S_bits));
+			CPPUNIT_ASSERT(pubkey.get_fixed_R(0)->covers(R_bits));
+		}
+		else
+		{
+			CPPUNIT_ASSERT(pubkey.get_fixed_S()->size() == 0);
+		}
+	}
+}
+
+void multiexp_tests::test_multiexp_speed()
+{
+	// Mimic the factors of a proof verification with 1024-bit
+	// modulus: S^v'^, A'^e^ and the attribute bases
+	mpz_class n = silvia_rng::i()->get_random(1024);
+	mpz_setbit(_Z(n), 1023);
+	mpz_setbit(_Z(n), 0);
+
+	std::vector<mpz_class> b;
+	std::vector<mpz_class> x;
+
+	b.push_back(silvia_rng::i()->get_random(1024));
+	x.push_back(silvia_rng::i()->get_random(2060));
+	b.push_back(silvia_rng::i()->get_random(1024));
+	x.push_back(silvia_rng::i()->get_random(840));
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		b.push_back(silvia_rng::i()->get_random(1024));
+		x.push_back(silvia_rng::i()->get_random(592));
+	}
+
+	size_t count = 50;
+	silvia_timer timer;
+	mpz_class naive_result;
+	mpz_class me_result;
+
+	timer.mark();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		naive_result = naive_multiexp(n, b, x);
+	}
+
+	unsigned long long naive_elapsed = timer.elapsed();
+
+	timer.mark();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		silvia_multiexp me(n);
+
+		for (size_t j = 0; j < b.size(); j++)
+		{
+			me.add(b[j], x[j]);
+		}
+
+		me_result = me.compute();
+	}
+
+	unsigned long long me_elapsed = timer.elapsed();
+
+	CPPUNIT_ASSERT(me_result == naive_result);
+
+	// Now treat all bases except the second (A') as fixed bases
+	std::vector<mpz_class> R(b.begin() + 2, b.end());
+	silvia_pub_key pubkey(n, b[0], 1, R);
+
+	pubkey.precompute();
+
+	timer.mark();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		silvia_multiexp me(n);
+
+		me.add(pubkey.get_fixed_S(), x[0]);
+		me.add(b[1], x[1]);
+
+		for (size_t j = 0; j < R.size(); j++)
+		{
+			me.add(pubkey.get_fixed_R(j), x[j + 2]);
+		}
+
+		me_result = me.compute();
+	}
+
+	unsigned long long fixed_elapsed = timer.elapsed();
+
+	CPPUNIT_ASSERT(me_result == naive_result);
+
+	printf("\n\nmpz_powm per factor: %lluus, multi-exponentiation: %lluus, with fixed bases: %lluus\n\n", naive_elapsed / 1000 / count, me_elapsed / 1000 / count, fixed_elapsed / 1000 / count);
+}
+
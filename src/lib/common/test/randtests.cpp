@@ -37,6 +37,10 @@
 #include "randtests.h"
 #include "silvia_rand.h"
 #include <gmpxx.h>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <pthread.h>
 
 CPPUNIT_TEST_SUITE_REGISTRATION(rand_tests);
 
@@ -50,21 +54,168 @@ void rand_tests::tearDown()
 
 void rand_tests::test_rand()
 {
-	for (size_t i = 1; i < 1024; i++)
+	silvia_rng_mode_t modes[] = { SILVIA_RNG_DRBG, SILVIA_RNG_OPENSSL };
+
+	for (size_t m = 0; m < 2; m++)
 	{
-		size_t max = 0;
+		silvia_rng::i()->set_mode(modes[m]);
+
+		CPPUNIT_ASSERT(silvia_rng::i()->get_mode() == modes[m]);
 
-		for (int j = 0; j < 100; j++)
+		for (size_t i = 1; i < 1024; i++)
 		{
-			mpz_class r = silvia_rng::i()->get_random(i);
-			size_t size = mpz_sizeinbase(r.get_mpz_t(), 2);
+			size_t max = 0;
+
+			for (int j = 0; j < 100; j++)
+			{
+				mpz_class r = silvia_rng::i()->get_random(i);
+				size_t size = mpz_sizeinbase(r.get_mpz_t(), 2);
 
-			CPPUNIT_ASSERT(size <= i);
+				CPPUNIT_ASSERT(size <= i);
 
-			if (size > max) max = size;
+				if (size > max) max = size;
+			}
+
+			CPPUNIT_ASSERT(max == i);
+		}
+	}
+
+	silvia_rng::i()->set_mode(SILVIA_RNG_DRBG);
+
+	CPPUNIT_ASSERT(silvia_rng::i()->get_random(0) == 0);
+}
+
+void rand_tests::test_rand_in_place()
+{
+	// Reuse the same value, shrinking and growing it; the DRBG buffer
+	// is refilled many times in the process
+	mpz_class r = silvia_rng::i()->get_random(4096);
+	mpz_class prev = r;
+
+	for (size_t i = 0; i < 2000; i++)
+	{
+		size_t bits = 1 + (i * 131) % 4096;
+
+		silvia_rng::i()->get_random(r, bits);
+
+		CPPUNIT_ASSERT(mpz_sgn(r.get_mpz_t()) >= 0);
+		CPPUNIT_ASSERT(mpz_sizeinbase(r.get_mpz_t(), 2) <= bits);
+
+		// Long random values should never repeat
+		if (bits > 128)
+		{
+			CPPUNIT_ASSERT(r != prev);
 		}
 
-		CPPUNIT_ASSERT(max == i);
+		prev = r;
 	}
 }
 
+void rand_tests::test_rand_batch()
+{
+	std::vector<size_t> bits;
+
+	bits.push_back(2724 + 80 + 256);
+	bits.push_back(120 + 80 + 256);
+	bits.push_back(2048 + 80);
+	bits.push_back(0);
+	bits.push_back(7);
+
+	for (int i = 0; i < 10; i++)
+	{
+		bits.push_back(256 + 80 + 256);
+	}
+
+	std::vector<mpz_class> r;
+
+	silvia_rng::i()->get_random(r, bits);
+
+	CPPUNIT_ASSERT(r.size() == bits.size());
+
+	for (size_t i = 0; i < r.size(); i++)
+	{
+		CPPUNIT_ASSERT(mpz_sizeinbase(r[i].get_mpz_t(), 2) <= ((bits[i] == 0) ? 1 : bits[i]));
+
+		if (bits[i] > 128)
+		{
+			CPPUNIT_ASSERT(mpz_sizeinbase(r[i].get_mpz_t(), 2) > bits[i] - 64);
+		}
+	}
+
+	CPPUNIT_ASSERT(r[3] == 0);
+
+	for (size_t i = 5; i < r.size() - 1; i++)
+	{
+		CPPUNIT_ASSERT(r[i] != r[i + 1]);
+	}
+}
+
+// Result of drawing random numbers in a forked child and its parent
+struct fork_result
+{
+	std::string out;
+	std::string child_out;
+	bool child_ok;
+};
+
+static void* fork_thread(void* arg)
+{
+	fork_result* result = (fork_result*) arg;
+
+	// A new thread has its own DRBG; after the first draw, its buffer
+	// holds almost a full buffer of unused output when forking
+	silvia_rng::i()->get_random(8);
+
+	int fds[2];
+
+	result->child_ok = false;
+
+	if (pipe(fds) != 0) return NULL;
+
+	pid_t child = fork();
+
+	if (child < 0) return NULL;
+
+	result->out = silvia_rng::i()->get_random(512).get_str(16);
+
+	if (child == 0)
+	{
+		// Hand the output of the child to the parent
+		ssize_t written = write(fds[1], result->out.c_str(), result->out.size());
+
+		_exit((written == (ssize_t) result->out.size()) ? 0 : 1);
+	}
+
+	close(fds[1]);
+
+	char buf[256];
+	ssize_t n;
+
+	while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+	{
+		result->child_out.append(buf, n);
+	}
+
+	close(fds[0]);
+
+	int status = 0;
+
+	result->child_ok = (waitpid(child, &status, 0) == child) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+
+	return NULL;
+}
+
+void rand_tests::test_rand_fork()
+{
+	fork_result result;
+	pthread_t thread;
+
+	CPPUNIT_ASSERT(pthread_create(&thread, NULL, fork_thread, &result) == 0);
+	CPPUNIT_ASSERT(pthread_join(thread, NULL) == 0);
+
+	CPPUNIT_ASSERT(result.child_ok);
+	CPPUNIT_ASSERT(!result.child_out.empty());
+
+	// The parent and the child must not produce the same output
+	CPPUNIT_ASSERT(result.out != result.child_out);
+}
@@ -41,10 +41,16 @@ class rand_tests : public CppUnit::TestFixture
 {
 	CPPUNIT_TEST_SUITE(rand_tests);
 	CPPUNIT_TEST(test_rand);
+	CPPUNIT_TEST(test_rand_in_place);
+	CPPUNIT_TEST(test_rand_batch);
+	CPPUNIT_TEST(test_rand_fork);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void test_rand();
+	void test_rand_in_place();
+	void test_rand_batch();
+	void test_rand_fork();
 
 	void setUp();
 	void tearDown();
@@ -0,0 +1,120 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ runtimetests.cpp
+
+ Tests the runtime context
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <pthread.h>
+#include "runtimetests.h"
+#include "silvia_runtime.h"
+#include "silvia_parameters.h"
+#include "silvia_rand.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(runtime_tests);
+
+void runtime_tests::setUp()
+{
+}
+
+void runtime_tests::tearDown()
+{
+	silvia_system_parameters::i()->reset();
+}
+
+void runtime_tests::test_runtime_params()
+{
+	silvia_system_parameters::i()->set_l_n(1024);
+	silvia_system_parameters::i()->set_hash_type("sha1");
+
+	// The runtime takes a copy of the process-wide parameters
+	silvia_runtime runtime;
+
+	silvia_system_parameters::i()->reset();
+
+	CPPUNIT_ASSERT(runtime.get_params().get_l_n() == 1024);
+	CPPUNIT_ASSERT(runtime.get_params().get_hash_type() == "sha1");
+	CPPUNIT_ASSERT(SYSPAR(l_n) == 2048);
+
+	// Or uses explicitly specified parameters
+	silvia_system_parameters params;
+	params.set_l_statzk(128);
+
+	silvia_runtime runtime2(params);
+
+	params.set_l_statzk(80);
+
+	CPPUNIT_ASSERT(runtime2.get_params().get_l_statzk() == 128);
+	CPPUNIT_ASSERT(runtime2.get_params().get_l_n() == 2048);
+}
+
+static void* get_thread_rng(void* arg)
+{
+	silvia_runtime* runtime = (silvia_runtime*) arg;
+
+	silvia_rng* rng = runtime->get_rng();
+
+	// Use the generator on this thread
+	mpz_class r = rng->get_random(128);
+
+	return (rng == runtime->get_rng()) ? rng : NULL;
+}
+
+void runtime_tests::test_runtime_rng()
+{
+	silvia_runtime runtime;
+
+	// The calling thread always gets the same generator
+	silvia_rng* rng = runtime.get_rng();
+
+	CPPUNIT_ASSERT(rng != NULL);
+	CPPUNIT_ASSERT(rng == runtime.get_rng());
+	CPPUNIT_ASSERT(rng == silvia_rng::i());
+
+	// Other threads get their own generator
+	pthread_t threads[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		CPPUNIT_ASSERT(pthread_create(&threads[i], NULL, get_thread_rng, &runtime) == 0);
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		void* thread_rng = NULL;
+
+		CPPUNIT_ASSERT(pthread_join(threads[i], &thread_rng) == 0);
+		CPPUNIT_ASSERT(thread_rng != NULL);
+		CPPUNIT_ASSERT(thread_rng != rng);
+	}
+}
+
@@ -0,0 +1,277 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ threadpooltests.cpp
+
+ Tests the thread pool
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "threadpooltests.h"
+#include "silvia_thread_pool.h"
+#include "silvia_macros.h"
+#include <gmpxx.h>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(thread_pool_tests);
+
+/**
+ * Test job; computes 3^exp mod (2^1024 - 105)
+ */
+class test_job : public silvia_job
+{
+public:
+	test_job(unsigned long exp)
+	{
+		this->exp = exp;
+		runs = 0;
+	}
+
+	virtual void run()
+	{
+		mpz_class n = 1;
+		n <<= 1024;
+		n -= 105;
+
+		mpz_class b = 3;
+		mpz_powm_ui(_Z(result), _Z(b), exp, _Z(n));
+
+		runs++;
+	}
+
+	unsigned long exp;
+	mpz_class result;
+	int runs;
+};
+
+/**
+ * Test job that counts down when it has finished
+ */
+class counted_job : public test_job
+{
+public:
+	counted_job(unsigned long exp, silvia_job_countdown* countdown) : test_job(exp)
+	{
+		this->countdown = countdown;
+	}
+
+	virtual void run()
+	{
+		test_job::run();
+
+		countdown->done();
+	}
+
+private:
+	silvia_job_countdown* countdown;
+};
+
+/**
+ * Job that blocks until it is released
+ */
+class blocking_job : public silvia_job
+{
+public:
+	blocking_job()
+	{
+		released = false;
+		finished = false;
+
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&cond, NULL);
+	}
+
+	~blocking_job()
+	{
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&lock);
+	}
+
+	virtual void run()
+	{
+		pthread_mutex_lock(&lock);
+
+		while (!released)
+		{
+			pthread_cond_wait(&cond, &lock);
+		}
+
+		finished = true;
+
+		pthread_mutex_unlock(&lock);
+	}
+
+	void release()
+	{
+		pthread_mutex_lock(&lock);
+
+		released = true;
+
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+
+	bool is_finished()
+	{
+		pthread_mutex_lock(&lock);
+
+		bool rv = finished;
+
+		pthread_mutex_unlock(&lock);
+
+		return rv;
+	}
+
+private:
+	bool released;
+	bool finished;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+void thread_pool_tests::setUp()
+{
+}
+
+void thread_pool_tests::tearDown()
+{
+}
+
+static void check_jobs(std::vector<test_job*>& jobs)
+{
+	mpz_class n = 1;
+	n <<= 1024;
+	n -= 105;
+
+	for (std::vector<test_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		mpz_class expected;
+		mpz_class b = 3;
+		mpz_powm_ui(_Z(expected), _Z(b), (*i)->exp, _Z(n));
+
+		CPPUNIT_ASSERT((*i)->runs == 1);
+		CPPUNIT_ASSERT((*i)->result == expected);
+	}
+}
+
+void thread_pool_tests::test_thread_pool()
+{
+	CPPUNIT_ASSERT(silvia_thread_pool::num_cpus() >= 1);
+
+	silvia_thread_pool pool(4);
+
+	CPPUNIT_ASSERT(pool.size() == 4);
+
+	// Waiting without jobs should return immediately
+	pool.wait();
+
+	std::vector<test_job*> jobs;
+
+	for (unsigned long i = 0; i < 200; i++)
+	{
+		jobs.push_back(new test_job(1000 + i * 37));
+
+		pool.submit(jobs.back());
+	}
+
+	pool.wait();
+
+	check_jobs(jobs);
+
+	for (std::vector<test_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		delete *i;
+	}
+}
+
+void thread_pool_tests::test_thread_pool_reuse()
+{
+	silvia_thread_pool pool;
+
+	CPPUNIT_ASSERT(pool.size() == silvia_thread_pool::num_cpus());
+
+	for (int round = 0; round < 5; round++)
+	{
+		std::vector<test_job*> jobs;
+
+		for (unsigned long i = 0; i < 20; i++)
+		{
+			jobs.push_back(new test_job(round * 1000 + i));
+
+			pool.submit(jobs.back());
+		}
+
+		pool.wait();
+
+		check_jobs(jobs);
+
+		for (std::vector<test_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+		{
+			delete *i;
+		}
+	}
+}
+
+void thread_pool_tests::test_job_countdown()
+{
+	silvia_thread_pool pool(2);
+
+	// Unrelated work that is still running must not hold up the group
+	blocking_job blocker;
+
+	pool.submit(&blocker);
+
+	silvia_job_countdown countdown(20);
+	std::vector<test_job*> jobs;
+
+	for (unsigned long i = 0; i < 20; i++)
+	{
+		jobs.push_back(new counted_job(1000 + i, &countdown));
+
+		pool.submit(jobs.back());
+	}
+
+	countdown.wait();
+
+	check_jobs(jobs);
+
+	CPPUNIT_ASSERT(!blocker.is_finished());
+
+	blocker.release();
+
+	pool.wait();
+
+	CPPUNIT_ASSERT(blocker.is_finished());
+
+	for (std::vector<test_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		delete *i;
+	}
+}
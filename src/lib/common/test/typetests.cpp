@@ -92,6 +92,45 @@ void type_tests::test_silvia_priv_key()
 	CPPUNIT_ASSERT(test_priv2.get_q_prime() == mpz_class("0x77fad652752811628175200a848e215829773ac5ff413032396c70475dddfd56d294a81987236084b4611b542b96281fc58fc78c5a86ee05306ecdbc4cc05679bfda2a05bf1d48b7c3c0271a999f78de69e5043f17338a13b657b68f6067048bf33ea9ebc31c6f3e0718cec358c53ec8aba27a9bff8b7f0add5e326c5e72f5a3"));
 }
 
+void type_tests::test_silvia_priv_key_crt()
+{
+	// Exhaustively check a small key against plain exponentiation
+	silvia_priv_key test_priv1(7, 11);
+
+	for (unsigned long base = 1; base < 77; base++)
+	{
+		if ((base % 7 == 0) || (base % 11 == 0)) continue;
+
+		for (long exp = -40; exp <= 200; exp += 3)
+		{
+			mpz_class b = base;
+			mpz_class x = exp;
+			mpz_class expected;
+			mpz_class n = 77;
+
+			mpz_powm(expected.get_mpz_t(), b.get_mpz_t(), x.get_mpz_t(), n.get_mpz_t());
+
+			CPPUNIT_ASSERT(test_priv1.powm_crt(b, x) == expected);
+		}
+	}
+
+	// Check a full-size key
+	silvia_priv_key test_priv2
+	(
+		mpz_class("0xfa2087628d1df70221cbd3deac8392633514db651f7f9c514f9e77109c9d54d39d3b6376260e08925fbd425d9eaba93c46e5857b0985036291746e9b8a5311f4f1ddc32fc4f2e03f6c0826f73e43ab0c6a8babd86780d18a1117ab5e4669b570653106a4d1a1dd915ff94bc09bbae85595afd069ef302e92249b399834a38ab3"),
+		mpz_class("0xeff5aca4ea5022c502ea4015091c42b052ee758bfe82606472d8e08ebbbbfaada52950330e46c10968c236a8572c503f8b1f8f18b50ddc0a60dd9b789980acf37fb4540b7e3a916f87804e35333ef1bcd3ca087e2e6714276caf6d1ec0ce0917e67d53d78638de7c0e319d86b18a7d915744f537ff16fe15babc64d8bce5eb47")
+	);
+
+	mpz_class n = test_priv2.get_p() * test_priv2.get_q();
+	mpz_class b("0x4d1a1dd915ff94bc09bbae85595afd069ef302e92249b399834a38ab3c42b052ee758bfe82606472d8e08ebbbbfaada52950330e46c10968c236a8572c503f8b1f8f18b50ddc0a60dd9b7899");
+	mpz_class x = test_priv2.get_n_prime() - 12345;
+	mpz_class expected;
+
+	mpz_powm(expected.get_mpz_t(), b.get_mpz_t(), x.get_mpz_t(), n.get_mpz_t());
+
+	CPPUNIT_ASSERT(test_priv2.powm_crt(b, x) == expected);
+}
+
 void type_tests::test_attributes()
 {
 	silvia_attribute* generic = NULL;
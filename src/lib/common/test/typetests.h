@@ -43,6 +43,7 @@ class type_tests : public CppUnit::TestFixture
 	CPPUNIT_TEST_SUITE(type_tests);
 	CPPUNIT_TEST(test_silvia_pub_key);
 	CPPUNIT_TEST(test_silvia_priv_key);
+	CPPUNIT_TEST(test_silvia_priv_key_crt);
 	CPPUNIT_TEST(test_attributes);
 	CPPUNIT_TEST(test_credential);
 	CPPUNIT_TEST_SUITE_END();
@@ -50,6 +51,7 @@ class type_tests : public CppUnit::TestFixture
 public:
 	void test_silvia_pub_key();
 	void test_silvia_priv_key();
+	void test_silvia_priv_key_crt();
 	void test_attributes();
 	void test_credential();
 
@@ -0,0 +1,971 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_emulated_card.cpp
+
+ Software emulation of an IRMA card
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_emulated_card.h"
+#include "silvia_parameters.h"
+#include "silvia_rand.h"
+#include <assert.h>
+#include <time.h>
+#include <errno.h>
+
+// Application identifier of the IRMA card application (version >= 0.8)
+#define IRMA_AID				"F849524D4163617264"
+
+// File control information returned on selection (version 0.8)
+#define IRMA_FCI				"6F08A506800400080000"
+
+// Card limits
+#define IRMA_MAX_CREDENTIALS			16
+#define IRMA_PIN_TRIES				3
+#define IRMA_PIN_SIZE				8
+#define IRMA_LOG_SIZE				30
+#define IRMA_LOG_ENTRY_SIZE			16
+#define IRMA_LOG_ENTRIES_PER_APDU		(255 / IRMA_LOG_ENTRY_SIZE)
+
+// Log actions
+#define IRMA_ACTION_ISSUE			0x01
+#define IRMA_ACTION_PROVE			0x02
+#define IRMA_ACTION_REMOVE			0x03
+
+// Status words
+#define SW_OK					"9000"
+#define SW_WRONG_LENGTH				"6700"
+#define SW_SECURITY_STATUS_NOT_SATISFIED	"6982"
+#define SW_CONDITIONS_NOT_SATISFIED		"6985"
+#define SW_COMMAND_NOT_ALLOWED			"6986"
+#define SW_WRONG_DATA				"6A80"
+#define SW_FILE_NOT_FOUND			"6A82"
+#define SW_FILE_FULL				"6A84"
+#define SW_REFERENCED_DATA_NOT_FOUND		"6A88"
+#define SW_WRONG_P1P2				"6B00"
+#define SW_INS_NOT_SUPPORTED			"6D00"
+
+// Issuance steps
+#define ISSUE_NONE				0
+#define ISSUE_STARTED				1
+#define ISSUE_COMMITTED				2
+#define ISSUE_SIGNING				3
+
+// Pad a PIN to its fixed length
+static bytestring pad_pin(const std::string& PIN)
+{
+	bytestring rv;
+	
+	for (std::string::const_iterator i = PIN.begin(); i != PIN.end(); i++)
+	{
+		rv += (unsigned char) *i;
+	}
+	
+	while (rv.size() < IRMA_PIN_SIZE) rv += (unsigned char) 0x00;
+	
+	return rv;
+}
+
+// Get a big-endian short from a byte string
+static unsigned short get_short(bytestring& data, size_t offset)
+{
+	return (data[offset] << 8) + data[offset + 1];
+}
+
+silvia_emulated_card::silvia_emulated_card(const std::string& cred_PIN /* = "0000" */, const std::string& admin_PIN /* = "000000" */)
+{
+	assert(cred_PIN.size() <= IRMA_PIN_SIZE);
+	assert(admin_PIN.size() <= IRMA_PIN_SIZE);
+	
+	apdu_us = 0;
+	byte_us = 0;
+	require_pin = false;
+	present = true;
+	
+	// The master secret is shared by all credentials on the card
+	secret = silvia_rng::i()->get_random(SYSPAR(l_m));
+	
+	cred_pin.value = pad_pin(cred_PIN);
+	cred_pin.tries = IRMA_PIN_TRIES;
+	admin_pin.value = pad_pin(admin_PIN);
+	admin_pin.tries = IRMA_PIN_TRIES;
+	
+	selected = false;
+	cred_pin_verified = false;
+	admin_pin_verified = false;
+	admin_selected = NULL;
+	
+	issue_step = ISSUE_NONE;
+	issue_pubkey = NULL;
+	credgen = NULL;
+	
+	proof_cred = NULL;
+	proof_ready = false;
+}
+
+silvia_emulated_card::~silvia_emulated_card()
+{
+	reset_issuance();
+	reset_proof();
+	
+	while (!credentials.empty())
+	{
+		delete_credential(credentials.back());
+	}
+}
+
+silvia_emulated_card* silvia_emulated_card::clone()
+{
+	silvia_emulated_card* rv = new silvia_emulated_card();
+	
+	rv->apdu_us = apdu_us;
+	rv->byte_us = byte_us;
+	rv->require_pin = require_pin;
+	rv->secret = secret;
+	rv->cred_pin = cred_pin;
+	rv->admin_pin = admin_pin;
+	rv->log_entries = log_entries;
+	
+	for (std::vector<credential*>::iterator i = credentials.begin(); i != credentials.end(); i++)
+	{
+		credential* c = new credential();
+		
+		c->id = (*i)->id;
+		c->pubkey = new silvia_pub_key((*i)->pubkey->get_n(), (*i)->pubkey->get_S(), (*i)->pubkey->get_Z(), (*i)->pubkey->get_R());
+		
+		for (std::vector<silvia_attribute*>::iterator j = (*i)->attributes.begin(); j != (*i)->attributes.end(); j++)
+		{
+			c->attributes.push_back(new silvia_integer_attribute((*j)->rep()));
+		}
+		
+		c->cred = new silvia_credential(secret, c->attributes, (*i)->cred->get_A(), (*i)->cred->get_e(), (*i)->cred->get_v());
+		c->prover = new silvia_prover(c->pubkey, c->cred);
+		
+		rv->credentials.push_back(c);
+	}
+	
+	return rv;
+}
+
+void silvia_emulated_card::set_latency(unsigned long apdu_us, unsigned long byte_us /* = 0 */)
+{
+	this->apdu_us = apdu_us;
+	this->byte_us = byte_us;
+}
+
+void silvia_emulated_card::set_require_pin(bool require_pin)
+{
+	this->require_pin = require_pin;
+}
+
+void silvia_emulated_card::remove()
+{
+	present = false;
+}
+
+size_t silvia_emulated_card::num_credentials()
+{
+	return credentials.size();
+}
+
+int silvia_emulated_card::get_type()
+{
+	return SILVIA_CHANNEL_EMULATOR;
+}
+
+bool silvia_emulated_card::status()
+{
+	return present;
+}
+
+bool silvia_emulated_card::transmit(const bytestring& APDU, bytestring& data, unsigned short& sw)
+{
+	if (!transmit(APDU, data))
+	{
+		return false;
+	}
+	
+	sw = data[data.size() - 2] << 8;
+	sw += data[data.size() - 1];
+	
+	data.resize(data.size() - 2);
+	
+	return true;
+}
+
+bool silvia_emulated_card::transmit(const bytestring& APDU, bytestring& data_sw)
+{
+	if (!present)
+	{
+		return false;
+	}
+	
+	data_sw = process(APDU);
+	
+	// Add the artificial latency of the exchange
+	unsigned long long latency_us = apdu_us + (unsigned long long) byte_us * (APDU.size() + data_sw.size());
+	
+	if (latency_us > 0)
+	{
+		struct timespec delay;
+		
+		delay.tv_sec = latency_us / 1000000;
+		delay.tv_nsec = (latency_us % 1000000) * 1000;
+		
+		while ((nanosleep(&delay, &delay) != 0) && (errno == EINTR));
+	}
+	
+	return true;
+}
+
+std::string silvia_emulated_card::get_reader_name()
+{
+	return "Emulator";
+}
+
+bytestring silvia_emulated_card::process(bytestring APDU)
+{
+	if (APDU.size() < 4)
+	{
+		return SW_WRONG_LENGTH;
+	}
+	
+	unsigned char INS = APDU[1];
+	unsigned char P1 = APDU[2];
+	unsigned char P2 = APDU[3];
+	bytestring data;
+	
+	if (APDU.size() > 5)
+	{
+		data = APDU.substr(5, APDU[4]);
+		
+		if (data.size() != APDU[4])
+		{
+			return SW_WRONG_LENGTH;
+		}
+	}
+	
+	if (INS == 0xA4)
+	{
+		return select(data);
+	}
+	
+	if (!selected)
+	{
+		return SW_INS_NOT_SUPPORTED;
+	}
+	
+	switch(INS)
+	{
+	case 0x20:
+		return (APDU[0] == 0x00) ? verify_pin(P2, data) : prove(INS, P1, data);
+	case 0x24:
+		return change_pin(P2, data);
+	case 0x10:
+	case 0x11:
+	case 0x12:
+	case 0x1A:
+	case 0x1B:
+	case 0x1C:
+	case 0x1D:
+	case 0x1F:
+		return issue(INS, P1, P2, data);
+	case 0x2A:
+	case 0x2B:
+	case 0x2C:
+		return prove(INS, P1, data);
+	case 0x30:
+	case 0x31:
+	case 0x32:
+	case 0x3A:
+	case 0x3B:
+		return admin(INS, P1, data);
+	default:
+		return SW_INS_NOT_SUPPORTED;
+	}
+}
+
+bytestring silvia_emulated_card::select(bytestring& data)
+{
+	// Selection resets the session
+	cred_pin_verified = false;
+	admin_pin_verified = false;
+	admin_selected = NULL;
+	
+	reset_issuance();
+	reset_proof();
+	
+	selected = (data == IRMA_AID);
+	
+	return selected ? IRMA_FCI SW_OK : SW_FILE_NOT_FOUND;
+}
+
+bytestring silvia_emulated_card::check_pin(pin& p, bytestring& value, bool& verified)
+{
+	verified = false;
+	
+	if (p.tries == 0)
+	{
+		return "63C0";
+	}
+	
+	if (value != p.value)
+	{
+		p.tries--;
+		
+		bytestring sw = "63C0";
+		sw[1] += p.tries;
+		
+		return sw;
+	}
+	
+	p.tries = IRMA_PIN_TRIES;
+	verified = true;
+	
+	return SW_OK;
+}
+
+bytestring silvia_emulated_card::verify_pin(unsigned char P2, bytestring& data)
+{
+	if (data.size() != IRMA_PIN_SIZE)
+	{
+		return SW_WRONG_LENGTH;
+	}
+	
+	switch(P2)
+	{
+	case 0x00:
+		return check_pin(cred_pin, data, cred_pin_verified);
+	case 0x01:
+		return check_pin(admin_pin, data, admin_pin_verified);
+	default:
+		return SW_WRONG_P1P2;
+	}
+}
+
+bytestring silvia_emulated_card::change_pin(unsigned char P2, bytestring& data)
+{
+	if (P2 == 0x01)
+	{
+		// Change the administrative PIN; the old PIN is checked first
+		if (data.size() != 2 * IRMA_PIN_SIZE)
+		{
+			return SW_WRONG_LENGTH;
+		}
+		
+		bytestring old_PIN = data.substr(0, IRMA_PIN_SIZE);
+		bytestring sw = check_pin(admin_pin, old_PIN, admin_pin_verified);
+		
+		if (sw == SW_OK)
+		{
+			admin_pin.value = data.substr(IRMA_PIN_SIZE);
+		}
+		
+		return sw;
+	}
+	else if (P2 == 0x00)
+	{
+		// Change the credential PIN; requires the administrative PIN
+		if (!admin_pin_verified)
+		{
+			return SW_SECURITY_STATUS_NOT_SATISFIED;
+		}
+		
+		if (data.size() != IRMA_PIN_SIZE)
+		{
+			return SW_WRONG_LENGTH;
+		}
+		
+		cred_pin.value = data;
+		cred_pin.tries = IRMA_PIN_TRIES;
+		
+		return SW_OK;
+	}
+	
+	return SW_WRONG_P1P2;
+}
+
+bytestring silvia_emulated_card::issue(unsigned char INS, unsigned char P1, unsigned char P2, bytestring& data)
+{
+	if (!cred_pin_verified)
+	{
+		return SW_SECURITY_STATUS_NOT_SATISFIED;
+	}
+	
+	switch(INS)
+	{
+	case 0x10:
+		{
+			// Start issuance: id, attribute count, flags, context, timestamp
+			size_t context_size = SYSPAR_BYTES(l_H);
+			
+			if (data.size() != 2 + 2 + 3 + context_size + 4)
+			{
+				return SW_WRONG_LENGTH;
+			}
+			
+			reset_issuance();
+			reset_proof();
+			
+			issue_id = get_short(data, 0);
+			issue_count = get_short(data, 2);
+			issue_context = data.view(7, context_size).mpz_val();
+			issue_timestamp = data.substr(7 + context_size);
+			
+			if (find_credential(issue_id) != NULL)
+			{
+				return SW_COMMAND_NOT_ALLOWED;
+			}
+			
+			if (credentials.size() >= IRMA_MAX_CREDENTIALS)
+			{
+				return SW_FILE_FULL;
+			}
+			
+			if (issue_count == 0)
+			{
+				return SW_WRONG_DATA;
+			}
+			
+			// R_0 is the base for the master secret
+			issue_R.resize(issue_count + 1);
+			issue_attributes.resize(issue_count, NULL);
+			
+			issue_step = ISSUE_STARTED;
+			
+			return SW_OK;
+		}
+	case 0x11:
+		// Set the public key: n, S, Z and R_i
+		if (issue_step != ISSUE_STARTED)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		switch(P1)
+		{
+		case 0x00:
+			issue_n = data.mpz_val();
+			break;
+		case 0x01:
+			issue_S = data.mpz_val();
+			break;
+		case 0x02:
+			issue_Z = data.mpz_val();
+			break;
+		case 0x03:
+			if (P2 >= issue_R.size())
+			{
+				return SW_WRONG_P1P2;
+			}
+			
+			issue_R[P2] = data.mpz_val();
+			break;
+		default:
+			return SW_WRONG_P1P2;
+		}
+		
+		return SW_OK;
+	case 0x12:
+		// Set attribute P1
+		if (issue_step != ISSUE_STARTED)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		if ((P1 == 0) || (P1 > issue_count))
+		{
+			return SW_WRONG_P1P2;
+		}
+		
+		if (issue_attributes[P1 - 1] != NULL)
+		{
+			delete issue_attributes[P1 - 1];
+		}
+		
+		issue_attributes[P1 - 1] = new silvia_integer_attribute(data.mpz_val());
+		
+		return SW_OK;
+	case 0x1A:
+		{
+			// Commit to the master secret; returns U
+			if (issue_step != ISSUE_STARTED)
+			{
+				return SW_CONDITIONS_NOT_SATISFIED;
+			}
+			
+			bool complete = (issue_n != 0) && (issue_S != 0) && (issue_Z != 0);
+			
+			for (std::vector<mpz_class>::iterator i = issue_R.begin(); i != issue_R.end(); i++)
+			{
+				if (*i == 0) complete = false;
+			}
+			
+			for (std::vector<silvia_attribute*>::iterator i = issue_attributes.begin(); i != issue_attributes.end(); i++)
+			{
+				if (*i == NULL) complete = false;
+			}
+			
+			if (!complete)
+			{
+				return SW_CONDITIONS_NOT_SATISFIED;
+			}
+			
+			mpz_class v_prime;
+			
+			issue_pubkey = new silvia_pub_key(issue_n, issue_S, issue_Z, issue_R);
+			credgen = new silvia_credential_generator(issue_pubkey);
+			
+			credgen->set_attributes(issue_attributes);
+			credgen->set_secret(secret);
+			credgen->compute_commitment(issue_U, v_prime);
+			credgen->prove_commitment(data.mpz_val(), issue_context, issue_c, issue_v_prime_hat, issue_s_hat);
+			
+			issue_step = ISSUE_COMMITTED;
+			
+			return bytestring(issue_U, SYSPAR_BYTES(l_n)) + SW_OK;
+		}
+	case 0x1B:
+		// Proof of the commitment: c, v'^, s^
+		if (issue_step != ISSUE_COMMITTED)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		switch(P1)
+		{
+		case 0x01:
+			return bytestring(issue_c, SYSPAR_BYTES(l_H)) + SW_OK;
+		case 0x02:
+			return bytestring(issue_v_prime_hat) + SW_OK;
+		case 0x03:
+			return bytestring(issue_s_hat) + SW_OK;
+		default:
+			return SW_WRONG_P1P2;
+		}
+	case 0x1C:
+		// Card nonce n2
+		if (issue_step != ISSUE_COMMITTED)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		issue_step = ISSUE_SIGNING;
+		
+		return bytestring(credgen->get_prover_nonce(), SYSPAR_BYTES(l_statzk)) + SW_OK;
+	case 0x1D:
+		// Signature values A, e, v'' and proof values c, e^
+		if (issue_step != ISSUE_SIGNING)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		switch(P1)
+		{
+		case 0x01:
+			sig_A = data.mpz_val();
+			break;
+		case 0x02:
+			sig_e = data.mpz_val();
+			break;
+		case 0x03:
+			sig_v_prime_prime = data.mpz_val();
+			break;
+		case 0x04:
+			sig_c = data.mpz_val();
+			break;
+		case 0x05:
+			sig_e_hat = data.mpz_val();
+			break;
+		default:
+			return SW_WRONG_P1P2;
+		}
+		
+		return SW_OK;
+	case 0x1F:
+		{
+			// Verify the signature and store the credential
+			if (issue_step != ISSUE_SIGNING)
+			{
+				return SW_CONDITIONS_NOT_SATISFIED;
+			}
+			
+			if (!credgen->verify_signature(issue_context, sig_A, sig_e, sig_c, sig_e_hat))
+			{
+				reset_issuance();
+				
+				return SW_WRONG_DATA;
+			}
+			
+			credgen->compute_credential(sig_A, sig_e, sig_v_prime_prime);
+			
+			if (!credgen->verify_credential())
+			{
+				reset_issuance();
+				
+				return SW_WRONG_DATA;
+			}
+			
+			credential* c = new credential();
+			
+			c->id = issue_id;
+			c->pubkey = issue_pubkey;
+			c->attributes = issue_attributes;
+			c->cred = credgen->get_credential();
+			c->prover = new silvia_prover(c->pubkey, c->cred);
+			
+			credentials.push_back(c);
+			
+			// The credential now owns the key and the attributes
+			issue_pubkey = NULL;
+			issue_attributes.clear();
+			
+			log(IRMA_ACTION_ISSUE, issue_id, 0, issue_timestamp);
+			
+			reset_issuance();
+			
+			return SW_OK;
+		}
+	}
+	
+	return SW_INS_NOT_SUPPORTED;
+}
+
+bytestring silvia_emulated_card::prove(unsigned char INS, unsigned char P1, bytestring& data)
+{
+	if (require_pin && !cred_pin_verified)
+	{
+		return SW_SECURITY_STATUS_NOT_SATISFIED;
+	}
+	
+	switch(INS)
+	{
+	case 0x20:
+		{
+			// Start proof: id, disclosure selection, context, timestamp
+			size_t context_size = SYSPAR_BYTES(l_H);
+			
+			if (data.size() != 2 + 2 + context_size + 4)
+			{
+				return SW_WRONG_LENGTH;
+			}
+			
+			reset_issuance();
+			reset_proof();
+			
+			proof_cred = find_credential(get_short(data, 0));
+			
+			if (proof_cred == NULL)
+			{
+				return SW_REFERENCED_DATA_NOT_FOUND;
+			}
+			
+			// Bit 0 of the selection refers to the master secret,
+			// which is never disclosed
+			unsigned short selection = get_short(data, 2);
+			
+			for (size_t i = 0; i < proof_cred->attributes.size(); i++)
+			{
+				proof_D.push_back(((selection >> (i + 1)) & 0x01) == 0x01);
+			}
+			
+			proof_context = data.view(4, context_size).mpz_val();
+			
+			bytestring timestamp = data.substr(4 + context_size);
+			
+			log(IRMA_ACTION_PROVE, proof_cred->id, selection, timestamp);
+			
+			return SW_OK;
+		}
+	case 0x2A:
+		// Verifier nonce n1; returns c
+		if (proof_cred == NULL)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		proof_a_i_hat.clear();
+		proof_a_i.clear();
+		
+		proof_cred->prover->prove(proof_D, data.mpz_val(), proof_context, proof_c, proof_A_prime, proof_e_hat, proof_v_prime_hat, proof_a_i_hat, proof_a_i);
+		
+		proof_ready = true;
+		
+		return bytestring(proof_c, SYSPAR_BYTES(l_H)) + SW_OK;
+	case 0x2B:
+		// Signature values A', e^, v'^
+		if (!proof_ready)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		switch(P1)
+		{
+		case 0x01:
+			return bytestring(proof_A_prime, SYSPAR_BYTES(l_n)) + SW_OK;
+		case 0x02:
+			return bytestring(proof_e_hat) + SW_OK;
+		case 0x03:
+			return bytestring(proof_v_prime_hat) + SW_OK;
+		default:
+			return SW_WRONG_P1P2;
+		}
+	case 0x2C:
+		{
+			// Master secret (0) or attribute P1: the value if it
+			// is disclosed, the response a_i^ otherwise
+			if (!proof_ready)
+			{
+				return SW_CONDITIONS_NOT_SATISFIED;
+			}
+			
+			if (P1 > proof_D.size())
+			{
+				return SW_WRONG_P1P2;
+			}
+			
+			if (P1 == 0)
+			{
+				return bytestring(proof_a_i_hat[0]) + SW_OK;
+			}
+			
+			if (proof_D[P1 - 1])
+			{
+				return proof_cred->attributes[P1 - 1]->bs_rep() + SW_OK;
+			}
+			
+			size_t hidden_index = 1;
+			
+			for (size_t i = 0; i < (size_t) (P1 - 1); i++)
+			{
+				if (!proof_D[i]) hidden_index++;
+			}
+			
+			return bytestring(proof_a_i_hat[hidden_index]) + SW_OK;
+		}
+	}
+	
+	return SW_INS_NOT_SUPPORTED;
+}
+
+bytestring silvia_emulated_card::admin(unsigned char INS, unsigned char P1, bytestring& data)
+{
+	if (!admin_pin_verified)
+	{
+		return SW_SECURITY_STATUS_NOT_SATISFIED;
+	}
+	
+	switch(INS)
+	{
+	case 0x30:
+		// Select credential
+		if (data.size() != 2)
+		{
+			return SW_WRONG_LENGTH;
+		}
+		
+		admin_selected = find_credential(get_short(data, 0));
+		
+		return (admin_selected != NULL) ? SW_OK : SW_REFERENCED_DATA_NOT_FOUND;
+	case 0x31:
+		// Remove the selected credential
+		if (admin_selected == NULL)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		if (data.size() != 4)
+		{
+			return SW_WRONG_LENGTH;
+		}
+		
+		log(IRMA_ACTION_REMOVE, admin_selected->id, 0, data);
+		
+		if (proof_cred == admin_selected)
+		{
+			reset_proof();
+		}
+		
+		delete_credential(admin_selected);
+		admin_selected = NULL;
+		
+		return SW_OK;
+	case 0x32:
+		// Read attribute P1 of the selected credential
+		if (admin_selected == NULL)
+		{
+			return SW_CONDITIONS_NOT_SATISFIED;
+		}
+		
+		if ((P1 == 0) || (P1 > admin_selected->attributes.size()))
+		{
+			return SW_WRONG_P1P2;
+		}
+		
+		return admin_selected->attributes[P1 - 1]->bs_rep() + SW_OK;
+	case 0x3A:
+		{
+			// List the credential slots
+			bytestring rv;
+			
+			for (size_t i = 0; i < IRMA_MAX_CREDENTIALS; i++)
+			{
+				unsigned short id = (i < credentials.size()) ? credentials[i]->id : 0;
+				
+				rv += (unsigned char) (id >> 8);
+				rv += (unsigned char) (id & 0xff);
+			}
+			
+			return rv + SW_OK;
+		}
+	case 0x3B:
+		{
+			// Read the log, starting at entry P1 (most recent first)
+			if (P1 >= IRMA_LOG_SIZE)
+			{
+				return SW_WRONG_P1P2;
+			}
+			
+			bytestring rv;
+			
+			for (size_t i = P1; (i < (size_t) (P1 + IRMA_LOG_ENTRIES_PER_APDU)) && (i < IRMA_LOG_SIZE); i++)
+			{
+				if (i < log_entries.size())
+				{
+					rv += log_entries[i];
+				}
+				else
+				{
+					bytestring empty;
+					empty.wipe(IRMA_LOG_ENTRY_SIZE);
+					
+					rv += empty;
+				}
+			}
+			
+			return rv + SW_OK;
+		}
+	}
+	
+	return SW_INS_NOT_SUPPORTED;
+}
+
+silvia_emulated_card::credential* silvia_emulated_card::find_credential(unsigned short id)
+{
+	for (std::vector<credential*>::iterator i = credentials.begin(); i != credentials.end(); i++)
+	{
+		if ((*i)->id == id)
+		{
+			return *i;
+		}
+	}
+	
+	return NULL;
+}
+
+void silvia_emulated_card::delete_credential(credential* c)
+{
+	for (std::vector<credential*>::iterator i = credentials.begin(); i != credentials.end(); i++)
+	{
+		if (*i == c)
+		{
+			credentials.erase(i);
+			
+			break;
+		}
+	}
+	
+	delete c->prover;
+	delete c->cred;
+	
+	for (std::vector<silvia_attribute*>::iterator i = c->attributes.begin(); i != c->attributes.end(); i++)
+	{
+		delete *i;
+	}
+	
+	delete c->pubkey;
+	delete c;
+}
+
+void silvia_emulated_card::reset_issuance()
+{
+	delete credgen;
+	credgen = NULL;
+	
+	delete issue_pubkey;
+	issue_pubkey = NULL;
+	
+	for (std::vector<silvia_attribute*>::iterator i = issue_attributes.begin(); i != issue_attributes.end(); i++)
+	{
+		delete *i;
+	}
+	
+	issue_attributes.clear();
+	issue_R.clear();
+	
+	issue_n = issue_S = issue_Z = 0;
+	sig_A = sig_e = sig_v_prime_prime = sig_c = sig_e_hat = 0;
+	
+	issue_step = ISSUE_NONE;
+}
+
+void silvia_emulated_card::reset_proof()
+{
+	proof_cred = NULL;
+	proof_ready = false;
+	proof_D.clear();
+	proof_a_i_hat.clear();
+	proof_a_i.clear();
+}
+
+void silvia_emulated_card::log(unsigned char action, unsigned short id, unsigned short selection, bytestring& timestamp)
+{
+	bytestring entry;
+	
+	// Timestamp and terminal
+	entry += timestamp.substr(0, 4);
+	entry += "00000000";
+	
+	entry += action;
+	entry += (unsigned char) (id >> 8);
+	entry += (unsigned char) (id & 0xff);
+	entry += (unsigned char) (selection >> 8);
+	entry += (unsigned char) (selection & 0xff);
+	
+	while (entry.size() < IRMA_LOG_ENTRY_SIZE) entry += (unsigned char) 0x00;
+	
+	log_entries.push_front(entry);
+	
+	if (log_entries.size() > IRMA_LOG_SIZE)
+	{
+		log_entries.pop_back();
+	}
+}
+
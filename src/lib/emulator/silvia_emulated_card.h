@@ -0,0 +1,234 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_emulated_card.h
+
+ Software emulation of an IRMA card
+ *****************************************************************************/
+
+#ifndef _SILVIA_EMULATED_CARD_H
+#define _SILVIA_EMULATED_CARD_H
+
+#include "silvia_card_channel.h"
+#include "silvia_types.h"
+#include "silvia_prover.h"
+#include "silvia_prover_credgen.h"
+#include <gmpxx.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+#define SILVIA_CHANNEL_EMULATOR			0x05	// In-process IRMA card emulator
+
+/**
+ * Emulated IRMA card; implements the APDU set of the IRMA card
+ * application (version 0.8) in software. Issuance, proofs, PIN
+ * verification and the administrative commands are supported. The
+ * card can add artificial latency to every APDU exchange to mimic
+ * a physical card in load tests. An emulated card must only be used
+ * by one thread at a time; use separate cards for concurrent sessions.
+ */
+class silvia_emulated_card : public silvia_card_channel
+{
+public:
+	/**
+	 * Constructor
+	 * @param cred_PIN the credential PIN (at most 8 characters)
+	 * @param admin_PIN the administrative PIN (at most 8 characters)
+	 */
+	silvia_emulated_card(const std::string& cred_PIN = "0000", const std::string& admin_PIN = "000000");
+
+	/**
+	 * Destructor
+	 */
+	virtual ~silvia_emulated_card();
+
+	/**
+	 * Create a card with the same PINs, master secret, credentials and
+	 * settings as this card; use this to prepare many cards for a load
+	 * test after issuing the credentials once
+	 * @return a new card (the caller takes ownership)
+	 */
+	silvia_emulated_card* clone();
+
+	/**
+	 * Set the artificial latency of every APDU exchange
+	 * @param apdu_us the latency per APDU in microseconds
+	 * @param byte_us the additional latency per transferred byte in microseconds
+	 */
+	void set_latency(unsigned long apdu_us, unsigned long byte_us = 0);
+
+	/**
+	 * Require credential PIN verification before proving
+	 * @param require_pin true to require the PIN (issuance always requires it)
+	 */
+	void set_require_pin(bool require_pin);
+
+	/**
+	 * Emulate removing the card from the reader
+	 */
+	void remove();
+
+	/**
+	 * Get the number of credentials on the card
+	 * @return the number of credentials on the card
+	 */
+	size_t num_credentials();
+
+	/**
+	 * Process an APDU without artificial latency
+	 * @param APDU the APDU
+	 * @return the response data including the status word
+	 */
+	bytestring process(bytestring APDU);
+
+	/**
+	 * Get the channel type
+	 * @return the channel type
+	 */
+	virtual int get_type();
+
+	/**
+	 * Get the connection status
+	 * @return true if the card has not been removed
+	 */
+	virtual bool status();
+
+	/**
+	 * Transmit an APDU and receive return data
+	 * @param apdu The APDU to transmit
+	 * @param data The return data
+	 * @param sw The return status word
+	 * @return true if the APDU exchange completed successfully
+	 */
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw);
+
+	/**
+	 * Transmit an APDU and receive return data
+	 * @param apdu The APDU to transmit
+	 * @param data_sw The return data including the status word
+	 * @return true if the APDU exchange completed successfully
+	 */
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw);
+
+	/**
+	 * Get the card reader name in which the card resides
+	 * @return the card reader name of the reader containing the card
+	 */
+	virtual std::string get_reader_name();
+
+private:
+	// Copying is not allowed
+	silvia_emulated_card(const silvia_emulated_card&);
+	silvia_emulated_card& operator=(const silvia_emulated_card&);
+
+	// A credential stored on the card
+	struct credential
+	{
+		unsigned short id;
+		silvia_pub_key* pubkey;
+		std::vector<silvia_attribute*> attributes;
+		silvia_credential* cred;
+		silvia_prover* prover;
+	};
+
+	// A PIN and its remaining tries
+	struct pin
+	{
+		bytestring value;
+		int tries;
+	};
+
+	// Command handlers
+	bytestring select(bytestring& data);
+	bytestring verify_pin(unsigned char P2, bytestring& data);
+	bytestring change_pin(unsigned char P2, bytestring& data);
+	bytestring issue(unsigned char INS, unsigned char P1, unsigned char P2, bytestring& data);
+	bytestring prove(unsigned char INS, unsigned char P1, bytestring& data);
+	bytestring admin(unsigned char INS, unsigned char P1, bytestring& data);
+
+	// Check a PIN and update the remaining tries
+	bytestring check_pin(pin& p, bytestring& value, bool& verified);
+
+	// Credential storage
+	credential* find_credential(unsigned short id);
+	void delete_credential(credential* c);
+
+	// Abort a running issuance or proof
+	void reset_issuance();
+	void reset_proof();
+
+	// Add an entry to the log
+	void log(unsigned char action, unsigned short id, unsigned short selection, bytestring& timestamp);
+
+	// Settings
+	unsigned long apdu_us;
+	unsigned long byte_us;
+	bool require_pin;
+	bool present;
+
+	// Card state
+	silvia_integer_attribute secret;
+	pin cred_pin;
+	pin admin_pin;
+	std::vector<credential*> credentials;
+	std::deque<bytestring> log_entries;
+
+	// Session state (reset on application selection)
+	bool selected;
+	bool cred_pin_verified;
+	bool admin_pin_verified;
+	credential* admin_selected;
+
+	// Issuance state
+	int issue_step;
+	unsigned short issue_id;
+	unsigned short issue_count;
+	bytestring issue_timestamp;
+	mpz_class issue_context;
+	mpz_class issue_n, issue_S, issue_Z;
+	std::vector<mpz_class> issue_R;
+	std::vector<silvia_attribute*> issue_attributes;
+	silvia_pub_key* issue_pubkey;
+	silvia_credential_generator* credgen;
+	mpz_class issue_U, issue_c, issue_v_prime_hat, issue_s_hat;
+	mpz_class sig_A, sig_e, sig_v_prime_prime, sig_c, sig_e_hat;
+
+	// Proof state
+	credential* proof_cred;
+	std::vector<bool> proof_D;
+	mpz_class proof_context;
+	bool proof_ready;
+	mpz_class proof_c, proof_A_prime, proof_e_hat, proof_v_prime_hat;
+	std::vector<mpz_class> proof_a_i_hat;
+	std::vector<silvia_attribute*> proof_a_i;
+};
+
+#endif // !_SILVIA_EMULATED_CARD_H
+
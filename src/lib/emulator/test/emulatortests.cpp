@@ -0,0 +1,425 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ emulatortests.cpp
+
+ Tests the IRMA card emulator
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <gmpxx.h>
+#include <time.h>
+#include "emulatortests.h"
+#include "testvectors.h"
+#include "silvia_emulated_card.h"
+#include "silvia_irma_issuer.h"
+#include "silvia_irma_batch_issuer.h"
+#include "silvia_prime_pool.h"
+#include "silvia_thread_pool.h"
+#include "silvia_irma_verifier.h"
+#include "silvia_irma_manager.h"
+#include "silvia_types.h"
+#include "silvia_parameters.h"
+#include "silvia_timer.h"
+#include <pthread.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(emulator_tests);
+
+void emulator_tests::setUp()
+{
+	set_test_parameters();
+}
+
+void emulator_tests::tearDown()
+{
+	silvia_system_parameters::i()->reset();
+}
+
+// Exchange every command with the card, regardless of the status words
+static std::vector<bytestring> exchange_apdus(silvia_card_channel* card, std::vector<bytestring> commands)
+{
+	std::vector<bytestring> results;
+	
+	for (std::vector<bytestring>::iterator i = commands.begin(); i != commands.end(); i++)
+	{
+		bytestring data_sw;
+		
+		CPPUNIT_ASSERT(card->transmit(*i, data_sw));
+		
+		results.push_back(data_sw);
+	}
+	
+	return results;
+}
+
+static bytestring status_word(const bytestring& data_sw)
+{
+	return data_sw.substr(data_sw.size() - 2);
+}
+
+// Issue the test credential to the card
+static void issue(silvia_emulated_card* card, silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec)
+{
+	silvia_irma_issuer issuer(pubkey, privkey, ispec);
+	std::vector<bytestring> results;
+	
+	results = exchange_apdus(card, issuer.get_select_commands());
+	
+	CPPUNIT_ASSERT(issuer.submit_select_data(results));
+	CPPUNIT_ASSERT(card->process("00200000083030303000000000") == "9000");
+	
+	results = exchange_apdus(card, issuer.get_issue_commands_round_1());
+	
+	CPPUNIT_ASSERT(issuer.submit_issue_results_round_1(results));
+	
+	results = exchange_apdus(card, issuer.get_issue_commands_round_2());
+	
+	CPPUNIT_ASSERT(issuer.submit_issue_results_round_2(results));
+}
+
+// Verify the test credential on the card
+static bool verify(silvia_card_channel* card, silvia_pub_key* pubkey, std::vector<std::pair<std::string, bytestring> >& revealed)
+{
+	std::vector<std::string> names;
+	std::vector<bool> D;
+	
+	names.push_back("metadata");
+	names.push_back("over12");
+	names.push_back("over16");
+	names.push_back("over18");
+	
+	D.push_back(true);
+	D.push_back(false);
+	D.push_back(true);
+	D.push_back(false);
+	
+	silvia_verifier_specification vspec("test", "test", 1, 0xa, names, D);
+	silvia_irma_verifier verifier(pubkey, &vspec);
+	
+	std::vector<bytestring> results = exchange_apdus(card, verifier.get_select_commands());
+	
+	CPPUNIT_ASSERT(status_word(results[0]) == "6A82");
+	CPPUNIT_ASSERT(status_word(results[1]) == "9000");
+	CPPUNIT_ASSERT(verifier.submit_select_data(results));
+	
+	results = exchange_apdus(card, verifier.get_proof_commands());
+	
+	return verifier.submit_and_verify(results, revealed);
+}
+
+void emulator_tests::test_issue_and_verify()
+{
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_priv_key* privkey = test_privkey();
+	silvia_issue_specification* ispec = test_ispec();
+	
+	silvia_emulated_card card;
+	
+	CPPUNIT_ASSERT(card.get_type() == SILVIA_CHANNEL_EMULATOR);
+	CPPUNIT_ASSERT(card.num_credentials() == 0);
+	
+	issue(&card, pubkey, privkey, ispec);
+	
+	CPPUNIT_ASSERT(card.num_credentials() == 1);
+	
+	// Verify the credential on the card and on a clone of the card
+	silvia_emulated_card* clone = card.clone();
+	silvia_card_channel* cards[2] = { &card, clone };
+	
+	for (int i = 0; i < 2; i++)
+	{
+		std::vector<std::pair<std::string, bytestring> > revealed;
+		
+		CPPUNIT_ASSERT(verify(cards[i], pubkey, revealed));
+		
+		CPPUNIT_ASSERT(revealed.size() == 2);
+		CPPUNIT_ASSERT(revealed[0].first == "metadata");
+		CPPUNIT_ASSERT(revealed[0].second.size() == 32);
+		CPPUNIT_ASSERT(revealed[1].first == "over16");
+		CPPUNIT_ASSERT(revealed[1].second == ispec->get_attributes()[1]->bs_rep());
+	}
+	
+	delete clone;
+	
+	// A second issuance of the same credential is refused
+	CPPUNIT_ASSERT(card.process("00A4040009F849524D416361726400").size() > 2);
+	CPPUNIT_ASSERT(card.process("00200000083030303000000000") == "9000");
+	
+	silvia_irma_issuer issuer(pubkey, privkey, ispec);
+	
+	issuer.get_select_commands();
+	
+	std::vector<bytestring> select_results;
+	select_results.push_back("9000");
+	
+	CPPUNIT_ASSERT(issuer.submit_select_data(select_results));
+	CPPUNIT_ASSERT(card.process(issuer.get_issue_commands_round_1()[0]) == "6986");
+	
+	issuer.abort();
+	
+	// Proving requires the PIN if this is configured
+	card.set_require_pin(true);
+	
+	std::vector<std::pair<std::string, bytestring> > revealed;
+	
+	CPPUNIT_ASSERT(!verify(&card, pubkey, revealed));
+	
+	delete ispec;
+	delete privkey;
+	delete pubkey;
+}
+
+void emulator_tests::test_pin()
+{
+	silvia_emulated_card card("1234");
+	
+	// Commands require selection of the application
+	CPPUNIT_ASSERT(card.process("00200000083132333400000000") == "6D00");
+	CPPUNIT_ASSERT(card.process("00A404000849524D416361726400") == "6A82");
+	CPPUNIT_ASSERT(status_word(card.process("00A4040009F849524D416361726400")) == "9000");
+	
+	// Issuance requires the PIN
+	CPPUNIT_ASSERT(card.process("8010000000") == "6982");
+	
+	// Wrong PINs count down the remaining tries
+	CPPUNIT_ASSERT(card.process("00200000083030303000000000") == "63C2");
+	CPPUNIT_ASSERT(card.process("00200000083132333400000000") == "9000");
+	CPPUNIT_ASSERT(card.process("00200000083030303000000000") == "63C2");
+	CPPUNIT_ASSERT(card.process("00200000083030303000000000") == "63C1");
+	CPPUNIT_ASSERT(card.process("00200000083030303000000000") == "63C0");
+	
+	// A blocked PIN stays blocked
+	CPPUNIT_ASSERT(card.process("00200000083132333400000000") == "63C0");
+	
+	// The admin PIN can unblock and change the credential PIN
+	CPPUNIT_ASSERT(card.process("00240000083536373800000000") == "6982");
+	CPPUNIT_ASSERT(card.process("00200001083030303030300000") == "9000");
+	CPPUNIT_ASSERT(card.process("00240000083536373800000000") == "9000");
+	CPPUNIT_ASSERT(card.process("00200000083536373800000000") == "9000");
+	
+	// Change the admin PIN
+	CPPUNIT_ASSERT(card.process("002400011030303030303000003131313131310000") == "9000");
+	CPPUNIT_ASSERT(card.process("00200001083030303030300000") == "63C2");
+	CPPUNIT_ASSERT(card.process("00200001083131313131310000") == "9000");
+	
+	// Removing the card breaks the connection
+	bytestring data_sw;
+	
+	CPPUNIT_ASSERT(card.status());
+	
+	card.remove();
+	
+	CPPUNIT_ASSERT(!card.status());
+	CPPUNIT_ASSERT(!card.transmit("00A4040009F849524D416361726400", data_sw));
+}
+
+void emulator_tests::test_admin()
+{
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_priv_key* privkey = test_privkey();
+	silvia_issue_specification* ispec = test_ispec();
+	
+	silvia_emulated_card card;
+	
+	issue(&card, pubkey, privkey, ispec);
+	
+	silvia_irma_manager manager;
+	std::vector<bytestring> results;
+	
+	// Administrative commands require the admin PIN
+	CPPUNIT_ASSERT(card.process("803A000000") == "6982");
+	
+	// List the credentials
+	results = exchange_apdus(&card, manager.list_credentials_commands("000000"));
+	
+	CPPUNIT_ASSERT(results.size() == 3);
+	CPPUNIT_ASSERT(results[2].size() == 2 * 16 + 2);
+	CPPUNIT_ASSERT(results[2].substr(0, 4) == "000A0000");
+	
+	// Read the attributes; reading past the last attribute fails
+	results = exchange_apdus(&card, manager.read_credential_commands("10", "000000"));
+	
+	CPPUNIT_ASSERT(results.size() == 8);
+	CPPUNIT_ASSERT(results[2] == "9000");
+	CPPUNIT_ASSERT(results[4] == ispec->get_attributes()[0]->bs_rep() + "9000");
+	CPPUNIT_ASSERT(results[6] == ispec->get_attributes()[2]->bs_rep() + "9000");
+	CPPUNIT_ASSERT(results[7] == "6B00");
+	
+	// Read the log
+	results = exchange_apdus(&card, manager.get_log_commands("000000"));
+	
+	CPPUNIT_ASSERT(results.size() == 4);
+	CPPUNIT_ASSERT(results[2].size() == 15 * 16 + 2);
+	CPPUNIT_ASSERT(results[2][8] == 0x01);
+	CPPUNIT_ASSERT(results[2].substr(9, 2) == "000A");
+	CPPUNIT_ASSERT(results[3].size() == 15 * 16 + 2);
+	
+	// Delete the credential
+	results = exchange_apdus(&card, manager.del_cred_commands("10", "000000"));
+	
+	CPPUNIT_ASSERT(results.size() == 4);
+	CPPUNIT_ASSERT(results[3] == "9000");
+	CPPUNIT_ASSERT(card.num_credentials() == 0);
+	
+	results = exchange_apdus(&card, manager.get_log_commands("000000"));
+	
+	CPPUNIT_ASSERT(results[2][8] == 0x03);
+	CPPUNIT_ASSERT(results[2][16 + 8] == 0x01);
+	
+	delete ispec;
+	delete privkey;
+	delete pubkey;
+}
+
+void emulator_tests::test_latency()
+{
+	silvia_emulated_card card;
+	silvia_timer timer;
+	std::vector<bytestring> commands;
+	std::vector<bytestring> results;
+	
+	commands.push_back("00A4040009F849524D416361726400");
+	commands.push_back("00200000083030303000000000");
+	
+	card.set_latency(5000, 100);
+	
+	timer.mark();
+	
+	CPPUNIT_ASSERT(card.transmit_batch(commands, results));
+	
+	// 2 APDUs of 5ms each plus 42 bytes of commands and responses of 100us each
+	CPPUNIT_ASSERT(results.size() == 2);
+	CPPUNIT_ASSERT(timer.elapsed() >= 14200000ULL);
+}
+
+
+// A card that is issued to from its own thread
+struct batch_card
+{
+	silvia_irma_batch_issuer* batch;
+	silvia_emulated_card* card;
+	std::string PIN;
+	size_t issued;
+	std::string error;
+	bool ok;
+	pthread_t thread;
+};
+
+static void* batch_card_main(void* arg)
+{
+	batch_card* bc = (batch_card*) arg;
+	
+	bc->ok = bc->batch->issue(bc->card, bc->PIN, bc->issued, bc->error);
+	
+	return NULL;
+}
+
+void emulator_tests::test_batch_issue()
+{
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_priv_key* privkey = test_privkey();
+	silvia_issue_specification* ispec = test_ispec();
+	
+	std::vector<silvia_attribute*> attributes;
+	
+	attributes.push_back(new silvia_string_attribute("no"));
+	attributes.push_back(new silvia_string_attribute("yes"));
+	
+	silvia_issue_specification* ispec2 = new silvia_issue_specification("ageHigher", "MijnOverheid", 0xb, time(NULL) / 86400 + 365, attributes);
+	
+	silvia_thread_pool pool(2);
+	silvia_prime_pool prime_pool(8, 2);
+	silvia_irma_batch_issuer batch(&pool, &prime_pool);
+	
+	batch.add_credential(pubkey, privkey, ispec);
+	batch.add_credential(pubkey, privkey, ispec2);
+	
+	CPPUNIT_ASSERT(batch.size() == 2);
+	
+	// Issue to several cards at the same time; one of them gets the wrong PIN
+	const size_t num_cards = 4;
+	batch_card cards[num_cards];
+	
+	for (size_t i = 0; i < num_cards; i++)
+	{
+		cards[i].batch = &batch;
+		cards[i].card = new silvia_emulated_card();
+		cards[i].card->set_latency(1000);
+		cards[i].PIN = (i == 2) ? "1234" : "0000";
+		cards[i].issued = 42;
+		cards[i].ok = false;
+		
+		pthread_create(&cards[i].thread, NULL, batch_card_main, &cards[i]);
+	}
+	
+	for (size_t i = 0; i < num_cards; i++)
+	{
+		pthread_join(cards[i].thread, NULL);
+		
+		if (i == 2)
+		{
+			CPPUNIT_ASSERT(!cards[i].ok);
+			CPPUNIT_ASSERT(cards[i].issued == 0);
+			CPPUNIT_ASSERT(cards[i].error == "incorrect-pin 2");
+			CPPUNIT_ASSERT(cards[i].card->num_credentials() == 0);
+		}
+		else
+		{
+			CPPUNIT_ASSERT(cards[i].ok);
+			CPPUNIT_ASSERT(cards[i].issued == 2);
+			CPPUNIT_ASSERT(cards[i].card->num_credentials() == 2);
+		}
+	}
+	
+	// The issued credential can be verified
+	std::vector<std::pair<std::string, bytestring> > revealed;
+	
+	CPPUNIT_ASSERT(verify(cards[0].card, pubkey, revealed));
+	CPPUNIT_ASSERT(revealed[1].second == ispec->get_attributes()[1]->bs_rep());
+	
+	// A card that already has the credentials is refused
+	size_t issued = 0;
+	std::string error;
+	
+	CPPUNIT_ASSERT(!batch.issue(cards[0].card, "0000", issued, error));
+	CPPUNIT_ASSERT(issued == 0);
+	CPPUNIT_ASSERT(error == "card-error 0x6986");
+	
+	for (size_t i = 0; i < num_cards; i++)
+	{
+		delete cards[i].card;
+	}
+	
+	delete ispec2;
+	delete ispec;
+	delete privkey;
+	delete pubkey;
+}
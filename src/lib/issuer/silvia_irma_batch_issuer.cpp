@@ -0,0 +1,375 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_irma_batch_issuer.cpp
+
+ Issues a list of credentials to IRMA cards; many cards can be served
+ concurrently
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_irma_batch_issuer.h"
+#include "silvia_irma_issuer.h"
+#include "silvia_apdu.h"
+#include "silvia_parameters.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <pthread.h>
+
+/**
+ * Job that either prepares the first round of issuance or processes
+ * the results of the first round and computes the second round
+ */
+class silvia_irma_batch_issuer::round_job : public silvia_job
+{
+public:
+	round_job(silvia_irma_issuer* issuer, std::vector<bytestring>* results = NULL)
+	{
+		this->issuer = issuer;
+		this->results = results;
+		
+		ok = false;
+		done = false;
+		
+		pthread_mutex_init(&done_lock, NULL);
+		pthread_cond_init(&done_cond, NULL);
+	}
+	
+	~round_job()
+	{
+		pthread_cond_destroy(&done_cond);
+		pthread_mutex_destroy(&done_lock);
+	}
+	
+	virtual void run()
+	{
+		bool rv = true;
+		
+		if (results == NULL)
+		{
+			commands = issuer->get_issue_commands_round_1();
+		}
+		else if ((rv = issuer->submit_issue_results_round_1(*results)))
+		{
+			commands = issuer->get_issue_commands_round_2();
+		}
+		
+		pthread_mutex_lock(&done_lock);
+		
+		ok = rv;
+		done = true;
+		
+		pthread_cond_signal(&done_cond);
+		pthread_mutex_unlock(&done_lock);
+	}
+	
+	// Wait for the job to finish and return the result
+	bool wait()
+	{
+		pthread_mutex_lock(&done_lock);
+		
+		while (!done)
+		{
+			pthread_cond_wait(&done_cond, &done_lock);
+		}
+		
+		bool rv = ok;
+		
+		pthread_mutex_unlock(&done_lock);
+		
+		return rv;
+	}
+	
+	// The commands of the round
+	std::vector<bytestring> commands;
+	
+private:
+	silvia_irma_issuer* issuer;
+	std::vector<bytestring>* results;
+	bool ok;
+	bool done;
+	pthread_mutex_t done_lock;
+	pthread_cond_t done_cond;
+};
+
+silvia_irma_batch_issuer::silvia_irma_batch_issuer(silvia_thread_pool* pool /* = NULL */, silvia_prime_pool* prime_pool /* = NULL */)
+{
+	if (pool == NULL)
+	{
+		this->pool = new silvia_thread_pool();
+		own_pool = true;
+	}
+	else
+	{
+		this->pool = pool;
+		own_pool = false;
+	}
+	
+	this->prime_pool = prime_pool;
+}
+
+silvia_irma_batch_issuer::~silvia_irma_batch_issuer()
+{
+	if (own_pool)
+	{
+		delete pool;
+	}
+}
+
+void silvia_irma_batch_issuer::add_credential(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec)
+{
+	// Build the tables of the public key now; after this, the
+	// concurrent issuance sessions only read from the public key
+	pubkey->precompute(*silvia_system_parameters::i());
+	
+	credential cred;
+	
+	cred.pubkey = pubkey;
+	cred.privkey = privkey;
+	cred.ispec = ispec;
+	
+	credentials.push_back(cred);
+}
+
+size_t silvia_irma_batch_issuer::size()
+{
+	return credentials.size();
+}
+
+bool silvia_irma_batch_issuer::communicate(silvia_card_channel* card, const std::vector<bytestring>& commands, std::vector<bytestring>& results, std::string& error)
+{
+	results.clear();
+	
+	if (!card->transmit_batch(commands, results) || results.empty())
+	{
+		error = "card communication failed";
+		
+		return false;
+	}
+	
+	// Every response ends in a status word
+	if (results.back().size() < 2)
+	{
+		error = "card communication failed";
+		
+		return false;
+	}
+	
+	// The batch stops at the first command that does not return 9000
+	unsigned short sw = silvia_apdu::get_sw(results.back());
+	
+	if (sw == 0x6982)
+	{
+		error = "card requires PIN";
+		
+		return false;
+	}
+	else if (sw != 0x9000)
+	{
+		error = silvia_apdu::sw_error(sw);
+		
+		return false;
+	}
+	else if (results.size() != commands.size())
+	{
+		error = "card communication failed";
+		
+		return false;
+	}
+	
+	return true;
+}
+
+bool silvia_irma_batch_issuer::verify_pin(silvia_card_channel* card, const std::string& PIN, std::string& error)
+{
+	if (PIN.empty() || (PIN.size() > 8))
+	{
+		error = "invalid PIN";
+		
+		return false;
+	}
+	
+	bytestring data;
+	unsigned short sw;
+	
+	if (!card->transmit(silvia_apdu::verify_pin(PIN), data, sw))
+	{
+		error = "card communication failed";
+		
+		return false;
+	}
+	
+	if (sw == 0x9000)
+	{
+		return true;
+	}
+	
+	error = silvia_apdu::sw_error(sw);
+	
+	return false;
+}
+
+bool silvia_irma_batch_issuer::issue(silvia_card_channel* card, const std::string& PIN, size_t& issued, std::string& error)
+{
+	issued = 0;
+	
+	if (credentials.empty())
+	{
+		return true;
+	}
+	
+	// Create an issuer for every credential
+	std::vector<silvia_irma_issuer*> issuers;
+	
+	for (std::vector<credential>::iterator i = credentials.begin(); i != credentials.end(); i++)
+	{
+		issuers.push_back(new silvia_irma_issuer(i->pubkey, i->privkey, i->ispec, prime_pool));
+	}
+	
+	// Select the application once and hand the result to all issuers
+	std::vector<bytestring> commands = issuers[0]->get_select_commands();
+	std::vector<bytestring> results;
+	
+	bool rv = true;
+	
+	if (!card->transmit_batch(commands, results) || results.empty())
+	{
+		error = "card communication failed";
+		
+		rv = false;
+	}
+	
+	for (std::vector<silvia_irma_issuer*>::iterator i = issuers.begin(); rv && (i != issuers.end()); i++)
+	{
+		if (i != issuers.begin())
+		{
+			(*i)->get_select_commands();
+		}
+		
+		if (!(*i)->submit_select_data(results))
+		{
+			error = "no IRMA application";
+			
+			rv = false;
+		}
+	}
+	
+	// The PIN stays verified until the application is selected again
+	rv = rv && verify_pin(card, PIN, error);
+	
+	// Prepare the first round of the first credential
+	round_job* prepare = NULL;
+	
+	if (rv)
+	{
+		prepare = new round_job(issuers[0]);
+		
+		pool->submit(prepare);
+	}
+	
+	for (size_t i = 0; rv && (i < issuers.size()); i++)
+	{
+		// Round 1: write the attributes and get the commitment
+		prepare->wait();
+		
+		commands = prepare->commands;
+		
+		delete prepare;
+		prepare = NULL;
+		
+		if (!communicate(card, commands, results, error))
+		{
+			issuers[i]->abort();
+			
+			rv = false;
+			
+			break;
+		}
+		
+		// Verify the commitment and compute the signature
+		round_job sign(issuers[i], &results);
+		
+		pool->submit(&sign);
+		
+		if (!sign.wait())
+		{
+			error = "round 1 failed";
+			
+			rv = false;
+			
+			break;
+		}
+		
+		// Prepare the next credential while the card processes the
+		// signature of this one
+		if (i + 1 < issuers.size())
+		{
+			prepare = new round_job(issuers[i + 1]);
+			
+			pool->submit(prepare);
+		}
+		
+		// Round 2: write and verify the signature
+		if (!communicate(card, sign.commands, results, error))
+		{
+			issuers[i]->abort();
+			
+			rv = false;
+			
+			break;
+		}
+		
+		if (!issuers[i]->submit_issue_results_round_2(results))
+		{
+			error = "round 2 failed";
+			
+			rv = false;
+			
+			break;
+		}
+		
+		issued++;
+	}
+	
+	// Wait for a preparation that is still running before the issuers go
+	if (prepare != NULL)
+	{
+		prepare->wait();
+		
+		delete prepare;
+	}
+	
+	for (std::vector<silvia_irma_issuer*>::iterator i = issuers.begin(); i != issuers.end(); i++)
+	{
+		delete *i;
+	}
+	
+	return rv;
+}
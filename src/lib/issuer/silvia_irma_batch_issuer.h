@@ -0,0 +1,130 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_irma_batch_issuer.h
+
+ Issues a list of credentials to IRMA cards; many cards can be served
+ concurrently
+ *****************************************************************************/
+
+#ifndef _SILVIA_IRMA_BATCH_ISSUER_H
+#define _SILVIA_IRMA_BATCH_ISSUER_H
+
+#include "silvia_types.h"
+#include "silvia_irma_issuer.h"
+#include "silvia_issue_spec.h"
+#include "silvia_prime_pool.h"
+#include "silvia_thread_pool.h"
+#include "silvia_card_channel.h"
+#include <string>
+#include <vector>
+
+/**
+ * IRMA batch issuer class; issues the same list of credentials to every
+ * card it is given. The application selection and PIN verification are
+ * done once per card. The cryptography runs on a worker pool, and the
+ * first round of the next credential is prepared while the card
+ * processes the second round of the current credential. Every card is
+ * handled by the thread that calls issue(), so cards on different
+ * readers can be served at the same time by calling issue() from a
+ * thread per reader.
+ */
+class silvia_irma_batch_issuer
+{
+public:
+	/**
+	 * Constructor
+	 * @param pool the worker pool for the cryptography (optional, by default a pool with one thread per CPU is used)
+	 * @param prime_pool the pool to take the signature values e from (optional)
+	 */
+	silvia_irma_batch_issuer(silvia_thread_pool* pool = NULL, silvia_prime_pool* prime_pool = NULL);
+
+	/**
+	 * Destructor
+	 */
+	~silvia_irma_batch_issuer();
+
+	/**
+	 * Add a credential to the list of credentials to issue; the caller
+	 * retains ownership of the keys and the specification, which are
+	 * shared by all cards. Must not be called while cards are issued.
+	 * @param pubkey the issuer public key
+	 * @param privkey the issuer private key
+	 * @param ispec the issue specification
+	 */
+	void add_credential(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec);
+
+	/**
+	 * Get the number of credentials that are issued to every card
+	 * @return the number of credentials
+	 */
+	size_t size();
+
+	/**
+	 * Issue all credentials to a card; may be called from several
+	 * threads at the same time for different cards
+	 * @param card the card
+	 * @param PIN the credential PIN of the card
+	 * @param issued receives the number of credentials that were issued
+	 * @param error receives a description of the error if issuance failed
+	 * @return true if all credentials were issued
+	 */
+	bool issue(silvia_card_channel* card, const std::string& PIN, size_t& issued, std::string& error);
+
+private:
+	// Copying is not allowed
+	silvia_irma_batch_issuer(const silvia_irma_batch_issuer&);
+	silvia_irma_batch_issuer& operator=(const silvia_irma_batch_issuer&);
+
+	// Job that computes part of a round on the worker pool
+	class round_job;
+
+	// Exchange commands with the card; fails unless every command returns 9000
+	bool communicate(silvia_card_channel* card, const std::vector<bytestring>& commands, std::vector<bytestring>& results, std::string& error);
+
+	// Verify the PIN of the card
+	bool verify_pin(silvia_card_channel* card, const std::string& PIN, std::string& error);
+
+	// The credentials
+	struct credential
+	{
+		silvia_pub_key* pubkey;
+		silvia_priv_key* privkey;
+		silvia_issue_specification* ispec;
+	};
+
+	std::vector<credential> credentials;
+
+	// The worker pool and prime pool
+	silvia_thread_pool* pool;
+	bool own_pool;
+	silvia_prime_pool* prime_pool;
+};
+
+#endif // !_SILVIA_IRMA_BATCH_ISSUER_H
@@ -44,13 +44,11 @@
 #include <assert.h>
 #include <time.h>
 
-#define MPZ_FROM_RESULT(result_index) results[result_index].substr(0, results[result_index].size() - 2).mpz_val()
-
-#define PAD_TO_SYSPAR(b,syspar) while (b.size() < SYSPAR_BYTES(syspar)) b = "00" + b;
+#define MPZ_FROM_RESULT(result_index) silvia_apdu::get_data(results[result_index]).mpz_val()
 
 #define IRMA_CREDENTIAL_METADATA_VERSION	"01"
 
-silvia_irma_issuer::silvia_irma_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec)
+silvia_irma_issuer::silvia_irma_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec, silvia_prime_pool* prime_pool /* = NULL */)
 {
 	assert(pubkey->get_R().size() >= (ispec->get_attributes().size() + 2));		// Check if we have enough R values to issue this credential
 	
@@ -61,6 +59,7 @@ silvia_irma_issuer::silvia_irma_issuer(silvia_pub_key* pubkey, silvia_priv_key*
 	irma_issuer_state = IRMA_ISSUER_START;
 	
 	issuer = new silvia_issuer(pubkey, privkey);
+	issuer->set_prime_pool(prime_pool);
 	
 	metadata_attribute = NULL;
 }
@@ -108,7 +107,7 @@ bool silvia_irma_issuer::submit_select_data(std::vector<bytestring>& results)
 	
 	for (std::vector<bytestring>::iterator i = results.begin(); i != results.end(); i++)
 	{
-		if (i->substr(i->size() - 2) != "9000")
+		if (silvia_apdu::get_sw(*i) != 0x9000)
 		{
 			this->abort();
 		
@@ -133,22 +132,19 @@ std::vector<bytestring> silvia_irma_issuer::get_issue_commands_round_1()
 	
 	// FIXME: context is randomly generated and kept as state!
 	mpz_class context_mpz = silvia_rng::i()->get_random(SYSPAR(l_H));
-	context = bytestring(context_mpz);
+	context = bytestring(context_mpz, SYSPAR_BYTES(l_H));
 	bytestring id;
-	id += (unsigned char) ((ispec->get_credential_id() & 0xff00) >> 8);
-	id += (unsigned char) (ispec->get_credential_id() & 0x00ff);
+	id.append_uint(ispec->get_credential_id(), 2);
 	
 	bytestring attr_count;
-	attr_count += (unsigned char) ((ispec->get_attributes().size() + 1) & 0xff00) >> 8; // +1 for expires
-	attr_count += (unsigned char) ((ispec->get_attributes().size() + 1) & 0x00ff); 		// +1 for expires
+	attr_count.append_uint(ispec->get_attributes().size() + 1, 2); // +1 for expires
 	
 	// FIXME: actually do something with these flags!
-	bytestring attr_flags = "000000";
-	
-	bytestring timestamp = (unsigned long) time(NULL);
-	timestamp = timestamp.substr(timestamp.size() - 4);
+	bytestring attr_flags;
+	attr_flags.append_uint(0, 3);
 	
-	PAD_TO_SYSPAR(context, l_H);
+	bytestring timestamp;
+	timestamp.append_uint(time(NULL), 4);
 	
 	silvia_apdu issue_start(0x80, 0x10, 0x00, 0x00);
 	
@@ -166,34 +162,19 @@ std::vector<bytestring> silvia_irma_issuer::get_issue_commands_round_1()
 	
 	// n
 	silvia_apdu issue_set_n(0x80, 0x11, 0x00, 0x00);
-	bytestring n(pubkey->get_n());
-	
-	// Pad if necessary
-	PAD_TO_SYSPAR(n, l_n);
-	
-	issue_set_n.append_data(n);
+	issue_set_n.append_mpz(pubkey->get_n(), SYSPAR_BYTES(l_n));
 	
 	commands.push_back(issue_set_n.get_apdu());
 	
 	// S
 	silvia_apdu issue_set_S(0x80, 0x11, 0x01, 0x00);
-	bytestring S(pubkey->get_S());
-	
-	// Pad if necessary
-	PAD_TO_SYSPAR(S, l_n);
-	
-	issue_set_S.append_data(S);
+	issue_set_S.append_mpz(pubkey->get_S(), SYSPAR_BYTES(l_n));
 	
 	commands.push_back(issue_set_S.get_apdu());
 	
 	// Z
 	silvia_apdu issue_set_Z(0x80, 0x11, 0x02, 0x00);
-	bytestring Z(pubkey->get_Z());
-	
-	// Pad if necessary
-	PAD_TO_SYSPAR(Z, l_n);
-	
-	issue_set_Z.append_data(Z);
+	issue_set_Z.append_mpz(pubkey->get_Z(), SYSPAR_BYTES(l_n));
 	
 	commands.push_back(issue_set_Z.get_apdu());
 	
@@ -201,12 +182,7 @@ std::vector<bytestring> silvia_irma_issuer::get_issue_commands_round_1()
 	{
 		silvia_apdu issue_set_R(0x80, 0x11, 0x03, (unsigned char) (0x00 + i));
 		
-		bytestring R(pubkey->get_R()[i]);
-		
-		// Pad if necessary
-		PAD_TO_SYSPAR(R, l_n);
-		
-		issue_set_R.append_data(R);
+		issue_set_R.append_mpz(pubkey->get_R()[i], SYSPAR_BYTES(l_n));
 		
 		commands.push_back(issue_set_R.get_apdu());
 	}
@@ -265,13 +241,8 @@ std::vector<bytestring> silvia_irma_issuer::get_issue_commands_round_1()
 	
 	silvia_apdu issue_commitment_nonce(0x80, 0x1a, 0x00, 0x00);
 	
-	bytestring n1(issuer->get_issuer_nonce());
-	
-	// pad if necessary
-	PAD_TO_SYSPAR(n1, l_statzk);
-	
 	silvia_apdu issue_commitment(0x80, 0x1a, 0x00, 0x00);
-	issue_commitment.append_data(n1);
+	issue_commitment.append_mpz(issuer->get_issuer_nonce(), SYSPAR_BYTES(l_statzk));
 	
 	commands.push_back(issue_commitment.get_apdu());
 	
@@ -318,7 +289,7 @@ bool silvia_irma_issuer::submit_issue_results_round_1(std::vector<bytestring>& r
 	
 	for (std::vector<bytestring>::iterator i = results.begin(); i != results.end(); i++)
 	{
-		if (i->substr(i->size() - 2) != "9000")
+		if (silvia_apdu::get_sw(*i) != 0x9000)
 		{
 			this->abort();
 		
@@ -410,21 +381,15 @@ std::vector<bytestring> silvia_irma_issuer::get_issue_commands_round_2()
 	////////////////////////////////////////////////////////////////////
 	
 	silvia_apdu issue_write_A(0x80, 0x1d, 0x01, 0x00);
-	bytestring A_val(A);
-	PAD_TO_SYSPAR(A_val, l_n);
-	issue_write_A.append_data(A_val);
+	issue_write_A.append_mpz(A, SYSPAR_BYTES(l_n));
 	commands.push_back(issue_write_A.get_apdu());
 	
 	silvia_apdu issue_write_e(0x80, 0x1d, 0x02, 0x00);
-	bytestring e_val(e);
-	PAD_TO_SYSPAR(e_val, l_e);
-	issue_write_e.append_data(e_val);
+	issue_write_e.append_mpz(e, SYSPAR_BYTES(l_e));
 	commands.push_back(issue_write_e.get_apdu());
 	
 	silvia_apdu issue_write_v_prime_prime(0x80, 0x1d, 0x03, 0x00);
-	bytestring vpp_val(v_prime_prime);
-	PAD_TO_SYSPAR(vpp_val, l_v);
-	issue_write_v_prime_prime.append_data(vpp_val);
+	issue_write_v_prime_prime.append_mpz(v_prime_prime, SYSPAR_BYTES(l_v));
 	commands.push_back(issue_write_v_prime_prime.get_apdu());
 	
 	////////////////////////////////////////////////////////////////////
@@ -432,15 +397,11 @@ std::vector<bytestring> silvia_irma_issuer::get_issue_commands_round_2()
 	////////////////////////////////////////////////////////////////////
 	
 	silvia_apdu issue_submit_proof_c(0x80, 0x1d, 0x04, 0x00);
-	bytestring c_val(c);
-	PAD_TO_SYSPAR(c_val, l_H);
-	issue_submit_proof_c.append_data(c_val);
+	issue_submit_proof_c.append_mpz(c, SYSPAR_BYTES(l_H));
 	commands.push_back(issue_submit_proof_c.get_apdu());
 	
 	silvia_apdu issue_submit_proof_e_hat(0x80, 0x1d, 0x05, 0x00);
-	bytestring e_hat_val(e_hat);
-	PAD_TO_SYSPAR(e_hat_val, l_n);
-	issue_submit_proof_e_hat.append_data(e_hat_val);	
+	issue_submit_proof_e_hat.append_mpz(e_hat, SYSPAR_BYTES(l_n));
 	commands.push_back(issue_submit_proof_e_hat.get_apdu());
 	
 	////////////////////////////////////////////////////////////////////
@@ -474,7 +435,7 @@ bool silvia_irma_issuer::submit_issue_results_round_2(std::vector<bytestring>& r
 	
 	for (std::vector<bytestring>::iterator i = results.begin(); i != results.end(); i++)
 	{
-		if (i->substr(i->size() - 2) != "9000")
+		if (silvia_apdu::get_sw(*i) != 0x9000)
 		{
 			this->abort();
 		
@@ -59,8 +59,9 @@ public:
 	 * Constructor
 	 * @param pubkey the issuer public key
 	 * @param vspec the issuer specification
+	 * @param prime_pool the pool to take the signature value e from (optional)
 	 */
-	silvia_irma_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec);
+	silvia_irma_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec, silvia_prime_pool* prime_pool = NULL);
 	
 	/**
 	 * Destructor
@@ -0,0 +1,84 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_irma_issuer_session.cpp
+
+ Non-blocking IRMA issuance session
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_irma_issuer_session.h"
+#include "silvia_parameters.h"
+
+silvia_irma_issuer_session::silvia_irma_issuer_session(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec, const std::string PIN, silvia_prime_pool* prime_pool /* = NULL */)
+	: silvia_session(PIN), issuer(pubkey, privkey, ispec, prime_pool)
+{
+	// Build the tables of the public key now; sessions on the worker
+	// threads only read from the public key
+	pubkey->precompute(*silvia_system_parameters::i());
+	
+	step = ISSUER_SESSION_START;
+}
+
+silvia_session_state_t silvia_irma_issuer_session::next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands)
+{
+	switch(step)
+	{
+	case ISSUER_SESSION_START:
+		commands = issuer.get_select_commands();
+		step = ISSUER_SESSION_SELECT;
+		
+		return SILVIA_SESSION_RUNNING;
+	case ISSUER_SESSION_SELECT:
+		if (!issuer.submit_select_data(results))
+		{
+			return SILVIA_SESSION_FAILED;
+		}
+		
+		commands = issuer.get_issue_commands_round_1();
+		step = ISSUER_SESSION_ROUND_1;
+		
+		return SILVIA_SESSION_RUNNING;
+	case ISSUER_SESSION_ROUND_1:
+		if (!issuer.submit_issue_results_round_1(results))
+		{
+			return SILVIA_SESSION_FAILED;
+		}
+		
+		commands = issuer.get_issue_commands_round_2();
+		step = ISSUER_SESSION_ROUND_2;
+		
+		return SILVIA_SESSION_RUNNING;
+	case ISSUER_SESSION_ROUND_2:
+		return issuer.submit_issue_results_round_2(results) ? SILVIA_SESSION_SUCCEEDED : SILVIA_SESSION_FAILED;
+	}
+	
+	return SILVIA_SESSION_FAILED;
+}
+
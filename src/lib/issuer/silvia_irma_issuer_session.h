@@ -0,0 +1,81 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_irma_issuer_session.h
+
+ Non-blocking IRMA issuance session
+ *****************************************************************************/
+
+#ifndef _SILVIA_IRMA_ISSUER_SESSION_H
+#define _SILVIA_IRMA_ISSUER_SESSION_H
+
+#include "silvia_types.h"
+#include "silvia_session.h"
+#include "silvia_irma_issuer.h"
+#include "silvia_issue_spec.h"
+#include "silvia_prime_pool.h"
+#include <string>
+#include <vector>
+
+/**
+ * IRMA issuance session; selects the IRMA application and issues a
+ * credential in two rounds. The card requests the PIN before issuance.
+ */
+class silvia_irma_issuer_session : public silvia_session
+{
+public:
+	/**
+	 * Constructor
+	 * @param pubkey the issuer public key (shared with other sessions)
+	 * @param privkey the issuer private key
+	 * @param ispec the issue specification
+	 * @param PIN the PIN of the card
+	 * @param prime_pool the pool to take the signature value e from (optional)
+	 */
+	silvia_irma_issuer_session(silvia_pub_key* pubkey, silvia_priv_key* privkey, silvia_issue_specification* ispec, const std::string PIN, silvia_prime_pool* prime_pool = NULL);
+
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands);
+
+private:
+	// The issuer
+	silvia_irma_issuer issuer;
+	
+	enum
+	{
+		ISSUER_SESSION_START,
+		ISSUER_SESSION_SELECT,
+		ISSUER_SESSION_ROUND_1,
+		ISSUER_SESSION_ROUND_2
+	}
+	step;
+};
+
+#endif // !_SILVIA_IRMA_ISSUER_SESSION_H
+
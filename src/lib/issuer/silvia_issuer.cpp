@@ -43,15 +43,45 @@
 #include "silvia_macros.h"
 #include "silvia_asn1.h"
 #include "silvia_hash.h"
+#include "silvia_multiexp.h"
+#include "silvia_prime_pool.h"
 
-silvia_issuer::silvia_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey)
+silvia_issuer::silvia_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey, const silvia_runtime* runtime /* = NULL */)
 {
 	this->pubkey = pubkey;
 	this->privkey = privkey;
+
+	prime_pool = NULL;
+
+	// Signing operations can be accelerated using the Chinese Remainder
+	// Theorem if the private key holds the factors of the modulus
+	use_crt = (privkey != NULL) && ((privkey->get_p() * privkey->get_q()) == pubkey->get_n());
+
+	if (runtime != NULL)
+	{
+		this->runtime = *runtime;
+	}
 	
 	issuer_state = ISSUER_START;
 }
 	
+mpz_class silvia_issuer::powm_signing(const mpz_class& base, const mpz_class& exp)
+{
+	if (use_crt)
+	{
+		return privkey->powm_crt(base, exp);
+	}
+	else
+	{
+		return pubkey->get_modulus().powm(base, exp);
+	}
+}
+
+void silvia_issuer::set_prime_pool(silvia_prime_pool* prime_pool)
+{
+	this->prime_pool = prime_pool;
+}
+
 void silvia_issuer::set_attributes(const std::vector<silvia_attribute*> a)
 {
 	assert(issuer_state == ISSUER_START);
@@ -68,7 +98,7 @@ mpz_class silvia_issuer::get_issuer_nonce(mpz_class* ext_n1 /* = NULL*/)
 	if (ext_n1 == NULL)
 	{
 		// Generate new issuer nonce
-		n1 = silvia_rng::i()->get_random(SYSPAR(l_statzk));
+		n1 = runtime.get_rng()->get_random(RTPAR(l_statzk));
 	}
 	else
 	{
@@ -86,7 +116,7 @@ bool silvia_issuer::submit_and_verify_commitment(mpz_class context, mpz_class U,
 	assert(issuer_state == ISSUER_NONCE);
 	
 	// Check length of v'^
-	if (mpz_sizeinbase(_Z(v_prime_hat), 2) > SYSPAR(l_n) + SYSPAR(l_statzk)*2 + SYSPAR(l_H) + 1)
+	if (mpz_sizeinbase(_Z(v_prime_hat), 2) > RTPAR(l_n) + RTPAR(l_statzk)*2 + RTPAR(l_H) + 1)
 	{
 		reset();
 		
@@ -96,47 +126,36 @@ bool silvia_issuer::submit_and_verify_commitment(mpz_class context, mpz_class U,
 	// Negate c
 	mpz_class c_neg = -c;
 	
-	// Compute U^
-	
-	// Compute factor U^-c
-	mpz_class U_c_neg;
-	mpz_powm(_Z(U_c_neg), _Z(U), _Z(c_neg), _Z(pubkey->get_n()));
+	// Compute U^ = U^-c * S^v'^ * R_0^s^
+	silvia_multiexp U_hat_me(pubkey->get_modulus());
 	
-	// Compute factor S^v'^
-	mpz_class S_v_prime_hat;
-	mpz_powm(_Z(S_v_prime_hat), _Z(pubkey->get_S()), _Z(v_prime_hat), _Z(pubkey->get_n()));
+	if (!U_hat_me.add(U, c_neg))
+	{
+		reset();
+		
+		return false;
+	}
 	
-	// Compute factor R_0^s^
-	mpz_class R0_s_hat;
-	mpz_powm(_Z(R0_s_hat), _Z(pubkey->get_R()[0]), _Z(s_hat), _Z(pubkey->get_n()));
+	U_hat_me.add(pubkey->get_fixed_S(), v_prime_hat);
+	U_hat_me.add(pubkey->get_fixed_R(0), s_hat);
 	
-	// Now compose U^ from the factors
-	mpz_class U_hat = U_c_neg * S_v_prime_hat * R0_s_hat;
-	mpz_mod(_Z(U_hat), _Z(U_hat), _Z(pubkey->get_n()));
+	mpz_class U_hat = U_hat_me.compute();
 	
 	// Create hash c^ from the data the issuer knows
 	
 	// Create ASN.1 encoding of all the data to hash
-	silvia_asn1_sequence challenge_seq;
-	
-	silvia_asn1_integer context_asn1(context);
-	challenge_seq.append(&context_asn1);
-	
-	silvia_asn1_integer U_asn1(U);
-	challenge_seq.append(&U_asn1);
-	
-	silvia_asn1_integer U_hat_asn1(U_hat);
-	challenge_seq.append(&U_hat_asn1);
-	
-	silvia_asn1_integer n1_asn1(n1);
-	challenge_seq.append(&n1_asn1);
+	silvia_der_sequence challenge_seq;
+	challenge_seq.append(context);
+	challenge_seq.append(U);
+	challenge_seq.append(U_hat);
+	challenge_seq.append(n1);
 	
 	// Hash the data
-	silvia_hash h(SYSPAR(hash_type));
+	silvia_hash* h = runtime.get_hash();
 	
-	h.init();
-	h.update(challenge_seq.get_der_encoding());
-	mpz_class c_hat = h.final();
+	h->init();
+	challenge_seq.hash(h);
+	mpz_class c_hat = h->final();
 	
 	// Compare c to c^
 	if (c != c_hat)
@@ -160,26 +179,15 @@ void silvia_issuer::compute_signature(mpz_class& A, mpz_class& e, mpz_class& v_p
 	
 	if (ext_e == NULL)
 	{
-		// Generate a prime e in the interval [2^l_e-1, 2^l_e-1 + 2^l_e'-1]
-		mpz_class lower_bound;
-		mpz_setbit(_Z(lower_bound), SYSPAR(l_e) - 1);
-	
-		mpz_class upper_bound;
-		mpz_setbit(_Z(upper_bound), SYSPAR(l_e_prime) - 1);
-		upper_bound += lower_bound;
-		
-		e = 0;
-		
-		while ((e < lower_bound) || (e > upper_bound))
+		// Take a prime e in the interval [2^l_e-1, 2^l_e-1 + 2^l_e'-1]
+		// from the pool or generate one if there is no pool
+		if (prime_pool != NULL)
+		{
+			prime_pool->get_prime(e);
+		}
+		else
 		{
-			e = lower_bound;
-			
-			e += silvia_rng::i()->get_random(SYSPAR(l_e_prime) - 1);
-			
-			while ((e < upper_bound) && !mpz_probab_prime_p(_Z(e), SYSPAR(rabin_miller_its)))
-			{
-				mpz_nextprime(_Z(e), _Z(e));
-			}
+			e = silvia_prime_pool::generate_prime(runtime);
 		}
 	}
 	else
@@ -192,7 +200,7 @@ void silvia_issuer::compute_signature(mpz_class& A, mpz_class& e, mpz_class& v_p
 	
 	if (ext_v_tilde == NULL)
 	{
-		v_tilde = silvia_rng::i()->get_random(SYSPAR(l_v) - 1);
+		v_tilde = runtime.get_rng()->get_random(RTPAR(l_v) - 1);
 	}
 	else
 	{
@@ -201,7 +209,7 @@ void silvia_issuer::compute_signature(mpz_class& A, mpz_class& e, mpz_class& v_p
 	
 	// Compute 2^l_v-1
 	mpz_class two_l_v_1;
-	mpz_setbit(_Z(two_l_v_1), SYSPAR(l_v) - 1);
+	mpz_setbit(_Z(two_l_v_1), RTPAR(l_v) - 1);
 	
 	// Compute v''
 	v_prime_prime = two_l_v_1 + v_tilde;
@@ -210,41 +218,33 @@ void silvia_issuer::compute_signature(mpz_class& A, mpz_class& e, mpz_class& v_p
 	
 	// Compute the denominator term of Q
 	
-	// Compute factor S^v''
-	mpz_class S_v_prime_prime;
-	mpz_powm(_Z(S_v_prime_prime), _Z(pubkey->get_S()), _Z(v_prime_prime), _Z(pubkey->get_n()));
+	// Compute factors S^v'' and R(i)^a(i) for all attributes
+	silvia_multiexp Q_denom_me(pubkey->get_modulus());
+	
+	Q_denom_me.add(pubkey->get_fixed_S(), v_prime_prime);
 	
-	// Compute factors for all attributes
-	mpz_class R_a(1);
 	size_t R_index = 1;
 	
 	for (std::vector<silvia_attribute*>::iterator i = a.begin(); i != a.end(); i++)
 	{
-		// Compute R(i)^a(i)
-		mpz_class R_a_i;
-		mpz_powm(_Z(R_a_i), _Z(pubkey->get_R()[R_index++]), _Z((*i)->rep()), _Z(pubkey->get_n()));
-		
-		// Factor in R(i)^a(i)
-		R_a *= R_a_i;
-		
-		// Normalize in Z(n)
-		mpz_mod(_Z(R_a), _Z(R_a), _Z(pubkey->get_n()));
+		Q_denom_me.add(pubkey->get_fixed_R(R_index++), (*i)->rep());
 	}
 	
-	mpz_class Q_denom = U * S_v_prime_prime * R_a;
+	Q_denom_me.add(U, 1);
+	
+	mpz_class Q_denom = Q_denom_me.compute();
 	
 	// Compute Q = Z * Q_denom^-1
 	mpz_class Q_denom_inv;
 	mpz_invert(_Z(Q_denom_inv), _Z(Q_denom), _Z(pubkey->get_n()));
 	
-	mpz_class Q = pubkey->get_Z() * Q_denom_inv;
-	mpz_mod(_Z(Q), _Z(Q), _Z(pubkey->get_n()));
+	mpz_class Q = pubkey->get_modulus().mulmod(pubkey->get_Z(), Q_denom_inv);
 	
 	// Compute A = Q^(e^-1 mod p'q')
 	mpz_class e_inv;
 	mpz_invert(_Z(e_inv), _Z(e), _Z(privkey->get_n_prime()));
 	
-	mpz_powm(_Z(A), _Z(Q), _Z(e_inv), _Z(pubkey->get_n()));
+	A = powm_signing(Q, e_inv);
 	
 	// Save state
 	this->Q = Q;
@@ -263,7 +263,7 @@ void silvia_issuer::prove_signature(mpz_class n2, mpz_class context, mpz_class&
 	
 	if (r_ext == NULL)
 	{
-		r = silvia_rng::i()->get_random(SYSPAR(l_n));
+		r = runtime.get_rng()->get_random(RTPAR(l_n));
 		
 		mpz_mod(_Z(r), _Z(r), _Z(privkey->get_n_prime()));
 	}
@@ -273,35 +273,24 @@ void silvia_issuer::prove_signature(mpz_class n2, mpz_class context, mpz_class&
 	}
 	
 	// Compute A~
-	mpz_class A_tilde;
-	mpz_powm(_Z(A_tilde), _Z(Q), _Z(r), _Z(pubkey->get_n()));
+	mpz_class A_tilde = powm_signing(Q, r);
 	
 	// Compute c
 	
 	// Create ASN.1 encoding of all the data to hash
-	silvia_asn1_sequence challenge_seq;
-	
-	silvia_asn1_integer context_asn1(context);
-	challenge_seq.append(&context_asn1);
-	
-	silvia_asn1_integer Q_asn1(Q);
-	challenge_seq.append(&Q_asn1);
-	
-	silvia_asn1_integer A_asn1(A);
-	challenge_seq.append(&A_asn1);
-	
-	silvia_asn1_integer n2_asn1(n2);
-	challenge_seq.append(&n2_asn1);
-	
-	silvia_asn1_integer A_tilde_asn1(A_tilde);
-	challenge_seq.append(&A_tilde_asn1);
+	silvia_der_sequence challenge_seq;
+	challenge_seq.append(context);
+	challenge_seq.append(Q);
+	challenge_seq.append(A);
+	challenge_seq.append(n2);
+	challenge_seq.append(A_tilde);
 	
 	// Hash the data
-	silvia_hash h(SYSPAR(hash_type));
+	silvia_hash* h = runtime.get_hash();
 	
-	h.init();
-	h.update(challenge_seq.get_der_encoding());
-	c = h.final();
+	h->init();
+	challenge_seq.hash(h);
+	c = h->final();
 	
 	// Compute e_hat
 	mpz_class e_inv;
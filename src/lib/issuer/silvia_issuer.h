@@ -37,6 +37,8 @@
 
 #include <gmpxx.h>
 #include "silvia_types.h"
+#include "silvia_runtime.h"
+#include "silvia_prime_pool.h"
 
 /**
  * Credential issuer class
@@ -48,8 +50,15 @@ public:
 	 * Constructor
 	 * @param pubkey the issuer public key
 	 * @param privkey the issuer private key
+	 * @param runtime the runtime context; if NULL, a context with the current system parameters is used
 	 */
-	silvia_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey);
+	silvia_issuer(silvia_pub_key* pubkey, silvia_priv_key* privkey, const silvia_runtime* runtime = NULL);
+	
+	/**
+	 * Set the prime pool to take the signature value e from
+	 * @param prime_pool the prime pool (NULL to generate e while issuing); the caller retains ownership
+	 */
+	void set_prime_pool(silvia_prime_pool* prime_pool);
 	
 	/**
 	 * Set the attributes
@@ -100,6 +109,9 @@ public:
 	void reset();
 
 private:
+	// Compute base^exp mod n, using CRT if the private factors are available
+	mpz_class powm_signing(const mpz_class& base, const mpz_class& exp);
+
 	// State
 	std::vector<silvia_attribute*> a; 	// credential attributes
 	mpz_class n1;						// issuer nonce
@@ -124,6 +136,13 @@ private:
 	// Issuer keys
 	silvia_pub_key* pubkey;
 	silvia_priv_key* privkey;
+	bool use_crt;						// sign using the private factors
+
+	// Pool of primes e
+	silvia_prime_pool* prime_pool;
+
+	// The runtime context
+	silvia_runtime runtime;
 };
 
 #endif // !_SILVIA_ISSUER_H
@@ -34,50 +34,413 @@
 
 #include "config.h"
 #include <vector>
+#include <algorithm>
 #include <gmpxx.h>
 #include <assert.h>
-#include <openssl/bn.h>
 #include "silvia_rand.h"
 #include "silvia_issuer_keygen.h"
 #include "silvia_types.h"
 #include "silvia_parameters.h"
 #include "silvia_macros.h"
+#include "silvia_thread_pool.h"
+#include "silvia_timer.h"
+
+// The number of candidates covered by one sieve batch in the safe prime search
+#define SAFE_PRIME_SIEVE_WINDOW		4096
+
+// The upper bound for the small primes used to sieve the candidates
+#define SAFE_PRIME_SIEVE_LIMIT		65536
+
+// Primes of <bits> bits must differ by at least 2^(<bits> - SAFE_PRIME_MIN_DISTANCE);
+// if p and q are too close, n = pq can be factored using Fermat's method
+#define SAFE_PRIME_MIN_DISTANCE		100
 
 ////////////////////////////////////////////////////////////////////////////////
-// Key factory
+// Progress reporting
 ////////////////////////////////////////////////////////////////////////////////
 
-// Initialise the one-and-only instance
-/*static*/ std::auto_ptr<silvia_issuer_keyfactory> silvia_issuer_keyfactory::_i(NULL);
+class keygen_progress
+{
+public:
+	keygen_progress(silvia_keygen_progress_cb cb, void* ctx)
+	{
+		this->cb = cb;
+		this->ctx = ctx;
 
-/*static*/ silvia_issuer_keyfactory* silvia_issuer_keyfactory::i()
+		for (int i = 0; i <= SILVIA_KEYGEN_DONE; i++)
+		{
+			counters[i] = 0;
+		}
+
+		timer.mark();
+
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~keygen_progress()
+	{
+		pthread_mutex_destroy(&lock);
+	}
+
+	// Add n to the counter of the stage and report the new value
+	void add(silvia_keygen_stage_t stage, size_t n)
+	{
+		pthread_mutex_lock(&lock);
+
+		counters[stage] += n;
+
+		if (cb != NULL)
+		{
+			cb(stage, counters[stage], elapsed(), ctx);
+		}
+
+		pthread_mutex_unlock(&lock);
+	}
+
+	// Report a value for the stage
+	void report(silvia_keygen_stage_t stage, size_t count)
+	{
+		pthread_mutex_lock(&lock);
+
+		counters[stage] = count;
+
+		if (cb != NULL)
+		{
+			cb(stage, count, elapsed(), ctx);
+		}
+
+		pthread_mutex_unlock(&lock);
+	}
+
+private:
+	double elapsed()
+	{
+		return (double) timer.elapsed() / 1000000000.0;
+	}
+
+	silvia_keygen_progress_cb cb;
+	void* ctx;
+	size_t counters[SILVIA_KEYGEN_DONE + 1];
+	silvia_timer timer;
+	pthread_mutex_t lock;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Parallel safe prime search
+////////////////////////////////////////////////////////////////////////////////
+
+// Shared state of a search for safe primes
+class safe_prime_search
 {
-	if (_i.get() == NULL)
+public:
+	safe_prime_search(size_t bits, size_t count, keygen_progress* progress)
 	{
-		_i = std::auto_ptr<silvia_issuer_keyfactory>(new silvia_issuer_keyfactory());
+		this->bits = bits;
+		this->count = count;
+		this->progress = progress;
+
+		if (bits > SAFE_PRIME_MIN_DISTANCE)
+		{
+			mpz_setbit(_Z(min_distance), bits - SAFE_PRIME_MIN_DISTANCE);
+		}
+
+		pthread_mutex_init(&lock, NULL);
+
+		// Find the odd primes below the sieve limit
+		std::vector<char> composite(SAFE_PRIME_SIEVE_LIMIT, 0);
+
+		for (unsigned long i = 3; i < SAFE_PRIME_SIEVE_LIMIT; i += 2)
+		{
+			if (composite[i]) continue;
+
+			small_primes.push_back(i);
+
+			for (unsigned long j = i * i; j < SAFE_PRIME_SIEVE_LIMIT; j += 2 * i)
+			{
+				composite[j] = 1;
+			}
+		}
 	}
 
-	return _i.get();
-}
+	~safe_prime_search()
+	{
+		pthread_mutex_destroy(&lock);
+	}
 
-silvia_issuer_keyfactory::silvia_issuer_keyfactory()
+	// Check if enough primes have been found
+	bool done()
+	{
+		pthread_mutex_lock(&lock);
+
+		bool rv = (primes.size() >= count);
+
+		pthread_mutex_unlock(&lock);
+
+		return rv;
+	}
+
+	// Add a safe prime that was found; primes that are too close to
+	// a prime that was found before are rejected
+	void add(const mpz_class& p)
+	{
+		pthread_mutex_lock(&lock);
+
+		bool added = (primes.size() < count);
+
+		for (std::vector<mpz_class>::iterator i = primes.begin(); added && (i != primes.end()); i++)
+		{
+			mpz_class distance = abs(p - *i);
+
+			if ((distance == 0) || (distance < min_distance))
+			{
+				added = false;
+			}
+		}
+
+		if (added)
+		{
+			primes.push_back(p);
+		}
+
+		pthread_mutex_unlock(&lock);
+
+		if (added)
+		{
+			progress->add(SILVIA_KEYGEN_PRIME_FOUND, 1);
+		}
+	}
+
+	// Sieve a batch of candidates starting at a random p' and test the survivors
+	void search_batch()
+	{
+		// Pick a random odd p' of bits - 1 bits with the two most significant
+		// bits set, so p = 2p' + 1 has its two most significant bits set
+		mpz_class p_prime = silvia_rng::i()->get_random(bits - 1);
+
+		mpz_setbit(_Z(p_prime), bits - 2);
+		mpz_setbit(_Z(p_prime), bits - 3);
+		mpz_setbit(_Z(p_prime), 0);
+
+		// Strike out the candidates p' + 2k for which either p' or 2p' + 1
+		// is divisible by one of the small primes
+		std::vector<char> sieve(SAFE_PRIME_SIEVE_WINDOW, 1);
+
+		for (std::vector<unsigned long>::iterator i = small_primes.begin(); i != small_primes.end(); i++)
+		{
+			unsigned long r = *i;
+			unsigned long rem = mpz_fdiv_ui(_Z(p_prime), r);
+			unsigned long inv2 = (r + 1) / 2;
+
+			// p' + 2k = 0 (mod r)
+			unsigned long k = (((r - rem) % r) * inv2) % r;
+
+			for (; k < SAFE_PRIME_SIEVE_WINDOW; k += r)
+			{
+				sieve[k] = 0;
+			}
+
+			// 2(p' + 2k) + 1 = 0 (mod r)
+			k = ((((r - 1) / 2 + r - rem) % r) * inv2) % r;
+
+			for (; k < SAFE_PRIME_SIEVE_WINDOW; k += r)
+			{
+				sieve[k] = 0;
+			}
+		}
+
+		// Test the candidates that survived the sieve
+		mpz_class candidate;
+		mpz_class p;
+		mpz_class fermat;
+		mpz_class two = 2;
+		size_t tested = 0;
+
+		for (size_t k = 0; k < SAFE_PRIME_SIEVE_WINDOW; k++)
+		{
+			if (!sieve[k]) continue;
+
+			if (done()) break;
+
+			candidate = p_prime + (2 * k);
+			p = (2 * candidate) + 1;
+
+			if (mpz_sizeinbase(_Z(p), 2) != bits) break;
+
+			tested++;
+
+			// Quick Fermat test of p before the more expensive tests
+			mpz_class p_minus_1 = p - 1;
+			mpz_powm(_Z(fermat), _Z(two), _Z(p_minus_1), _Z(p));
+
+			if (fermat != 1) continue;
+
+			if (!mpz_probab_prime_p(_Z(candidate), SYSPAR(rabin_miller_its))) continue;
+
+			if (!mpz_probab_prime_p(_Z(p), SYSPAR(rabin_miller_its))) continue;
+
+			// The next prime comes from a new random starting point, so
+			// two primes are never taken from the same window
+			add(p);
+
+			break;
+		}
+
+		progress->add(SILVIA_KEYGEN_SEARCHING, tested);
+	}
+
+	// The primes that were found
+	std::vector<mpz_class> primes;
+
+private:
+	size_t bits;
+	size_t count;
+	mpz_class min_distance;
+	keygen_progress* progress;
+	std::vector<unsigned long> small_primes;
+	pthread_mutex_t lock;
+};
+
+// Job that searches for safe primes until the search is done
+class safe_prime_job : public silvia_job
 {
+public:
+	safe_prime_job(safe_prime_search* search, silvia_job_countdown* countdown)
+	{
+		this->search = search;
+		this->countdown = countdown;
+	}
+
+	virtual void run()
+	{
+		while (!search->done())
+		{
+			search->search_batch();
+		}
+
+		countdown->done();
+	}
+
+private:
+	safe_prime_search* search;
+	silvia_job_countdown* countdown;
+};
+
+static void search_safe_primes
+(
+	size_t bits,
+	size_t count,
+	std::vector<mpz_class>& primes,
+	silvia_thread_pool* pool,
+	keygen_progress* progress
+)
+{
+	assert(bits > 32);
+
+	silvia_thread_pool* search_pool = (pool == NULL) ? new silvia_thread_pool() : pool;
+
+	safe_prime_search search(bits, count, progress);
+
+	// Start one search job on every thread; the first jobs to find
+	// a prime end the search for all others
+	std::vector<safe_prime_job*> jobs;
+	silvia_job_countdown countdown(search_pool->size());
+
+	for (size_t i = 0; i < search_pool->size(); i++)
+	{
+		jobs.push_back(new safe_prime_job(&search, &countdown));
+
+		search_pool->submit(jobs.back());
+	}
+
+	// Only wait for the own jobs; the pool may be shared
+	countdown.wait();
+
+	for (std::vector<safe_prime_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		delete *i;
+	}
+
+	if (pool == NULL)
+	{
+		delete search_pool;
+	}
+
+	primes = search.primes;
 }
 
-void silvia_issuer_keyfactory::generate_keypair
+////////////////////////////////////////////////////////////////////////////////
+// Parallel base derivation
+////////////////////////////////////////////////////////////////////////////////
+
+// Job that derives a base S^x for a random x
+class derive_base_job : public silvia_job
+{
+public:
+	derive_base_job(silvia_priv_key* privkey, size_t prime_size, const mpz_class* S, mpz_class* base, keygen_progress* progress, silvia_job_countdown* countdown)
+	{
+		this->privkey = privkey;
+		this->prime_size = prime_size;
+		this->S = S;
+		this->base = base;
+		this->progress = progress;
+		this->countdown = countdown;
+	}
+
+	virtual void run()
+	{
+		mpz_class x;
+
+		while (true)
+		{
+			x = silvia_rng::i()->get_random(prime_size);
+
+			if ((x > 2) && (x < privkey->get_n_prime()))
+			{
+				break;
+			}
+		}
+
+		// Compute base = S^x mod n
+		*base = privkey->powm_crt(*S, x);
+
+		progress->add(SILVIA_KEYGEN_BASE_DERIVED, 1);
+
+		countdown->done();
+	}
+
+private:
+	silvia_priv_key* privkey;
+	size_t prime_size;
+	const mpz_class* S;
+	mpz_class* base;
+	keygen_progress* progress;
+	silvia_job_countdown* countdown;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Key-pair generation
+////////////////////////////////////////////////////////////////////////////////
+
+// Generate an issuer key-pair with an <l_n>-bit modulus
+static void generate_keypair_of_size
 (
 	size_t max_attr,
+	size_t l_n,
 	silvia_pub_key** pubkey,
-	silvia_priv_key** privkey
+	silvia_priv_key** privkey,
+	silvia_thread_pool* pool,
+	keygen_progress* keygen_prog
 )
 {
-	assert(SYSPAR(l_n) % 2 == 0);	// p,q have half the size of n
-	assert(SYSPAR(l_n) % 4 == 0);	// p',q' have half the size of p,q
-	assert(SYSPAR(l_n) % 16 == 0);	// p, q must be a multiple of 8 bits
+	assert(l_n % 2 == 0);	// p,q have half the size of n
+	assert(l_n % 4 == 0);	// p',q' have half the size of p,q
+	assert(l_n % 16 == 0);	// p, q must be a multiple of 8 bits
 
 	assert(pubkey != NULL);
 	assert(privkey != NULL);
 
+	silvia_thread_pool* keygen_pool = (pool == NULL) ? new silvia_thread_pool() : pool;
+
 	// Public key values
 	std::vector<mpz_class> R;
 	mpz_class S;
@@ -89,63 +452,24 @@ void silvia_issuer_keyfactory::generate_keypair
 	mpz_class q;
 
 	// Compute prime size
-	size_t prime_size = SYSPAR(l_n) / 2;
-
-	// Generate p and q using OpenSSL safe prime generation
-	BIGNUM* p_ossl = NULL;
-	BIGNUM* q_ossl = NULL;
-	
-	do
-	{
-		p_ossl = BN_generate_prime(NULL, prime_size, 1 /* safe_prime */, NULL, NULL, NULL, NULL);
-	}
-	while (!BN_is_prime(p_ossl, SYSPAR(rabin_miller_its), NULL, NULL, NULL));
-	
-	do
-	{
-		q_ossl = BN_generate_prime(NULL, prime_size, 1 /* safe_prime */, NULL, NULL, NULL, NULL);
-	}
-	while (!BN_is_prime(q_ossl, SYSPAR(rabin_miller_its), NULL, NULL, NULL));
-
-	// Convert OpenSSL values to big-endian large integers
-	std::vector<unsigned char> p_val;
-	std::vector<unsigned char> q_val;
+	size_t prime_size = l_n / 2;
 
-	int p_size = BN_num_bytes(p_ossl);
-	int q_size = BN_num_bytes(q_ossl);
+	// Search for the safe primes p and q concurrently
+	std::vector<mpz_class> primes;
 
-	p_val.resize(p_size);
-	q_val.resize(q_size);
+	search_safe_primes(prime_size, 2, primes, keygen_pool, keygen_prog);
 
-	BN_bn2bin(p_ossl, &p_val[0]);
-	BN_bn2bin(q_ossl, &q_val[0]);
+	p = primes[0];
+	q = primes[1];
 
-	// FIXME: should be BN_clear_free if we want more security
-	BN_free(p_ossl);
-	BN_free(q_ossl);
-
-	// Convert big-endian values from OpenSSL to GMP format
-	mpz_import(_Z(p), p_size, 1, sizeof(unsigned char), 1, 0, &p_val[0]);
-	mpz_import(_Z(q), q_size, 1, sizeof(unsigned char), 1, 0, &q_val[0]);
-
-	// Compute p', q'
-	mpz_class p_prime = p;
-	p_prime -= 1;
-	mpz_divexact_ui(_Z(p_prime), _Z(p_prime), 2);
-
-	mpz_class q_prime = q;
-	q_prime -= 1;
-	mpz_divexact_ui(_Z(q_prime), _Z(q_prime), 2);
-
-	// Compute n, n'
+	// Compute n
 	n = p * q;
-	mpz_class n_prime = p_prime * q_prime;
 
 	// Find an acceptable value for S; we do this by picking a random
-	// <SYSPAR(l_n)> value and checking whether it is a quadratic residue modulo n
+	// <l_n> value and checking whether it is a quadratic residue modulo n
 	while (true)
 	{
-		S = silvia_rng::i()->get_random(SYSPAR(l_n));
+		S = silvia_rng::i()->get_random(l_n);
 
 		// Check if S \elem Z_n
 		if (S > n) continue;
@@ -158,44 +482,214 @@ void silvia_issuer_keyfactory::generate_keypair
 		}
 	}
 
-	// Derive Z from S
-	mpz_class x;
+	// Derive Z and R_i for i = 0..max_attr from S in parallel; the
+	// exponentiations use the factors of n
+	silvia_priv_key crt_key(p, q);
 
-	while (true)
+	std::vector<mpz_class> bases(max_attr + 1);
+	std::vector<derive_base_job*> jobs;
+	silvia_job_countdown countdown(bases.size());
+
+	for (size_t i = 0; i < bases.size(); i++)
 	{
-		x = silvia_rng::i()->get_random(prime_size);
+		jobs.push_back(new derive_base_job(&crt_key, prime_size, &S, &bases[i], keygen_prog, &countdown));
 
-		if ((x > 2) && (x < n_prime))
-		{
-			break;
-		}
+		keygen_pool->submit(jobs.back());
 	}
 
-	// Compute Z = S^x mod n
-	mpz_powm(_Z(Z), _Z(S), _Z(x), _Z(n));
+	countdown.wait();
 
-	// Derive R_i for i = 0..max_attr from S
-	for (size_t i = 0; i < max_attr; i++)
+	for (std::vector<derive_base_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
 	{
-		mpz_class R_i;
+		delete *i;
+	}
 
-		while (true)
+	if (pool == NULL)
+	{
+		delete keygen_pool;
+	}
+
+	Z = bases[0];
+	R.assign(bases.begin() + 1, bases.end());
+
+	keygen_prog->report(SILVIA_KEYGEN_DONE, bases.size());
+
+	// Construct the return key-pair
+	*pubkey = new silvia_pub_key(n, S, Z, R);
+	*privkey = new silvia_priv_key(p, q);
+}
+
+// Shared state of a batch of key-pairs
+class keygen_batch
+{
+public:
+	keygen_batch(std::vector<silvia_keygen_batch_entry>& entries, size_t threads_per_key, silvia_keygen_batch_cb cb, void* ctx)
+		: entries(entries)
+	{
+		this->threads_per_key = threads_per_key;
+		this->cb = cb;
+		this->ctx = ctx;
+
+		pthread_mutex_init(&lock, NULL);
+	}
+
+	~keygen_batch()
+	{
+		pthread_mutex_destroy(&lock);
+	}
+
+	// Generate the key-pair with the specified index
+	void generate(size_t index)
+	{
+		silvia_keygen_batch_entry& entry = entries[index];
+
+		silvia_timer timer;
+
+		timer.mark();
+
+		// Every key-pair gets its own pool; waiting for the jobs of one
+		// key-pair must not wait for the jobs of the other key-pairs
+		silvia_thread_pool key_pool(threads_per_key);
+		keygen_progress keygen_prog(NULL, NULL);
+
+		generate_keypair_of_size(entry.max_attr, entry.l_n, &entry.pubkey, &entry.privkey, &key_pool, &keygen_prog);
+
+		entry.elapsed = (double) timer.elapsed() / 1000000000.0;
+
+		if (cb != NULL)
 		{
-			x = silvia_rng::i()->get_random(prime_size);
+			pthread_mutex_lock(&lock);
 
-			if ((x > 2) && (x < n_prime))
-			{
-				break;
-			}
+			cb(index, entry, ctx);
+
+			pthread_mutex_unlock(&lock);
 		}
+	}
 
-		mpz_powm(_Z(R_i), _Z(S), _Z(x), _Z(n));
+private:
+	std::vector<silvia_keygen_batch_entry>& entries;
+	size_t threads_per_key;
+	silvia_keygen_batch_cb cb;
+	void* ctx;
+	pthread_mutex_t lock;
+};
+
+// Job that generates one key-pair of a batch
+class keygen_batch_job : public silvia_job
+{
+public:
+	keygen_batch_job(keygen_batch* batch, size_t index)
+	{
+		this->batch = batch;
+		this->index = index;
+	}
 
-		R.push_back(R_i);
+	virtual void run()
+	{
+		batch->generate(index);
 	}
 
-	// Construct the return key-pair
-	*pubkey = new silvia_pub_key(n, S, Z, R);
-	*privkey = new silvia_priv_key(p, q);
+private:
+	keygen_batch* batch;
+	size_t index;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Key factory
+////////////////////////////////////////////////////////////////////////////////
+
+// Initialise the one-and-only instance
+/*static*/ std::auto_ptr<silvia_issuer_keyfactory> silvia_issuer_keyfactory::_i(NULL);
+
+/*static*/ pthread_once_t silvia_issuer_keyfactory::_i_once = PTHREAD_ONCE_INIT;
+
+/*static*/ void silvia_issuer_keyfactory::init_i()
+{
+	_i = std::auto_ptr<silvia_issuer_keyfactory>(new silvia_issuer_keyfactory());
+}
+
+/*static*/ silvia_issuer_keyfactory* silvia_issuer_keyfactory::i()
+{
+	pthread_once(&_i_once, init_i);
+
+	return _i.get();
+}
+
+silvia_issuer_keyfactory::silvia_issuer_keyfactory()
+{
 }
 
+void silvia_issuer_keyfactory::generate_keypair
+(
+	size_t max_attr,
+	silvia_pub_key** pubkey,
+	silvia_priv_key** privkey,
+	silvia_thread_pool* pool /* = NULL */,
+	silvia_keygen_progress_cb progress /* = NULL */,
+	void* progress_ctx /* = NULL */
+)
+{
+	keygen_progress keygen_prog(progress, progress_ctx);
+
+	generate_keypair_of_size(max_attr, SYSPAR(l_n), pubkey, privkey, pool, &keygen_prog);
+}
+
+void silvia_issuer_keyfactory::generate_keypairs
+(
+	std::vector<silvia_keygen_batch_entry>& batch,
+	size_t num_threads /* = 0 */,
+	silvia_keygen_batch_cb done /* = NULL */,
+	void* done_ctx /* = NULL */
+)
+{
+	if (batch.empty()) return;
+
+	if (num_threads == 0)
+	{
+		num_threads = silvia_thread_pool::num_cpus();
+	}
+
+	// Generate as many key-pairs at the same time as there are threads
+	// and divide the threads evenly over the key-pairs in progress
+	size_t concurrent = (batch.size() < num_threads) ? batch.size() : num_threads;
+
+	keygen_batch state(batch, num_threads / concurrent, done, done_ctx);
+
+	silvia_thread_pool batch_pool(concurrent);
+	std::vector<keygen_batch_job*> jobs;
+
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		batch[i].pubkey = NULL;
+		batch[i].privkey = NULL;
+		batch[i].elapsed = 0.0;
+
+		jobs.push_back(new keygen_batch_job(&state, i));
+
+		batch_pool.submit(jobs.back());
+	}
+
+	batch_pool.wait();
+
+	for (std::vector<keygen_batch_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		delete *i;
+	}
+}
+
+void silvia_issuer_keyfactory::generate_safe_primes
+(
+	size_t bits,
+	size_t count,
+	std::vector<mpz_class>& primes,
+	silvia_thread_pool* pool /* = NULL */,
+	silvia_keygen_progress_cb progress /* = NULL */,
+	void* progress_ctx /* = NULL */
+)
+{
+	keygen_progress keygen_prog(progress, progress_ctx);
+
+	search_safe_primes(bits, count, primes, pool, &keygen_prog);
+
+	keygen_prog.report(SILVIA_KEYGEN_DONE, primes.size());
+}
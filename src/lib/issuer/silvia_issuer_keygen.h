@@ -38,7 +38,55 @@
 #include "config.h"
 #include <gmpxx.h>
 #include "silvia_types.h"
+#include "silvia_thread_pool.h"
 #include <memory>
+#include <vector>
+#include <pthread.h>
+
+/**
+ * Key generation progress stages
+ */
+typedef enum
+{
+	SILVIA_KEYGEN_SEARCHING,	/**< count is the number of prime candidates tested so far */
+	SILVIA_KEYGEN_PRIME_FOUND,	/**< count is the number of safe primes found so far */
+	SILVIA_KEYGEN_BASE_DERIVED,	/**< count is the number of bases (Z, R_i) derived so far */
+	SILVIA_KEYGEN_DONE		/**< key generation has finished */
+}
+silvia_keygen_stage_t;
+
+/**
+ * Key generation progress callback; calls are serialised, but may come
+ * from any of the threads taking part in the key generation
+ * @param stage the stage the key generation is in
+ * @param count stage dependent progress counter
+ * @param elapsed the number of seconds elapsed since the start
+ * @param ctx the context that was passed with the callback
+ */
+typedef void (*silvia_keygen_progress_cb)(silvia_keygen_stage_t stage, size_t count, double elapsed, void* ctx);
+
+/**
+ * Key-pair in a batch of key-pairs to generate
+ */
+typedef struct
+{
+	size_t			max_attr;	/**< the maximum number of attributes to support */
+	size_t			l_n;		/**< the size of the modulus in bits */
+	silvia_pub_key*		pubkey;		/**< receives the public key */
+	silvia_priv_key*	privkey;	/**< receives the private key */
+	double			elapsed;	/**< receives the number of seconds it took to generate the key-pair */
+}
+silvia_keygen_batch_entry;
+
+/**
+ * Batch completion callback; called once for every key-pair in the batch
+ * as soon as it has been generated. Calls are serialised, but may come
+ * from any of the threads taking part in the key generation.
+ * @param index the index of the key-pair in the batch
+ * @param entry the key-pair
+ * @param ctx the context that was passed with the callback
+ */
+typedef void (*silvia_keygen_batch_cb)(size_t index, const silvia_keygen_batch_entry& entry, void* ctx);
 
 /**
  * Key factory
@@ -57,12 +105,56 @@ public:
 	 * @param max_attr the maximum number of attributes to support
 	 * @param pubkey the public key object
 	 * @param privkey the private key object
+	 * @param pool the thread pool to use (optional, by default a pool with one thread per CPU is used)
+	 * @param progress the progress callback (optional)
+	 * @param progress_ctx context to pass to the progress callback
 	 */
 	void generate_keypair
 	(
 		size_t max_attr,
 		silvia_pub_key** pubkey,
-		silvia_priv_key** privkey
+		silvia_priv_key** privkey,
+		silvia_thread_pool* pool = NULL,
+		silvia_keygen_progress_cb progress = NULL,
+		void* progress_ctx = NULL
+	);
+
+	/**
+	 * Generate a batch of issuer key-pairs; the key-pairs are generated
+	 * concurrently, each on its share of the threads, so the serial parts
+	 * of the generation of one key-pair overlap with the work on others
+	 * @param batch the key-pairs to generate; the keys are returned in the entries
+	 * @param num_threads the total number of threads to use (optional, 0 uses one thread per CPU)
+	 * @param done the completion callback (optional)
+	 * @param done_ctx context to pass to the completion callback
+	 */
+	void generate_keypairs
+	(
+		std::vector<silvia_keygen_batch_entry>& batch,
+		size_t num_threads = 0,
+		silvia_keygen_batch_cb done = NULL,
+		void* done_ctx = NULL
+	);
+
+	/**
+	 * Generate distinct safe primes p = 2p' + 1 with the two most
+	 * significant bits set; the search runs on all threads of the pool
+	 * and stops as soon as enough primes have been found
+	 * @param bits the size of the primes in bits
+	 * @param count the number of primes to generate
+	 * @param primes receives the primes
+	 * @param pool the thread pool to use (optional, by default a pool with one thread per CPU is used)
+	 * @param progress the progress callback (optional)
+	 * @param progress_ctx context to pass to the progress callback
+	 */
+	void generate_safe_primes
+	(
+		size_t bits,
+		size_t count,
+		std::vector<mpz_class>& primes,
+		silvia_thread_pool* pool = NULL,
+		silvia_keygen_progress_cb progress = NULL,
+		void* progress_ctx = NULL
 	);
 
 private:
@@ -71,6 +163,10 @@ private:
 
 	// The one-and-only instance
 	static std::auto_ptr<silvia_issuer_keyfactory> _i;
+	static pthread_once_t _i_once;
+
+	// Create the one-and-only instance
+	static void init_i();
 };
 
 #endif // !_SILVIA_ISSUER_KEYGEN_H
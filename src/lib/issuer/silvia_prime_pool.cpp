@@ -0,0 +1,248 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_prime_pool.cpp
+
+ Pool of primes e for issuing signatures, filled in the background
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_prime_pool.h"
+#include "silvia_rand.h"
+#include "silvia_macros.h"
+#include <assert.h>
+
+silvia_prime_pool::silvia_prime_pool(size_t capacity /* = 32 */, size_t low_water /* = 8 */, const silvia_runtime* runtime /* = NULL */)
+{
+	assert(capacity > 0);
+	assert(low_water < capacity);
+
+	this->capacity = capacity;
+	this->low_water = low_water;
+
+	if (runtime != NULL)
+	{
+		this->runtime = *runtime;
+	}
+
+	stats.available = 0;
+	stats.generated = 0;
+	stats.handed_out = 0;
+	stats.misses = 0;
+
+	stats_cb = NULL;
+	stats_ctx = NULL;
+	stats_cb_running = false;
+
+	stopping = false;
+
+	pthread_mutex_init(&pool_lock, NULL);
+	pthread_cond_init(&refill_cond, NULL);
+	pthread_cond_init(&full_cond, NULL);
+	pthread_cond_init(&stats_cb_cond, NULL);
+
+	pthread_create(&thread, NULL, refill_main, this);
+}
+
+silvia_prime_pool::~silvia_prime_pool()
+{
+	pthread_mutex_lock(&pool_lock);
+
+	stopping = true;
+
+	pthread_cond_broadcast(&refill_cond);
+	pthread_cond_broadcast(&full_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	pthread_join(thread, NULL);
+
+	pthread_cond_destroy(&stats_cb_cond);
+	pthread_cond_destroy(&full_cond);
+	pthread_cond_destroy(&refill_cond);
+	pthread_mutex_destroy(&pool_lock);
+}
+
+void silvia_prime_pool::get_prime(mpz_class& e)
+{
+	pthread_mutex_lock(&pool_lock);
+
+	if (!primes.empty())
+	{
+		// Remove the prime from the pool so it can never be handed out again
+		e = primes.front();
+		primes.pop_front();
+
+		stats.handed_out++;
+		stats.available = primes.size();
+
+		if (primes.size() <= low_water)
+		{
+			pthread_cond_signal(&refill_cond);
+		}
+
+		pthread_mutex_unlock(&pool_lock);
+
+		return;
+	}
+
+	stats.misses++;
+
+	pthread_cond_signal(&refill_cond);
+	pthread_mutex_unlock(&pool_lock);
+
+	// The pool has run dry; generate a prime on the calling thread
+	e = generate_prime(runtime);
+}
+
+silvia_prime_pool_stats silvia_prime_pool::get_stats()
+{
+	pthread_mutex_lock(&pool_lock);
+
+	silvia_prime_pool_stats rv = stats;
+
+	pthread_mutex_unlock(&pool_lock);
+
+	return rv;
+}
+
+void silvia_prime_pool::set_stats_callback(silvia_prime_pool_stats_cb cb, void* ctx)
+{
+	pthread_mutex_lock(&pool_lock);
+
+	// The callback itself may replace the callback without waiting
+	while (stats_cb_running && !pthread_equal(pthread_self(), thread))
+	{
+		pthread_cond_wait(&stats_cb_cond, &pool_lock);
+	}
+
+	stats_cb = cb;
+	stats_ctx = ctx;
+
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void silvia_prime_pool::wait_until_full()
+{
+	pthread_mutex_lock(&pool_lock);
+
+	while (!stopping && (primes.size() < capacity))
+	{
+		pthread_cond_wait(&full_cond, &pool_lock);
+	}
+
+	pthread_mutex_unlock(&pool_lock);
+}
+
+/*static*/ mpz_class silvia_prime_pool::generate_prime(const silvia_runtime& runtime)
+{
+	// Generate a prime e in the interval [2^l_e-1, 2^l_e-1 + 2^l_e'-1]
+	mpz_class lower_bound;
+	mpz_setbit(_Z(lower_bound), RTPAR(l_e) - 1);
+
+	mpz_class upper_bound;
+	mpz_setbit(_Z(upper_bound), RTPAR(l_e_prime) - 1);
+	upper_bound += lower_bound;
+
+	mpz_class e = 0;
+
+	while ((e < lower_bound) || (e > upper_bound))
+	{
+		e = lower_bound;
+
+		e += runtime.get_rng()->get_random(RTPAR(l_e_prime) - 1);
+
+		while ((e < upper_bound) && !mpz_probab_prime_p(_Z(e), RTPAR(rabin_miller_its)))
+		{
+			mpz_nextprime(_Z(e), _Z(e));
+		}
+	}
+
+	return e;
+}
+
+/*static*/ void* silvia_prime_pool::refill_main(void* arg)
+{
+	silvia_prime_pool* pool = (silvia_prime_pool*) arg;
+
+	pthread_mutex_lock(&pool->pool_lock);
+
+	while (!pool->stopping)
+	{
+		// Fill the pool up to capacity; the search for a prime is
+		// done without holding the lock
+		while (!pool->stopping && (pool->primes.size() < pool->capacity))
+		{
+			pthread_mutex_unlock(&pool->pool_lock);
+
+			mpz_class e = generate_prime(pool->runtime);
+
+			pthread_mutex_lock(&pool->pool_lock);
+
+			pool->primes.push_back(e);
+
+			pool->stats.generated++;
+			pool->stats.available = pool->primes.size();
+		}
+
+		if (pool->stopping) break;
+
+		pthread_cond_broadcast(&pool->full_cond);
+
+		// Call the statistics callback without holding the lock, so
+		// it can call back into the pool and cannot stall take()
+		if (pool->stats_cb != NULL)
+		{
+			silvia_prime_pool_stats stats = pool->stats;
+			silvia_prime_pool_stats_cb stats_cb = pool->stats_cb;
+			void* stats_ctx = pool->stats_ctx;
+
+			pool->stats_cb_running = true;
+
+			pthread_mutex_unlock(&pool->pool_lock);
+
+			stats_cb(stats, stats_ctx);
+
+			pthread_mutex_lock(&pool->pool_lock);
+
+			pool->stats_cb_running = false;
+
+			pthread_cond_broadcast(&pool->stats_cb_cond);
+		}
+
+		// Sleep until the pool drops to the low-water mark
+		while (!pool->stopping && (pool->primes.size() > pool->low_water))
+		{
+			pthread_cond_wait(&pool->refill_cond, &pool->pool_lock);
+		}
+	}
+
+	pthread_mutex_unlock(&pool->pool_lock);
+
+	return NULL;
+}
@@ -0,0 +1,152 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_prime_pool.h
+
+ Pool of primes e for issuing signatures, filled in the background
+ *****************************************************************************/
+
+#ifndef _SILVIA_PRIME_POOL_H
+#define _SILVIA_PRIME_POOL_H
+
+#include <gmpxx.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <deque>
+#include "silvia_runtime.h"
+
+/**
+ * Prime pool statistics
+ */
+typedef struct
+{
+	size_t	available;	/**< the number of primes currently in the pool */
+	size_t	generated;	/**< the number of primes generated in the background */
+	size_t	handed_out;	/**< the number of primes handed out from the pool */
+	size_t	misses;		/**< the number of requests that found the pool empty */
+}
+silvia_prime_pool_stats;
+
+/**
+ * Statistics callback; called from the background thread every time the
+ * pool has been refilled. The callback receives a copy of the statistics
+ * and is called without holding the pool lock, so it may call back into
+ * the pool.
+ */
+typedef void (*silvia_prime_pool_stats_cb)(const silvia_prime_pool_stats& stats, void* ctx);
+
+/**
+ * Prime pool class; a background thread keeps a bounded pool of primes
+ * e in the interval [2^l_e-1, 2^l_e-1 + 2^l_e'-1] so the issuer does not
+ * need to search for a prime while issuing. Every prime is handed out
+ * exactly once.
+ */
+class silvia_prime_pool
+{
+public:
+	/**
+	 * Constructor; starts the background thread
+	 * @param capacity the maximum number of primes in the pool
+	 * @param low_water the number of primes at or below which the pool is refilled
+	 * @param runtime the runtime context to use (optional, by default the global parameters are used)
+	 */
+	silvia_prime_pool(size_t capacity = 32, size_t low_water = 8, const silvia_runtime* runtime = NULL);
+
+	/**
+	 * Destructor; stops the background thread
+	 */
+	~silvia_prime_pool();
+
+	/**
+	 * Take a prime from the pool; if the pool is empty, a prime is
+	 * generated on the calling thread instead
+	 * @param e receives the prime
+	 */
+	void get_prime(mpz_class& e);
+
+	/**
+	 * Get the pool statistics
+	 * @return the current statistics
+	 */
+	silvia_prime_pool_stats get_stats();
+
+	/**
+	 * Set the statistics callback; waits for a call to the previous
+	 * callback that is in progress, so its context may be released
+	 * once this returns
+	 * @param cb the callback (NULL to disable)
+	 * @param ctx context passed to the callback
+	 */
+	void set_stats_callback(silvia_prime_pool_stats_cb cb, void* ctx);
+
+	/**
+	 * Wait until the pool has been filled to capacity
+	 */
+	void wait_until_full();
+
+	/**
+	 * Generate a prime e in the interval [2^l_e-1, 2^l_e-1 + 2^l_e'-1]
+	 * @param runtime the runtime context to use
+	 * @return a prime e
+	 */
+	static mpz_class generate_prime(const silvia_runtime& runtime);
+
+private:
+	// Copying is not allowed
+	silvia_prime_pool(const silvia_prime_pool&);
+	silvia_prime_pool& operator=(const silvia_prime_pool&);
+
+	// Background thread main loop
+	static void* refill_main(void* arg);
+
+	// The pool
+	std::deque<mpz_class> primes;
+	size_t capacity;
+	size_t low_water;
+
+	// Statistics
+	silvia_prime_pool_stats stats;
+	silvia_prime_pool_stats_cb stats_cb;
+	void* stats_ctx;
+	bool stats_cb_running;
+	pthread_cond_t stats_cb_cond;
+
+	// Background thread state
+	pthread_t thread;
+	pthread_mutex_t pool_lock;
+	pthread_cond_t refill_cond;
+	pthread_cond_t full_cond;
+	bool stopping;
+
+	// The runtime context
+	silvia_runtime runtime;
+};
+
+#endif // !_SILVIA_PRIME_POOL_H
+
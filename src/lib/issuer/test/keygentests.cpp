@@ -38,6 +38,8 @@
 #include <gmpxx.h>
 #include "keygentests.h"
 #include "silvia_issuer_keygen.h"
+#include "silvia_parameters.h"
+#include "silvia_thread_pool.h"
 #include <stdio.h>
 
 CPPUNIT_TEST_SUITE_REGISTRATION(keygen_tests);
@@ -48,6 +50,7 @@ void keygen_tests::setUp()
 
 void keygen_tests::tearDown()
 {
+	silvia_system_parameters::i()->reset();
 }
 
 void keygen_tests::test_keygen()
@@ -88,3 +91,188 @@ void keygen_tests::test_keygen()
 	delete priv;
 }
 
+
+static void count_progress(silvia_keygen_stage_t stage, size_t count, double elapsed, void* ctx)
+{
+	size_t* counters = (size_t*) ctx;
+
+	counters[stage] = count;
+}
+
+void keygen_tests::test_keygen_small()
+{
+	silvia_pub_key* pub = NULL;
+	silvia_priv_key* priv = NULL;
+
+	// Generate a key-pair with a 512-bit modulus for 5 attributes
+	silvia_system_parameters::i()->set_l_n(512);
+
+	size_t counters[SILVIA_KEYGEN_DONE + 1] = { 0 };
+	silvia_thread_pool pool(2);
+
+	silvia_issuer_keyfactory::i()->generate_keypair(5, &pub, &priv, &pool, count_progress, counters);
+
+	CPPUNIT_ASSERT(counters[SILVIA_KEYGEN_SEARCHING] > 0);
+	CPPUNIT_ASSERT(counters[SILVIA_KEYGEN_PRIME_FOUND] == 2);
+	CPPUNIT_ASSERT(counters[SILVIA_KEYGEN_BASE_DERIVED] == 6);
+	CPPUNIT_ASSERT(counters[SILVIA_KEYGEN_DONE] == 6);
+
+	// Check properties of the generated private key
+	CPPUNIT_ASSERT(mpz_sizeinbase(priv->get_p().get_mpz_t(), 2) == 256);
+	CPPUNIT_ASSERT(mpz_sizeinbase(priv->get_q().get_mpz_t(), 2) == 256);
+	CPPUNIT_ASSERT(priv->get_p() != priv->get_q());
+	CPPUNIT_ASSERT(mpz_probab_prime_p(priv->get_p().get_mpz_t(), 40) >= 1);
+	CPPUNIT_ASSERT(mpz_probab_prime_p(priv->get_q().get_mpz_t(), 40) >= 1);
+	CPPUNIT_ASSERT(mpz_probab_prime_p(priv->get_p_prime().get_mpz_t(), 40) >= 1);
+	CPPUNIT_ASSERT(mpz_probab_prime_p(priv->get_q_prime().get_mpz_t(), 40) >= 1);
+
+	// Check properties of the generated public key
+	CPPUNIT_ASSERT(mpz_sizeinbase(pub->get_n().get_mpz_t(), 2) == 512);
+	CPPUNIT_ASSERT(pub->get_R().size() == 5);
+
+	CPPUNIT_ASSERT(mpz_legendre(pub->get_S().get_mpz_t(), priv->get_p().get_mpz_t()) == 1);
+	CPPUNIT_ASSERT(mpz_legendre(pub->get_S().get_mpz_t(), priv->get_q().get_mpz_t()) == 1);
+
+	CPPUNIT_ASSERT(mpz_legendre(pub->get_Z().get_mpz_t(), priv->get_p().get_mpz_t()) == 1);
+	CPPUNIT_ASSERT(mpz_legendre(pub->get_Z().get_mpz_t(), priv->get_q().get_mpz_t()) == 1);
+
+	for (int i = 0; i < 5; i++)
+	{
+		CPPUNIT_ASSERT(mpz_legendre(pub->get_R()[i].get_mpz_t(), priv->get_p().get_mpz_t()) == 1);
+		CPPUNIT_ASSERT(mpz_legendre(pub->get_R()[i].get_mpz_t(), priv->get_q().get_mpz_t()) == 1);
+		CPPUNIT_ASSERT(pub->get_R()[i] != pub->get_Z());
+	}
+
+	delete pub;
+	delete priv;
+}
+
+void keygen_tests::test_safe_primes()
+{
+	std::vector<mpz_class> primes;
+	size_t counters[SILVIA_KEYGEN_DONE + 1] = { 0 };
+
+	silvia_issuer_keyfactory::i()->generate_safe_primes(384, 4, primes, NULL, count_progress, counters);
+
+	CPPUNIT_ASSERT(primes.size() == 4);
+	CPPUNIT_ASSERT(counters[SILVIA_KEYGEN_PRIME_FOUND] == 4);
+	CPPUNIT_ASSERT(counters[SILVIA_KEYGEN_DONE] == 4);
+
+	for (size_t i = 0; i < primes.size(); i++)
+	{
+		mpz_class p_prime = (primes[i] - 1) / 2;
+
+		CPPUNIT_ASSERT(mpz_sizeinbase(primes[i].get_mpz_t(), 2) == 384);
+		CPPUNIT_ASSERT(mpz_tstbit(primes[i].get_mpz_t(), 382) == 1);
+		CPPUNIT_ASSERT(mpz_probab_prime_p(primes[i].get_mpz_t(), 40) >= 1);
+		CPPUNIT_ASSERT(mpz_probab_prime_p(p_prime.get_mpz_t(), 40) >= 1);
+
+		for (size_t j = 0; j < i; j++)
+		{
+			CPPUNIT_ASSERT(primes[i] != primes[j]);
+		}
+	}
+}
+
+void keygen_tests::test_safe_prime_distance()
+{
+	// With a single thread, all primes are found by the same worker; they
+	// must still be far enough apart to withstand Fermat factorisation
+	silvia_thread_pool pool(1);
+	std::vector<mpz_class> primes;
+
+	silvia_issuer_keyfactory::i()->generate_safe_primes(384, 4, primes, &pool);
+
+	CPPUNIT_ASSERT(primes.size() == 4);
+
+	mpz_class min_distance;
+	mpz_setbit(min_distance.get_mpz_t(), 384 - 100);
+
+	for (size_t i = 0; i < primes.size(); i++)
+	{
+		for (size_t j = 0; j < i; j++)
+		{
+			mpz_class distance = abs(primes[i] - primes[j]);
+
+			CPPUNIT_ASSERT(distance >= min_distance);
+		}
+	}
+
+	// The same goes for the factors of a generated modulus
+	silvia_pub_key* pub = NULL;
+	silvia_priv_key* priv = NULL;
+
+	silvia_system_parameters::i()->set_l_n(512);
+
+	silvia_issuer_keyfactory::i()->generate_keypair(2, &pub, &priv, &pool);
+
+	min_distance = 0;
+	mpz_setbit(min_distance.get_mpz_t(), 256 - 100);
+
+	CPPUNIT_ASSERT(abs(priv->get_p() - priv->get_q()) >= min_distance);
+
+	delete pub;
+	delete priv;
+}
+
+// Progress of a batch as seen by the callback; the callback runs on a
+// worker thread, so the results are checked on the main thread
+typedef struct
+{
+	size_t	done[3];
+	bool	complete[3];
+}
+batch_progress;
+
+static void count_batch(size_t index, const silvia_keygen_batch_entry& entry, void* ctx)
+{
+	batch_progress* progress = (batch_progress*) ctx;
+
+	progress->complete[index] = (entry.pubkey != NULL) && (entry.privkey != NULL);
+	progress->done[index]++;
+}
+
+void keygen_tests::test_keygen_batch()
+{
+	// Generate key-pairs of different sizes in one batch
+	size_t sizes[3] = { 512, 384, 512 };
+	size_t attrs[3] = { 3, 2, 5 };
+	batch_progress progress = { { 0 }, { false } };
+
+	std::vector<silvia_keygen_batch_entry> batch(3);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		batch[i].max_attr = attrs[i];
+		batch[i].l_n = sizes[i];
+	}
+
+	size_t l_n = silvia_system_parameters::i()->get_l_n();
+
+	silvia_issuer_keyfactory::i()->generate_keypairs(batch, 2, count_batch, &progress);
+
+	// The batch does not touch the system parameters
+	CPPUNIT_ASSERT(silvia_system_parameters::i()->get_l_n() == l_n);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		silvia_pub_key* pub = batch[i].pubkey;
+		silvia_priv_key* priv = batch[i].privkey;
+
+		CPPUNIT_ASSERT(progress.done[i] == 1);
+		CPPUNIT_ASSERT(progress.complete[i]);
+		CPPUNIT_ASSERT(batch[i].elapsed > 0.0);
+
+		CPPUNIT_ASSERT(mpz_sizeinbase(pub->get_n().get_mpz_t(), 2) == sizes[i]);
+		CPPUNIT_ASSERT(pub->get_n() == priv->get_p() * priv->get_q());
+		CPPUNIT_ASSERT(pub->get_R().size() == attrs[i]);
+		CPPUNIT_ASSERT(mpz_probab_prime_p(priv->get_p_prime().get_mpz_t(), 40) >= 1);
+		CPPUNIT_ASSERT(mpz_probab_prime_p(priv->get_q_prime().get_mpz_t(), 40) >= 1);
+
+		CPPUNIT_ASSERT(mpz_legendre(pub->get_Z().get_mpz_t(), priv->get_p().get_mpz_t()) == 1);
+		CPPUNIT_ASSERT(mpz_legendre(pub->get_Z().get_mpz_t(), priv->get_q().get_mpz_t()) == 1);
+
+		delete pub;
+		delete priv;
+	}
+}
@@ -42,10 +42,18 @@ class keygen_tests : public CppUnit::TestFixture
 {
 	CPPUNIT_TEST_SUITE(keygen_tests);
 	CPPUNIT_TEST(test_keygen);
+	CPPUNIT_TEST(test_keygen_small);
+	CPPUNIT_TEST(test_safe_primes);
+	CPPUNIT_TEST(test_safe_prime_distance);
+	CPPUNIT_TEST(test_keygen_batch);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void test_keygen();
+	void test_keygen_small();
+	void test_safe_primes();
+	void test_safe_prime_distance();
+	void test_keygen_batch();
 
 	void setUp();
 	void tearDown();
@@ -0,0 +1,216 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ primepooltests.cpp
+
+ Tests the prime pool
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <gmpxx.h>
+#include <set>
+#include "primepooltests.h"
+#include "silvia_prime_pool.h"
+#include "silvia_parameters.h"
+#include <stdio.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(prime_pool_tests);
+
+void prime_pool_tests::setUp()
+{
+}
+
+void prime_pool_tests::tearDown()
+{
+}
+
+// Refill counter that calls back into the pool from the callback
+struct refill_counter
+{
+	silvia_prime_pool* pool;
+	pthread_mutex_t lock;
+	size_t refills;
+	size_t generated;
+};
+
+static void count_refills(const silvia_prime_pool_stats& stats, void* ctx)
+{
+	refill_counter* counter = (refill_counter*) ctx;
+
+	silvia_prime_pool_stats current = counter->pool->get_stats();
+
+	pthread_mutex_lock(&counter->lock);
+
+	counter->refills++;
+	counter->generated = current.generated;
+
+	pthread_mutex_unlock(&counter->lock);
+}
+
+// Wait until the callback has been called at least <count> times
+static size_t wait_for_refills(refill_counter& counter, size_t count)
+{
+	size_t refills = 0;
+
+	for (int i = 0; i < 5000; i++)
+	{
+		pthread_mutex_lock(&counter.lock);
+
+		refills = counter.refills;
+
+		pthread_mutex_unlock(&counter.lock);
+
+		if (refills >= count) break;
+
+		usleep(1000);
+	}
+
+	return refills;
+}
+
+static bool is_valid_e(const mpz_class& e)
+{
+	silvia_system_parameters* params = silvia_system_parameters::i();
+
+	mpz_class lower_bound;
+	mpz_setbit(lower_bound.get_mpz_t(), params->get_l_e() - 1);
+
+	mpz_class upper_bound;
+	mpz_setbit(upper_bound.get_mpz_t(), params->get_l_e_prime() - 1);
+	upper_bound += lower_bound;
+
+	return (e >= lower_bound) && (e <= upper_bound) && mpz_probab_prime_p(e.get_mpz_t(), params->get_rabin_miller_its());
+}
+
+void prime_pool_tests::test_prime_pool()
+{
+	silvia_prime_pool pool(16, 4);
+
+	refill_counter counter;
+
+	counter.pool = &pool;
+	counter.refills = 0;
+	counter.generated = 0;
+	pthread_mutex_init(&counter.lock, NULL);
+
+	pool.set_stats_callback(count_refills, &counter);
+	pool.wait_until_full();
+
+	silvia_prime_pool_stats stats = pool.get_stats();
+
+	CPPUNIT_ASSERT(stats.available == 16);
+	CPPUNIT_ASSERT(stats.generated == 16);
+	CPPUNIT_ASSERT(stats.handed_out == 0);
+	CPPUNIT_ASSERT(stats.misses == 0);
+
+	// Take primes from the full pool; this should not involve a prime search
+	std::set<mpz_class> seen;
+
+	struct timeval before, after;
+
+	gettimeofday(&before, NULL);
+
+	for (int i = 0; i < 12; i++)
+	{
+		mpz_class e;
+
+		pool.get_prime(e);
+
+		seen.insert(e);
+	}
+
+	gettimeofday(&after, NULL);
+
+	unsigned long long duration = (after.tv_sec - before.tv_sec) * 1000000 + (after.tv_usec - before.tv_usec);
+
+	printf("p(%0.3fus)", (float) duration / 12.0f); fflush(stdout);
+
+	// Every prime must be handed out only once
+	CPPUNIT_ASSERT(seen.size() == 12);
+
+	for (std::set<mpz_class>::iterator i = seen.begin(); i != seen.end(); i++)
+	{
+		CPPUNIT_ASSERT(is_valid_e(*i));
+	}
+
+	// Dropping below the low-water mark triggers a refill
+	pool.wait_until_full();
+
+	stats = pool.get_stats();
+
+	CPPUNIT_ASSERT(stats.available == 16);
+	CPPUNIT_ASSERT(stats.generated == 28);
+	CPPUNIT_ASSERT(stats.handed_out == 12);
+	CPPUNIT_ASSERT(wait_for_refills(counter, 2) >= 2);
+
+	// Primes from the refilled pool must differ from the earlier ones
+	for (int i = 0; i < 16; i++)
+	{
+		mpz_class e;
+
+		pool.get_prime(e);
+
+		CPPUNIT_ASSERT(is_valid_e(e));
+		CPPUNIT_ASSERT(seen.insert(e).second);
+	}
+
+	pool.set_stats_callback(NULL, NULL);
+
+	pthread_mutex_destroy(&counter.lock);
+}
+
+void prime_pool_tests::test_prime_pool_empty()
+{
+	silvia_prime_pool pool(2, 1);
+
+	// Drain the pool faster than it can be refilled; requests that
+	// find the pool empty must still receive a valid prime
+	std::set<mpz_class> seen;
+
+	for (int i = 0; i < 10; i++)
+	{
+		mpz_class e;
+
+		pool.get_prime(e);
+
+		CPPUNIT_ASSERT(is_valid_e(e));
+
+		seen.insert(e);
+	}
+
+	CPPUNIT_ASSERT(seen.size() == 10);
+
+	silvia_prime_pool_stats stats = pool.get_stats();
+
+	CPPUNIT_ASSERT(stats.handed_out + stats.misses == 10);
+}
@@ -35,6 +35,7 @@
 #include "config.h"
 #include "silvia_nfc_card.h"
 #include "silvia_macros.h"
+#include "silvia_timer.h"
 #include <assert.h>
 #include <string.h>
 #include <vector>
@@ -79,7 +80,7 @@ bool silvia_nfc_card::status()
 	return connected;
 }
 	
-bool silvia_nfc_card::transmit(bytestring APDU, bytestring& data, unsigned short& sw)
+bool silvia_nfc_card::transmit(const bytestring& APDU, bytestring& data, unsigned short& sw)
 {
 	if (!transmit(APDU, data))
 	{
@@ -94,20 +95,22 @@ bool silvia_nfc_card::transmit(bytestring APDU, bytestring& data, unsigned short
 	return true;
 }
 
-bool silvia_nfc_card::transmit(bytestring APDU, bytestring& data_sw)
+bool silvia_nfc_card::transmit(const bytestring& APDU, bytestring& data_sw)
 {
 	if (!connected) return false;
 	
-	data_sw.resize(65536);
+	// Receive on the stack; the response is copied into the byte
+	// string, which only allocates for extended length responses
+	unsigned char response[65536];
 	
-	int out_len = nfc_initiator_transceive_bytes(device, APDU.byte_str(), APDU.size(), data_sw.byte_str(), data_sw.size(), 0);
+	int out_len = nfc_initiator_transceive_bytes(device, APDU.const_byte_str(), APDU.size(), response, sizeof(response), 0);
 
 	if (out_len < 2)
 	{
 		return false;
 	}
 	
-	data_sw.resize(out_len);
+	data_sw = bytestring(response, out_len);
 	
 	if (data_sw.size() < 2)
 	{
@@ -117,6 +120,47 @@ bool silvia_nfc_card::transmit(bytestring APDU, bytestring& data_sw)
 	return true;
 }
 
+bool silvia_nfc_card::transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings /* = NULL */)
+{
+	if (!connected) return false;
+	
+	silvia_timer timer;
+	
+	if (recv_buf.size() < 65536)
+	{
+		recv_buf.resize(65536);
+	}
+	
+	data_sw.reserve(data_sw.size() + APDUs.size());
+	
+	for (std::vector<bytestring>::const_iterator i = APDUs.begin(); i != APDUs.end(); i++)
+	{
+		timer.mark();
+		
+		int out_len = nfc_initiator_transceive_bytes(device, i->const_byte_str(), i->size(), &recv_buf[0], recv_buf.size(), 0);
+		
+		if (out_len < 2)
+		{
+			return false;
+		}
+		
+		if (timings != NULL)
+		{
+			timings->push_back(timer.elapsed());
+		}
+		
+		data_sw.push_back(bytestring(&recv_buf[0], out_len));
+		
+		// Stop at the first status word other than 9000
+		if ((recv_buf[out_len - 2] != 0x90) || (recv_buf[out_len - 1] != 0x00))
+		{
+			break;
+		}
+	}
+	
+	return true;
+}
+
 std::string silvia_nfc_card::get_reader_name()
 {
 	return reader_name;
@@ -193,3 +237,107 @@ silvia_nfc_card_monitor::~silvia_nfc_card_monitor()
 	nfc_close(device);
 	nfc_exit(context);
 }
+
+////////////////////////////////////////////////////////////////////////
+// Reader monitor class
+////////////////////////////////////////////////////////////////////////
+
+// The maximum number of NFC devices that are listed
+#define NFC_MAX_DEVICES	32
+
+silvia_nfc_reader_monitor::silvia_nfc_reader_monitor(std::string connstring)
+{
+	this->connstring = connstring;
+	
+	device = NULL;
+	
+	nfc_init(&context);
+}
+
+silvia_nfc_reader_monitor::~silvia_nfc_reader_monitor()
+{
+	if (device != NULL)
+	{
+		nfc_close(device);
+	}
+	
+	if (context != NULL)
+	{
+		nfc_exit(context);
+	}
+}
+
+bool silvia_nfc_reader_monitor::wait_for_card(silvia_nfc_card** card)
+{
+	assert(card != NULL);
+	
+	if (context == NULL) return false;
+	
+	if (device == NULL)
+	{
+		device = nfc_open(context, connstring.c_str());
+		
+		if (device == NULL)
+		{
+			return false;
+		}
+		
+		nfc_initiator_init(device);
+	}
+	
+	// CAVEAT: only tested with PN533
+	const nfc_modulation modulation = { NMT_ISO14443A, NBR_106 };
+	
+	// Poll for a card
+	int rv = 0;
+	nfc_target target;
+	
+	while ((rv = nfc_initiator_select_passive_target(device, modulation, NULL, 0, &target)) == 0)
+	{
+		usleep(10000);
+	}
+	
+	if (rv < 0)
+	{
+		return false;
+	}
+	
+	*card = new silvia_nfc_card(device, target, get_reader_name());
+	
+	return true;
+}
+
+std::string silvia_nfc_reader_monitor::get_reader_name()
+{
+	if (device != NULL)
+	{
+		return std::string(nfc_device_get_name(device)) + " (" + connstring + ")";
+	}
+	
+	return connstring;
+}
+
+/*static*/ bool silvia_nfc_reader_monitor::list_readers(std::vector<std::string>& connstrings)
+{
+	nfc_context* list_context = NULL;
+	
+	nfc_init(&list_context);
+	
+	if (list_context == NULL)
+	{
+		return false;
+	}
+	
+	nfc_connstring devices[NFC_MAX_DEVICES];
+	
+	size_t num_devices = nfc_list_devices(list_context, devices, NFC_MAX_DEVICES);
+	
+	for (size_t i = 0; i < num_devices; i++)
+	{
+		connstrings.push_back(std::string(devices[i]));
+	}
+	
+	nfc_exit(list_context);
+	
+	return true;
+}
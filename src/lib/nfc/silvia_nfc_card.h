@@ -37,6 +37,7 @@
 #include <nfc/nfc.h>
 #include <memory>
 #include <string>
+#include <vector>
  
 #ifndef _SILVIA_NFC_CARD_H
 #define _SILVIA_NFC_CARD_H
@@ -80,7 +81,7 @@ public:
 	 * @param sw The return status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data, unsigned short& sw);
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw);
 	
 	/**
 	 * Transmit an APDU and receive return data
@@ -88,7 +89,18 @@ public:
 	 * @param data_sw The return data including the status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data_sw);
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw);
+	
+	/**
+	 * Transmit a batch of APDUs and receive the return data; the exchange
+	 * stops after the first APDU for which the card returns a status word
+	 * other than 9000
+	 * @param APDUs The APDUs to transmit
+	 * @param data_sw The return data including the status word of every APDU that was exchanged
+	 * @param timings The duration of every APDU exchange in nanoseconds (optional)
+	 * @return true if all APDU exchanges completed successfully, regardless of the status words
+	 */
+	virtual bool transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings = NULL);
 	
 	/**
 	 * Get the card reader name in which the card resides
@@ -106,6 +118,9 @@ private:
 	
 	// The card reader name
 	std::string reader_name;
+	
+	// Receive buffer for batched exchanges
+	std::vector<uint8_t> recv_buf;
 };
  
 /**
@@ -144,5 +159,55 @@ private:
 	// The one-and-only instance
 	static std::auto_ptr<silvia_nfc_card_monitor> _i;	
 };
+
+/**
+ * Reader monitor class; watches a single NFC device using its own libnfc
+ * context, so every thread can monitor a reader of its own
+ */
+class silvia_nfc_reader_monitor
+{
+public:
+	/**
+	 * Constructor
+	 * @param connstring the libnfc connection string of the device to monitor
+	 */
+	silvia_nfc_reader_monitor(std::string connstring);
+	
+	/**
+	 * Destructor
+	 */
+	~silvia_nfc_reader_monitor();
+	
+	/**
+	 * Wait for a card to be presented to the reader
+	 * @param card returns a card object for the presented card
+	 * @return true if a card was successfully detected and a new card
+	 *              object was created
+	 */
+	bool wait_for_card(silvia_nfc_card** card);
+	
+	/**
+	 * Get the name of the monitored reader
+	 * @return the reader name
+	 */
+	std::string get_reader_name();
+	
+	/**
+	 * List the NFC devices that are attached to the system
+	 * @param connstrings returns the connection strings of the devices
+	 * @return true if the devices could be listed
+	 */
+	static bool list_readers(std::vector<std::string>& connstrings);
+	
+private:
+	// Copying is not allowed
+	silvia_nfc_reader_monitor(const silvia_nfc_reader_monitor&);
+	silvia_nfc_reader_monitor& operator=(const silvia_nfc_reader_monitor&);
+	
+	// State
+	nfc_context* context;
+	nfc_device* device;
+	std::string connstring;
+};
  
 #endif // !_SILVIA_NFC_CARD_H
@@ -35,6 +35,7 @@
 #include "config.h"
 #include "silvia_pcsc_card.h"
 #include "silvia_macros.h"
+#include "silvia_timer.h"
 #include <PCSC/winscard.h>
 #include <assert.h>
 #include <string.h>
@@ -91,7 +92,7 @@ bool silvia_pcsc_card::status()
 	return connected;
 }
 	
-bool silvia_pcsc_card::transmit(bytestring APDU, bytestring& data, unsigned short& sw)
+bool silvia_pcsc_card::transmit(const bytestring& APDU, bytestring& data, unsigned short& sw)
 {
 	if (!transmit(APDU, data))
 	{
@@ -106,21 +107,23 @@ bool silvia_pcsc_card::transmit(bytestring APDU, bytestring& data, unsigned shor
 	return true;
 }
 
-bool silvia_pcsc_card::transmit(bytestring APDU, bytestring& data_sw)
+bool silvia_pcsc_card::transmit(const bytestring& APDU, bytestring& data_sw)
 {
 	if (!connected) return false;
 	
-	data_sw.resize(65536);
-	DWORD out_len = 65536;
+	// Receive on the stack; the response is copied into the byte
+	// string, which only allocates for extended length responses
+	unsigned char response[65536];
+	DWORD out_len = sizeof(response);
 	SCARD_IO_REQUEST recv_req;
 		
 	LONG rv = SCardTransmit(
 		card_handle, 
 		protocol == SCARD_PROTOCOL_T0 ? SCARD_PCI_T0 : SCARD_PCI_T1, 
-		APDU.byte_str(), 
+		APDU.const_byte_str(), 
 		APDU.size(), 
 		&recv_req,
-		data_sw.byte_str(),
+		response,
 		&out_len);
 		
 	if (rv != SCARD_S_SUCCESS)
@@ -128,7 +131,7 @@ bool silvia_pcsc_card::transmit(bytestring APDU, bytestring& data_sw)
 		return false;
 	}
 	
-	data_sw.resize(out_len);
+	data_sw = bytestring(response, out_len);
 	
 	if (data_sw.size() < 2)
 	{
@@ -138,6 +141,69 @@ bool silvia_pcsc_card::transmit(bytestring APDU, bytestring& data_sw)
 	return true;
 }
 
+bool silvia_pcsc_card::transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings /* = NULL */)
+{
+	if (!connected) return false;
+	
+	silvia_timer timer;
+	
+	if (recv_buf.size() < 65536)
+	{
+		recv_buf.resize(65536);
+	}
+	
+	data_sw.reserve(data_sw.size() + APDUs.size());
+	
+	// Perform all exchanges in a single transaction so no other
+	// application can interleave commands with the batch
+	if (SCardBeginTransaction(card_handle) != SCARD_S_SUCCESS)
+	{
+		return false;
+	}
+	
+	bool rv = true;
+	
+	for (std::vector<bytestring>::const_iterator i = APDUs.begin(); i != APDUs.end(); i++)
+	{
+		DWORD out_len = recv_buf.size();
+		SCARD_IO_REQUEST recv_req;
+		
+		timer.mark();
+		
+		LONG tx_rv = SCardTransmit(
+			card_handle, 
+			protocol == SCARD_PROTOCOL_T0 ? SCARD_PCI_T0 : SCARD_PCI_T1, 
+			i->const_byte_str(), 
+			i->size(), 
+			&recv_req,
+			&recv_buf[0],
+			&out_len);
+		
+		if ((tx_rv != SCARD_S_SUCCESS) || (out_len < 2))
+		{
+			rv = false;
+			break;
+		}
+		
+		if (timings != NULL)
+		{
+			timings->push_back(timer.elapsed());
+		}
+		
+		data_sw.push_back(bytestring(&recv_buf[0], out_len));
+		
+		// Stop at the first status word other than 9000
+		if ((recv_buf[out_len - 2] != 0x90) || (recv_buf[out_len - 1] != 0x00))
+		{
+			break;
+		}
+	}
+	
+	SCardEndTransaction(card_handle, SCARD_LEAVE_CARD);
+	
+	return rv;
+}
+
 std::string silvia_pcsc_card::get_reader_name()
 {
 	return reader_name;
@@ -266,3 +332,110 @@ silvia_pcsc_card_monitor::~silvia_pcsc_card_monitor()
 {
 	SCardReleaseContext(pcsc_context);
 }
+
+////////////////////////////////////////////////////////////////////////
+// Reader monitor class
+////////////////////////////////////////////////////////////////////////
+
+silvia_pcsc_reader_monitor::silvia_pcsc_reader_monitor(std::string reader_name)
+{
+	this->reader_name = reader_name;
+	
+	valid = (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &pcsc_context) == SCARD_S_SUCCESS);
+}
+
+silvia_pcsc_reader_monitor::~silvia_pcsc_reader_monitor()
+{
+	if (valid)
+	{
+		SCardReleaseContext(pcsc_context);
+	}
+}
+
+bool silvia_pcsc_reader_monitor::wait_for_card(silvia_pcsc_card** card)
+{
+	assert(card != NULL);
+	
+	if (!valid) return false;
+	
+	SCARD_READERSTATE reader_state;
+	
+	reader_state.szReader = reader_name.c_str();
+	reader_state.pvUserData = NULL;
+	reader_state.dwCurrentState = SCARD_STATE_UNAWARE;
+	reader_state.dwEventState = SCARD_STATE_UNAWARE;
+	reader_state.cbAtr = MAX_ATR_SIZE;
+	
+	while (SCardGetStatusChange(pcsc_context, INFINITE, &reader_state, 1) == SCARD_S_SUCCESS)
+	{
+		if (FLAG_SET(reader_state.dwEventState, SCARD_STATE_PRESENT))
+		{
+			// Attempt to connect to the card
+			DWORD active_protocol;
+			SCARDHANDLE card_handle;
+			
+			LONG rv = SCardConnect(pcsc_context, reader_name.c_str(), SCARD_SHARE_SHARED, SCARD_PROTOCOL_T0 | SCARD_PROTOCOL_T1, &card_handle, &active_protocol);
+			
+			if (rv == SCARD_S_SUCCESS)
+			{
+				*card = new silvia_pcsc_card(card_handle, active_protocol, reader_name);
+				
+				return true;
+			}
+		}
+		
+		reader_state.dwCurrentState = reader_state.dwEventState;
+	}
+	
+	return false;
+}
+
+std::string silvia_pcsc_reader_monitor::get_reader_name()
+{
+	return reader_name;
+}
+
+/*static*/ bool silvia_pcsc_reader_monitor::list_readers(std::vector<std::string>& readers)
+{
+	SCARDCONTEXT list_context;
+	
+	if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &list_context) != SCARD_S_SUCCESS)
+	{
+		return false;
+	}
+	
+	DWORD reader_len = 0;
+	
+	LONG rv = SCardListReaders(list_context, NULL, NULL, &reader_len);
+	
+	if ((rv != SCARD_S_SUCCESS) || (reader_len == 0))
+	{
+		SCardReleaseContext(list_context);
+		
+		return false;
+	}
+	
+	std::vector<char> reader_list(reader_len);
+	
+	rv = SCardListReaders(list_context, NULL, &reader_list[0], &reader_len);
+	
+	SCardReleaseContext(list_context);
+	
+	if (rv != SCARD_S_SUCCESS)
+	{
+		return false;
+	}
+	
+	// The reader names are a sequence of null-terminated strings that
+	// ends with an empty string
+	const char* name = &reader_list[0];
+	
+	while ((name < &reader_list[0] + reader_len) && (*name != '\0'))
+	{
+		readers.push_back(std::string(name));
+		
+		name += strlen(name) + 1;
+	}
+	
+	return true;
+}
@@ -38,6 +38,7 @@
 #include <PCSC/wintypes.h>
 #include <memory>
 #include <string>
+#include <vector>
  
 #ifndef _SILVIA_PCSC_CARD_H
 #define _SILVIA_PCSC_CARD_H
@@ -82,7 +83,7 @@ public:
 	 * @param sw The return status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data, unsigned short& sw);
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw);
 	
 	/**
 	 * Transmit an APDU and receive return data
@@ -90,7 +91,18 @@ public:
 	 * @param data_sw The return data including the status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data_sw);
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw);
+	
+	/**
+	 * Transmit a batch of APDUs and receive the return data; the exchange
+	 * stops after the first APDU for which the card returns a status word
+	 * other than 9000
+	 * @param APDUs The APDUs to transmit
+	 * @param data_sw The return data including the status word of every APDU that was exchanged
+	 * @param timings The duration of every APDU exchange in nanoseconds (optional)
+	 * @return true if all APDU exchanges completed successfully, regardless of the status words
+	 */
+	virtual bool transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings = NULL);
 	
 	/**
 	 * Get the card reader name in which the card resides
@@ -108,6 +120,9 @@ private:
 	
 	// The card reader name
 	std::string reader_name;
+	
+	// Receive buffer for batched exchanges
+	std::vector<BYTE> recv_buf;
 };
  
 /**
@@ -145,5 +160,55 @@ private:
 	// The one-and-only instance
 	static std::auto_ptr<silvia_pcsc_card_monitor> _i;	
 };
+
+/**
+ * Reader monitor class; watches a single card reader using its own PC/SC
+ * context, so every thread can monitor a reader of its own
+ */
+class silvia_pcsc_reader_monitor
+{
+public:
+	/**
+	 * Constructor
+	 * @param reader_name the name of the reader to monitor
+	 */
+	silvia_pcsc_reader_monitor(std::string reader_name);
+	
+	/**
+	 * Destructor
+	 */
+	~silvia_pcsc_reader_monitor();
+	
+	/**
+	 * Wait for a card to be inserted in the reader
+	 * @param card returns a card object for the inserted card
+	 * @return true if a card was successfully detected and a new card
+	 *              object was created
+	 */
+	bool wait_for_card(silvia_pcsc_card** card);
+	
+	/**
+	 * Get the name of the monitored reader
+	 * @return the reader name
+	 */
+	std::string get_reader_name();
+	
+	/**
+	 * List the card readers that are attached to the system
+	 * @param readers returns the reader names
+	 * @return true if the readers could be listed
+	 */
+	static bool list_readers(std::vector<std::string>& readers);
+	
+private:
+	// Copying is not allowed
+	silvia_pcsc_reader_monitor(const silvia_pcsc_reader_monitor&);
+	silvia_pcsc_reader_monitor& operator=(const silvia_pcsc_reader_monitor&);
+	
+	// State
+	bool valid;
+	SCARDCONTEXT pcsc_context;
+	std::string reader_name;
+};
  
 #endif // !_SILVIA_PCSC_CARD_H
@@ -41,156 +41,312 @@
 #include "silvia_macros.h"
 #include "silvia_hash.h"
 #include "silvia_asn1.h"
+#include "silvia_multiexp.h"
+#include "silvia_thread_pool.h"
+#include <pthread.h>
 #include <vector>
+#include <deque>
+#include <map>
 #include <assert.h>
 
-silvia_prover::silvia_prover(silvia_pub_key* pubkey, silvia_credential* credential)
+silvia_prover::silvia_prover(silvia_pub_key* pubkey, silvia_credential* credential, const silvia_runtime* runtime /* = NULL */)
 {
 	this->pubkey = pubkey;
 	this->credential = credential;
+
+	if (runtime != NULL)
+	{
+		this->runtime = *runtime;
+	}
+
+	pending_coupons = 0;
+
+	pthread_mutex_init(&coupon_lock, NULL);
+	pthread_cond_init(&coupon_cond, NULL);
+}
+
+silvia_prover::~silvia_prover()
+{
+	wait_for_coupons();
+
+	pthread_cond_destroy(&coupon_cond);
+	pthread_mutex_destroy(&coupon_lock);
+}
+
+/**
+ * Job that computes a single coupon in the background; it deletes
+ * itself when it is done
+ */
+class silvia_prover::coupon_job : public silvia_job
+{
+public:
+	coupon_job(silvia_prover* prover, const std::vector<bool>& D)
+	{
+		this->prover = prover;
+		this->D = D;
+	}
+
+	virtual void run()
+	{
+		silvia_proof_coupon coupon;
+
+		prover->make_coupon(D, coupon);
+		prover->add_coupon(coupon);
+
+		pthread_mutex_lock(&prover->coupon_lock);
+
+		if (--prover->pending_coupons == 0)
+		{
+			pthread_cond_broadcast(&prover->coupon_cond);
+		}
+
+		pthread_mutex_unlock(&prover->coupon_lock);
+
+		delete this;
+	}
+
+private:
+	silvia_prover* prover;
+	std::vector<bool> D;
+};
+
+void silvia_prover::precompute(const std::vector<bool>& D, size_t count, silvia_thread_pool* pool /* = NULL */)
+{
+	if (pool == NULL)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			silvia_proof_coupon coupon;
+
+			make_coupon(D, coupon);
+			add_coupon(coupon);
+		}
+
+		return;
+	}
+
+	// The background jobs share the public key with this prover, so
+	// its tables are built before the first job starts
+	pubkey->precompute(runtime.get_params());
+
+	pthread_mutex_lock(&coupon_lock);
+	pending_coupons += count;
+	pthread_mutex_unlock(&coupon_lock);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		pool->submit(new coupon_job(this, D));
+	}
+}
+
+size_t silvia_prover::get_coupon_count(const std::vector<bool>& D)
+{
+	size_t count = 0;
+
+	pthread_mutex_lock(&coupon_lock);
+
+	std::map<std::vector<bool>, std::deque<silvia_proof_coupon> >::iterator found = coupons.find(D);
+
+	if (found != coupons.end())
+	{
+		count = found->second.size();
+	}
+
+	pthread_mutex_unlock(&coupon_lock);
+
+	return count;
+}
+
+void silvia_prover::wait_for_coupons()
+{
+	pthread_mutex_lock(&coupon_lock);
+
+	while (pending_coupons > 0)
+	{
+		pthread_cond_wait(&coupon_cond, &coupon_lock);
+	}
+
+	pthread_mutex_unlock(&coupon_lock);
+}
+
+void silvia_prover::clear_coupons()
+{
+	pthread_mutex_lock(&coupon_lock);
+	coupons.clear();
+	pthread_mutex_unlock(&coupon_lock);
+}
+
+void silvia_prover::add_coupon(const silvia_proof_coupon& coupon)
+{
+	pthread_mutex_lock(&coupon_lock);
+	coupons[coupon.D].push_back(coupon);
+	pthread_mutex_unlock(&coupon_lock);
+}
+
+bool silvia_prover::take_coupon(const std::vector<bool>& D, silvia_proof_coupon& coupon)
+{
+	bool rv = false;
+
+	pthread_mutex_lock(&coupon_lock);
+
+	std::map<std::vector<bool>, std::deque<silvia_proof_coupon> >::iterator found = coupons.find(D);
+
+	if ((found != coupons.end()) && !found->second.empty())
+	{
+		// Remove the coupon from the pool so that it is never reused
+		coupon = found->second.front();
+		found->second.pop_front();
+
+		rv = true;
+	}
+
+	pthread_mutex_unlock(&coupon_lock);
+
+	return rv;
 }
 	
-void silvia_prover::prove
+void silvia_prover::make_coupon
 (
-	std::vector<bool> D,
-	mpz_class n1,
-	mpz_class context,
-	mpz_class& c,
-	mpz_class& A_prime,
-	mpz_class& e_hat,
-	mpz_class& v_prime_hat,
-	std::vector<mpz_class>& a_i_hat,
-	std::vector<silvia_attribute*>& a_i,
+	const std::vector<bool>& D,
+	silvia_proof_coupon& coupon,
 	mpz_class* ext_e_tilde /* = NULL */,
 	mpz_class* ext_v_prime_tilde /* = NULL */,
 	mpz_class* ext_r_A /* = NULL */,
 	std::vector<mpz_class>* ext_a_tilde /* = NULL */
 )
 {
-	// Generate random blinding values
-	mpz_class e_tilde = (ext_e_tilde == NULL) ? silvia_rng::i()->get_random(SYSPAR(l_e_prime) + SYSPAR(l_statzk) + SYSPAR(l_H)) : *ext_e_tilde;
-	mpz_class v_prime_tilde = (ext_v_prime_tilde == NULL) ? silvia_rng::i()->get_random(SYSPAR(l_v) + SYSPAR(l_statzk) + SYSPAR(l_H)) : *ext_v_prime_tilde;
-	mpz_class r_A = (ext_r_A == NULL) ? silvia_rng::i()->get_random(SYSPAR(l_n) + SYSPAR(l_statzk)) : *ext_r_A;
-	
-	std::vector<mpz_class> a_tilde;
-	std::vector<size_t> R_index; // will hold references to the index in the R bases used in the ZKPs for unrevealed attributes
+	// Determine which attributes are hidden; R_index will hold the
+	// index in the R bases used in the ZKPs for unrevealed attributes
+	std::vector<size_t> R_index;
 	R_index.push_back(0); // we always hide the master secret!
 	
-	if (ext_a_tilde == NULL)
+	size_t attr_index = 1;
+	
+	for (std::vector<bool>::const_iterator i = D.begin(); i != D.end(); i++)
 	{
-		// Add random blinding value for the master secret
-		a_tilde.push_back(silvia_rng::i()->get_random(SYSPAR(l_m) + SYSPAR(l_statzk) + SYSPAR(l_H)));
-		
-		size_t r_index = 1;
-		
-		for (std::vector<bool>::iterator i = D.begin(); i != D.end(); i++)
+		if (*i == false)
 		{
-			if (*i == false)
-			{
-				// Add random blinding value for attribute that will not be revealed
-				a_tilde.push_back(silvia_rng::i()->get_random(SYSPAR(l_m) + SYSPAR(l_statzk) + SYSPAR(l_H)));
-				R_index.push_back(r_index);
-			}
-			
-			r_index++;
+			R_index.push_back(attr_index);
 		}
-	}
-	else
-	{
-		a_tilde = *ext_a_tilde;
-		
-		size_t r_index = 1;
 		
-		for (std::vector<bool>::iterator i = D.begin(); i != D.end(); i++)
-		{
-			if (*i == false)
-			{
-				R_index.push_back(r_index);
-			}
-			
-			r_index++;
-		}
+		attr_index++;
 	}
 	
-	// Calculate A'
-	mpz_class S_r_A;
-	mpz_powm(_Z(S_r_A), _Z(pubkey->get_S()), _Z(r_A), _Z(pubkey->get_n()));
+	// Generate all random blinding values in one batch: e~, v'~, r_A
+	// and one a~ for the master secret and each hidden attribute
+	std::vector<size_t> rand_bits;
+	
+	rand_bits.push_back(RTPAR(l_e_prime) + RTPAR(l_statzk) + RTPAR(l_H));
+	rand_bits.push_back(RTPAR(l_v) + RTPAR(l_statzk) + RTPAR(l_H));
+	rand_bits.push_back(RTPAR(l_n) + RTPAR(l_statzk));
+	rand_bits.resize(3 + R_index.size(), RTPAR(l_m) + RTPAR(l_statzk) + RTPAR(l_H));
+	
+	std::vector<mpz_class> rand_vals;
+	
+	runtime.get_rng()->get_random(rand_vals, rand_bits);
+	
+	coupon.D = D;
+	coupon.e_tilde = (ext_e_tilde == NULL) ? rand_vals[0] : *ext_e_tilde;
+	coupon.v_prime_tilde = (ext_v_prime_tilde == NULL) ? rand_vals[1] : *ext_v_prime_tilde;
 	
-	A_prime = credential->get_A() * S_r_A;
+	mpz_class r_A = (ext_r_A == NULL) ? rand_vals[2] : *ext_r_A;
 	
-	mpz_mod(_Z(A_prime), _Z(A_prime), _Z(pubkey->get_n()));
+	if (ext_a_tilde == NULL)
+	{
+		coupon.a_tilde.assign(rand_vals.begin() + 3, rand_vals.end());
+	}
+	else
+	{
+		coupon.a_tilde = *ext_a_tilde;
+	}
+	
+	// Calculate A' = A * S^r_A
+	silvia_multiexp A_prime_me(pubkey->get_modulus());
 	
-	// Calculate Z~
+	A_prime_me.add(credential->get_A(), 1);
+	A_prime_me.add(pubkey->get_fixed_S(), r_A);
 	
-	// Calculate factor A'^e~
-	mpz_class A_prime_e_tilde;
-	mpz_powm(_Z(A_prime_e_tilde), _Z(A_prime), _Z(e_tilde), _Z(pubkey->get_n()));
+	coupon.A_prime = A_prime_me.compute();
 	
-	// Calculate factor S^v'~
-	mpz_class S_v_prime_tilde;
-	mpz_powm(_Z(S_v_prime_tilde), _Z(pubkey->get_S()), _Z(v_prime_tilde), _Z(pubkey->get_n()));
+	// Calculate Z~ = A'^e~ * S^v'~ * prod(Ri^ai~) for non-disclosed
+	// attributes including the master secret
+	silvia_multiexp Z_tilde_me(pubkey->get_modulus());
 	
-	// Compute factors Ri^ai~ for non-disclosed attributes including the master secret
-	mpz_class Ri_factor(1);
+	Z_tilde_me.add(coupon.A_prime, coupon.e_tilde);
+	Z_tilde_me.add(pubkey->get_fixed_S(), coupon.v_prime_tilde);
 	
 	std::vector<size_t>::iterator r_index = R_index.begin();
 	
-	for (std::vector<mpz_class>::iterator i = a_tilde.begin(); i != a_tilde.end(); i++)
+	for (std::vector<mpz_class>::iterator i = coupon.a_tilde.begin(); i != coupon.a_tilde.end(); i++)
 	{
-		// Compute Ri^ai~
-		mpz_class Ri_ai_tilde;
-		mpz_powm(_Z(Ri_ai_tilde), _Z(pubkey->get_R()[*r_index]), _Z((*i)), _Z(pubkey->get_n()));
-		
-		// Factor it in
-		Ri_factor *= Ri_ai_tilde;
-		mpz_mod(_Z(Ri_factor), _Z(Ri_factor), _Z(pubkey->get_n()));
+		Z_tilde_me.add(pubkey->get_fixed_R(*r_index), *i);
 		
 		r_index++;
 	}
 	
-	// Now assemble all the factors to compute Z~
-	mpz_class Z_tilde = A_prime_e_tilde * S_v_prime_tilde * Ri_factor;
-	mpz_mod(_Z(Z_tilde), _Z(Z_tilde), _Z(pubkey->get_n()));
+	coupon.Z_tilde = Z_tilde_me.compute();
 	
-	// Compute proof hash c
-	
-	// Create ASN.1 DER encoding of value to hash
-	silvia_asn1_sequence challenge_seq;
+	// Compute v' = v - e*r_A
+	coupon.v_prime = credential->get_v() - (credential->get_e() * r_A);
+}
+
+void silvia_prover::prove
+(
+	std::vector<bool> D,
+	mpz_class n1,
+	mpz_class context,
+	mpz_class& c,
+	mpz_class& A_prime,
+	mpz_class& e_hat,
+	mpz_class& v_prime_hat,
+	std::vector<mpz_class>& a_i_hat,
+	std::vector<silvia_attribute*>& a_i,
+	mpz_class* ext_e_tilde /* = NULL */,
+	mpz_class* ext_v_prime_tilde /* = NULL */,
+	mpz_class* ext_r_A /* = NULL */,
+	std::vector<mpz_class>* ext_a_tilde /* = NULL */
+)
+{
+	// Use a precomputed coupon if possible; coupons are never used when
+	// external values are supplied for testing
+	silvia_proof_coupon coupon;
 	
-	silvia_asn1_integer context_asn1(context);
-	challenge_seq.append(&context_asn1);
+	if ((ext_e_tilde != NULL) || (ext_v_prime_tilde != NULL) || (ext_r_A != NULL) || (ext_a_tilde != NULL) ||
+	    !take_coupon(D, coupon))
+	{
+		make_coupon(D, coupon, ext_e_tilde, ext_v_prime_tilde, ext_r_A, ext_a_tilde);
+	}
 	
-	silvia_asn1_integer A_prime_asn1(A_prime);
-	challenge_seq.append(&A_prime_asn1);
+	A_prime = coupon.A_prime;
 	
-	silvia_asn1_integer Z_tilde_asn1(Z_tilde);
-	challenge_seq.append(&Z_tilde_asn1);
+	// Compute proof hash c
 	
-	silvia_asn1_integer n1_asn1(n1);
-	challenge_seq.append(&n1_asn1);
+	// Stream the ASN.1 DER encoding of the values to hash
+	silvia_der_sequence challenge_seq;
+	challenge_seq.append(context);
+	challenge_seq.append(A_prime);
+	challenge_seq.append(coupon.Z_tilde);
+	challenge_seq.append(n1);
 	
 	// Hash the data
-	silvia_hash h(SYSPAR(hash_type));
+	silvia_hash* h = runtime.get_hash();
 	
-	h.init();
-	h.update(challenge_seq.get_der_encoding());
-	c = h.final();
+	h->init();
+	challenge_seq.hash(h);
+	c = h->final();
 	
 	// Compute e'
 	mpz_class e_prime = credential->get_e();
-	mpz_clrbit(_Z(e_prime), SYSPAR(l_e) - 1);
-	
-	// Compute v'
-	mpz_class v_prime = credential->get_v() - (credential->get_e() * r_A);
+	mpz_clrbit(_Z(e_prime), RTPAR(l_e) - 1);
 	
 	// Compute e^
-	e_hat = e_tilde + (c * e_prime);
+	e_hat = coupon.e_tilde + (c * e_prime);
 	
 	// Compute v'^
-	v_prime_hat = v_prime_tilde + (c * v_prime);
+	v_prime_hat = coupon.v_prime_tilde + (c * coupon.v_prime);
 	
 	// Compute s^ and add it to the set of hidden attributes
-	std::vector<mpz_class>::iterator a_tilde_it = a_tilde.begin();
+	std::vector<mpz_class>::iterator a_tilde_it = coupon.a_tilde.begin();
 	
 	a_i_hat.push_back(*a_tilde_it + (c * credential->get_secret().rep()));
 	a_tilde_it++;
@@ -37,10 +37,33 @@
 
 #include <gmpxx.h>
 #include "silvia_types.h"
+#include "silvia_runtime.h"
+#include "silvia_thread_pool.h"
+#include <pthread.h>
 #include <vector>
+#include <deque>
+#include <map>
 
 /**
- * Prover class
+ * Proof coupon; holds the part of a proof that depends neither on the
+ * verifier nonce nor on the context. A coupon must only be used once.
+ */
+typedef struct
+{
+	std::vector<bool> D;			/**< the disclosure pattern */
+	mpz_class A_prime;			/**< the randomised signature value A' */
+	mpz_class Z_tilde;			/**< the commitment Z~ */
+	mpz_class e_tilde;			/**< the blinding value e~ */
+	mpz_class v_prime_tilde;		/**< the blinding value v'~ */
+	mpz_class v_prime;			/**< v' = v - e*r_A */
+	std::vector<mpz_class> a_tilde;		/**< the blinding values for the master secret and the hidden attributes */
+}
+silvia_proof_coupon;
+
+/**
+ * Prover class; a proof is split into an expensive offline phase that
+ * produces a coupon and a cheap online phase that answers the verifier
+ * nonce using the coupon. Coupons can be precomputed in the background.
  */
  
 class silvia_prover
@@ -50,11 +73,44 @@ public:
 	 * Constructor
 	 * @param pubkey the issuer public key
 	 * @param credential the credential
+	 * @param runtime the runtime context; if NULL, a context with the current system parameters is used
+	 */
+	silvia_prover(silvia_pub_key* pubkey, silvia_credential* credential, const silvia_runtime* runtime = NULL);
+	
+	/**
+	 * Destructor; waits for coupons that are still being precomputed
+	 */
+	~silvia_prover();
+	
+	/**
+	 * Precompute proof coupons for a disclosure pattern; prove() uses a
+	 * precomputed coupon for the pattern if one is available
+	 * @param D the attributes to disclose
+	 * @param count the number of coupons to add
+	 * @param pool the thread pool to compute the coupons on in the background; if NULL, they are computed before returning
+	 */
+	void precompute(const std::vector<bool>& D, size_t count, silvia_thread_pool* pool = NULL);
+	
+	/**
+	 * Get the number of precomputed coupons for a disclosure pattern
+	 * @param D the attributes to disclose
+	 * @return the number of coupons that are available
+	 */
+	size_t get_coupon_count(const std::vector<bool>& D);
+	
+	/**
+	 * Wait until all coupons that are computed in the background are done
 	 */
-	silvia_prover(silvia_pub_key* pubkey, silvia_credential* credential);
+	void wait_for_coupons();
 	
 	/**
-	 * Construct a proof
+	 * Discard all precomputed coupons
+	 */
+	void clear_coupons();
+	
+	/**
+	 * Construct a proof; uses a precomputed coupon if one is available
+	 * for D and no external values are supplied
 	 * @param D the attributes to disclose; set an entry to true to disclose the corresponding attribute
 	 * @param n1 the verifier nonce
 	 * @param context the context value
@@ -87,9 +143,42 @@ public:
 	);
 
 private:
+	// Copying is not allowed
+	silvia_prover(const silvia_prover&);
+	silvia_prover& operator=(const silvia_prover&);
+
+	// Job for background coupon computation
+	class coupon_job;
+
+	// Offline phase: compute a coupon
+	void make_coupon
+	(
+		const std::vector<bool>& D,
+		silvia_proof_coupon& coupon,
+		mpz_class* ext_e_tilde = NULL,
+		mpz_class* ext_v_prime_tilde = NULL,
+		mpz_class* ext_r_A = NULL,
+		std::vector<mpz_class>* ext_a_tilde = NULL
+	);
+
+	// Add a coupon to the pool
+	void add_coupon(const silvia_proof_coupon& coupon);
+
+	// Take a coupon for D from the pool; returns false if there is none
+	bool take_coupon(const std::vector<bool>& D, silvia_proof_coupon& coupon);
+
 	// State
 	silvia_pub_key* pubkey;
 	silvia_credential* credential;
+
+	// Precomputed coupons per disclosure pattern
+	std::map<std::vector<bool>, std::deque<silvia_proof_coupon> > coupons;
+	size_t pending_coupons;
+	pthread_mutex_t coupon_lock;
+	pthread_cond_t coupon_cond;
+
+	// The runtime context
+	silvia_runtime runtime;
 };
 
 #endif // !_SILVIA_PROVER_H
@@ -41,13 +41,19 @@
 #include "silvia_macros.h"
 #include "silvia_hash.h"
 #include "silvia_asn1.h"
+#include "silvia_multiexp.h"
 #include <vector>
 #include <assert.h>
 
-silvia_credential_generator::silvia_credential_generator(silvia_pub_key* pubkey)
+silvia_credential_generator::silvia_credential_generator(silvia_pub_key* pubkey, const silvia_runtime* runtime /* = NULL */)
 {
 	this->pubkey = pubkey;
 	this->credgen_state = CREDGEN_START;
+
+	if (runtime != NULL)
+	{
+		this->runtime = *runtime;
+	}
 }
 
 void silvia_credential_generator::set_attributes(const std::vector<silvia_attribute*> a)
@@ -72,7 +78,7 @@ void silvia_credential_generator::new_secret()
 {
 	assert((credgen_state == CREDGEN_START) || (credgen_state == CREDGEN_ATTRIBUTES_AND_SECRET));
 	
-	mpz_class s_val = silvia_rng::i()->get_random(SYSPAR(l_m));
+	mpz_class s_val = runtime.get_rng()->get_random(RTPAR(l_m));
 
 	s = s_val;
 
@@ -86,7 +92,7 @@ void silvia_credential_generator::compute_commitment(mpz_class& U, mpz_class& v_
 	if (ext_v_prime == NULL)
 	{
 		// Generate v'
-		v_prime = silvia_rng::i()->get_random(SYSPAR(l_n) + SYSPAR(l_statzk));
+		v_prime = runtime.get_rng()->get_random(RTPAR(l_n) + RTPAR(l_statzk));
 	}
 	else
 	{
@@ -94,20 +100,13 @@ void silvia_credential_generator::compute_commitment(mpz_class& U, mpz_class& v_
 		v_prime = *ext_v_prime;
 	}
 	
-	// Compute commitment U
-	// Factor S^v'
-	mpz_class S_v_prime;
-	mpz_powm(_Z(S_v_prime), _Z(pubkey->get_S()), _Z(v_prime), _Z(pubkey->get_n()));
+	// Compute commitment U = S^v' * R_0^s
+	silvia_multiexp U_me(pubkey->get_modulus());
 	
-	// Factor R_0^s
-	mpz_class R_0_s;
-	mpz_powm(_Z(R_0_s), _Z(pubkey->get_R()[0]), _Z(s.rep()), _Z(pubkey->get_n()));
+	U_me.add(pubkey->get_fixed_S(), v_prime);
+	U_me.add(pubkey->get_fixed_R(0), s.rep());
 	
-	// U
-	U = S_v_prime * R_0_s;
-	
-	// U mod n
-	mpz_mod(_Z(U), _Z(U), _Z(pubkey->get_n()))	;
+	U = U_me.compute();
 	
 	// Save state
 	this->v_prime = v_prime;
@@ -127,7 +126,7 @@ void silvia_credential_generator::prove_commitment(mpz_class n1, mpz_class conte
 	if (ext_s_tilde == NULL)
 	{
 		// Select blinding value for s
-		s_tilde = silvia_rng::i()->get_random(SYSPAR(l_m) + SYSPAR(l_statzk) + SYSPAR(l_H) + 1);
+		s_tilde = runtime.get_rng()->get_random(RTPAR(l_m) + RTPAR(l_statzk) + RTPAR(l_H) + 1);
 	}
 	else
 	{
@@ -140,7 +139,7 @@ void silvia_credential_generator::prove_commitment(mpz_class n1, mpz_class conte
 	if (ext_v_prime_tilde == NULL)
 	{
 		// Select blinding value for v'
-		v_prime_tilde = silvia_rng::i()->get_random(SYSPAR(l_n) + 2*SYSPAR(l_statzk) + SYSPAR(l_H));
+		v_prime_tilde = runtime.get_rng()->get_random(RTPAR(l_n) + 2*RTPAR(l_statzk) + RTPAR(l_H));
 	}
 	else
 	{
@@ -148,46 +147,29 @@ void silvia_credential_generator::prove_commitment(mpz_class n1, mpz_class conte
 		v_prime_tilde = *ext_v_prime_tilde;
 	}
 	
-	// Compute U~
-	mpz_class U_tilde;
-	
-	// Factor S^v_prime_tilde
-	mpz_class S_v_prime_tilde;
-	mpz_powm(_Z(S_v_prime_tilde), _Z(pubkey->get_S()), _Z(v_prime_tilde), _Z(pubkey->get_n()));
-	
-	// Factor R_0^s_tilde
-	mpz_class R_0_s_tilde;
-	mpz_powm(_Z(R_0_s_tilde), _Z(pubkey->get_R()[0]), _Z(s_tilde), _Z(pubkey->get_n()));
+	// Compute U~ = S^v'~ * R_0^s~
+	silvia_multiexp U_tilde_me(pubkey->get_modulus());
 	
-	// U~
-	U_tilde = S_v_prime_tilde * R_0_s_tilde;
+	U_tilde_me.add(pubkey->get_fixed_S(), v_prime_tilde);
+	U_tilde_me.add(pubkey->get_fixed_R(0), s_tilde);
 	
-	// U~ mod n
-	mpz_mod(_Z(U_tilde), _Z(U_tilde), _Z(pubkey->get_n()));
+	mpz_class U_tilde = U_tilde_me.compute();
 	
 	// Compute c
 	
-	// Create ASN.1 DER encoding of value to hash
-	silvia_asn1_sequence challenge_seq;
-	
-	silvia_asn1_integer context_asn1(context);
-	challenge_seq.append(&context_asn1);
-	
-	silvia_asn1_integer U_asn1(U);
-	challenge_seq.append(&U_asn1);
-	
-	silvia_asn1_integer U_tilde_asn1(U_tilde);
-	challenge_seq.append(&U_tilde_asn1);
-	
-	silvia_asn1_integer n1_asn1(n1);
-	challenge_seq.append(&n1_asn1);
+	// Stream the ASN.1 DER encoding of the values to hash
+	silvia_der_sequence challenge_seq;
+	challenge_seq.append(context);
+	challenge_seq.append(U);
+	challenge_seq.append(U_tilde);
+	challenge_seq.append(n1);
 	
 	// Hash the data
-	silvia_hash h(SYSPAR(hash_type));
+	silvia_hash* h = runtime.get_hash();
 	
-	h.init();
-	h.update(challenge_seq.get_der_encoding());
-	c = h.final();
+	h->init();
+	challenge_seq.hash(h);
+	c = h->final();
 	
 	// Compute s^
 	mpz_mul(_Z(s_hat), _Z(c), _Z(s.rep()));
@@ -208,7 +190,7 @@ mpz_class silvia_credential_generator::get_prover_nonce(mpz_class* ext_n2 /* = N
 	
 	if (ext_n2 == NULL)
 	{
-		return (n2 = silvia_rng::i()->get_random(SYSPAR(l_statzk)));
+		return (n2 = runtime.get_rng()->get_random(RTPAR(l_statzk)));
 	}
 	else
 	{
@@ -221,45 +203,30 @@ bool silvia_credential_generator::verify_signature(mpz_class context, mpz_class
 	assert(credgen_state == CREDGEN_RELEASED_N2);
 	
 	// Compute Q = A^e mod n
-	mpz_class Q;
-	
-	mpz_powm(_Z(Q), _Z(A), _Z(e), _Z(pubkey->get_n()));
-	
-	// Compute A^
-	mpz_class A_hat;
+	mpz_class Q = pubkey->get_modulus().powm(A, e);
 	
-	// Compute c + e^*e
+	// Compute A^ = A^(c + e^*e)
 	mpz_class A_hat_exp = e_hat * e;
 	A_hat_exp += c;
 	
-	mpz_powm(_Z(A_hat), _Z(A), _Z(A_hat_exp), _Z(pubkey->get_n()));
+	mpz_class A_hat = pubkey->get_modulus().powm(A, A_hat_exp);
 	
 	// Compute c'
 	
 	// Create ASN.1 sequence encoding of all data to hash
-	silvia_asn1_sequence challenge_seq;
-	
-	silvia_asn1_integer context_asn1(context);
-	challenge_seq.append(&context_asn1);
-	
-	silvia_asn1_integer Q_asn1(Q);
-	challenge_seq.append(&Q_asn1);
-	
-	silvia_asn1_integer A_asn1(A);
-	challenge_seq.append(&A_asn1);
-	
-	silvia_asn1_integer n2_asn1(n2);
-	challenge_seq.append(&n2_asn1);
-	
-	silvia_asn1_integer A_hat_asn1(A_hat);
-	challenge_seq.append(&A_hat_asn1);
+	silvia_der_sequence challenge_seq;
+	challenge_seq.append(context);
+	challenge_seq.append(Q);
+	challenge_seq.append(A);
+	challenge_seq.append(n2);
+	challenge_seq.append(A_hat);
 	
 	// Hash the data
-	silvia_hash h(SYSPAR(hash_type));
+	silvia_hash* h = runtime.get_hash();
 	
-	h.init();
-	h.update(challenge_seq.get_der_encoding());
-	mpz_class c_prime = h.final();
+	h->init();
+	challenge_seq.hash(h);
+	mpz_class c_prime = h->final();
 	
 	credgen_state = CREDGEN_VERIFIED_SIG;
 	
@@ -282,36 +249,23 @@ void silvia_credential_generator::compute_credential(mpz_class A, mpz_class e, m
 
 bool silvia_credential_generator::verify_credential()
 {
-	// Re-compute Z for comparison
-	mpz_class Z;
-	
-	// First, factor in A^e * S^v * R0^s
-	mpz_class A_e;
-	mpz_class S_v;
-	mpz_class R0_s;
+	// Re-compute Z = A^e * S^v * R0^s * prod(Ri^ai) for comparison
+	silvia_multiexp Z_me(pubkey->get_modulus());
 	
-	mpz_powm(_Z(A_e), _Z(A), _Z(e), _Z(pubkey->get_n()));
-	mpz_powm(_Z(S_v), _Z(pubkey->get_S()), _Z(v), _Z(pubkey->get_n()));
-	mpz_powm(_Z(R0_s), _Z(pubkey->get_R()[0]), _Z(s.rep()), _Z(pubkey->get_n()));
-	
-	Z = A_e * S_v * R0_s;
-	
-	mpz_mod(_Z(Z), _Z(Z), _Z(pubkey->get_n()));
+	Z_me.add(A, e);
+	Z_me.add(pubkey->get_fixed_S(), v);
+	Z_me.add(pubkey->get_fixed_R(0), s.rep());
 	
 	// Now factor in all attribute factor exponentiations
 	int r_index = 1;
 	
 	for (std::vector<silvia_attribute*>::iterator i = a.begin(); i != a.end(); i++)
 	{
-		mpz_class Ri_a;
-		
-		mpz_powm(_Z(Ri_a), _Z(pubkey->get_R()[r_index++]), _Z((*i)->rep()), _Z(pubkey->get_n()));
-		
-		Z = Z * Ri_a;
-		
-		mpz_mod(_Z(Z), _Z(Z), _Z(pubkey->get_n()));
+		Z_me.add(pubkey->get_fixed_R(r_index++), (*i)->rep());
 	}
 	
+	mpz_class Z = Z_me.compute();
+	
 	if (Z == pubkey->get_Z())
 	{
 		credgen_state = CREDGEN_VERIFIED_CRED;
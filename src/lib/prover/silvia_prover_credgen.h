@@ -37,6 +37,7 @@
 
 #include <gmpxx.h>
 #include "silvia_types.h"
+#include "silvia_runtime.h"
 #include <vector>
 
 /**
@@ -48,8 +49,9 @@ public:
 	/**
 	 * Constructor
 	 * @param pubkey the issuer's public key
+	 * @param runtime the runtime context; if NULL, a context with the current system parameters is used
 	 */
-	silvia_credential_generator(silvia_pub_key* pubkey);
+	silvia_credential_generator(silvia_pub_key* pubkey, const silvia_runtime* runtime = NULL);
 
 	/**
 	 * Set the attributes
@@ -131,6 +133,9 @@ private:
 	// The issuer public key
 	silvia_pub_key* pubkey;
 
+	// The runtime context
+	silvia_runtime runtime;
+
 	// The secret
 	silvia_integer_attribute s;
 
@@ -34,19 +34,39 @@
  
 #include "config.h"
 #include "silvia_stdio_card.h"
+#include "silvia_apdu.h"
 #include "silvia_macros.h"
+#include "silvia_timer.h"
 #include <assert.h>
 #include <string.h>
 #include <vector>
 #include <stdio.h>
+#include <limits>
 
 ////////////////////////////////////////////////////////////////////////
 // Card class
 ////////////////////////////////////////////////////////////////////////
   
-silvia_stdio_card::silvia_stdio_card()
+silvia_stdio_card::silvia_stdio_card(bool offer_binary /* = false */, std::istream& in /* = std::cin */, std::ostream& out /* = std::cout */) : in(in), out(out)
 {
+	binary = false;
+	
 	status();
+	
+	if (offer_binary)
+	{
+		out << "control binary-framing" << std::endl << std::flush;
+		
+		std::string response_type;
+		std::string response;
+		
+		in >> response_type >> response;
+		
+		// Consume the rest of the line; binary messages may follow directly
+		in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		
+		binary = (response_type == "binary-framing") && (response == "OK");
+	}
 }
 	
 silvia_stdio_card::~silvia_stdio_card()
@@ -64,7 +84,7 @@ bool silvia_stdio_card::status()
     return true;
 }
 	
-bool silvia_stdio_card::transmit(bytestring APDU, bytestring& data, unsigned short& sw)
+bool silvia_stdio_card::transmit(const bytestring& APDU, bytestring& data, unsigned short& sw)
 {
 	if (!transmit(APDU, data))
 	{
@@ -79,17 +99,31 @@ bool silvia_stdio_card::transmit(bytestring APDU, bytestring& data, unsigned sho
 	return true;
 }
 
-bool silvia_stdio_card::transmit(bytestring APDU, bytestring& data_sw)
+bool silvia_stdio_card::transmit(const bytestring& APDU, bytestring& data_sw)
 {
-    std::cout << "request " << APDU.hex_str() << std::endl << std::flush;
+	if (binary)
+	{
+		std::vector<bytestring> data_sw_v;
+		
+		if (!transmit_binary(std::vector<bytestring>(1, APDU), data_sw_v))
+		{
+			return false;
+		}
+		
+		data_sw += data_sw_v[0];
+		
+		return true;
+	}
+	
+    out << "request " << APDU.hex_str() << std::endl << std::flush;
 
     std::string response_type;
-    std::cin >> response_type;
+    in >> response_type;
     if(response_type.compare("response") != 0)
         return false;
 
     std::string response;
-    std::cin >> response;
+    in >> response;
 
     data_sw += response.c_str();
 	
@@ -101,7 +135,152 @@ bool silvia_stdio_card::transmit(bytestring APDU, bytestring& data_sw)
 	return true;
 }
 
+bool silvia_stdio_card::transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings /* = NULL */)
+{
+	if (!binary)
+	{
+		return silvia_card_channel::transmit_batch(APDUs, data_sw, timings);
+	}
+	
+	if (APDUs.empty())
+	{
+		return true;
+	}
+	
+	silvia_timer timer;
+	std::vector<bytestring> batch_data_sw;
+	
+	timer.mark();
+	
+	if (!transmit_binary(APDUs, batch_data_sw))
+	{
+		return false;
+	}
+	
+	if (timings != NULL)
+	{
+		unsigned long long elapsed = timer.elapsed();
+		
+		timings->insert(timings->end(), batch_data_sw.size(), elapsed / batch_data_sw.size());
+	}
+	
+	data_sw.insert(data_sw.end(), batch_data_sw.begin(), batch_data_sw.end());
+	
+	return true;
+}
+
+bool silvia_stdio_card::transmit_binary(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw)
+{
+	assert(APDUs.size() <= 0xffff);
+	
+	// Compose the request and send it in a single write
+	bytestring body;
+	
+	for (std::vector<bytestring>::const_iterator i = APDUs.begin(); i != APDUs.end(); i++)
+	{
+		assert(i->size() <= 0xffff);
+		
+		body += (unsigned char) (i->size() >> 8);
+		body += (unsigned char) (i->size() & 0xff);
+		body += *i;
+	}
+	
+	bytestring request;
+	
+	request += (unsigned char) SILVIA_STDIO_TAG_REQUEST;
+	request += (unsigned char) (APDUs.size() >> 8);
+	request += (unsigned char) (APDUs.size() & 0xff);
+	request += (unsigned char) (body.size() >> 24);
+	request += (unsigned char) ((body.size() >> 16) & 0xff);
+	request += (unsigned char) ((body.size() >> 8) & 0xff);
+	request += (unsigned char) (body.size() & 0xff);
+	request += body;
+	
+	out.write((const char*) request.const_byte_str(), request.size());
+	out.flush();
+	
+	if (!out.good())
+	{
+		return false;
+	}
+	
+	// Skip the line endings of text lines exchanged before the response
+	while ((in.peek() == '\n') || (in.peek() == '\r') || (in.peek() == ' '))
+	{
+		in.get();
+	}
+	
+	// Receive the header and then the whole response in a single read
+	unsigned char header[7];
+	
+	if (!in.read((char*) header, sizeof(header)) || (header[0] != SILVIA_STDIO_TAG_RESPONSE))
+	{
+		return false;
+	}
+	
+	size_t count = (header[1] << 8) + header[2];
+	size_t body_len = ((size_t) header[3] << 24) + (header[4] << 16) + (header[5] << 8) + header[6];
+	
+	if ((count == 0) || (count > APDUs.size()))
+	{
+		return false;
+	}
+	
+	// Every response is at most a length, 65535 bytes of data and a status word
+	if (body_len > count * (2 + 65535 + 2))
+	{
+		return false;
+	}
+	
+	bytestring response;
+	response.resize(body_len);
+	
+	if ((body_len > 0) && !in.read((char*) response.byte_str(), body_len))
+	{
+		return false;
+	}
+	
+	// Split the response through views; only the responses that are
+	// returned are copied
+	bytestring_view rest(response);
+	
+	data_sw.reserve(data_sw.size() + count);
+	
+	for (size_t i = 0; i < count; i++)
+	{
+		if (rest.size() < 2)
+		{
+			return false;
+		}
+		
+		bytestring_view len_bytes = rest.split(2);
+		size_t len = (len_bytes[0] << 8) + len_bytes[1];
+		
+		if ((len < 2) || (len > rest.size()))
+		{
+			return false;
+		}
+		
+		bytestring_view one_data_sw = rest.split(len);
+		
+		// The peer must stop at the first status word other than 9000
+		if ((i + 1 < count) && (silvia_apdu::get_sw(one_data_sw) != 0x9000))
+		{
+			return false;
+		}
+		
+		data_sw.push_back(one_data_sw);
+	}
+	
+	return (rest.size() == 0);
+}
+
 std::string silvia_stdio_card::get_reader_name()
 {
 	return "STDIO";
 }
+
+bool silvia_stdio_card::is_binary()
+{
+	return binary;
+}
@@ -37,23 +37,45 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
  
 #ifndef _SILVIA_STDIO_CARD_H
 #define _SILVIA_STDIO_CARD_H
  
 /**
  * Card class
+ *
+ * By default, every APDU is exchanged as a "request <hex>" line that is
+ * answered with a "response <hex>" line. If binary framing is offered and
+ * the peer accepts it (see the constructor), batches of APDUs are exchanged
+ * as single length-prefixed messages instead:
+ *
+ *   message = tag (1) || count (2) || body length (4) || body
+ *   body    = count * (length (2) || APDU or response data + status word)
+ *
+ * All values are big-endian. Requests carry tag 0xA0 and responses carry
+ * tag 0xA1. The peer stops processing a request at the first APDU that
+ * returns a status word other than 9000 and returns the responses up to and
+ * including that APDU. Text lines (e.g. for PIN entry) may still be
+ * exchanged between messages.
  */
+
+#define SILVIA_STDIO_TAG_REQUEST		0xA0
+#define SILVIA_STDIO_TAG_RESPONSE		0xA1
   
 class silvia_stdio_card : public silvia_card_channel
 {
 public:
 	/**
 	 * Constructor
-     * @param to_card the descriptor for communication to the card
-     * @param from_card the descriptor for communication from the card
+	 * @param offer_binary offer binary framing to the peer; the peer accepts
+	 *                     by answering "control binary-framing" with
+	 *                     "binary-framing OK", any other answer keeps the
+	 *                     text protocol
+	 * @param in the stream on which responses are received
+	 * @param out the stream on which requests are sent
 	 */
-	silvia_stdio_card();
+	silvia_stdio_card(bool offer_binary = false, std::istream& in = std::cin, std::ostream& out = std::cout);
 	
 	/**
 	 * Destructor
@@ -80,7 +102,7 @@ public:
 	 * @param sw The return status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data, unsigned short& sw);
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw);
 	
 	/**
 	 * Transmit an APDU and receive return data
@@ -88,13 +110,40 @@ public:
 	 * @param data_sw The return data including the status word
 	 * @return true if the APDU exchange completed successfully
 	 */
-	virtual bool transmit(bytestring APDU, bytestring& data_sw);
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw);
+	
+	/**
+	 * Transmit a batch of APDUs and receive the return data; with binary
+	 * framing, the batch is sent as a single message and the timings are
+	 * the duration of the whole exchange divided over the responses
+	 * @param APDUs The APDUs to transmit
+	 * @param data_sw The return data including the status word of every APDU that was exchanged
+	 * @param timings The duration of every APDU exchange in nanoseconds (optional)
+	 * @return true if all APDU exchanges completed successfully, regardless of the status words
+	 */
+	virtual bool transmit_batch(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw, std::vector<unsigned long long>* timings = NULL);
 
     virtual std::string get_reader_name();
 	
+	/**
+	 * Check whether binary framing is in use
+	 * @return true if the peer accepted binary framing
+	 */
+	bool is_binary();
+	
 private:
+	// Exchange a batch of APDUs as a single binary message
+	bool transmit_binary(const std::vector<bytestring>& APDUs, std::vector<bytestring>& data_sw);
+	
 	// The card connection status
 	bool connected;
+	
+	// The streams to and from the peer
+	std::istream& in;
+	std::ostream& out;
+	
+	// Is binary framing in use?
+	bool binary;
 };
  
 #endif // !_SILVIA_STDIO_CARD_H
@@ -0,0 +1,840 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_stdio_server.cpp
+
+ Event-driven socket server for the stdio card protocol
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_stdio_server.h"
+#include "silvia_apdu.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Maximum length of a protocol message
+#define SILVIA_STDIO_MAX_LINE	65536
+
+// Maximum number of events handled per iteration of the event loop
+#define SILVIA_STDIO_MAX_EVENTS	256
+
+////////////////////////////////////////////////////////////////////////
+// Connection state
+////////////////////////////////////////////////////////////////////////
+
+typedef enum
+{
+	CONN_WORKING,			// the session is with the session loop
+	CONN_AWAIT_RESPONSE,		// waiting for the response to a command
+	CONN_AWAIT_PIN,			// waiting for the peer to send the PIN
+	CONN_CLOSING			// waiting for the output to drain before closing
+}
+silvia_conn_state_t;
+
+struct silvia_stdio_server::connection
+{
+	int fd;
+	silvia_conn_state_t state;
+	silvia_session* session;
+	
+	// Buffered input and output
+	std::string in_buf;
+	std::string out_buf;
+	bool want_write;
+	
+	// The commands that are being sent to the peer and the responses so far
+	std::vector<bytestring> commands;
+	std::vector<bytestring> responses;
+	
+	// Lifecycle
+	bool finished;
+	bool closed;
+};
+
+////////////////////////////////////////////////////////////////////////
+// Helpers
+////////////////////////////////////////////////////////////////////////
+
+static bool set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	
+	if (flags < 0)
+	{
+		return false;
+	}
+	
+	return (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Server class
+////////////////////////////////////////////////////////////////////////
+
+silvia_stdio_server::silvia_stdio_server(silvia_session_factory* factory, silvia_thread_pool* pool /* = NULL */)
+{
+	assert(factory != NULL);
+	
+	this->factory = factory;
+	
+	loop = new silvia_session_loop(this, pool);
+	
+	stopping = false;
+	
+	epoll_fd = epoll_create(SILVIA_STDIO_MAX_EVENTS);
+	
+	if (pipe(wake_pipe) != 0)
+	{
+		wake_pipe[0] = wake_pipe[1] = -1;
+	}
+	else
+	{
+		set_nonblocking(wake_pipe[0]);
+		set_nonblocking(wake_pipe[1]);
+		
+		if (epoll_fd >= 0)
+		{
+			struct epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.fd = wake_pipe[0];
+			
+			epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_pipe[0], &ev);
+		}
+	}
+	
+	if ((epoll_fd >= 0) && (loop->get_notify_fd() >= 0))
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = loop->get_notify_fd();
+		
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, loop->get_notify_fd(), &ev);
+	}
+}
+
+silvia_stdio_server::~silvia_stdio_server()
+{
+	while (!connections.empty())
+	{
+		close_connection(connections.begin()->second);
+	}
+	
+	// Wait for the sessions that are still with the session loop
+	while (loop->get_session_count() > 0)
+	{
+		loop->dispatch(true);
+	}
+	
+	reap_connections();
+	
+	delete loop;
+	
+	for (std::vector<int>::iterator i = listeners.begin(); i != listeners.end(); i++)
+	{
+		close(*i);
+	}
+	
+	for (std::vector<std::string>::iterator i = unix_paths.begin(); i != unix_paths.end(); i++)
+	{
+		unlink(i->c_str());
+	}
+	
+	if (wake_pipe[0] >= 0)
+	{
+		close(wake_pipe[0]);
+		close(wake_pipe[1]);
+	}
+	
+	if (epoll_fd >= 0)
+	{
+		close(epoll_fd);
+	}
+}
+
+bool silvia_stdio_server::listen_unix(const std::string& path)
+{
+	struct sockaddr_un addr;
+	
+	if (path.empty() || (path.size() >= sizeof(addr.sun_path)))
+	{
+		return false;
+	}
+	
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	
+	if (fd < 0)
+	{
+		return false;
+	}
+	
+	unlink(path.c_str());
+	
+	if ((bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) ||
+	    (::listen(fd, SOMAXCONN) != 0) ||
+	    !add_listener(fd))
+	{
+		close(fd);
+		
+		return false;
+	}
+	
+	unix_paths.push_back(path);
+	
+	return true;
+}
+
+bool silvia_stdio_server::listen_tcp(const std::string& host, const std::string& port)
+{
+	struct addrinfo hints;
+	struct addrinfo* addrs = NULL;
+	
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	
+	if (getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &addrs) != 0)
+	{
+		return false;
+	}
+	
+	bool rv = false;
+	
+	for (struct addrinfo* ai = addrs; ai != NULL; ai = ai->ai_next)
+	{
+		int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		
+		if (fd < 0)
+		{
+			continue;
+		}
+		
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		
+		if ((bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) ||
+		    (::listen(fd, SOMAXCONN) != 0) ||
+		    !add_listener(fd))
+		{
+			close(fd);
+			
+			continue;
+		}
+		
+		rv = true;
+		
+		break;
+	}
+	
+	freeaddrinfo(addrs);
+	
+	return rv;
+}
+
+bool silvia_stdio_server::listen(const std::string& address)
+{
+	if (address.compare(0, 5, "unix:") == 0)
+	{
+		return listen_unix(address.substr(5));
+	}
+	else if (address.compare(0, 4, "tcp:") == 0)
+	{
+		std::string host_port = address.substr(4);
+		size_t colon = host_port.rfind(':');
+		
+		if (colon == std::string::npos)
+		{
+			return listen_tcp("", host_port);
+		}
+		
+		std::string host = host_port.substr(0, colon);
+		
+		// Strip the brackets from IPv6 addresses
+		if ((host.size() >= 2) && (host[0] == '[') && (host[host.size() - 1] == ']'))
+		{
+			host = host.substr(1, host.size() - 2);
+		}
+		
+		return listen_tcp(host, host_port.substr(colon + 1));
+	}
+	
+	return false;
+}
+
+bool silvia_stdio_server::add_listener(int fd)
+{
+	if ((epoll_fd < 0) || !set_nonblocking(fd))
+	{
+		return false;
+	}
+	
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		return false;
+	}
+	
+	listeners.push_back(fd);
+	
+	return true;
+}
+
+bool silvia_stdio_server::run()
+{
+	if ((epoll_fd < 0) || (wake_pipe[0] < 0))
+	{
+		return false;
+	}
+	
+	struct epoll_event events[SILVIA_STDIO_MAX_EVENTS];
+	
+	while (!stopping)
+	{
+		int count = epoll_wait(epoll_fd, events, SILVIA_STDIO_MAX_EVENTS, -1);
+		
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			
+			return false;
+		}
+		
+		for (int i = 0; i < count; i++)
+		{
+			int fd = events[i].data.fd;
+			
+			if (fd == wake_pipe[0])
+			{
+				char drain[256];
+				
+				while (read(wake_pipe[0], drain, sizeof(drain)) > 0);
+				
+				continue;
+			}
+			
+			if (fd == loop->get_notify_fd())
+			{
+				loop->dispatch();
+				
+				continue;
+			}
+			
+			if (std::find(listeners.begin(), listeners.end(), fd) != listeners.end())
+			{
+				accept_connections(fd);
+				
+				continue;
+			}
+			
+			std::map<int, connection*>::iterator conn_it = connections.find(fd);
+			
+			if (conn_it == connections.end())
+			{
+				continue;
+			}
+			
+			connection* conn = conn_it->second;
+			
+			if (events[i].events & EPOLLOUT)
+			{
+				flush_output(conn);
+			}
+			
+			if (!conn->closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+			{
+				handle_input(conn);
+			}
+		}
+		
+		reap_connections();
+	}
+	
+	return true;
+}
+
+void silvia_stdio_server::stop()
+{
+	stopping = true;
+	
+	wake();
+}
+
+size_t silvia_stdio_server::get_connection_count()
+{
+	return connections.size();
+}
+
+void silvia_stdio_server::wake()
+{
+	if (wake_pipe[1] >= 0)
+	{
+		// A full pipe means the event loop is already being woken up
+		char c = 0;
+		
+		if (write(wake_pipe[1], &c, 1) < 0)
+		{
+			return;
+		}
+	}
+}
+
+void silvia_stdio_server::accept_connections(int listen_fd)
+{
+	while (true)
+	{
+		int fd = accept(listen_fd, NULL, NULL);
+		
+		if (fd < 0)
+		{
+			// EAGAIN means all pending connections were accepted;
+			// other errors only affect the connection that failed
+			return;
+		}
+		
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		
+		if (!set_nonblocking(fd) || (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0))
+		{
+			close(fd);
+			
+			continue;
+		}
+		
+		connection* conn = new connection();
+		
+		conn->fd = fd;
+		conn->state = CONN_WORKING;
+		conn->session = factory->create_session();
+		conn->want_write = false;
+		conn->finished = false;
+		conn->closed = false;
+		
+		connections[fd] = conn;
+		sessions[conn->session] = conn;
+		
+		loop->start(conn->session);
+	}
+}
+
+void silvia_stdio_server::handle_input(connection* conn)
+{
+	char buf[4096];
+	
+	// Stop reading once the buffer holds more than a message of the
+	// maximum length; the rest is read when the lines have been handled
+	while (!conn->closed && (conn->in_buf.size() <= SILVIA_STDIO_MAX_LINE))
+	{
+		ssize_t len = read(conn->fd, buf, sizeof(buf));
+		
+		if (len == 0)
+		{
+			close_connection(conn);
+			
+			return;
+		}
+		else if (len < 0)
+		{
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				break;
+			}
+			else if (errno == EINTR)
+			{
+				continue;
+			}
+			
+			close_connection(conn);
+			
+			return;
+		}
+		
+		conn->in_buf.append(buf, len);
+	}
+	
+	size_t pos = 0;
+	size_t eol;
+	
+	while (!conn->closed && (conn->state != CONN_CLOSING) && ((eol = conn->in_buf.find('\n', pos)) != std::string::npos))
+	{
+		std::string line = conn->in_buf.substr(pos, eol - pos);
+		pos = eol + 1;
+		
+		if (!line.empty() && (line[line.size() - 1] == '\r'))
+		{
+			line.resize(line.size() - 1);
+		}
+		
+		if (!line.empty())
+		{
+			handle_line(conn, line);
+		}
+	}
+	
+	if (conn->closed)
+	{
+		return;
+	}
+	
+	conn->in_buf.erase(0, pos);
+	
+	if (conn->state == CONN_CLOSING)
+	{
+		// Input that arrives while closing is ignored
+		conn->in_buf.clear();
+	}
+	else if (conn->in_buf.size() > SILVIA_STDIO_MAX_LINE)
+	{
+		conn->in_buf.clear();
+		
+		protocol_error(conn);
+	}
+}
+
+void silvia_stdio_server::handle_line(connection* conn, const std::string& line)
+{
+	size_t space = line.find(' ');
+	std::string type = line.substr(0, space);
+	std::string value = (space == std::string::npos) ? "" : line.substr(space + 1);
+	
+	if ((type == "response") && (conn->state == CONN_AWAIT_RESPONSE))
+	{
+		bytestring data_sw = value.c_str();
+		
+		if (data_sw.size() >= 2)
+		{
+			handle_response(conn, data_sw);
+			
+			return;
+		}
+	}
+	else if ((type == "PIN") && (conn->state == CONN_AWAIT_PIN))
+	{
+		handle_pin(conn, value);
+		
+		return;
+	}
+	else if ((type == "PIN-result") && (conn->state == CONN_AWAIT_PIN) && (value == "OK"))
+	{
+		// The peer verified the PIN itself; if it had not, the card
+		// will return an error later
+		conn->state = CONN_WORKING;
+		
+		loop->supply_pin(conn->session, "");
+		
+		return;
+	}
+	
+	protocol_error(conn);
+}
+
+void silvia_stdio_server::handle_response(connection* conn, bytestring& data_sw)
+{
+	unsigned short sw = silvia_apdu::get_sw(data_sw);
+	
+	conn->responses.push_back(data_sw);
+	
+	if ((sw == 0x9000) && (conn->responses.size() < conn->commands.size()))
+	{
+		send_line(conn, "request " + conn->commands[conn->responses.size()].hex_str());
+	}
+	else
+	{
+		// Like a card channel, the exchange stops at the first status
+		// word other than 9000; the session loop decides what follows
+		conn->state = CONN_WORKING;
+		
+		loop->deliver(conn->session, conn->responses);
+	}
+}
+
+void silvia_stdio_server::handle_pin(connection* conn, const std::string& PIN)
+{
+	if (PIN.size() > 8)
+	{
+		send_line(conn, "warning pin-too-long");
+		
+		return;
+	}
+	else if (PIN.empty())
+	{
+		send_line(conn, "warning no-pin");
+		
+		return;
+	}
+	
+	conn->state = CONN_WORKING;
+	
+	loop->supply_pin(conn->session, PIN);
+}
+
+void silvia_stdio_server::protocol_error(connection* conn)
+{
+	// A session that is waiting for the peer will not get an answer
+	bool waiting = (conn->state == CONN_AWAIT_RESPONSE) || (conn->state == CONN_AWAIT_PIN);
+	
+	conn->state = CONN_CLOSING;
+	
+	if (waiting)
+	{
+		loop->fail(conn->session);
+	}
+	
+	send_line(conn, "error protocol-error");
+}
+
+void silvia_stdio_server::send(silvia_session* session, const std::vector<bytestring>& commands)
+{
+	connection* conn = sessions[session];
+	
+	send_messages(conn);
+	
+	if (conn->closed || (conn->state == CONN_CLOSING))
+	{
+		loop->fail(session);
+		
+		return;
+	}
+	
+	conn->state = CONN_AWAIT_RESPONSE;
+	conn->commands = commands;
+	conn->responses.clear();
+	
+	send_line(conn, "request " + commands[0].hex_str());
+}
+
+bool silvia_stdio_server::request_pin(silvia_session* session)
+{
+	connection* conn = sessions[session];
+	
+	send_messages(conn);
+	
+	if (conn->closed || (conn->state == CONN_CLOSING))
+	{
+		loop->fail(session);
+		
+		return true;
+	}
+	
+	conn->state = CONN_AWAIT_PIN;
+	
+	send_line(conn, "control send-pin");
+	
+	return true;
+}
+
+void silvia_stdio_server::finished(silvia_session* session)
+{
+	connection* conn = sessions[session];
+	
+	sessions.erase(session);
+	
+	conn->finished = true;
+	
+	if (conn->closed)
+	{
+		closed.push_back(conn);
+		
+		return;
+	}
+	
+	if (conn->state != CONN_CLOSING)
+	{
+		send_messages(conn);
+		
+		if (conn->closed)
+		{
+			return;
+		}
+		
+		unsigned short sw = session->get_pin_status();
+		
+		if ((session->get_state() == SILVIA_SESSION_FAILED) && (sw != 0) && (sw != 0x9000))
+		{
+			conn->out_buf += "error " + silvia_apdu::sw_error(sw);
+			conn->out_buf += "\n";
+		}
+		
+		conn->state = CONN_CLOSING;
+	}
+	
+	flush_output(conn);
+}
+
+void silvia_stdio_server::send_messages(connection* conn)
+{
+	std::vector<std::string> messages;
+	
+	conn->session->take_messages(messages);
+	
+	if (conn->closed)
+	{
+		return;
+	}
+	
+	for (std::vector<std::string>::iterator i = messages.begin(); i != messages.end(); i++)
+	{
+		conn->out_buf += *i;
+		conn->out_buf += "\n";
+	}
+	
+	flush_output(conn);
+}
+
+void silvia_stdio_server::send_line(connection* conn, const std::string& line)
+{
+	conn->out_buf += line;
+	conn->out_buf += "\n";
+	
+	flush_output(conn);
+}
+
+void silvia_stdio_server::flush_output(connection* conn)
+{
+	while (!conn->out_buf.empty())
+	{
+		ssize_t len = ::send(conn->fd, conn->out_buf.data(), conn->out_buf.size(), MSG_NOSIGNAL);
+		
+		if (len < 0)
+		{
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			{
+				break;
+			}
+			else if (errno == EINTR)
+			{
+				continue;
+			}
+			
+			close_connection(conn);
+			
+			return;
+		}
+		
+		conn->out_buf.erase(0, len);
+	}
+	
+	if (conn->out_buf.empty() && (conn->state == CONN_CLOSING))
+	{
+		close_connection(conn);
+		
+		return;
+	}
+	
+	update_events(conn);
+}
+
+void silvia_stdio_server::update_events(connection* conn)
+{
+	bool want_write = !conn->out_buf.empty();
+	
+	if (want_write == conn->want_write)
+	{
+		return;
+	}
+	
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+	ev.data.fd = conn->fd;
+	
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+	
+	conn->want_write = want_write;
+}
+
+void silvia_stdio_server::close_connection(connection* conn)
+{
+	if (conn->closed)
+	{
+		return;
+	}
+	
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	
+	connections.erase(conn->fd);
+	
+	conn->closed = true;
+	
+	// A session that is waiting for the peer fails; the connection
+	// is released when its session has finished
+	if ((conn->state == CONN_AWAIT_RESPONSE) || (conn->state == CONN_AWAIT_PIN))
+	{
+		conn->state = CONN_WORKING;
+		
+		loop->fail(conn->session);
+	}
+	
+	if (conn->finished)
+	{
+		closed.push_back(conn);
+	}
+}
+
+void silvia_stdio_server::reap_connections()
+{
+	for (std::vector<connection*>::iterator i = closed.begin(); i != closed.end(); i++)
+	{
+		delete (*i)->session;
+		delete *i;
+	}
+	
+	closed.clear();
+}
+
+#endif // HAVE_SYS_EPOLL_H
+
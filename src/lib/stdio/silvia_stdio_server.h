@@ -0,0 +1,173 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_stdio_server.h
+
+ Event-driven socket server for the stdio card protocol
+ *****************************************************************************/
+
+#ifndef _SILVIA_STDIO_SERVER_H
+#define _SILVIA_STDIO_SERVER_H
+
+#include "silvia_bytestring.h"
+#include "silvia_session.h"
+#include "silvia_thread_pool.h"
+#include <string>
+#include <vector>
+#include <map>
+
+/**
+ * Server class; multiplexes the sessions of many connections over a single
+ * event loop. The sessions are driven by a session loop that runs their
+ * rounds on a worker pool; the server sends the commands of a round to the
+ * peer one at a time as "request" messages and collects the "response"
+ * messages. When the session loop needs a PIN, the server asks the peer
+ * for it. The messages a session produces are sent to the peer as they
+ * are.
+ */
+class silvia_stdio_server : public silvia_session_handler
+{
+public:
+	/**
+	 * Constructor
+	 * @param factory the factory for new sessions
+	 * @param pool the worker pool for the session rounds (optional, by default a pool with one thread per CPU is used)
+	 */
+	silvia_stdio_server(silvia_session_factory* factory, silvia_thread_pool* pool = NULL);
+
+	/**
+	 * Destructor; closes all connections
+	 */
+	~silvia_stdio_server();
+
+	/**
+	 * Listen on a Unix domain socket
+	 * @param path the path of the socket; an existing socket is replaced
+	 * @return true if the server is listening on the socket
+	 */
+	bool listen_unix(const std::string& path);
+
+	/**
+	 * Listen on a TCP socket
+	 * @param host the address to listen on (empty for all addresses)
+	 * @param port the port to listen on
+	 * @return true if the server is listening on the socket
+	 */
+	bool listen_tcp(const std::string& host, const std::string& port);
+
+	/**
+	 * Listen on an address of the form unix:<path>, tcp:<host>:<port> or tcp:<port>
+	 * @param address the address
+	 * @return true if the server is listening on the address
+	 */
+	bool listen(const std::string& address);
+
+	/**
+	 * Run the event loop until stop() is called
+	 * @return false if the event loop could not be started
+	 */
+	bool run();
+
+	/**
+	 * Stop the event loop; can be called from any thread
+	 */
+	void stop();
+
+	/**
+	 * Get the number of open connections
+	 * @return the number of open connections
+	 */
+	size_t get_connection_count();
+
+private:
+	// Copying is not allowed
+	silvia_stdio_server(const silvia_stdio_server&);
+	silvia_stdio_server& operator=(const silvia_stdio_server&);
+
+	// Connection state
+	struct connection;
+
+	// Session handler
+	virtual void send(silvia_session* session, const std::vector<bytestring>& commands);
+	virtual bool request_pin(silvia_session* session);
+	virtual void finished(silvia_session* session);
+
+	// Accept new connections on a listening socket
+	void accept_connections(int listen_fd);
+
+	// Handle events on a connection
+	void handle_input(connection* conn);
+	void handle_line(connection* conn, const std::string& line);
+	void handle_response(connection* conn, bytestring& data_sw);
+	void handle_pin(connection* conn, const std::string& PIN);
+
+	// Report a protocol error to the peer and close the connection
+	void protocol_error(connection* conn);
+
+	// Send the messages that the session produced to the peer
+	void send_messages(connection* conn);
+
+	// Queue a message for the peer
+	void send_line(connection* conn, const std::string& line);
+
+	// Write queued output
+	void flush_output(connection* conn);
+
+	// Update the events the event loop waits for on a connection
+	void update_events(connection* conn);
+
+	// Close a connection; it is released once its session has finished
+	void close_connection(connection* conn);
+
+	// Release closed connections
+	void reap_connections();
+
+	// Add a listening socket
+	bool add_listener(int fd);
+
+	// Wake up the event loop
+	void wake();
+
+	// The session factory and session loop
+	silvia_session_factory* factory;
+	silvia_session_loop* loop;
+
+	// Event loop state
+	int epoll_fd;
+	int wake_pipe[2];
+	std::vector<int> listeners;
+	std::vector<std::string> unix_paths;
+	std::map<int, connection*> connections;
+	std::map<silvia_session*, connection*> sessions;
+	std::vector<connection*> closed;
+	volatile bool stopping;
+};
+
+#endif // !_SILVIA_STDIO_SERVER_H
+
@@ -0,0 +1,223 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ cardtests.cpp
+
+ Tests the stdio card channel
+ *****************************************************************************/
+
+#include "config.h"
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "cardtests.h"
+#include "silvia_stdio_card.h"
+#include "silvia_bytestring.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(card_tests);
+
+void card_tests::setUp()
+{
+}
+
+void card_tests::tearDown()
+{
+}
+
+// Compose a binary message from the given entries
+static std::string binary_message(unsigned char tag, const std::vector<bytestring>& entries)
+{
+	bytestring body;
+	
+	for (std::vector<bytestring>::const_iterator i = entries.begin(); i != entries.end(); i++)
+	{
+		body += (unsigned char) (i->size() >> 8);
+		body += (unsigned char) (i->size() & 0xff);
+		body += *i;
+	}
+	
+	bytestring message;
+	
+	message += tag;
+	message += (unsigned char) (entries.size() >> 8);
+	message += (unsigned char) (entries.size() & 0xff);
+	message += (unsigned char) 0x00;
+	message += (unsigned char) 0x00;
+	message += (unsigned char) (body.size() >> 8);
+	message += (unsigned char) (body.size() & 0xff);
+	message += body;
+	
+	return std::string((const char*) message.const_byte_str(), message.size());
+}
+
+void card_tests::test_text()
+{
+	std::istringstream in("response 6F009000\nresponse 9000\n");
+	std::ostringstream out;
+	
+	silvia_stdio_card card(false, in, out);
+	
+	CPPUNIT_ASSERT(!card.is_binary());
+	CPPUNIT_ASSERT(out.str().empty());
+	
+	std::vector<bytestring> APDUs;
+	std::vector<bytestring> data_sw;
+	
+	APDUs.push_back("00A4040009F849524D416361726400");
+	APDUs.push_back("0020000008303030300000000000");
+	
+	CPPUNIT_ASSERT(card.transmit_batch(APDUs, data_sw));
+	CPPUNIT_ASSERT(data_sw.size() == 2);
+	CPPUNIT_ASSERT(data_sw[0] == "6F009000");
+	CPPUNIT_ASSERT(data_sw[1] == "9000");
+	
+	CPPUNIT_ASSERT(out.str() == "request 00A4040009F849524D416361726400\nrequest 0020000008303030300000000000\n");
+}
+
+void card_tests::test_binary_refused()
+{
+	std::istringstream in("binary-framing no\nresponse 9000\n");
+	std::ostringstream out;
+	
+	silvia_stdio_card card(true, in, out);
+	
+	CPPUNIT_ASSERT(!card.is_binary());
+	
+	bytestring data_sw;
+	
+	CPPUNIT_ASSERT(card.transmit("00A4040009F849524D416361726400", data_sw));
+	CPPUNIT_ASSERT(data_sw == "9000");
+	
+	CPPUNIT_ASSERT(out.str() == "control binary-framing\nrequest 00A4040009F849524D416361726400\n");
+}
+
+void card_tests::test_binary()
+{
+	std::vector<bytestring> APDUs;
+	std::vector<bytestring> responses;
+	
+	APDUs.push_back("00A4040009F849524D416361726400");
+	APDUs.push_back("0020000008303030300000000000");
+	APDUs.push_back("802A00000A");
+	
+	// The peer stops at the second APDU
+	responses.push_back("6F009000");
+	responses.push_back("63C2");
+	
+	std::istringstream in("binary-framing OK\n" + binary_message(SILVIA_STDIO_TAG_RESPONSE, responses));
+	std::ostringstream out;
+	
+	silvia_stdio_card card(true, in, out);
+	
+	CPPUNIT_ASSERT(card.is_binary());
+	
+	std::vector<bytestring> data_sw;
+	std::vector<unsigned long long> timings;
+	
+	CPPUNIT_ASSERT(card.transmit_batch(APDUs, data_sw, &timings));
+	CPPUNIT_ASSERT(data_sw.size() == 2);
+	CPPUNIT_ASSERT(data_sw[0] == "6F009000");
+	CPPUNIT_ASSERT(data_sw[1] == "63C2");
+	CPPUNIT_ASSERT(timings.size() == 2);
+	
+	// The whole batch is sent as a single message
+	CPPUNIT_ASSERT(out.str() == "control binary-framing\n" + binary_message(SILVIA_STDIO_TAG_REQUEST, APDUs));
+	
+	// A truncated or malformed response fails the exchange
+	bytestring response;
+	
+	CPPUNIT_ASSERT(!card.transmit("00A4040009F849524D416361726400", response));
+	
+	std::istringstream bad_in("binary-framing OK\n" + binary_message(SILVIA_STDIO_TAG_REQUEST, responses));
+	silvia_stdio_card bad_card(true, bad_in, out);
+	
+	CPPUNIT_ASSERT(bad_card.is_binary());
+	CPPUNIT_ASSERT(!bad_card.transmit("00A4040009F849524D416361726400", response));
+	
+	// Responses after a status word other than 9000 are not accepted
+	std::vector<bytestring> continued;
+	
+	continued.push_back("63C2");
+	continued.push_back("9000");
+	
+	std::istringstream continued_in("binary-framing OK\n" + binary_message(SILVIA_STDIO_TAG_RESPONSE, continued));
+	silvia_stdio_card continued_card(true, continued_in, out);
+	
+	data_sw.clear();
+	
+	CPPUNIT_ASSERT(continued_card.is_binary());
+	CPPUNIT_ASSERT(!continued_card.transmit_batch(APDUs, data_sw));
+	
+	// The body length must fit the number of responses
+	std::string oversized = binary_message(SILVIA_STDIO_TAG_RESPONSE, responses);
+	oversized[3] = (char) 0x7f;
+	
+	std::istringstream oversized_in("binary-framing OK\n" + oversized);
+	silvia_stdio_card oversized_card(true, oversized_in, out);
+	
+	CPPUNIT_ASSERT(oversized_card.is_binary());
+	CPPUNIT_ASSERT(!oversized_card.transmit_batch(APDUs, data_sw));
+}
+
+void card_tests::test_binary_interleaved_text()
+{
+	std::vector<bytestring> first;
+	std::vector<bytestring> second;
+	
+	first.push_back("6982");
+	second.push_back("AABB9000");
+	
+	// A PIN line is read by the application between two messages
+	std::istringstream in("binary-framing OK\n" + binary_message(SILVIA_STDIO_TAG_RESPONSE, first) + "PIN 0000\n" + binary_message(SILVIA_STDIO_TAG_RESPONSE, second));
+	std::ostringstream out;
+	
+	silvia_stdio_card card(true, in, out);
+	
+	bytestring data;
+	unsigned short sw;
+	
+	CPPUNIT_ASSERT(card.transmit("802A00000A", data, sw));
+	CPPUNIT_ASSERT(data.size() == 0);
+	CPPUNIT_ASSERT(sw == 0x6982);
+	
+	std::string response_type;
+	std::string PIN;
+	
+	in >> response_type >> PIN;
+	
+	CPPUNIT_ASSERT(response_type == "PIN");
+	CPPUNIT_ASSERT(PIN == "0000");
+	
+	CPPUNIT_ASSERT(card.transmit("802A00000A", data, sw));
+	CPPUNIT_ASSERT(data == "AABB");
+	CPPUNIT_ASSERT(sw == 0x9000);
+}
+
@@ -0,0 +1,422 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ servertests.cpp
+
+ Tests the stdio socket server
+ *****************************************************************************/
+
+#include "config.h"
+#include <stdlib.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include "servertests.h"
+#include "silvia_stdio_server.h"
+#include "silvia_bytestring.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(server_tests);
+
+void server_tests::setUp()
+{
+}
+
+void server_tests::tearDown()
+{
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+// Session that sends two commands and reports the responses
+class scripted_session : public silvia_session
+{
+public:
+	scripted_session(bool verify_pin)
+	{
+		this->verify_pin = verify_pin;
+		round = 0;
+	}
+
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands)
+	{
+		if (round++ == 0)
+		{
+			commands.push_back("00A4040009F849524D416361726400");
+			commands.push_back("80B0000000");
+			
+			if (verify_pin)
+			{
+				require_pin();
+			}
+			
+			return SILVIA_SESSION_RUNNING;
+		}
+		
+		std::string result = "result";
+		
+		for (std::vector<bytestring>::const_iterator i = results.begin(); i != results.end(); i++)
+		{
+			result += " " + i->hex_str();
+		}
+		
+		add_message(result);
+		
+		return SILVIA_SESSION_SUCCEEDED;
+	}
+
+private:
+	bool verify_pin;
+	int round;
+};
+
+class scripted_factory : public silvia_session_factory
+{
+public:
+	scripted_factory(bool verify_pin = false)
+	{
+		this->verify_pin = verify_pin;
+	}
+
+	virtual silvia_session* create_session()
+	{
+		return new scripted_session(verify_pin);
+	}
+
+private:
+	bool verify_pin;
+};
+
+// Runs the server on a separate thread
+class server_runner
+{
+public:
+	server_runner(silvia_session_factory* factory)
+	{
+		char path[64];
+		snprintf(path, 64, "/tmp/silvia_stdiotest_%d.sock", (int) getpid());
+		
+		socket_path = path;
+		server = new silvia_stdio_server(factory);
+		
+		CPPUNIT_ASSERT(server->listen("unix:" + socket_path));
+		
+		pthread_create(&thread, NULL, server_main, this);
+	}
+
+	~server_runner()
+	{
+		server->stop();
+		
+		pthread_join(thread, NULL);
+		
+		delete server;
+		
+		CPPUNIT_ASSERT(access(socket_path.c_str(), F_OK) != 0);
+	}
+
+	std::string socket_path;
+
+private:
+	static void* server_main(void* arg)
+	{
+		((server_runner*) arg)->server->run();
+		
+		return NULL;
+	}
+
+	silvia_stdio_server* server;
+	pthread_t thread;
+};
+
+// Minimal blocking client
+class test_client
+{
+public:
+	test_client(const std::string& path)
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, path.c_str());
+		
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		
+		if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	~test_client()
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+
+	bool read_line(std::string& line)
+	{
+		size_t eol;
+		
+		while ((eol = buf.find('\n')) == std::string::npos)
+		{
+			char data[256];
+			ssize_t len = read(fd, data, sizeof(data));
+			
+			if (len <= 0)
+			{
+				return false;
+			}
+			
+			buf.append(data, len);
+		}
+		
+		line = buf.substr(0, eol);
+		buf.erase(0, eol + 1);
+		
+		return true;
+	}
+
+	void write_line(const std::string& line)
+	{
+		std::string data = line + "\n";
+		
+		CPPUNIT_ASSERT(write(fd, data.data(), data.size()) == (ssize_t) data.size());
+	}
+
+	// Echo every request with the specified status word appended
+	std::vector<std::string> echo_session(const std::string& sw = "9000")
+	{
+		std::vector<std::string> lines;
+		std::string line;
+		
+		while (read_line(line))
+		{
+			lines.push_back(line);
+			
+			if (line.compare(0, 8, "request ") == 0)
+			{
+				write_line("response " + line.substr(8) + sw);
+			}
+		}
+		
+		return lines;
+	}
+
+	int fd;
+
+private:
+	std::string buf;
+};
+
+static void* concurrent_client(void* arg)
+{
+	test_client client(*((std::string*) arg));
+	
+	std::vector<std::string> lines = client.echo_session();
+	
+	bool rv = (lines.size() == 3) && (lines[2] == "result 00A4040009F849524D4163617264009000 80B00000009000");
+	
+	return rv ? arg : NULL;
+}
+
+void server_tests::test_session()
+{
+	scripted_factory factory;
+	server_runner runner(&factory);
+	
+	test_client client(runner.socket_path);
+	
+	CPPUNIT_ASSERT(client.fd >= 0);
+	
+	std::vector<std::string> lines = client.echo_session();
+	
+	CPPUNIT_ASSERT(lines.size() == 3);
+	CPPUNIT_ASSERT(lines[0] == "request 00A4040009F849524D416361726400");
+	CPPUNIT_ASSERT(lines[1] == "request 80B0000000");
+	CPPUNIT_ASSERT(lines[2] == "result 00A4040009F849524D4163617264009000 80B00000009000");
+}
+
+void server_tests::test_pin()
+{
+	// The card requires the PIN for the second command
+	{
+		scripted_factory factory;
+		server_runner runner(&factory);
+		
+		test_client client(runner.socket_path);
+		std::string line;
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 00A4040009F849524D416361726400"));
+		client.write_line("response 9000");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 80B0000000"));
+		client.write_line("response 6982");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "control send-pin"));
+		client.write_line("PIN 123456789");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "warning pin-too-long"));
+		client.write_line("PIN 0000");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 00200000083030303000000000"));
+		client.write_line("response 9000");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 80B0000000"));
+		client.write_line("response 01029000");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "result 9000 01029000"));
+		CPPUNIT_ASSERT(!client.read_line(line));
+	}
+	
+	// The PIN is only asked for once if the card keeps refusing the command
+	{
+		scripted_factory factory;
+		server_runner runner(&factory);
+		
+		test_client client(runner.socket_path);
+		std::string line;
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 00A4040009F849524D416361726400"));
+		client.write_line("response 9000");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 80B0000000"));
+		client.write_line("response 6982");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "control send-pin"));
+		client.write_line("PIN-result OK");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 80B0000000"));
+		client.write_line("response 6982");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "result 9000 6982"));
+		CPPUNIT_ASSERT(!client.read_line(line));
+	}
+	
+	// The session asks for the PIN up front and the PIN is wrong
+	{
+		scripted_factory factory(true);
+		server_runner runner(&factory);
+		
+		test_client client(runner.socket_path);
+		std::string line;
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "control send-pin"));
+		client.write_line("PIN 1234");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "request 00200000083132333400000000"));
+		client.write_line("response 63C2");
+		
+		CPPUNIT_ASSERT(client.read_line(line) && (line == "error incorrect-pin 2"));
+		CPPUNIT_ASSERT(!client.read_line(line));
+	}
+}
+
+void server_tests::test_concurrent_sessions()
+{
+	scripted_factory factory;
+	server_runner runner(&factory);
+	
+	std::vector<pthread_t> clients(64);
+	
+	for (std::vector<pthread_t>::iterator i = clients.begin(); i != clients.end(); i++)
+	{
+		CPPUNIT_ASSERT(pthread_create(&(*i), NULL, concurrent_client, &runner.socket_path) == 0);
+	}
+	
+	size_t succeeded = 0;
+	
+	for (std::vector<pthread_t>::iterator i = clients.begin(); i != clients.end(); i++)
+	{
+		void* rv = NULL;
+		
+		pthread_join(*i, &rv);
+		
+		if (rv != NULL) succeeded++;
+	}
+	
+	CPPUNIT_ASSERT(succeeded == clients.size());
+}
+
+void server_tests::test_protocol_error()
+{
+	scripted_factory factory;
+	server_runner runner(&factory);
+	
+	test_client client(runner.socket_path);
+	std::string line;
+	
+	CPPUNIT_ASSERT(client.read_line(line) && (line == "request 00A4040009F849524D416361726400"));
+	client.write_line("PIN 0000");
+	
+	CPPUNIT_ASSERT(client.read_line(line) && (line == "error protocol-error"));
+	CPPUNIT_ASSERT(!client.read_line(line));
+	
+	// A message without an end is not buffered indefinitely
+	test_client long_client(runner.socket_path);
+	
+	CPPUNIT_ASSERT(long_client.read_line(line) && (line == "request 00A4040009F849524D416361726400"));
+	
+	std::string data(80 * 1024, 'A');
+	
+	CPPUNIT_ASSERT(send(long_client.fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t) data.size());
+	
+	CPPUNIT_ASSERT(long_client.read_line(line) && (line == "error protocol-error"));
+	CPPUNIT_ASSERT(!long_client.read_line(line));
+}
+
+#else // !HAVE_SYS_EPOLL_H
+
+void server_tests::test_session()
+{
+}
+
+void server_tests::test_pin()
+{
+}
+
+void server_tests::test_concurrent_sessions()
+{
+}
+
+void server_tests::test_protocol_error()
+{
+}
+
+#endif // HAVE_SYS_EPOLL_H
+
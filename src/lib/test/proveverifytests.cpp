@@ -48,6 +48,7 @@
 #include "silvia_macros.h"
 #include "silvia_rand.h"
 #include "silvia_timer.h"
+#include "silvia_thread_pool.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(proveverify_tests);
 
@@ -330,6 +331,74 @@ void proveverify_tests::test_prove_and_verify()
 		printf("\n\nScenario %d: average time per verification is %llums\n\n", scenario, elapsed / (1000*1000) / proof_count);
 	}
 	
+	////////////////////////////////////////////////////////////////////
+	// Generate and verify <proof_count> proofs using coupons that are
+	// precomputed in the background, disclosing 1 attribute and hiding 2
+	////////////////////////////////////////////////////////////////////
+	
+	{
+		std::vector<bool> D;
+		
+		D.push_back(false);
+		D.push_back(false);
+		D.push_back(true);
+		
+		silvia_thread_pool pool;
+		
+		prover.precompute(D, proof_count, &pool);
+		prover.wait_for_coupons();
+		
+		CPPUNIT_ASSERT(prover.get_coupon_count(D) == proof_count);
+		
+		std::vector<mpz_class> c_on(proof_count);
+		std::vector<mpz_class> A_prime_on(proof_count);
+		std::vector<mpz_class> e_hat_on(proof_count);
+		std::vector<mpz_class> v_prime_hat_on(proof_count);
+		std::vector<std::vector<mpz_class> > a_i_hat_on(proof_count);
+		std::vector<std::vector<silvia_attribute*> > a_i_on(proof_count);
+		std::vector<mpz_class> n1_on(proof_count);
+		
+		proof_timer.mark();
+		
+		for (int i = 0; i < proof_count; i++)
+		{
+			n1_on[i] = silvia_rng::i()->get_random(SYSPAR(l_statzk));
+			
+			prover.prove(D, n1_on[i], context, c_on[i], A_prime_on[i], e_hat_on[i], v_prime_hat_on[i], a_i_hat_on[i], a_i_on[i]);
+		}
+		
+		unsigned long long elapsed = proof_timer.elapsed();
+		
+		printf("\n\nAverage time per proof with a precomputed coupon is %lluus\n\n", elapsed / 1000 / proof_count);
+		
+		// All coupons have been used exactly once
+		CPPUNIT_ASSERT(prover.get_coupon_count(D) == 0);
+		
+		for (int i = 0; i < proof_count; i++)
+		{
+			// Coupons are never reused
+			if (i > 0)
+			{
+				CPPUNIT_ASSERT(A_prime_on[i] != A_prime_on[i - 1]);
+			}
+			
+			verifier.get_verifier_nonce(&n1_on[i]);
+			CPPUNIT_ASSERT(verifier.verify(D, context, c_on[i], A_prime_on[i], e_hat_on[i], v_prime_hat_on[i], a_i_hat_on[i], a_i_on[i]) == true);
+		}
+		
+		// Coupons for another pattern are not used for this pattern
+		std::vector<bool> D_all(3, true);
+		
+		prover.precompute(D_all, 2);
+		
+		CPPUNIT_ASSERT(prover.get_coupon_count(D_all) == 2);
+		CPPUNIT_ASSERT(prover.get_coupon_count(D) == 0);
+		
+		prover.clear_coupons();
+		
+		CPPUNIT_ASSERT(prover.get_coupon_count(D_all) == 0);
+	}
+	
 	////////////////////////////////////////////////////////////////////
 	// Clean up
 	////////////////////////////////////////////////////////////////////	
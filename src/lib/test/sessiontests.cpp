@@ -0,0 +1,383 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ sessiontests.cpp
+
+ Drive many issuance and verification sessions from a single thread
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <time.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <gmpxx.h>
+#include "sessiontests.h"
+#include "testvectors.h"
+#include "silvia_session.h"
+#include "silvia_irma_issuer_session.h"
+#include "silvia_irma_verifier_session.h"
+#include "silvia_emulated_card.h"
+#include "silvia_types.h"
+#include "silvia_parameters.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(session_tests);
+
+void session_tests::setUp()
+{
+	set_test_parameters();
+}
+
+void session_tests::tearDown()
+{
+	silvia_system_parameters::i()->reset();
+}
+
+/**
+ * Handler that exchanges the commands with emulated cards from the test
+ * thread; the exchanges are queued and performed after dispatching, as
+ * a network or card link would deliver them later
+ */
+class emulated_card_handler : public silvia_session_handler
+{
+public:
+	virtual void send(silvia_session* session, const std::vector<bytestring>& commands)
+	{
+		pending.push_back(std::make_pair(session, commands));
+	}
+	
+	virtual void finished(silvia_session* session)
+	{
+		done.push_back(session);
+	}
+	
+	void exchange(silvia_session_loop& loop)
+	{
+		std::vector<std::pair<silvia_session*, std::vector<bytestring> > > exchanges;
+		
+		exchanges.swap(pending);
+		
+		for (std::vector<std::pair<silvia_session*, std::vector<bytestring> > >::iterator i = exchanges.begin(); i != exchanges.end(); i++)
+		{
+			std::vector<bytestring> responses;
+			
+			if (cards[i->first]->transmit_batch(i->second, responses))
+			{
+				loop.deliver(i->first, responses);
+			}
+			else
+			{
+				loop.fail(i->first);
+			}
+		}
+	}
+	
+	std::map<silvia_session*, silvia_card_channel*> cards;
+	std::vector<std::pair<silvia_session*, std::vector<bytestring> > > pending;
+	std::vector<silvia_session*> done;
+};
+
+/**
+ * Card that accepts the PIN but keeps refusing every other command
+ */
+class pin_refusing_card : public silvia_card_channel
+{
+public:
+	pin_refusing_card()
+	{
+		verifications = 0;
+	}
+	
+	virtual int get_type() { return SILVIA_CHANNEL_STDIO; }
+	
+	virtual bool status() { return true; }
+	
+	virtual bool transmit(const bytestring& APDU, bytestring& data, unsigned short& sw)
+	{
+		data.wipe();
+		
+		if ((APDU.size() >= 2) && (APDU[1] == 0x20))
+		{
+			verifications++;
+			sw = 0x9000;
+		}
+		else
+		{
+			sw = 0x6982;
+		}
+		
+		return true;
+	}
+	
+	virtual bool transmit(const bytestring& APDU, bytestring& data_sw)
+	{
+		unsigned short sw;
+		
+		transmit(APDU, data_sw, sw);
+		
+		data_sw += (unsigned char) (sw >> 8);
+		data_sw += (unsigned char) (sw & 0xff);
+		
+		return true;
+	}
+	
+	virtual std::string get_reader_name() { return "pin-refusing"; }
+	
+	size_t verifications;
+};
+
+/**
+ * Session that sends a single command and succeeds if the card accepts it
+ */
+class single_command_session : public silvia_session
+{
+public:
+	single_command_session(const std::string PIN) : silvia_session(PIN)
+	{
+		sent = false;
+	}
+
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands)
+	{
+		if (!sent)
+		{
+			sent = true;
+			commands.push_back("80B0000000");
+			
+			return SILVIA_SESSION_RUNNING;
+		}
+		
+		if ((results.size() == 1) && (results[0] == "9000"))
+		{
+			return SILVIA_SESSION_SUCCEEDED;
+		}
+		
+		return SILVIA_SESSION_FAILED;
+	}
+
+private:
+	bool sent;
+};
+
+// Run the loop until all sessions have finished
+static void run_loop(silvia_session_loop& loop, emulated_card_handler& handler)
+{
+	while (loop.get_session_count() > 0)
+	{
+		loop.dispatch(handler.pending.empty());
+		
+		handler.exchange(loop);
+	}
+}
+
+void session_tests::test_sessions()
+{
+	const size_t num_cards = 8;
+	
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_priv_key* privkey = test_privkey();
+	silvia_issue_specification* ispec = test_ispec();
+	silvia_verifier_specification* vspec = test_vspec();
+	
+	emulated_card_handler handler;
+	silvia_session_loop loop(&handler);
+	std::vector<silvia_emulated_card*> cards;
+	
+	// Issue a credential to all cards concurrently
+	for (size_t i = 0; i < num_cards; i++)
+	{
+		cards.push_back(new silvia_emulated_card("1234"));
+		
+		silvia_session* session = new silvia_irma_issuer_session(pubkey, privkey, ispec, "1234");
+		
+		handler.cards[session] = cards.back();
+		
+		loop.start(session);
+	}
+	
+	run_loop(loop, handler);
+	
+	CPPUNIT_ASSERT(handler.done.size() == num_cards);
+	
+	for (size_t i = 0; i < num_cards; i++)
+	{
+		CPPUNIT_ASSERT(handler.done[i]->get_state() == SILVIA_SESSION_SUCCEEDED);
+		CPPUNIT_ASSERT(cards[i]->num_credentials() == 1);
+		
+		delete handler.done[i];
+	}
+	
+	handler.done.clear();
+	handler.cards.clear();
+	
+	// Verify all cards concurrently, twice per card; a card can only run
+	// one session at a time, since selecting the application on behalf of
+	// one session resets the card state of another session
+	for (int wave = 0; wave < 2; wave++)
+	{
+		for (size_t i = 0; i < num_cards; i++)
+		{
+			silvia_session* session = new silvia_irma_verifier_session(pubkey, vspec);
+			
+			handler.cards[session] = cards[i];
+			
+			loop.start(session);
+		}
+		
+		CPPUNIT_ASSERT(loop.get_session_count() == num_cards);
+		
+		run_loop(loop, handler);
+		
+		CPPUNIT_ASSERT(handler.done.size() == num_cards);
+		
+		for (std::vector<silvia_session*>::iterator i = handler.done.begin(); i != handler.done.end(); i++)
+		{
+			silvia_irma_verifier_session* session = (silvia_irma_verifier_session*) *i;
+			
+			CPPUNIT_ASSERT(session->get_state() == SILVIA_SESSION_SUCCEEDED);
+			CPPUNIT_ASSERT(session->get_revealed().size() == 2);
+			CPPUNIT_ASSERT(session->get_revealed()[1].first == "over16");
+			CPPUNIT_ASSERT(session->get_revealed()[1].second == ispec->get_attributes()[1]->bs_rep());
+			
+			delete session;
+		}
+		
+		handler.done.clear();
+		handler.cards.clear();
+	}
+	
+	for (std::vector<silvia_emulated_card*>::iterator i = cards.begin(); i != cards.end(); i++)
+	{
+		delete *i;
+	}
+	
+	delete vspec;
+	delete ispec;
+	delete privkey;
+	delete pubkey;
+}
+
+void session_tests::test_pin()
+{
+	silvia_pub_key* pubkey = test_pubkey();
+	silvia_priv_key* privkey = test_privkey();
+	silvia_issue_specification* ispec = test_ispec();
+	silvia_verifier_specification* vspec = test_vspec();
+	
+	emulated_card_handler handler;
+	silvia_session_loop loop(&handler);
+	silvia_emulated_card card("1234");
+	
+	// Issuance with a wrong PIN or without a PIN fails
+	silvia_session* wrong_pin = new silvia_irma_issuer_session(pubkey, privkey, ispec, "4321");
+	silvia_session* no_pin = new silvia_irma_issuer_session(pubkey, privkey, ispec, "");
+	
+	handler.cards[wrong_pin] = &card;
+	handler.cards[no_pin] = &card;
+	
+	loop.start(wrong_pin);
+	run_loop(loop, handler);
+	loop.start(no_pin);
+	run_loop(loop, handler);
+	
+	CPPUNIT_ASSERT(wrong_pin->get_state() == SILVIA_SESSION_FAILED);
+	CPPUNIT_ASSERT(no_pin->get_state() == SILVIA_SESSION_FAILED);
+	CPPUNIT_ASSERT(card.num_credentials() == 0);
+	
+	// Issue with the right PIN
+	silvia_session* issue = new silvia_irma_issuer_session(pubkey, privkey, ispec, "1234");
+	
+	handler.cards[issue] = &card;
+	
+	loop.start(issue);
+	run_loop(loop, handler);
+	
+	CPPUNIT_ASSERT(issue->get_state() == SILVIA_SESSION_SUCCEEDED);
+	
+	// Verification on a card that requires the PIN for proofs
+	card.set_require_pin(true);
+	
+	silvia_session* verify_no_pin = new silvia_irma_verifier_session(pubkey, vspec);
+	silvia_session* verify_pin = new silvia_irma_verifier_session(pubkey, vspec, "1234");
+	
+	handler.cards[verify_no_pin] = &card;
+	handler.cards[verify_pin] = &card;
+	
+	loop.start(verify_no_pin);
+	run_loop(loop, handler);
+	loop.start(verify_pin);
+	run_loop(loop, handler);
+	
+	CPPUNIT_ASSERT(verify_no_pin->get_state() == SILVIA_SESSION_FAILED);
+	CPPUNIT_ASSERT(verify_pin->get_state() == SILVIA_SESSION_SUCCEEDED);
+	
+	// A removed card fails the session
+	silvia_session* removed = new silvia_irma_verifier_session(pubkey, vspec, "1234");
+	
+	handler.cards[removed] = &card;
+	card.remove();
+	
+	loop.start(removed);
+	run_loop(loop, handler);
+	
+	CPPUNIT_ASSERT(removed->get_state() == SILVIA_SESSION_FAILED);
+	
+	for (std::vector<silvia_session*>::iterator i = handler.done.begin(); i != handler.done.end(); i++)
+	{
+		delete *i;
+	}
+	
+	delete vspec;
+	delete ispec;
+	delete privkey;
+	delete pubkey;
+}
+
+void session_tests::test_pin_retry()
+{
+	emulated_card_handler handler;
+	silvia_session_loop loop(&handler);
+	pin_refusing_card card;
+	
+	// The command is resent once after PIN verification; the session
+	// fails instead of verifying the PIN over and over again
+	silvia_session* session = new single_command_session("1234");
+	
+	handler.cards[session] = &card;
+	
+	loop.start(session);
+	run_loop(loop, handler);
+	
+	CPPUNIT_ASSERT(session->get_state() == SILVIA_SESSION_FAILED);
+	CPPUNIT_ASSERT(card.verifications == 1);
+	
+	delete session;
+}
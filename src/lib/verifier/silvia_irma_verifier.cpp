@@ -44,14 +44,14 @@
 #include <assert.h>
 #include <time.h>
 
-silvia_irma_verifier::silvia_irma_verifier(silvia_pub_key* pubkey, silvia_verifier_specification* vspec)
+silvia_irma_verifier::silvia_irma_verifier(silvia_pub_key* pubkey, silvia_verifier_specification* vspec, const silvia_runtime* runtime /* = NULL */)
 {
 	this->pubkey = pubkey;
 	this->vspec = vspec;
 	
 	irma_verifier_state = IRMA_VERIFIER_START;
 	
-	verifier = new silvia_verifier(pubkey);
+	verifier = new silvia_verifier(pubkey, runtime);
 }
 
 silvia_irma_verifier::~silvia_irma_verifier()
@@ -97,9 +97,9 @@ bool silvia_irma_verifier::submit_select_data(std::vector<bytestring>& results)
 	
 	for (std::vector<bytestring>::iterator i = results.begin(); i != results.end(); i++)
 	{
-		if ((i->substr(i->size() - 2) != "9000") && 
-		    (i->substr(i->size() - 2) != "6A82") &&
-		    (i->substr(i->size() - 2) != "6D00"))
+		unsigned short sw = silvia_apdu::get_sw(*i);
+		
+		if ((sw != 0x9000) && (sw != 0x6A82) && (sw != 0x6D00))
 		{
 			irma_verifier_state = IRMA_VERIFIER_START;
 		
@@ -119,9 +119,9 @@ bool silvia_irma_verifier::submit_select_data(std::vector<bytestring>& results)
 	
 	for (std::vector<bytestring>::iterator i = results.begin(); i != results.end(); i++)
 	{
-		if (i->substr(i->size() - 2) == "9000")
+		if (silvia_apdu::get_sw(*i) == 0x9000)
 		{
-			irma_version_info = i->substr(0, i->size() - 2);
+			irma_version_info = silvia_apdu::get_data(*i);
 			
 			break;
 		}
@@ -157,10 +157,9 @@ std::vector<bytestring> silvia_irma_verifier::get_proof_commands()
 	
 	// FIXME: context is randomly generated and kept as state!
 	mpz_class context_mpz = silvia_rng::i()->get_random(SYSPAR(l_H));
-	context = bytestring(context_mpz);
+	context = bytestring(context_mpz, SYSPAR_BYTES(l_H));
 	bytestring id;
-	id += (unsigned char) ((vspec->get_credential_id() & 0xff00) >> 8);
-	id += (unsigned char) (vspec->get_credential_id() & 0x00ff);
+	id.append_uint(vspec->get_credential_id(), 2);
 	
 	// Build proof specification
 	unsigned short D_val = 0;
@@ -176,13 +175,11 @@ std::vector<bytestring> silvia_irma_verifier::get_proof_commands()
 		D_mask = D_mask << 1;
 	}
 	
-	bytestring D = (unsigned long) D_val;
-	D = D.substr(D.size() - 2);
-	
-	bytestring timestamp = (unsigned long) time(NULL);
-	timestamp = timestamp.substr(timestamp.size() - 4);
+	bytestring D;
+	D.append_uint(D_val, 2);
 	
-	while (context.size() < (SYSPAR(l_H)/8)) context = "00" + context;
+	bytestring timestamp;
+	timestamp.append_uint(time(NULL), 4);
 	
 	silvia_apdu prove_apdu(0x80, 0x20, 0x00, 0x00);
 	
@@ -213,13 +210,8 @@ std::vector<bytestring> silvia_irma_verifier::get_proof_commands()
 	// Step 3: send nonce and get commitment hash
 	////////////////////////////////////////////////////////////////////
 	
-	mpz_class n1 = verifier->get_verifier_nonce();
-	bytestring n1_val(n1);
-	
-	while (n1_val.size() < 10) n1_val = "00" + n1_val;
-	
 	silvia_apdu commit_apdu(0x80, 0x2a, 0x00, 0x00);
-	commit_apdu.append_data(n1_val);
+	commit_apdu.append_mpz(verifier->get_verifier_nonce(), 10);
 	
 	commands.push_back(commit_apdu.get_apdu());
 	
@@ -228,13 +220,13 @@ std::vector<bytestring> silvia_irma_verifier::get_proof_commands()
 	////////////////////////////////////////////////////////////////////
 	
 	// Prove signature A'
-	commands.push_back("802b0100");
+	commands.push_back(silvia_apdu(0x80, 0x2B, 0x01, 0x00).get_apdu());
 	
 	// Prove signature e^
-	commands.push_back("802b0200");
+	commands.push_back(silvia_apdu(0x80, 0x2B, 0x02, 0x00).get_apdu());
 	
 	// Prove signature v'^
-	commands.push_back("802b0300");
+	commands.push_back(silvia_apdu(0x80, 0x2B, 0x03, 0x00).get_apdu());
 	
 	////////////////////////////////////////////////////////////////////
 	// Step 5: retrieve the attribute values
@@ -278,7 +270,7 @@ bool silvia_irma_verifier::submit_and_verify(std::vector<bytestring>& results, s
 	
 	for (std::vector<bytestring>::iterator i = results.begin(); i != results.end(); i++)
 	{
-		if (i->substr(i->size() - 2) != "9000")
+		if (silvia_apdu::get_sw(*i) != 0x9000)
 		{
 			irma_verifier_state = IRMA_VERIFIER_START;
 		
@@ -288,7 +280,7 @@ bool silvia_irma_verifier::submit_and_verify(std::vector<bytestring>& results, s
 		}
 	}
 	
-#define MPZ_FROM_RESULT(result_index) results[result_index].substr(0, results[result_index].size() - 2).mpz_val()
+#define MPZ_FROM_RESULT(result_index) silvia_apdu::get_data(results[result_index]).mpz_val()
 
 	// Retrieve generic values from command results
 	
@@ -342,7 +334,7 @@ bool silvia_irma_verifier::submit_and_verify(std::vector<bytestring>& results, s
 		{
 			a_i.push_back(new silvia_integer_attribute(MPZ_FROM_RESULT(ri)));
 			
-			revealed.push_back(make_pair(vspec->get_attribute_names()[ai], results[ri].substr(0, results[ri].size() - 2)));
+			revealed.push_back(make_pair(vspec->get_attribute_names()[ai], bytestring(silvia_apdu::get_data(results[ri]))));
 		}
 		else
 		{
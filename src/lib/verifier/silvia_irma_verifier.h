@@ -60,8 +60,9 @@ public:
 	 * Constructor
 	 * @param pubkey the issuer public key
 	 * @param vspec the verifier specification
+	 * @param runtime the runtime context; if NULL, a context with the current system parameters is used
 	 */
-	silvia_irma_verifier(silvia_pub_key* pubkey, silvia_verifier_specification* vspec);
+	silvia_irma_verifier(silvia_pub_key* pubkey, silvia_verifier_specification* vspec, const silvia_runtime* runtime = NULL);
 	
 	/**
 	 * Destructor
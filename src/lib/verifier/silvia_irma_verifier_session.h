@@ -0,0 +1,89 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_irma_verifier_session.h
+
+ Non-blocking IRMA verification session
+ *****************************************************************************/
+
+#ifndef _SILVIA_IRMA_VERIFIER_SESSION_H
+#define _SILVIA_IRMA_VERIFIER_SESSION_H
+
+#include "silvia_types.h"
+#include "silvia_session.h"
+#include "silvia_irma_verifier.h"
+#include "silvia_verifier_spec.h"
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+ * IRMA verification session; selects the IRMA application, requests a
+ * proof and verifies it
+ */
+class silvia_irma_verifier_session : public silvia_session
+{
+public:
+	/**
+	 * Constructor
+	 * @param pubkey the issuer public key (shared with other sessions)
+	 * @param vspec the verifier specification
+	 * @param PIN the PIN to verify if the card requests it (optional)
+	 */
+	silvia_irma_verifier_session(silvia_pub_key* pubkey, silvia_verifier_specification* vspec, const std::string PIN = "");
+	
+	/**
+	 * Get the revealed attributes
+	 * @return the revealed attributes as pairs of (id, value) after a successful session
+	 */
+	const std::vector<std::pair<std::string, bytestring> >& get_revealed();
+
+protected:
+	virtual silvia_session_state_t next_round(std::vector<bytestring>& results, std::vector<bytestring>& commands);
+	
+	virtual bool accept_status(unsigned short sw);
+
+private:
+	// The verifier
+	silvia_irma_verifier verifier;
+	
+	// The revealed attributes
+	std::vector<std::pair<std::string, bytestring> > revealed;
+	
+	enum
+	{
+		VERIFIER_SESSION_START,
+		VERIFIER_SESSION_SELECT,
+		VERIFIER_SESSION_PROVE
+	}
+	step;
+};
+
+#endif // !_SILVIA_IRMA_VERIFIER_SESSION_H
+
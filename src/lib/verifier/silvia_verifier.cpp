@@ -41,13 +41,20 @@
 #include "silvia_macros.h"
 #include "silvia_hash.h"
 #include "silvia_asn1.h"
+#include "silvia_multiexp.h"
+#include "silvia_thread_pool.h"
 #include <vector>
 #include <assert.h>
 
-silvia_verifier::silvia_verifier(silvia_pub_key* pubkey)
+silvia_verifier::silvia_verifier(silvia_pub_key* pubkey, const silvia_runtime* runtime /* = NULL */)
 {
 	this->pubkey = pubkey;
 	
+	if (runtime != NULL)
+	{
+		this->runtime = *runtime;
+	}
+	
 	verifier_state = VERIFIER_START;
 }
 
@@ -59,7 +66,7 @@ mpz_class silvia_verifier::get_verifier_nonce(mpz_class* ext_n1 /* = NULL */)
 	
 	if (ext_n1 == NULL)
 	{
-		return (n1 = silvia_rng::i()->get_random(SYSPAR(l_statzk)));
+		return (n1 = runtime.get_rng()->get_random(RTPAR(l_statzk)));
 	}
 	else
 	{
@@ -83,27 +90,135 @@ bool silvia_verifier::verify
 	
 	verifier_state = VERIFIER_START;
 	
+	return verify_proof(D, context, n1, c, A_prime, e_hat, v_prime_hat, a_i_hat, a_i);
+}
+
+/**
+ * Job that verifies a single proof of a batch
+ */
+class silvia_verifier::verify_batch_job : public silvia_job
+{
+public:
+	verify_batch_job(silvia_verifier* verifier, const silvia_proof* proof, char* result, silvia_job_countdown* countdown)
+	{
+		this->verifier = verifier;
+		this->proof = proof;
+		this->result = result;
+		this->countdown = countdown;
+	}
+
+	virtual void run()
+	{
+		*result = verifier->verify_proof
+		(
+			proof->D,
+			proof->context,
+			proof->n1,
+			proof->c,
+			proof->A_prime,
+			proof->e_hat,
+			proof->v_prime_hat,
+			proof->a_i_hat,
+			proof->a_i
+		) ? 1 : 0;
+
+		countdown->done();
+	}
+
+private:
+	silvia_verifier* verifier;
+	const silvia_proof* proof;
+	char* result;
+	silvia_job_countdown* countdown;
+};
+
+std::vector<bool> silvia_verifier::verify_batch(const std::vector<silvia_proof>& proofs, silvia_thread_pool* pool /* = NULL */)
+{
+	silvia_thread_pool* batch_pool = (pool == NULL) ? new silvia_thread_pool() : pool;
+	
+	// The workers share the public key, so its tables are built
+	// before the first job starts
+	pubkey->precompute(runtime.get_params());
+	
+	// Each job writes its own result; std::vector<bool> cannot
+	// safely be written from multiple threads
+	std::vector<char> results(proofs.size(), 0);
+	std::vector<verify_batch_job*> jobs;
+	silvia_job_countdown countdown(proofs.size());
+	
+	for (size_t i = 0; i < proofs.size(); i++)
+	{
+		jobs.push_back(new verify_batch_job(this, &proofs[i], &results[i], &countdown));
+		
+		batch_pool->submit(jobs.back());
+	}
+	
+	// Only wait for the own jobs; the pool may be shared
+	countdown.wait();
+	
+	for (std::vector<verify_batch_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		delete *i;
+	}
+	
+	if (pool == NULL)
+	{
+		delete batch_pool;
+	}
+	
+	return std::vector<bool>(results.begin(), results.end());
+}
+
+bool silvia_verifier::verify_proof
+(
+	const std::vector<bool>& D,
+	const mpz_class& context,
+	const mpz_class& n1,
+	const mpz_class& c,
+	const mpz_class& A_prime,
+	const mpz_class& e_hat,
+	const mpz_class& v_prime_hat,
+	const std::vector<mpz_class>& a_i_hat,
+	const std::vector<silvia_attribute*>& a_i
+)
+{
 	// Check size of a_i^ values
-	for (std::vector<mpz_class>::iterator i = a_i_hat.begin(); i != a_i_hat.end(); i++)
+	for (std::vector<mpz_class>::const_iterator i = a_i_hat.begin(); i != a_i_hat.end(); i++)
 	{
-		if (mpz_sizeinbase(_Z((*i)), 2) > SYSPAR(l_m) + SYSPAR(l_statzk) + SYSPAR(l_H) + 1)
+		if (mpz_sizeinbase(_Z((*i)), 2) > RTPAR(l_m) + RTPAR(l_statzk) + RTPAR(l_H) + 1)
 		{
 			return false;
 		}
 	}
 	
 	// Check size of e^
-	if (mpz_sizeinbase(_Z(e_hat), 2) > SYSPAR(l_e_prime) + SYSPAR(l_statzk) + SYSPAR(l_H) + 1)
+	if (mpz_sizeinbase(_Z(e_hat), 2) > RTPAR(l_e_prime) + RTPAR(l_statzk) + RTPAR(l_H) + 1)
+		return false;
+	
+	// Check that there is an R value for every attribute
+	if (D.size() + 1 > pubkey->get_R().size())
 		return false;
 		
-	// Compute Z^
+	// Compute Z^ = Z^-c * (prod(R_i^a_i) * A'^2^(l_e-1))^c * A'^e^ * prod(R_i^a_i^) * S^v'^
+	//
+	// All factors are computed in a single multi-exponentiation, so the
+	// inverse of the denominator is never computed explicitly; instead,
+	// its factors are raised to the power c
+	silvia_multiexp Z_hat_me(pubkey->get_modulus());
+	
+	// Factor in Z^-c
+	mpz_class c_neg = -c;
+	
+	if (!Z_hat_me.add(pubkey->get_Z(), c_neg))
+	{
+		return false;
+	}
 	
-	// Compute denominator prod(R^ai)*A'^2^l_e-1 for revealed attributes
-	mpz_class Z_denom = 1;
-	std::vector<silvia_attribute*>::iterator a_it = a_i.begin();
+	// Factor in R_i^(c*a_i) for revealed attributes
+	std::vector<silvia_attribute*>::const_iterator a_it = a_i.begin();
 	size_t r_index = 1;
 	
-	for (std::vector<bool>::iterator i = D.begin(); i != D.end(); i++)
+	for (std::vector<bool>::const_iterator i = D.begin(); i != D.end(); i++)
 	{		
 		if (*i == true)
 		{
@@ -112,14 +227,7 @@ bool silvia_verifier::verify
 				return false; // prevent crashing because of running out of attributes to verify
 			}
 			
-			mpz_class Ri_ai;
-			mpz_powm(_Z(Ri_ai), _Z(pubkey->get_R()[r_index]), _Z((*a_it)->rep()), _Z(pubkey->get_n()));
-			
-			// Factor it in
-			Z_denom *= Ri_ai;
-			
-			// Reduce in Z(n)
-			mpz_mod(_Z(Z_denom), _Z(Z_denom), _Z(pubkey->get_n()));
+			Z_hat_me.add(pubkey->get_fixed_R(r_index), c * (*a_it)->rep());
 			
 			a_it++;
 		}
@@ -127,44 +235,29 @@ bool silvia_verifier::verify
 		r_index++;
 	}
 	
-	// Factor in A'^2^l_e-1
-	mpz_class A_prime_2;
-	mpz_class two_l_e_1;
-	mpz_setbit(_Z(two_l_e_1), SYSPAR(l_e) - 1);
-	mpz_powm(_Z(A_prime_2), _Z(A_prime), _Z(two_l_e_1), _Z(pubkey->get_n()));
-	
-	Z_denom *= A_prime_2;
-	
-	// Reduce in Z(n) and invert
-	mpz_mod(_Z(Z_denom), _Z(Z_denom), _Z(pubkey->get_n()));
-	mpz_invert(_Z(Z_denom), _Z(Z_denom), _Z(pubkey->get_n()));
-	
-	// Compute this factor of Z^
-	mpz_class Z_hat_fac1;
-	mpz_class c_neg = -c;
-	Z_hat_fac1 = Z_denom * pubkey->get_Z();
-	
-	mpz_powm(_Z(Z_hat_fac1), _Z(Z_hat_fac1), _Z(c_neg), _Z(pubkey->get_n()));
+	// Factor in A'^(c*2^(l_e-1) + e^)
+	mpz_class A_prime_exp;
+	mpz_setbit(_Z(A_prime_exp), RTPAR(l_e) - 1);
+	A_prime_exp *= c;
+	A_prime_exp += e_hat;
 	
-	// Compute A'^e^
-	mpz_class A_prime_e_hat;
-	mpz_powm(_Z(A_prime_e_hat), _Z(A_prime), _Z(e_hat), _Z(pubkey->get_n()));
+	Z_hat_me.add(A_prime, A_prime_exp);
 	
-	// Compute factor for the hidden attributes
-	mpz_class Ri_ai_hat = 1;
+	// Factor in R_i^a_i^ for the hidden attributes
 	r_index = 0;
 	
-	std::vector<mpz_class>::iterator ai_hat_it = a_i_hat.begin();
+	std::vector<mpz_class>::const_iterator ai_hat_it = a_i_hat.begin();
+	
+	if (ai_hat_it == a_i_hat.end()) // prevent running out of a_i^ values
+	{
+		return false;
+	}
 	
 	// Factor in a_i^ value for the master secret
-	mpz_class R0_a0;
-	mpz_powm(_Z(R0_a0), _Z(pubkey->get_R()[r_index++]), _Z((*ai_hat_it)), _Z(pubkey->get_n()));
+	Z_hat_me.add(pubkey->get_fixed_R(r_index++), *ai_hat_it);
 	ai_hat_it++;
 	
-	Ri_ai_hat *= R0_a0;
-	mpz_mod(_Z(Ri_ai_hat), _Z(Ri_ai_hat), _Z(pubkey->get_n()));
-	
-	for (std::vector<bool>::iterator i = D.begin(); i != D.end(); i++)
+	for (std::vector<bool>::const_iterator i = D.begin(); i != D.end(); i++)
 	{
 		if (*i == false)
 		{
@@ -173,12 +266,7 @@ bool silvia_verifier::verify
 				return false;
 			}
 			
-			mpz_class Ri_ai;
-			mpz_powm(_Z(Ri_ai), _Z(pubkey->get_R()[r_index]), _Z((*ai_hat_it)), _Z(pubkey->get_n()));
-			
-			// Factor in the value and reduce in Z(n)
-			Ri_ai_hat *= Ri_ai;
-			mpz_mod(_Z(Ri_ai_hat), _Z(Ri_ai_hat), _Z(pubkey->get_n()));
+			Z_hat_me.add(pubkey->get_fixed_R(r_index), *ai_hat_it);
 			
 			ai_hat_it++;
 		}
@@ -186,39 +274,30 @@ bool silvia_verifier::verify
 		r_index++;
 	}
 	
-	// Finally, compute S^v'^
-	mpz_class S_v_prime_hat;
-	mpz_powm(_Z(S_v_prime_hat), _Z(pubkey->get_S()), _Z(v_prime_hat), _Z(pubkey->get_n()));
+	// Finally, factor in S^v'^
+	if (!Z_hat_me.add(pubkey->get_fixed_S(), v_prime_hat))
+	{
+		return false;
+	}
 	
 	// Compose all the factors to get Z^
-	mpz_class Z_hat = Z_hat_fac1 * A_prime_e_hat * Ri_ai_hat * S_v_prime_hat;
-	
-	// Reduce in Z(n)
-	mpz_mod(_Z(Z_hat), _Z(Z_hat), _Z(pubkey->get_n()));
+	mpz_class Z_hat = Z_hat_me.compute();
 	
 	// Compute proof hash c^
 	
-	// Create ASN.1 DER encoding of value to hash
-	silvia_asn1_sequence challenge_seq;
-	
-	silvia_asn1_integer context_asn1(context);
-	challenge_seq.append(&context_asn1);
-	
-	silvia_asn1_integer A_prime_asn1(A_prime);
-	challenge_seq.append(&A_prime_asn1);
-	
-	silvia_asn1_integer Z_hat_asn1(Z_hat);
-	challenge_seq.append(&Z_hat_asn1);
-	
-	silvia_asn1_integer n1_asn1(n1);
-	challenge_seq.append(&n1_asn1);
+	// Stream the ASN.1 DER encoding of the values to hash
+	silvia_der_sequence challenge_seq;
+	challenge_seq.append(context);
+	challenge_seq.append(A_prime);
+	challenge_seq.append(Z_hat);
+	challenge_seq.append(n1);
 	
 	// Hash the data
-	silvia_hash h(SYSPAR(hash_type));
+	silvia_hash* h = runtime.get_hash();
 	
-	h.init();
-	h.update(challenge_seq.get_der_encoding());
-	mpz_class c_hat = h.final();
+	h->init();
+	challenge_seq.hash(h);
+	mpz_class c_hat = h->final();
 	
 	return (c == c_hat);
 }
@@ -37,8 +37,27 @@
 
 #include <gmpxx.h>
 #include "silvia_types.h"
+#include "silvia_runtime.h"
+#include "silvia_thread_pool.h"
 #include <vector>
 
+/**
+ * Proof for batch verification
+ */
+typedef struct
+{
+	std::vector<bool> D;			/**< which attributes are hidden and which revealed */
+	mpz_class context;			/**< the shared context */
+	mpz_class n1;				/**< the verifier nonce */
+	mpz_class c;				/**< the proof hash c */
+	mpz_class A_prime;			/**< the proof A' value */
+	mpz_class e_hat;			/**< the proof e^ value */
+	mpz_class v_prime_hat;			/**< the proof v'^ value */
+	std::vector<mpz_class> a_i_hat;		/**< the proof's a_i^ values */
+	std::vector<silvia_attribute*> a_i;	/**< the proof's revealed attributes */
+}
+silvia_proof;
+
 /**
  * Verifier class
  */
@@ -49,8 +68,9 @@ public:
 	/**
 	 * Constructor
 	 * @param pubkey the issuer public key
+	 * @param runtime the runtime context; if NULL, a context with the current system parameters is used
 	 */
-	silvia_verifier(silvia_pub_key* pubkey);
+	silvia_verifier(silvia_pub_key* pubkey, const silvia_runtime* runtime = NULL);
 	
 	/**
 	 * Get the verifier nonce
@@ -83,12 +103,39 @@ public:
 		std::vector<silvia_attribute*> a_i
 	);
 	
+	/**
+	 * Verify a batch of proofs made with the issuer public key of this
+	 * verifier; the proofs are verified in parallel and independent of
+	 * the nonce state of this verifier
+	 * @param proofs the proofs to verify, each with its own nonce n1
+	 * @param pool the thread pool to use; if NULL, a temporary pool with one thread per CPU is used
+	 * @return a vector with the verification result for each proof
+	 */
+	std::vector<bool> verify_batch(const std::vector<silvia_proof>& proofs, silvia_thread_pool* pool = NULL);
+	
 	/**
 	 * Reset the verifier
 	 */
 	void reset();
 
 private:
+	// Job for batch verification
+	class verify_batch_job;
+
+	// Verify a proof against the specified nonce
+	bool verify_proof
+	(
+		const std::vector<bool>& D,
+		const mpz_class& context,
+		const mpz_class& n1,
+		const mpz_class& c,
+		const mpz_class& A_prime,
+		const mpz_class& e_hat,
+		const mpz_class& v_prime_hat,
+		const std::vector<mpz_class>& a_i_hat,
+		const std::vector<silvia_attribute*>& a_i
+	);
+
 	// State
 	silvia_pub_key* pubkey;
 	mpz_class n1;
@@ -99,6 +146,9 @@ private:
 		VERIFIER_NONCE
 	}
 	verifier_state;
+
+	// The runtime context
+	silvia_runtime runtime;
 };
 
 #endif // !_SILVIA_VERIFIER_H
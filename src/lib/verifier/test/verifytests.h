@@ -42,10 +42,12 @@ class verify_tests : public CppUnit::TestFixture
 {
 	CPPUNIT_TEST_SUITE(verify_tests);
 	CPPUNIT_TEST(test_verify_irma_testvec);
+	CPPUNIT_TEST(test_verify_batch_irma_testvec);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void test_verify_irma_testvec();
+	void test_verify_batch_irma_testvec();
 
 	void setUp();
 	void tearDown();
@@ -38,42 +38,51 @@
 #include "silvia_types.h"
 #include "silvia_idemix_xmlreader.h"
 #include "silvia_macros.h"
+#include "silvia_xml_stream.h"
 #include <vector>
 #include <memory>
+#include <string>
+#include <stdlib.h>
+#include <strings.h>
 #include <assert.h>
-#include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
 
+// Upper bound on the number of bases in a public key; the IRMA
+// credentials use far fewer, this only guards against absurd values
+#define IDEMIX_MAX_BASES	1024
+
 // Initialise the one-and-only instance
 /*static*/ std::auto_ptr<silvia_idemix_xmlreader> silvia_idemix_xmlreader::_i(NULL);
 
+/*static*/ pthread_once_t silvia_idemix_xmlreader::_i_once = PTHREAD_ONCE_INIT;
+
+/*static*/ void silvia_idemix_xmlreader::init_i()
+{
+	xmlInitParser();
+
+	_i = std::auto_ptr<silvia_idemix_xmlreader>(new silvia_idemix_xmlreader());
+}
+
 /*static*/ silvia_idemix_xmlreader* silvia_idemix_xmlreader::i()
 {
-	if (_i.get() == NULL)
-	{
-		_i = std::auto_ptr<silvia_idemix_xmlreader>(new silvia_idemix_xmlreader());
-	}
+	pthread_once(&_i_once, init_i);
 
 	return _i.get();
 }
 
 silvia_pub_key* silvia_idemix_xmlreader::read_idemix_pubkey(const std::string file_name)
 {
-	// Read the XML file
-	xmlDocPtr xmldoc = xmlParseFile(file_name.c_str());
+	// Open the XML file
+	silvia_xml_stream xml;
 	
-	if (xmldoc == NULL)
+	if (!xml.open(file_name))
 	{
 		return NULL;
 	}
 	
 	// Check integrity
-	xmlNodePtr root_elem = xmlDocGetRootElement(xmldoc);
-	
-	if ((root_elem == NULL) || (xmlStrcasecmp(root_elem->name, (const xmlChar*) "IssuerPublicKey") != 0))
+	if (!xml.next_element() || !xml.is("IssuerPublicKey"))
 	{
-		xmlFreeDoc(xmldoc);
-		
 		return NULL;
 	}
 	
@@ -83,129 +92,123 @@ silvia_pub_key* silvia_idemix_xmlreader::read_idemix_pubkey(const std::string fi
 	mpz_class n;
 	size_t base_count = 0;
 	std::vector<mpz_class> R;
+	std::vector<bool> R_found;
 	
 	bool S_set = false;
 	bool Z_set = false;
 	bool n_set = false;
 	bool R_set = false;
+	bool elements_found = false;
 	
-	xmlNodePtr child_elem = root_elem->xmlChildrenNode;
-	
-	// Find the "Elements" tag
-	while ((child_elem != NULL) && (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Elements") != 0))
-	{
-		child_elem = child_elem->next;
-	}
+	std::string value;
 	
-	if (child_elem == NULL)
+	while (xml.next_element(0))
 	{
-		xmlFreeDoc(xmldoc);
+		// Only the first "Elements" tag is parsed
+		if ((xml.depth() != 1) || !xml.is("Elements") || elements_found)
+		{
+			continue;
+		}
 		
-		return NULL;
-	}
-	
-	// Now parse the elements
-	xmlNodePtr elements = child_elem->xmlChildrenNode;
-	
-	while(elements != NULL)
-	{
-		if (xmlStrcasecmp(elements->name, (const xmlChar*) "S") == 0)
+		elements_found = true;
+		
+		// Now parse the elements
+		while (xml.next_element(1))
 		{
-			// Retrieve the value for S; this is a string
-			xmlChar* S_value = xmlNodeListGetString(xmldoc, elements->xmlChildrenNode, 1);
+			if (xml.depth() != 2)
+			{
+				continue;
+			}
 			
-			if (S_value != NULL)
+			if (xml.is("S"))
 			{
-				S = mpz_class((const char*) S_value);
-				
-				xmlFree(S_value);
+				// Retrieve the value for S; this is a number
+				if (!xml.read_mpz(S))
+				{
+					return NULL;
+				}
 				
 				S_set = true;
 			}
-		}
-		else if (xmlStrcasecmp(elements->name, (const xmlChar*) "Z") == 0)
-		{
-			// Retrieve the value for Z; this is a string
-			xmlChar* Z_value = xmlNodeListGetString(xmldoc, elements->xmlChildrenNode, 1);
-			
-			if (Z_value != NULL)
+			else if (xml.is("Z"))
 			{
-				Z = mpz_class((const char*) Z_value);
-				
-				xmlFree(Z_value);
+				// Retrieve the value for Z; this is a number
+				if (!xml.read_mpz(Z))
+				{
+					return NULL;
+				}
 				
 				Z_set = true;
 			}
-		}
-		else if (xmlStrcasecmp(elements->name, (const xmlChar*) "n") == 0)
-		{
-			// Retrieve the value for n; this is a string
-			xmlChar* n_value = xmlNodeListGetString(xmldoc, elements->xmlChildrenNode, 1);
-			
-			if (n_value != NULL)
+			else if (xml.is("n"))
 			{
-				n = mpz_class((const char*) n_value);
-				
-				xmlFree(n_value);
+				// Retrieve the value for n; this is a number
+				if (!xml.read_mpz(n))
+				{
+					return NULL;
+				}
 				
 				n_set = true;
 			}
-		}
-		else if (xmlStrcasecmp(elements->name, (const xmlChar*) "Bases") == 0)
-		{
-			// Retrieve the number of bases
-			xmlChar* base_count_str = xmlGetProp(elements, (const xmlChar*) "num");
-			
-			if (base_count_str == NULL)
+			else if (xml.is("Bases"))
 			{
-				xmlFreeDoc(xmldoc);
+				// Retrieve the number of bases
+				if (!xml.get_attribute("num", value))
+				{
+					return NULL;
+				}
 				
-				return NULL;
-			}
-			
-			base_count = atoi((const char*) base_count_str);
-			
-			xmlNodePtr bases = elements->xmlChildrenNode;
-			
-			for (size_t i = 0; i < base_count; i++)
-			{
-				char base_name[256];
+				char* end = NULL;
+				
+				base_count = strtoul(value.c_str(), &end, 10);
+				
+				if (value.empty() || (value.find_first_not_of("0123456789") != std::string::npos) || (*end != '\0') || (base_count > IDEMIX_MAX_BASES))
+				{
+					return NULL;
+				}
 				
-				sprintf(base_name, "Base_%zd", i);
+				R.assign(base_count, 0);
+				R_found.assign(base_count, false);
 				
-				xmlNodePtr base = bases;
+				size_t found = 0;
 				
-				while (base != NULL)
+				// The bases are named Base_0 ... Base_<num-1>
+				while (xml.next_element(2))
 				{
-					if (xmlStrcasecmp(base->name, (const xmlChar*) base_name) == 0)
+					std::string base_name = xml.name();
+					
+					if ((xml.depth() != 3) || (base_name.size() <= 5) || (strncasecmp(base_name.c_str(), "Base_", 5) != 0))
 					{
-						xmlChar* R_value = xmlNodeListGetString(xmldoc, base->xmlChildrenNode, 1);
-						
-						if (R_value != NULL)
+						continue;
+					}
+					
+					std::string index_str = base_name.substr(5);
+					
+					if (index_str.find_first_not_of("0123456789") != std::string::npos)
+					{
+						continue;
+					}
+					
+					size_t index = strtoul(index_str.c_str(), NULL, 10);
+					
+					if ((index < base_count) && !R_found[index])
+					{
+						if (!xml.read_mpz(R[index]))
 						{
-							mpz_class R_i = mpz_class((const char*) R_value);
-							
-							xmlFree(R_value);
-							
-							R.push_back(R_i);
+							return NULL;
 						}
 						
-						break;
+						R_found[index] = true;
+						found++;
 					}
-					
-					base = base->next;
 				}
+				
+				R_set = (found == base_count);
 			}
-			
-			R_set = R.size() == base_count;
 		}
-		
-		elements = elements->next;
 	}
 	
-	xmlFreeDoc(xmldoc);
-	
-	if (!S_set || !Z_set || !n_set || !R_set)
+	if (!xml.finish() || !S_set || !Z_set || !n_set || !R_set)
 	{
 		return NULL;
 	}
@@ -215,21 +218,17 @@ silvia_pub_key* silvia_idemix_xmlreader::read_idemix_pubkey(const std::string fi
 
 silvia_priv_key* silvia_idemix_xmlreader::read_idemix_privkey(const std::string file_name)
 {
-	// Read the XML file
-	xmlDocPtr xmldoc = xmlParseFile(file_name.c_str());
+	// Open the XML file
+	silvia_xml_stream xml;
 	
-	if (xmldoc == NULL)
+	if (!xml.open(file_name))
 	{
 		return NULL;
 	}
 	
 	// Check integrity
-	xmlNodePtr root_elem = xmlDocGetRootElement(xmldoc);
-	
-	if ((root_elem == NULL) || (xmlStrcasecmp(root_elem->name, (const xmlChar*) "IssuerPrivateKey") != 0))
+	if (!xml.next_element() || !xml.is("IssuerPrivateKey"))
 	{
-		xmlFreeDoc(xmldoc);
-		
 		return NULL;
 	}
 	
@@ -239,62 +238,52 @@ silvia_priv_key* silvia_idemix_xmlreader::read_idemix_privkey(const std::string
 	
 	bool p_set = false;
 	bool q_set = false;
+	bool elements_found = false;
 	
-	xmlNodePtr child_elem = root_elem->xmlChildrenNode;
-	
-	// Find the "Elements" tag
-	while ((child_elem != NULL) && (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Elements") != 0))
-	{
-		child_elem = child_elem->next;
-	}
+	std::string value;
 	
-	if (child_elem == NULL)
+	while (xml.next_element(0))
 	{
-		xmlFreeDoc(xmldoc);
+		// Only the first "Elements" tag is parsed
+		if ((xml.depth() != 1) || !xml.is("Elements") || elements_found)
+		{
+			continue;
+		}
 		
-		return NULL;
-	}
-	
-	// Now parse the elements
-	xmlNodePtr elements = child_elem->xmlChildrenNode;
-	
-	while(elements != NULL)
-	{
-		if (xmlStrcasecmp(elements->name, (const xmlChar*) "p") == 0)
+		elements_found = true;
+		
+		// Now parse the elements
+		while (xml.next_element(1))
 		{
-			// Retrieve the value for p; this is a string
-			xmlChar* p_value = xmlNodeListGetString(xmldoc, elements->xmlChildrenNode, 1);
+			if (xml.depth() != 2)
+			{
+				continue;
+			}
 			
-			if (p_value != NULL)
+			if (xml.is("p"))
 			{
-				p = mpz_class((const char*) p_value);
-				
-				xmlFree(p_value);
+				// Retrieve the value for p; this is a number
+				if (!xml.read_mpz(p))
+				{
+					return NULL;
+				}
 				
 				p_set = true;
 			}
-		}
-		else if (xmlStrcasecmp(elements->name, (const xmlChar*) "q") == 0)
-		{
-			// Retrieve the value for q; this is a string
-			xmlChar* q_value = xmlNodeListGetString(xmldoc, elements->xmlChildrenNode, 1);
-			
-			if (q_value != NULL)
+			else if (xml.is("q"))
 			{
-				q = mpz_class((const char*) q_value);
-				
-				xmlFree(q_value);
+				// Retrieve the value for q; this is a number
+				if (!xml.read_mpz(q))
+				{
+					return NULL;
+				}
 				
 				q_set = true;
 			}
 		}
-		
-		elements = elements->next;
 	}
 	
-	xmlFreeDoc(xmldoc);
-	
-	if (!p_set || !q_set)
+	if (!xml.finish() || !p_set || !q_set)
 	{
 		return NULL;
 	}
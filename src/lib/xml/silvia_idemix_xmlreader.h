@@ -40,6 +40,7 @@
 #include "silvia_types.h"
 #include <vector>
 #include <memory>
+#include <pthread.h>
 
 /**
  * Idemix XML reader class
@@ -70,6 +71,10 @@ public:
 private:
 	// The one-and-only instance
 	static std::auto_ptr<silvia_idemix_xmlreader> _i;
+	static pthread_once_t _i_once;
+
+	// Create the one-and-only instance
+	static void init_i();
 };
 
 #endif // !_SILVIA_IDEMIX_XMLREADER_H
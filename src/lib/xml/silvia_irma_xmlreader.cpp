@@ -39,10 +39,13 @@
 #include "silvia_irma_xmlreader.h"
 #include "silvia_macros.h"
 #include "silvia_bytestring.h"
+#include "silvia_xml_stream.h"
 #include <vector>
 #include <memory>
+#include <string>
+#include <stdlib.h>
+#include <strings.h>
 #include <assert.h>
-#include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
 #include <time.h>
 #include <iostream>
@@ -50,12 +53,18 @@
 // Initialise the one-and-only instance
 /*static*/ std::auto_ptr<silvia_irma_xmlreader> silvia_irma_xmlreader::_i(NULL);
 
+/*static*/ pthread_once_t silvia_irma_xmlreader::_i_once = PTHREAD_ONCE_INIT;
+
+/*static*/ void silvia_irma_xmlreader::init_i()
+{
+	xmlInitParser();
+
+	_i = std::auto_ptr<silvia_irma_xmlreader>(new silvia_irma_xmlreader());
+}
+
 /*static*/ silvia_irma_xmlreader* silvia_irma_xmlreader::i()
 {
-	if (_i.get() == NULL)
-	{
-		_i = std::auto_ptr<silvia_irma_xmlreader>(new silvia_irma_xmlreader());
-	}
+	pthread_once(&_i_once, init_i);
 
 	return _i.get();
 }
@@ -65,80 +74,73 @@ silvia_verifier_specification* silvia_irma_xmlreader::read_verifier_spec(const s
 	////////////////////////////////////////////////////////////////////
 	// Read the issuer description XML file
 	////////////////////////////////////////////////////////////////////
-	xmlDocPtr xmldoc = xmlParseFile(id_file_name.c_str());
+	silvia_xml_stream xml;
 	
-	if (xmldoc == NULL)
+	if (!xml.open(id_file_name))
 	{
-		// error printed to stdout by libxml2
+		// error printed to stderr by libxml2
 		return NULL;
 	}
 	
 	// Check integrity
-	xmlNodePtr root_elem = xmlDocGetRootElement(xmldoc);
-	
-	if ((root_elem == NULL) || (xmlStrcasecmp(root_elem->name, (const xmlChar*) "IssueSpecification") != 0))
+	if (!xml.next_element() || !xml.is("IssueSpecification"))
 	{
-		xmlFreeDoc(xmldoc);
 		std::cerr << id_file_name << ": root element IssueSpecification not found" << std::endl;
 		return NULL;
 	}
 	
 	// Parse the data
 	unsigned short credential_id = 0;
+	bool credential_id_set = false;
 	
-	xmlNodePtr child_elem = root_elem->xmlChildrenNode;
+	std::string value;
 	
 	// Find the "Id" tag; this is the only tag we need from the issuer specification
-	while ((child_elem != NULL) && (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Id") != 0))
+	while (xml.next_element(0))
 	{
-		child_elem = child_elem->next;
+		if ((xml.depth() == 1) && xml.is("Id"))
+		{
+			if (!xml.read_text(value))
+			{
+				std::cerr << id_file_name << ": Id element in IssueSpecification has no value" << std::endl;
+				
+				return NULL;
+			}
+			
+			credential_id = atoi(value.c_str());
+			credential_id_set = true;
+			
+			break;
+		}
 	}
 	
-	if (child_elem == NULL)
+	if (!xml.finish())
 	{
-		std::cerr << id_file_name << ": missing Id element in IssueSpecification" << std::endl;
-		xmlFreeDoc(xmldoc);
-		
 		return NULL;
 	}
 	
-	xmlChar* id_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-	
-	if (id_value == NULL)
+	if (!credential_id_set)
 	{
-		std::cerr << id_file_name << ": Id element in IssueSpecification has no value" << std::endl;
-		xmlFreeDoc(xmldoc);
+		std::cerr << id_file_name << ": missing Id element in IssueSpecification" << std::endl;
 		
 		return NULL;
 	}
 	
-	credential_id = atoi((const char*) id_value);
-	
-	xmlFree(id_value);
-	
-	xmlFreeDoc(xmldoc);
-	
 	////////////////////////////////////////////////////////////////////
 	// Read the verifier description XML file
 	////////////////////////////////////////////////////////////////////
 	
-	xmldoc = xmlParseFile(vd_file_name.c_str());
-	
-	if (xmldoc == NULL)
+	if (!xml.open(vd_file_name))
 	{
-		// error printed to stdout by libxml2
+		// error printed to stderr by libxml2
 		return NULL;
 	}
 	
 	// Check integrity
-	root_elem = xmlDocGetRootElement(xmldoc);
-	
-	if ((root_elem == NULL) || (xmlStrcasecmp(root_elem->name, (const xmlChar*) "VerifySpecification") != 0))
+	if (!xml.next_element() || !xml.is("VerifySpecification"))
 	{
 		std::cerr << vd_file_name << ": root element VerifySpecification not found" << std::endl;
 		
-		xmlFreeDoc(xmldoc);
-		
 		return NULL;
 	}
 	
@@ -160,20 +162,18 @@ silvia_verifier_specification* silvia_irma_xmlreader::read_verifier_spec(const s
 	D.push_back(true);
 	attribute_names.push_back("expires");
 	
-	child_elem = root_elem->xmlChildrenNode;
-	
-	while (child_elem != NULL)
+	while (xml.next_element(0))
 	{
-		if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Name") == 0)
+		if (xml.depth() != 1)
 		{
-			xmlChar* name_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (name_value != NULL)
+			continue;
+		}
+		
+		if (xml.is("Name"))
+		{
+			if (xml.read_text(value))
 			{
-				short_msg = std::string((const char*) name_value);
-				
-				xmlFree(name_value);
-				
+				short_msg = value;
 				short_msg_set = true;
 			}
 			else
@@ -181,16 +181,11 @@ silvia_verifier_specification* silvia_irma_xmlreader::read_verifier_spec(const s
 				std::cerr << vd_file_name << ": Name element in VerifySpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "VerifierID") == 0)
+		else if (xml.is("VerifierID"))
 		{
-			xmlChar* verifier_id_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (verifier_id_value != NULL)
+			if (xml.read_text(value))
 			{
-				verifier_name = std::string((const char*) verifier_id_value);
-				
-				xmlFree(verifier_id_value);
-				
+				verifier_name = value;
 				verifier_name_set = true;
 			}
 			else
@@ -198,16 +193,11 @@ silvia_verifier_specification* silvia_irma_xmlreader::read_verifier_spec(const s
 				std::cerr << vd_file_name << ": Verifier element in VerifySpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Id") == 0)
+		else if (xml.is("Id"))
 		{
-			xmlChar* id_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (id_value != NULL)
+			if (xml.read_text(value))
 			{
-				verifier_id = atoi((const char*) id_value);
-				
-				xmlFree(id_value);
-				
+				verifier_id = atoi(value.c_str());
 				verifier_id_set = true;
 			}
 			else
@@ -215,71 +205,58 @@ silvia_verifier_specification* silvia_irma_xmlreader::read_verifier_spec(const s
 				std::cerr << vd_file_name << ": Id element in VerifySpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "AttributeModes") == 0)
+		else if (xml.is("AttributeModes"))
 		{
-			xmlNodePtr attribute_mode = child_elem->xmlChildrenNode;
-			
-			while (attribute_mode != NULL)
+			while (xml.next_element(1))
 			{
-				if (xmlStrcasecmp(attribute_mode->name, (const xmlChar*) "AttributeMode") == 0)
+				if ((xml.depth() != 2) || !xml.is("AttributeMode"))
 				{
-					xmlChar* attr_id_value = xmlGetProp(attribute_mode, (const xmlChar*) "id");
-					
-					if (attr_id_value == NULL)
-					{
-						std::cerr << vd_file_name << ": id property in AttributeMode element not set" << std::endl;
-						
-						xmlFreeDoc(xmldoc);
-						
-						return NULL;
-					}
-					
-					attribute_names.push_back(std::string((const char*) attr_id_value));
-					
-					xmlFree(attr_id_value);
-					
-					xmlChar* mode_value = xmlGetProp(attribute_mode, (const xmlChar*) "mode");
+					continue;
+				}
+				
+				if (!xml.get_attribute("id", value))
+				{
+					std::cerr << vd_file_name << ": id property in AttributeMode element not set" << std::endl;
 					
-					if (mode_value == NULL)
-					{
-						// Missing mandatory attribute
-						std::cerr << vd_file_name << ": mode property in AttributeMode element not set" << std::endl;
-						
-						xmlFreeDoc(xmldoc);
-						
-						return NULL;
-					}
+					return NULL;
+				}
+				
+				attribute_names.push_back(value);
+				
+				if (!xml.get_attribute("mode", value))
+				{
+					// Missing mandatory attribute
+					std::cerr << vd_file_name << ": mode property in AttributeMode element not set" << std::endl;
 					
-					if (xmlStrcasecmp(mode_value, (const xmlChar*) "revealed") == 0)
-					{
-						D.push_back(true);
-					}
-					else if (xmlStrcasecmp(mode_value, (const xmlChar*) "unrevealed") == 0)
-					{
-						D.push_back(false);
-					}
-					else
-					{
-						// Unknown value for mode
-						std::cerr << vd_file_name << ": unknown mode " << mode_value << " in AttributeMode element not set" << std::endl;
-						
-						xmlFreeDoc(xmldoc);
-						
-						return NULL;
-					}
+					return NULL;
 				}
 				
-				attribute_mode = attribute_mode->next;
+				if (strcasecmp(value.c_str(), "revealed") == 0)
+				{
+					D.push_back(true);
+				}
+				else if (strcasecmp(value.c_str(), "unrevealed") == 0)
+				{
+					D.push_back(false);
+				}
+				else
+				{
+					// Unknown value for mode
+					std::cerr << vd_file_name << ": unknown mode " << value << " in AttributeMode element not set" << std::endl;
+					
+					return NULL;
+				}
 			}
 			
 			attribute_names_set = true;
 			D_set = true;
 		}
-		
-		child_elem = child_elem->next;
 	}
 	
-	xmlFreeDoc(xmldoc);
+	if (!xml.finish())
+	{
+		return NULL;
+	}
 	
 	if (!verifier_name_set || !short_msg_set || !verifier_id_set || !attribute_names_set || !D_set)
 	{
@@ -305,19 +282,72 @@ silvia_verifier_specification* silvia_irma_xmlreader::read_verifier_spec(const s
 	return new silvia_verifier_specification(verifier_name, short_msg, verifier_id, credential_id, attribute_names, D);
 }
 
+bool silvia_irma_xmlreader::read_verifier_reference(const std::string vd_file_name, std::string& issuer_id, std::string& credential_id)
+{
+	silvia_xml_stream xml;
+	
+	if (!xml.open(vd_file_name))
+	{
+		// error printed to stderr by libxml2
+		return false;
+	}
+	
+	// Check integrity
+	if (!xml.next_element() || !xml.is("VerifySpecification"))
+	{
+		std::cerr << vd_file_name << ": root element VerifySpecification not found" << std::endl;
+		
+		return false;
+	}
+	
+	bool issuer_id_set = false;
+	bool credential_id_set = false;
+	
+	while (xml.next_element(0))
+	{
+		if (xml.depth() != 1)
+		{
+			continue;
+		}
+		
+		if (xml.is("IssuerID"))
+		{
+			issuer_id_set = xml.read_text(issuer_id);
+		}
+		else if (xml.is("CredentialID"))
+		{
+			credential_id_set = xml.read_text(credential_id);
+		}
+	}
+	
+	if (!xml.finish())
+	{
+		return false;
+	}
+	
+	if (!issuer_id_set)
+	{
+		std::cerr << vd_file_name << ": missing IssuerID element in VerifySpecification" << std::endl;
+	}
+	
+	if (!credential_id_set)
+	{
+		std::cerr << vd_file_name << ": missing CredentialID element in VerifySpecification" << std::endl;
+	}
+	
+	return issuer_id_set && credential_id_set;
+}
+
 silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::string issue_spec_file_name)
 {
 	////////////////////////////////////////////////////////////////////
 	// Read the issue specification XML file
 	////////////////////////////////////////////////////////////////////
-	xmlDocPtr xmldoc = xmlParseFile(issue_spec_file_name.c_str());
+	silvia_xml_stream xml;
 	
 	// Check integrity
-	xmlNodePtr root_elem = xmlDocGetRootElement(xmldoc);
-	
-	if ((root_elem == NULL) || (xmlStrcasecmp(root_elem->name, (const xmlChar*) "CredentialIssueSpecification") != 0))
+	if (!xml.open(issue_spec_file_name) || !xml.next_element() || !xml.is("CredentialIssueSpecification"))
 	{
-		xmlFreeDoc(xmldoc);
 		std::cerr << issue_spec_file_name << ": root element CredentialIssueSpecification not found" << std::endl;
 		return NULL;
 	}
@@ -333,20 +363,21 @@ silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::st
 	bool expires_set = false;
 	std::vector<silvia_attribute*> attribute_values;
 	
-	xmlNodePtr child_elem = root_elem->xmlChildrenNode;
+	std::string value;
+	bool malformed = false;
 	
-	while (child_elem != NULL)
+	while (!malformed && xml.next_element(0))
 	{
-		if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Name") == 0)
+		if (xml.depth() != 1)
 		{
-			xmlChar* name_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (name_value != NULL)
+			continue;
+		}
+		
+		if (xml.is("Name"))
+		{
+			if (xml.read_text(value))
 			{
-				name = std::string((const char*) name_value);
-				
-				xmlFree(name_value);
-				
+				name = value;
 				name_set = true;
 			}
 			else
@@ -354,16 +385,11 @@ silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::st
 				std::cerr << issue_spec_file_name << ": element Name in CredentialIssueSpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "IssuerID") == 0)
+		else if (xml.is("IssuerID"))
 		{
-			xmlChar* issuer_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (issuer_value != NULL)
+			if (xml.read_text(value))
 			{
-				issuer = std::string((const char*) issuer_value);
-				
-				xmlFree(issuer_value);
-				
+				issuer = value;
 				issuer_set = true;
 			}
 			else
@@ -371,16 +397,11 @@ silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::st
 				std::cerr << issue_spec_file_name << ": element IssuerID in CredentialIssueSpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Id") == 0)
+		else if (xml.is("Id"))
 		{
-			xmlChar* id_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (id_value != NULL)
+			if (xml.read_text(value))
 			{
-				id = (unsigned short) atoi((const char*) id_value);
-				
-				xmlFree(id_value);
-				
+				id = (unsigned short) atoi(value.c_str());
 				id_set = true;
 			}
 			else
@@ -388,15 +409,11 @@ silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::st
 				std::cerr << issue_spec_file_name << ": element Id in CredentialIssueSpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Expires") == 0)
+		else if (xml.is("Expires"))
 		{
-			xmlChar* expires_value = xmlNodeListGetString(xmldoc, child_elem->xmlChildrenNode, 1);
-			
-			if (expires_value != NULL)
+			if (xml.read_text(value))
 			{
-				expires = (unsigned short) atoi((const char*) expires_value);
-				
-				xmlFree(expires_value);
+				expires = (unsigned short) atoi(value.c_str());
 
 				/* Compute actual expiry date */
 				time_t now = time(NULL);
@@ -411,111 +428,109 @@ silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::st
 				std::cerr << issue_spec_file_name << ": element Expires in CredentialIssueSpecification has no value" << std::endl;
 			}
 		}
-		else if (xmlStrcasecmp(child_elem->name, (const xmlChar*) "Attributes") == 0)
+		else if (xml.is("Attributes"))
 		{
-			xmlNodePtr attribute = child_elem->xmlChildrenNode;
-			
-			while (attribute != NULL)
+			while (!malformed && xml.next_element(1))
 			{
-				if (xmlStrcasecmp(attribute->name, (const xmlChar*) "Attribute") == 0)
+				if ((xml.depth() != 2) || !xml.is("Attribute"))
 				{
-					// Get attribute type
-					silvia_attr_t silvia_attr_type = SILVIA_UNDEFINED_ATTR;
+					continue;
+				}
+				
+				// Get attribute type
+				silvia_attr_t silvia_attr_type = SILVIA_UNDEFINED_ATTR;
+				
+				std::string attr_type;
+				
+				if (!xml.get_attribute("type", attr_type))
+				{
+					// Malformed specification!
+					std::cerr << issue_spec_file_name << ": type property of Attribute element not set" << std::endl;
 					
-					xmlChar* attr_type = xmlGetProp(attribute, (const xmlChar*) "type");
+					malformed = true;
 					
-					if (attr_type == NULL)
-					{
-						// Malformed specification!
-						std::cerr << issue_spec_file_name << ": type property of Attribute element not set" << std::endl;
-						
-						xmlFreeDoc(xmldoc);
-						
-						return NULL;
-					}
-					
-					if (xmlStrcasecmp(attr_type, (const xmlChar*) "int") == 0)
-					{
-						silvia_attr_type = SILVIA_INT_ATTR;
-					}
-					else if (xmlStrcasecmp(attr_type, (const xmlChar*) "string") == 0)
+					break;
+				}
+				
+				if (strcasecmp(attr_type.c_str(), "int") == 0)
+				{
+					silvia_attr_type = SILVIA_INT_ATTR;
+				}
+				else if (strcasecmp(attr_type.c_str(), "string") == 0)
+				{
+					silvia_attr_type = SILVIA_STRING_ATTR;
+				}
+				
+				// Now read the value; name is not actually used, it's just there for
+				// human convenience
+				std::string attr_value;
+				
+				while (xml.next_element(2))
+				{
+					if ((xml.depth() == 3) && xml.is("Value"))
 					{
-						silvia_attr_type = SILVIA_STRING_ATTR;
+						xml.read_text(attr_value);
 					}
+				}
+				
+				if (attr_value.empty())
+				{
+					std::cerr << issue_spec_file_name << ": Value element in Attribute not found" << std::endl;
 					
-					// Now read the value; name is not actually used, it's just there for
-					// human convenience
-					std::string value;
-					
-					xmlNodePtr attribute_data = attribute->xmlChildrenNode;
+					// Malformed specification
+					malformed = true;
 					
-					while (attribute_data != NULL)
+					break;
+				}
+				
+				switch(silvia_attr_type)
+				{
+				case SILVIA_INT_ATTR:
 					{
-						if (xmlStrcasecmp(attribute_data->name, (const xmlChar*) "Value") == 0)
+						mpz_class int_value;
+						
+						if (mpz_set_str(_Z(int_value), attr_value.c_str(), 0) != 0)
 						{
-							xmlChar* attribute_value = xmlNodeListGetString(xmldoc, attribute_data->xmlChildrenNode, 1);
+							std::cerr << issue_spec_file_name << ": Value of integer Attribute is not a number" << std::endl;
 							
-							if (attribute_value != NULL)
-							{
-								value = std::string((const char*) attribute_value);
-								
-								xmlFree(attribute_value);
-							}
+							// Malformed specification
+							malformed = true;
+							
+							break;
 						}
 						
-						attribute_data = attribute_data->next;
+						silvia_integer_attribute* new_attr = new silvia_integer_attribute(int_value);
+						attribute_values.push_back(new_attr);
 					}
-					
-					if (value.empty())
+					break;
+				case SILVIA_STRING_ATTR:
 					{
-						std::cerr << issue_spec_file_name << ": Value element in Attribute not found" << std::endl;
-						
-						// Malformed specification
-						xmlFreeDoc(xmldoc);
-						xmlFree(attr_type);
-						
-						return NULL;
+						// FIXME: there is no check to see if the integer representation overflows the system parameter value l_m
+						silvia_string_attribute* new_attr = new silvia_string_attribute(attr_value.c_str());
+						attribute_values.push_back(new_attr);
 					}
+					break;
+				default:
+					// Malformed specification
+					std::cerr << issue_spec_file_name << ": unknown Attribute type " << attr_type << std::endl;
 					
-					switch(silvia_attr_type)
-					{
-					case SILVIA_INT_ATTR:
-						{
-							silvia_integer_attribute* new_attr = new silvia_integer_attribute(mpz_class(value.c_str()));
-							attribute_values.push_back(new_attr);
-						}
-						break;
-					case SILVIA_STRING_ATTR:
-						{
-							// FIXME: there is no check to see if the integer representation overflows the system parameter value l_m
-							/*bytestring int_val((const unsigned char*) value.c_str(), value.size());
-						
-							silvia_integer_attribute* new_attr = new silvia_integer_attribute(int_val.mpz_val());
-							attribute_values.push_back(new_attr);*/
-							silvia_string_attribute* new_attr = new silvia_string_attribute(value.c_str());
-							attribute_values.push_back(new_attr);
-						}
-						break;
-					default:
-						// Malformed specification
-						std::cerr << issue_spec_file_name << ": unknown Attribute type " << attr_type << std::endl;
-						
-						xmlFreeDoc(xmldoc);
-						xmlFree(attr_type);
-						
-						return NULL;
-					}
-					xmlFree(attr_type);
+					malformed = true;
+					
+					break;
 				}
-				
-				attribute = attribute->next;
 			}
 		}
-		
-		child_elem = child_elem->next;
 	}
 	
-	xmlFreeDoc(xmldoc);
+	if (malformed || !xml.finish())
+	{
+		for (std::vector<silvia_attribute*>::iterator i = attribute_values.begin(); i != attribute_values.end(); i++)
+		{
+			delete *i;
+		}
+		
+		return NULL;
+	}
 	
 	if (!name_set || !issuer_set || !id_set || !expires_set || attribute_values.empty())
 	{
@@ -539,11 +554,15 @@ silvia_issue_specification* silvia_irma_xmlreader::read_issue_spec(const std::st
 		{
 			std::cerr << issue_spec_file_name << ": missing Attribute element(s) in CredentialIssueSpecification" << std::endl;
 		}
+		
+		for (std::vector<silvia_attribute*>::iterator i = attribute_values.begin(); i != attribute_values.end(); i++)
+		{
+			delete *i;
+		}
+		
 		return NULL;
 	}
-     
 
 	// Construct credential issue specification
 	return new silvia_issue_specification(name, issuer, id, expires, attribute_values);
 }
-
@@ -42,6 +42,7 @@
 #include "silvia_issue_spec.h"
 #include <vector>
 #include <memory>
+#include <pthread.h>
 
 /**
  * IRMA XML reader class
@@ -64,6 +65,15 @@ public:
 	 */
 	silvia_verifier_specification* read_verifier_spec(const std::string id_file_name, const std::string vd_file_name);
 
+	/**
+	 * Reads which credential of which issuer a verifier description refers to
+	 * @param vd_file_name File name of the verifier description file
+	 * @param issuer_id Receives the issuer ID
+	 * @param credential_id Receives the credential ID
+	 * @return true if both IDs were read, false if reading/parsing of the file failed
+	 */
+	bool read_verifier_reference(const std::string vd_file_name, std::string& issuer_id, std::string& credential_id);
+
 	/**
 	 * Reads a credential issue specification from file
 	 * @param issue_spec_file_name File name of the credential issue specification
@@ -74,6 +84,10 @@ public:
 private:
 	// The one-and-only instance
 	static std::auto_ptr<silvia_irma_xmlreader> _i;
+	static pthread_once_t _i_once;
+
+	// Create the one-and-only instance
+	static void init_i();
 };
 
 #endif // !_SILVIA_IRMA_XMLREADER_H
@@ -0,0 +1,582 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_scheme_registry.cpp
+
+ Registry of the issuer keys and verifier specifications in a scheme
+ directory, with reloading when the directory changes
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_scheme_registry.h"
+#include "silvia_idemix_xmlreader.h"
+#include "silvia_irma_xmlreader.h"
+#include "silvia_thread_pool.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif // HAVE_SYS_INOTIFY_H
+
+// Time to wait for a burst of changes to settle before reloading
+#define SCHEME_SETTLE_MS	100
+
+// List the subdirectories of a directory
+static std::vector<std::string> subdirectories(const std::string& dir)
+{
+	std::vector<std::string> rv;
+
+	DIR* d = opendir(dir.c_str());
+
+	if (d == NULL) return rv;
+
+	struct dirent* entry;
+
+	while ((entry = readdir(d)) != NULL)
+	{
+		if (entry->d_name[0] == '.') continue;
+
+		std::string path = dir + "/" + entry->d_name;
+		struct stat st;
+
+		if ((stat(path.c_str(), &st) == 0) && S_ISDIR(st.st_mode))
+		{
+			rv.push_back(entry->d_name);
+		}
+	}
+
+	closedir(d);
+
+	return rv;
+}
+
+static bool file_exists(const std::string& path)
+{
+	struct stat st;
+
+	return (stat(path.c_str(), &st) == 0) && S_ISREG(st.st_mode);
+}
+
+////////////////////////////////////////////////////////////////////////
+// silvia_scheme_snapshot implementation
+////////////////////////////////////////////////////////////////////////
+
+silvia_scheme_snapshot::silvia_scheme_snapshot()
+{
+	generation = 0;
+	refs = 1;
+}
+
+silvia_scheme_snapshot::~silvia_scheme_snapshot()
+{
+	for (std::map<std::string, silvia_pub_key*>::iterator i = pubkeys.begin(); i != pubkeys.end(); i++)
+	{
+		delete i->second;
+	}
+
+	for (std::map<spec_key, std::vector<silvia_verifier_specification*> >::iterator i = vspecs.begin(); i != vspecs.end(); i++)
+	{
+		for (std::vector<silvia_verifier_specification*>::iterator j = i->second.begin(); j != i->second.end(); j++)
+		{
+			delete *j;
+		}
+	}
+}
+
+void silvia_scheme_snapshot::add_ref()
+{
+	__sync_fetch_and_add(&refs, 1);
+}
+
+void silvia_scheme_snapshot::release()
+{
+	if (__sync_sub_and_fetch(&refs, 1) == 0)
+	{
+		delete this;
+	}
+}
+
+silvia_pub_key* silvia_scheme_snapshot::get_pubkey(const std::string& issuer)
+{
+	std::map<std::string, silvia_pub_key*>::iterator i = pubkeys.find(issuer);
+
+	return (i == pubkeys.end()) ? NULL : i->second;
+}
+
+const std::vector<silvia_verifier_specification*>& silvia_scheme_snapshot::get_verifier_specs(const std::string& issuer, unsigned short credential_id)
+{
+	std::map<spec_key, std::vector<silvia_verifier_specification*> >::iterator i = vspecs.find(spec_key(issuer, credential_id));
+
+	return (i == vspecs.end()) ? no_vspecs : i->second;
+}
+
+std::vector<std::string> silvia_scheme_snapshot::get_issuers()
+{
+	std::vector<std::string> rv;
+
+	for (std::map<std::string, silvia_pub_key*>::iterator i = pubkeys.begin(); i != pubkeys.end(); i++)
+	{
+		rv.push_back(i->first);
+	}
+
+	return rv;
+}
+
+unsigned long silvia_scheme_snapshot::get_generation()
+{
+	return generation;
+}
+
+////////////////////////////////////////////////////////////////////////
+// silvia_scheme_registry implementation
+////////////////////////////////////////////////////////////////////////
+
+silvia_scheme_registry::silvia_scheme_registry(const std::string scheme_dir, const silvia_runtime* runtime /* = NULL */)
+{
+	this->scheme_dir = scheme_dir;
+
+	if (runtime != NULL)
+	{
+		this->runtime = *runtime;
+	}
+
+	current = new silvia_scheme_snapshot();
+	epoch = 0;
+	pins[0] = pins[1] = 0;
+	generation = 0;
+
+	watching = false;
+	notify_fd = -1;
+	stop_pipe[0] = stop_pipe[1] = -1;
+
+	pthread_mutex_init(&reload_lock, NULL);
+}
+
+silvia_scheme_registry::~silvia_scheme_registry()
+{
+	stop_watching();
+
+	current->release();
+
+	pthread_mutex_destroy(&reload_lock);
+}
+
+silvia_scheme_snapshot* silvia_scheme_registry::acquire()
+{
+	// The pin keeps the snapshot from being released between
+	// reading the pointer and taking the reference; it only counts
+	// if the epoch did not move on while it was being taken
+	unsigned long pin_epoch;
+
+	for (;;)
+	{
+		pin_epoch = epoch;
+
+		__sync_fetch_and_add(&pins[pin_epoch & 1], 1);
+
+		if (__sync_fetch_and_add(&epoch, 0) == pin_epoch) break;
+
+		__sync_fetch_and_sub(&pins[pin_epoch & 1], 1);
+	}
+
+	silvia_scheme_snapshot* snapshot = current;
+
+	snapshot->add_ref();
+
+	__sync_fetch_and_sub(&pins[pin_epoch & 1], 1);
+
+	return snapshot;
+}
+
+void silvia_scheme_registry::publish(silvia_scheme_snapshot* snapshot)
+{
+	silvia_scheme_snapshot* old = current;
+	unsigned long old_epoch = epoch;
+
+	snapshot->generation = ++generation;
+
+	__sync_synchronize();
+	current = snapshot;
+	__sync_fetch_and_add(&epoch, 1);
+
+	// Only readers pinned to the previous epoch can still have the old
+	// pointer; readers that arrive now pin the new epoch, so this wait
+	// ends as soon as the few instructions of those readers are done
+	while (__sync_fetch_and_add(&pins[old_epoch & 1], 0) != 0)
+	{
+		sched_yield();
+	}
+
+	old->release();
+}
+
+void silvia_scheme_registry::watch(const std::string& dir)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if (notify_fd < 0) return;
+
+	// Adding a watch for a directory that is already watched is harmless;
+	// watches for directories that are removed disappear by themselves
+	inotify_add_watch(notify_fd, dir.c_str(), IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+#endif // HAVE_SYS_INOTIFY_H
+}
+
+/**
+ * Job that reads an issuer public key and builds its tables
+ */
+class silvia_scheme_registry::read_pubkey_job : public silvia_job
+{
+public:
+	read_pubkey_job(const std::string& issuer, const std::string& ipk_file, const silvia_runtime* runtime)
+	{
+		this->issuer = issuer;
+		this->ipk_file = ipk_file;
+		this->runtime = runtime;
+
+		pubkey = NULL;
+	}
+
+	virtual void run()
+	{
+		pubkey = silvia_idemix_xmlreader::i()->read_idemix_pubkey(ipk_file);
+
+		if (pubkey != NULL)
+		{
+			// Build the tables now for the parameters the sessions use;
+			// after publication, the key is only read
+			pubkey->precompute(runtime->get_params());
+		}
+	}
+
+	std::string issuer;
+	std::string ipk_file;
+	const silvia_runtime* runtime;
+	silvia_pub_key* pubkey;
+};
+
+/**
+ * Job that reads a verifier description and the issuer specification
+ * it refers to
+ */
+class silvia_scheme_registry::read_vspec_job : public silvia_job
+{
+public:
+	read_vspec_job(const std::string& scheme_dir, const std::string& vd_file)
+	{
+		this->scheme_dir = scheme_dir;
+		this->vd_file = vd_file;
+
+		vspec = NULL;
+		ok = false;
+	}
+
+	virtual void run()
+	{
+		std::string credential_id;
+
+		if (!silvia_irma_xmlreader::i()->read_verifier_reference(vd_file, issuer_id, credential_id))
+		{
+			return;
+		}
+
+		std::string id_file = scheme_dir + "/" + issuer_id + "/Issues/" + credential_id + "/description.xml";
+
+		if (!file_exists(id_file))
+		{
+			// Not an error; the scheme does not include this issuer
+			std::cerr << vd_file << ": no issuer specification for " << issuer_id << "/" << credential_id << std::endl;
+
+			ok = true;
+
+			return;
+		}
+
+		vspec = silvia_irma_xmlreader::i()->read_verifier_spec(id_file, vd_file);
+
+		ok = (vspec != NULL);
+	}
+
+	std::string scheme_dir;
+	std::string vd_file;
+	std::string issuer_id;
+	silvia_verifier_specification* vspec;
+	bool ok;
+};
+
+bool silvia_scheme_registry::scan(silvia_scheme_snapshot* snapshot)
+{
+	// Walk the directory tree first; this is cheap compared to reading
+	// the files, which is spread over a thread pool
+	std::vector<read_pubkey_job*> pubkey_jobs;
+	std::vector<read_vspec_job*> vspec_jobs;
+
+	watch(scheme_dir);
+
+	std::vector<std::string> entries = subdirectories(scheme_dir);
+
+	for (std::vector<std::string>::iterator i = entries.begin(); i != entries.end(); i++)
+	{
+		std::string entry_dir = scheme_dir + "/" + *i;
+
+		watch(entry_dir);
+
+		// The issuer public key
+		std::string ipk_file = entry_dir + "/ipk.xml";
+
+		if (file_exists(ipk_file))
+		{
+			pubkey_jobs.push_back(new read_pubkey_job(*i, ipk_file, &runtime));
+		}
+
+		// Watch the issuer specifications
+		std::string issues_dir = entry_dir + "/Issues";
+		watch(issues_dir);
+
+		std::vector<std::string> issues = subdirectories(issues_dir);
+
+		for (std::vector<std::string>::iterator j = issues.begin(); j != issues.end(); j++)
+		{
+			watch(issues_dir + "/" + *j);
+		}
+
+		// The verifier specifications
+		std::string verifies_dir = entry_dir + "/Verifies";
+		watch(verifies_dir);
+
+		std::vector<std::string> verifies = subdirectories(verifies_dir);
+
+		for (std::vector<std::string>::iterator j = verifies.begin(); j != verifies.end(); j++)
+		{
+			watch(verifies_dir + "/" + *j);
+
+			std::string vd_file = verifies_dir + "/" + *j + "/description.xml";
+
+			if (file_exists(vd_file))
+			{
+				vspec_jobs.push_back(new read_vspec_job(scheme_dir, vd_file));
+			}
+		}
+	}
+
+	// Read all files in parallel
+	if (!pubkey_jobs.empty() || !vspec_jobs.empty())
+	{
+		silvia_thread_pool pool;
+
+		for (std::vector<read_pubkey_job*>::iterator i = pubkey_jobs.begin(); i != pubkey_jobs.end(); i++)
+		{
+			pool.submit(*i);
+		}
+
+		for (std::vector<read_vspec_job*>::iterator i = vspec_jobs.begin(); i != vspec_jobs.end(); i++)
+		{
+			pool.submit(*i);
+		}
+
+		pool.wait();
+	}
+
+	// Hand the results to the snapshot; the snapshot deletes what it
+	// received, even if another file failed to load
+	bool rv = true;
+
+	for (std::vector<read_pubkey_job*>::iterator i = pubkey_jobs.begin(); i != pubkey_jobs.end(); i++)
+	{
+		if ((*i)->pubkey == NULL)
+		{
+			rv = false;
+		}
+		else
+		{
+			snapshot->pubkeys[(*i)->issuer] = (*i)->pubkey;
+		}
+
+		delete *i;
+	}
+
+	for (std::vector<read_vspec_job*>::iterator i = vspec_jobs.begin(); i != vspec_jobs.end(); i++)
+	{
+		if (!(*i)->ok)
+		{
+			rv = false;
+		}
+		else if ((*i)->vspec != NULL)
+		{
+			snapshot->vspecs[silvia_scheme_snapshot::spec_key((*i)->issuer_id, (*i)->vspec->get_credential_id())].push_back((*i)->vspec);
+		}
+
+		delete *i;
+	}
+
+	return rv;
+}
+
+bool silvia_scheme_registry::reload()
+{
+	pthread_mutex_lock(&reload_lock);
+
+	silvia_scheme_snapshot* snapshot = new silvia_scheme_snapshot();
+
+	bool rv = scan(snapshot);
+
+	if (rv)
+	{
+		publish(snapshot);
+	}
+	else
+	{
+		// Keep the current snapshot; a partially written file will
+		// trigger another reload once it is complete
+		snapshot->release();
+	}
+
+	pthread_mutex_unlock(&reload_lock);
+
+	return rv;
+}
+
+unsigned long silvia_scheme_registry::get_generation()
+{
+	silvia_scheme_snapshot* snapshot = acquire();
+
+	unsigned long rv = snapshot->get_generation();
+
+	snapshot->release();
+
+	return rv;
+}
+
+const silvia_runtime& silvia_scheme_registry::get_runtime()
+{
+	return runtime;
+}
+
+bool silvia_scheme_registry::start_watching()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if (watching) return true;
+
+	notify_fd = inotify_init();
+
+	if (notify_fd < 0) return false;
+
+	if (pipe(stop_pipe) != 0)
+	{
+		close(notify_fd);
+		notify_fd = -1;
+
+		return false;
+	}
+
+	// Load the directory again to set up the watches
+	reload();
+
+	watching = true;
+
+	pthread_create(&watcher, NULL, watcher_main, this);
+
+	return true;
+#else
+	return false;
+#endif // HAVE_SYS_INOTIFY_H
+}
+
+void silvia_scheme_registry::stop_watching()
+{
+	if (!watching) return;
+
+	char stop = 0;
+
+	if (write(stop_pipe[1], &stop, 1) == 1)
+	{
+		pthread_join(watcher, NULL);
+	}
+
+	close(stop_pipe[0]);
+	close(stop_pipe[1]);
+	stop_pipe[0] = stop_pipe[1] = -1;
+
+	pthread_mutex_lock(&reload_lock);
+
+	close(notify_fd);
+	notify_fd = -1;
+
+	pthread_mutex_unlock(&reload_lock);
+
+	watching = false;
+}
+
+/*static*/ void* silvia_scheme_registry::watcher_main(void* registry)
+{
+	((silvia_scheme_registry*) registry)->watcher_loop();
+
+	return NULL;
+}
+
+void silvia_scheme_registry::watcher_loop()
+{
+	char events[4096];
+
+	while (true)
+	{
+		struct pollfd fds[2];
+
+		fds[0].fd = notify_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = stop_pipe[0];
+		fds[1].events = POLLIN;
+
+		if (poll(fds, 2, -1) < 0) continue;
+
+		if (fds[1].revents != 0) return;
+
+		if ((fds[0].revents & POLLIN) == 0) continue;
+
+		// Wait for the changes to settle, so a key rotation that
+		// touches several files results in a single reload
+		do
+		{
+			if (read(notify_fd, events, sizeof(events)) <= 0) break;
+
+			fds[0].revents = 0;
+		}
+		while ((poll(fds, 2, SCHEME_SETTLE_MS) > 0) && ((fds[0].revents & POLLIN) != 0) && (fds[1].revents == 0));
+
+		if (fds[1].revents != 0) return;
+
+		reload();
+	}
+}
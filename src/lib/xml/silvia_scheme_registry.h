@@ -0,0 +1,229 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_scheme_registry.h
+
+ Registry of the issuer keys and verifier specifications in a scheme
+ directory, with reloading when the directory changes
+ *****************************************************************************/
+
+#ifndef _SILVIA_SCHEME_REGISTRY_H
+#define _SILVIA_SCHEME_REGISTRY_H
+
+#include <gmpxx.h>
+#include "silvia_types.h"
+#include "silvia_runtime.h"
+#include "silvia_verifier_spec.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <pthread.h>
+
+/**
+ * Snapshot of the contents of a scheme directory. A snapshot cannot
+ * change once it has been published and is reference counted, so a
+ * session can keep using the snapshot it started with after a newer
+ * one has been loaded. The keys and specifications in a snapshot must
+ * only be read.
+ */
+class silvia_scheme_snapshot
+{
+public:
+	/**
+	 * Give up a reference to the snapshot; the snapshot is
+	 * deleted when the last reference is released
+	 */
+	void release();
+
+	/**
+	 * Get the public key of an issuer; the tables of the key have
+	 * been precomputed, so the key can be shared between threads
+	 * @param issuer the issuer ID
+	 * @return the public key or NULL if the issuer is unknown
+	 */
+	silvia_pub_key* get_pubkey(const std::string& issuer);
+
+	/**
+	 * Get the verifier specifications for a credential
+	 * @param issuer the issuer ID
+	 * @param credential_id the credential ID
+	 * @return the verifier specifications (empty if there are none)
+	 */
+	const std::vector<silvia_verifier_specification*>& get_verifier_specs(const std::string& issuer, unsigned short credential_id);
+
+	/**
+	 * Get the IDs of the issuers that have a public key
+	 * @return the issuer IDs
+	 */
+	std::vector<std::string> get_issuers();
+
+	/**
+	 * Get the number of the reload that created the snapshot
+	 * @return the generation of the snapshot (0 if nothing was loaded)
+	 */
+	unsigned long get_generation();
+
+private:
+	friend class silvia_scheme_registry;
+
+	// Snapshots are only created and deleted by the registry
+	silvia_scheme_snapshot();
+	~silvia_scheme_snapshot();
+
+	// Prevent copying
+	silvia_scheme_snapshot(const silvia_scheme_snapshot&);
+	silvia_scheme_snapshot& operator=(const silvia_scheme_snapshot&);
+
+	// Take a reference
+	void add_ref();
+
+	// The contents
+	typedef std::pair<std::string, unsigned short> spec_key;
+
+	std::map<std::string, silvia_pub_key*> pubkeys;
+	std::map<spec_key, std::vector<silvia_verifier_specification*> > vspecs;
+	std::vector<silvia_verifier_specification*> no_vspecs;
+
+	unsigned long generation;
+	volatile int refs;
+};
+
+/**
+ * Scheme registry class; loads a scheme directory laid out like the IRMA
+ * configuration:
+ *
+ *   <issuer>/ipk.xml                              issuer public key
+ *   <issuer>/Issues/<credential>/description.xml  issuer specification
+ *   <verifier>/Verifies/<name>/description.xml    verifier specification
+ *
+ * Readers get the current snapshot without taking a lock; a reload builds
+ * a new snapshot and publishes it, after which the previous snapshot is
+ * deleted as soon as the last session using it releases it.
+ */
+class silvia_scheme_registry
+{
+public:
+	/**
+	 * Constructor
+	 * @param scheme_dir the scheme directory
+	 * @param runtime the runtime context the keys are used with; if NULL, a context with the current system parameters is used
+	 */
+	silvia_scheme_registry(const std::string scheme_dir, const silvia_runtime* runtime = NULL);
+
+	/**
+	 * Destructor
+	 */
+	~silvia_scheme_registry();
+
+	/**
+	 * Load the scheme directory and publish it as the current snapshot;
+	 * if a file in the directory cannot be read, the current snapshot
+	 * is kept
+	 * @return true if a new snapshot was published
+	 */
+	bool reload();
+
+	/**
+	 * Get the current snapshot; the caller must release it
+	 * @return the current snapshot
+	 */
+	silvia_scheme_snapshot* acquire();
+
+	/**
+	 * Reload the scheme directory in a background thread whenever
+	 * its contents change
+	 * @return true if watching started, false if it is not supported
+	 */
+	bool start_watching();
+
+	/**
+	 * Stop watching the scheme directory
+	 */
+	void stop_watching();
+
+	/**
+	 * Get the runtime context the tables of the keys were built for;
+	 * sessions using the keys should use the same context
+	 * @return the runtime context
+	 */
+	const silvia_runtime& get_runtime();
+
+	/**
+	 * Get the generation of the current snapshot
+	 * @return the number of snapshots that have been published
+	 */
+	unsigned long get_generation();
+
+private:
+	// Prevent copying
+	silvia_scheme_registry(const silvia_scheme_registry&);
+	silvia_scheme_registry& operator=(const silvia_scheme_registry&);
+
+	// Jobs that read the files of the scheme in parallel
+	class read_pubkey_job;
+	class read_vspec_job;
+
+	// Scan the scheme directory into a snapshot
+	bool scan(silvia_scheme_snapshot* snapshot);
+
+	// Watch a directory for changes
+	void watch(const std::string& dir);
+
+	// Replace the current snapshot
+	void publish(silvia_scheme_snapshot* snapshot);
+
+	// Watcher thread
+	static void* watcher_main(void* registry);
+	void watcher_loop();
+
+	// The scheme directory
+	std::string scheme_dir;
+
+	// The runtime context
+	silvia_runtime runtime;
+
+	// The current snapshot; readers that are taking a reference to it
+	// are pinned to the epoch in which they read the pointer, and a
+	// publication only waits for the readers of the previous epoch
+	silvia_scheme_snapshot* volatile current;
+	volatile unsigned long epoch;
+	volatile int pins[2];
+
+	// Serialises reloads
+	pthread_mutex_t reload_lock;
+	unsigned long generation;
+
+	// Watching
+	bool watching;
+	int notify_fd;
+	int stop_pipe[2];
+	pthread_t watcher;
+};
+
+#endif // !_SILVIA_SCHEME_REGISTRY_H
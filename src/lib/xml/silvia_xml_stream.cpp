@@ -0,0 +1,227 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_xml_stream.cpp
+
+ Forward-only XML reader used by the Idemix and IRMA readers; parses a file
+ in a single pass without building a document tree
+ *****************************************************************************/
+
+#include "config.h"
+#include "silvia_xml_stream.h"
+#include "silvia_macros.h"
+#include <gmpxx.h>
+#include <string>
+#include <libxml/xmlreader.h>
+
+silvia_xml_stream::silvia_xml_stream()
+{
+	reader = NULL;
+	pending = false;
+	error = false;
+}
+
+silvia_xml_stream::~silvia_xml_stream()
+{
+	if (reader != NULL)
+	{
+		xmlFreeTextReader(reader);
+	}
+}
+
+bool silvia_xml_stream::open(const std::string& file_name)
+{
+	if (reader != NULL)
+	{
+		xmlFreeTextReader(reader);
+	}
+
+	pending = false;
+	error = false;
+
+	reader = xmlReaderForFile(file_name.c_str(), NULL, 0);
+
+	return (reader != NULL);
+}
+
+bool silvia_xml_stream::read()
+{
+	if ((reader == NULL) || error)
+	{
+		return false;
+	}
+
+	int rv = xmlTextReaderRead(reader);
+
+	if (rv < 0)
+	{
+		// error printed to stderr by libxml2
+		error = true;
+	}
+
+	return (rv == 1);
+}
+
+bool silvia_xml_stream::next_element(int parent_depth /* = -1 */)
+{
+	if (pending)
+	{
+		if (depth() <= parent_depth)
+		{
+			return false;
+		}
+
+		pending = false;
+
+		return true;
+	}
+
+	while (read())
+	{
+		int type = xmlTextReaderNodeType(reader);
+
+		if (type == XML_READER_TYPE_ELEMENT)
+		{
+			if (depth() <= parent_depth)
+			{
+				// This element follows the enclosing element; keep
+				// it for the caller at the level above
+				pending = true;
+
+				return false;
+			}
+
+			return true;
+		}
+		else if ((type == XML_READER_TYPE_END_ELEMENT) && (depth() <= parent_depth))
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+bool silvia_xml_stream::is(const char* name)
+{
+	const xmlChar* local_name = xmlTextReaderConstLocalName(reader);
+
+	return (local_name != NULL) && (xmlStrcasecmp(local_name, (const xmlChar*) name) == 0);
+}
+
+std::string silvia_xml_stream::name()
+{
+	const xmlChar* local_name = xmlTextReaderConstLocalName(reader);
+
+	return (local_name == NULL) ? std::string() : std::string((const char*) local_name);
+}
+
+int silvia_xml_stream::depth()
+{
+	return xmlTextReaderDepth(reader);
+}
+
+bool silvia_xml_stream::read_text(std::string& text)
+{
+	text.clear();
+
+	if (xmlTextReaderIsEmptyElement(reader) == 1)
+	{
+		return false;
+	}
+
+	int element_depth = depth();
+	bool has_text = false;
+
+	while (read())
+	{
+		int type = xmlTextReaderNodeType(reader);
+
+		if ((type == XML_READER_TYPE_END_ELEMENT) && (depth() == element_depth))
+		{
+			return has_text;
+		}
+
+		// Only direct text content counts, as with xmlNodeListGetString
+		if ((depth() == element_depth + 1) &&
+		    ((type == XML_READER_TYPE_TEXT) ||
+		     (type == XML_READER_TYPE_CDATA) ||
+		     (type == XML_READER_TYPE_WHITESPACE) ||
+		     (type == XML_READER_TYPE_SIGNIFICANT_WHITESPACE)))
+		{
+			const xmlChar* value = xmlTextReaderConstValue(reader);
+
+			if (value != NULL)
+			{
+				text += (const char*) value;
+				has_text = true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool silvia_xml_stream::read_mpz(mpz_class& value)
+{
+	std::string text;
+
+	if (!read_text(text))
+	{
+		return false;
+	}
+
+	// Unlike the mpz_class constructor, this does not throw on bad input
+	return (mpz_set_str(_Z(value), text.c_str(), 0) == 0);
+}
+
+bool silvia_xml_stream::get_attribute(const char* name, std::string& value)
+{
+	xmlChar* attr_value = xmlTextReaderGetAttribute(reader, (const xmlChar*) name);
+
+	if (attr_value == NULL)
+	{
+		return false;
+	}
+
+	value = std::string((const char*) attr_value);
+
+	xmlFree(attr_value);
+
+	return true;
+}
+
+bool silvia_xml_stream::finish()
+{
+	pending = false;
+
+	while (read());
+
+	return (reader != NULL) && !error;
+}
@@ -0,0 +1,141 @@
+/* $Id$ */
+
+/*
+ * Copyright (c) 2013 Roland van Rijswijk-Deij
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*****************************************************************************
+ silvia_xml_stream.h
+
+ Forward-only XML reader used by the Idemix and IRMA readers; parses a file
+ in a single pass without building a document tree
+ *****************************************************************************/
+
+#ifndef _SILVIA_XML_STREAM_H
+#define _SILVIA_XML_STREAM_H
+
+#include <gmpxx.h>
+#include <string>
+#include <libxml/xmlreader.h>
+
+/**
+ * Streaming XML reader class
+ */
+class silvia_xml_stream
+{
+public:
+	/**
+	 * Constructor
+	 */
+	silvia_xml_stream();
+
+	/**
+	 * Destructor
+	 */
+	~silvia_xml_stream();
+
+	/**
+	 * Open an XML file
+	 * @param file_name the name of the XML file
+	 * @return true if the file was opened
+	 */
+	bool open(const std::string& file_name);
+
+	/**
+	 * Move to the start of the next element below the element at the
+	 * specified depth; the root element has depth 0
+	 * @param parent_depth the depth of the enclosing element, or -1 for the whole document
+	 * @return true if an element was found, false at the end of the enclosing element
+	 */
+	bool next_element(int parent_depth = -1);
+
+	/**
+	 * Check the (local) name of the current element; case insensitive
+	 * @param name the name to compare to
+	 * @return true if the name of the current element matches
+	 */
+	bool is(const char* name);
+
+	/**
+	 * Get the (local) name of the current element
+	 * @return the name of the current element
+	 */
+	std::string name();
+
+	/**
+	 * Get the depth of the current element
+	 * @return the depth of the current element
+	 */
+	int depth();
+
+	/**
+	 * Read the text content of the current element and move to its end
+	 * @param text receives the text content
+	 * @return true if the element has text content
+	 */
+	bool read_text(std::string& text);
+
+	/**
+	 * Read the text content of the current element as a number and
+	 * move to its end
+	 * @param value receives the number
+	 * @return true if the element has text content that is a number
+	 */
+	bool read_mpz(mpz_class& value);
+
+	/**
+	 * Get an attribute of the current element
+	 * @param name the name of the attribute
+	 * @param value receives the value of the attribute
+	 * @return true if the attribute is present
+	 */
+	bool get_attribute(const char* name, std::string& value);
+
+	/**
+	 * Read to the end of the document
+	 * @return true if the whole document is well-formed
+	 */
+	bool finish();
+
+private:
+	// Copying is not allowed
+	silvia_xml_stream(const silvia_xml_stream&);
+	silvia_xml_stream& operator=(const silvia_xml_stream&);
+
+	// Read the next node
+	bool read();
+
+	// The libxml2 reader
+	xmlTextReaderPtr reader;
+
+	// Set when the last node read was an element that is not part
+	// of the element the caller iterated over
+	bool pending;
+
+	// Set when a parse error occurred
+	bool error;
+};
+
+#endif // !_SILVIA_XML_STREAM_H
@@ -41,9 +41,15 @@
 #include "silvia_macros.h"
 #include "silvia_idemix_xmlreader.h"
 #include "silvia_irma_xmlreader.h"
+#include "silvia_scheme_registry.h"
 #include "silvia_bytestring.h"
+#include "silvia_thread_pool.h"
 #include <stdio.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
 
 CPPUNIT_TEST_SUITE_REGISTRATION(xml_tests);
 
@@ -53,6 +59,45 @@ std::string xml_tests::getDir() const
     return val == NULL ? std::string("./") : std::string(val) + "/";
 }
 
+// Copy a file into the test scheme directory
+static void copy_file(const std::string& from, const std::string& to)
+{
+	std::ifstream in(from.c_str(), std::ios::binary);
+	std::ofstream out(to.c_str(), std::ios::binary);
+
+	out << in.rdbuf();
+}
+
+// Build a scheme directory with a single issuer and a single verifier
+static std::string make_scheme(const std::string& src_dir)
+{
+	char scheme_dir[] = "/tmp/silvia_schemeXXXXXX";
+
+	CPPUNIT_ASSERT(mkdtemp(scheme_dir) != NULL);
+
+	std::string dir(scheme_dir);
+
+	mkdir((dir + "/MijnOverheid").c_str(), 0700);
+	mkdir((dir + "/MijnOverheid/Issues").c_str(), 0700);
+	mkdir((dir + "/MijnOverheid/Issues/ageLower").c_str(), 0700);
+	mkdir((dir + "/Bar").c_str(), 0700);
+	mkdir((dir + "/Bar/Verifies").c_str(), 0700);
+	mkdir((dir + "/Bar/Verifies/over18").c_str(), 0700);
+
+	copy_file(src_dir + "ipk.xml", dir + "/MijnOverheid/ipk.xml");
+	copy_file(src_dir + "id_agelower.xml", dir + "/MijnOverheid/Issues/ageLower/description.xml");
+	copy_file(src_dir + "vd_bar.xml", dir + "/Bar/Verifies/over18/description.xml");
+
+	return dir;
+}
+
+static void remove_scheme(const std::string& dir)
+{
+	std::string cmd = "rm -rf " + dir;
+
+	CPPUNIT_ASSERT(system(cmd.c_str()) == 0);
+}
+
 void xml_tests::setUp()
 {
 }
@@ -150,3 +195,337 @@ void xml_tests::test_irma_read_issue_spec()
 	delete spec;
 }
 
+
+// Write a file with the specified contents
+static void write_file(const std::string& file_name, const std::string& contents)
+{
+	std::ofstream out(file_name.c_str(), std::ios::binary);
+
+	out << contents;
+}
+
+static std::string read_file(const std::string& file_name)
+{
+	std::ifstream in(file_name.c_str(), std::ios::binary);
+	std::stringstream contents;
+
+	contents << in.rdbuf();
+
+	return contents.str();
+}
+
+void xml_tests::test_malformed_files()
+{
+	std::string ipk = read_file(getDir() + "ipk.xml");
+	std::string tmp_file = "xmltest_malformed.xml";
+
+	// Truncated files are rejected
+	write_file(tmp_file, ipk.substr(0, ipk.size() / 2));
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	write_file(tmp_file, ipk.substr(0, ipk.size() - 5));
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	// A missing base is rejected
+	std::string missing_base = ipk;
+	size_t base_start = missing_base.find("<Base_3>");
+	size_t base_end = missing_base.find("</Base_3>");
+
+	CPPUNIT_ASSERT((base_start != std::string::npos) && (base_end != std::string::npos));
+
+	missing_base.erase(base_start, base_end + 9 - base_start);
+
+	write_file(tmp_file, missing_base);
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	// The order of the bases does not matter
+	std::string base_3 = ipk.substr(base_start, base_end + 9 - base_start);
+	std::string reordered = missing_base;
+
+	reordered.insert(reordered.find("<Base_0>"), base_3);
+
+	write_file(tmp_file, reordered);
+
+	silvia_pub_key* pub_key = silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file);
+	silvia_pub_key* ref_key = silvia_idemix_xmlreader::i()->read_idemix_pubkey(getDir() + "ipk.xml");
+
+	CPPUNIT_ASSERT(pub_key != NULL);
+	CPPUNIT_ASSERT(ref_key != NULL);
+	CPPUNIT_ASSERT(pub_key->get_R() == ref_key->get_R());
+
+	delete pub_key;
+	delete ref_key;
+
+	// Values that are not numbers are rejected
+	std::string bad_S = ipk;
+
+	bad_S.insert(bad_S.find("<S>") + 3, "x");
+
+	write_file(tmp_file, bad_S);
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	std::string bad_base = ipk;
+
+	bad_base.insert(bad_base.find("<Base_3>") + 8, "not a number");
+
+	write_file(tmp_file, bad_base);
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	// Negative and absurd numbers of bases are rejected
+	std::string bad_num = ipk;
+
+	bad_num.replace(bad_num.find("num=\"10\""), 8, "num=\"-1\"");
+
+	write_file(tmp_file, bad_num);
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	bad_num = ipk;
+	bad_num.replace(bad_num.find("num=\"10\""), 8, "num=\"1000000000\"");
+
+	write_file(tmp_file, bad_num);
+
+	CPPUNIT_ASSERT(silvia_idemix_xmlreader::i()->read_idemix_pubkey(tmp_file) == NULL);
+
+	// A verifier description without AttributeModes is rejected
+	std::string vd = read_file(getDir() + "vd_bar.xml");
+
+	vd.erase(vd.find("<AttributeModes>"), vd.find("</AttributeModes>") + 17 - vd.find("<AttributeModes>"));
+
+	write_file(tmp_file, vd);
+
+	CPPUNIT_ASSERT(silvia_irma_xmlreader::i()->read_verifier_spec(getDir() + "id_agelower.xml", tmp_file) == NULL);
+
+	// An issue specification with an untyped attribute is rejected
+	std::string credspec = read_file(getDir() + "credspec.xml");
+
+	credspec.replace(credspec.find(" type=\"string\""), 14, "");
+
+	write_file(tmp_file, credspec);
+
+	CPPUNIT_ASSERT(silvia_irma_xmlreader::i()->read_issue_spec(tmp_file) == NULL);
+
+	// An integer attribute that is not a number is rejected
+	credspec = read_file(getDir() + "credspec.xml");
+
+	credspec.replace(credspec.find("type=\"string\""), 13, "type=\"int\"");
+
+	write_file(tmp_file, credspec);
+
+	CPPUNIT_ASSERT(silvia_irma_xmlreader::i()->read_issue_spec(tmp_file) == NULL);
+
+	remove(tmp_file.c_str());
+}
+
+/**
+ * Job that reads all test files
+ */
+class read_files_job : public silvia_job
+{
+public:
+	read_files_job(const std::string& dir)
+	{
+		this->dir = dir;
+
+		ok = false;
+	}
+
+	virtual void run()
+	{
+		silvia_pub_key* pub_key = silvia_idemix_xmlreader::i()->read_idemix_pubkey(dir + "ipk.xml");
+		silvia_priv_key* priv_key = silvia_idemix_xmlreader::i()->read_idemix_privkey(dir + "isk.xml");
+		silvia_verifier_specification* vspec = silvia_irma_xmlreader::i()->read_verifier_spec(dir + "id_agelower.xml", dir + "vd_bar.xml");
+		silvia_issue_specification* ispec = silvia_irma_xmlreader::i()->read_issue_spec(dir + "credspec.xml");
+
+		ok = (pub_key != NULL) && (pub_key->get_R().size() == 10) &&
+		     (priv_key != NULL) &&
+		     (vspec != NULL) && (vspec->get_verifier_id() == 801) &&
+		     (ispec != NULL) && (ispec->get_attributes().size() == 4);
+
+		delete pub_key;
+		delete priv_key;
+		delete vspec;
+		delete ispec;
+	}
+
+	std::string dir;
+	bool ok;
+};
+
+void xml_tests::test_parallel_read()
+{
+	silvia_thread_pool pool(4);
+	std::vector<read_files_job*> jobs;
+
+	for (int i = 0; i < 32; i++)
+	{
+		jobs.push_back(new read_files_job(getDir()));
+
+		pool.submit(jobs.back());
+	}
+
+	pool.wait();
+
+	for (std::vector<read_files_job*>::iterator i = jobs.begin(); i != jobs.end(); i++)
+	{
+		CPPUNIT_ASSERT((*i)->ok);
+
+		delete *i;
+	}
+}
+
+void xml_tests::test_scheme_registry()
+{
+	std::string dir = make_scheme(getDir());
+
+	silvia_scheme_registry registry(dir);
+
+	CPPUNIT_ASSERT(registry.get_generation() == 0);
+	CPPUNIT_ASSERT(registry.reload());
+	CPPUNIT_ASSERT(registry.get_generation() == 1);
+
+	silvia_scheme_snapshot* snapshot = registry.acquire();
+
+	CPPUNIT_ASSERT(snapshot->get_issuers().size() == 1);
+	CPPUNIT_ASSERT(snapshot->get_pubkey("MijnOverheid") != NULL);
+	CPPUNIT_ASSERT(snapshot->get_pubkey("Bar") == NULL);
+
+	const std::vector<silvia_verifier_specification*>& vspecs = snapshot->get_verifier_specs("MijnOverheid", 10);
+
+	CPPUNIT_ASSERT(vspecs.size() == 1);
+	CPPUNIT_ASSERT(vspecs[0]->get_verifier_name() == "Bar");
+	CPPUNIT_ASSERT(vspecs[0]->get_verifier_id() == 801);
+
+	CPPUNIT_ASSERT(snapshot->get_verifier_specs("MijnOverheid", 11).empty());
+
+	snapshot->release();
+
+	// A broken key must not replace the loaded scheme
+	{
+		std::ofstream out((dir + "/MijnOverheid/ipk.xml").c_str());
+
+		out << "<IssuerPublicKey>";
+	}
+
+	CPPUNIT_ASSERT(!registry.reload());
+	CPPUNIT_ASSERT(registry.get_generation() == 1);
+
+	snapshot = registry.acquire();
+
+	CPPUNIT_ASSERT(snapshot->get_pubkey("MijnOverheid") != NULL);
+
+	snapshot->release();
+
+	remove_scheme(dir);
+}
+
+void xml_tests::test_scheme_snapshot_lifetime()
+{
+	std::string dir = make_scheme(getDir());
+
+	silvia_scheme_registry registry(dir);
+
+	CPPUNIT_ASSERT(registry.reload());
+
+	silvia_scheme_snapshot* old_snapshot = registry.acquire();
+
+	// Remove the verifier and reload; the old snapshot is unaffected
+	remove((dir + "/Bar/Verifies/over18/description.xml").c_str());
+
+	CPPUNIT_ASSERT(registry.reload());
+	CPPUNIT_ASSERT(registry.get_generation() == 2);
+
+	silvia_scheme_snapshot* new_snapshot = registry.acquire();
+
+	CPPUNIT_ASSERT(new_snapshot->get_verifier_specs("MijnOverheid", 10).empty());
+	CPPUNIT_ASSERT(old_snapshot->get_verifier_specs("MijnOverheid", 10).size() == 1);
+	CPPUNIT_ASSERT(old_snapshot->get_verifier_specs("MijnOverheid", 10)[0]->get_verifier_id() == 801);
+	CPPUNIT_ASSERT(old_snapshot->get_generation() == 1);
+
+	new_snapshot->release();
+	old_snapshot->release();
+
+	remove_scheme(dir);
+}
+
+void xml_tests::test_scheme_hot_reload()
+{
+	std::string dir = make_scheme(getDir());
+
+	silvia_scheme_registry registry(dir);
+
+	if (!registry.start_watching())
+	{
+		// Not supported on this platform
+		remove_scheme(dir);
+
+		return;
+	}
+
+	unsigned long generation = registry.get_generation();
+
+	CPPUNIT_ASSERT(generation > 0);
+
+	// Add a second verifier
+	mkdir((dir + "/Shop").c_str(), 0700);
+	mkdir((dir + "/Shop/Verifies").c_str(), 0700);
+	mkdir((dir + "/Shop/Verifies/over18").c_str(), 0700);
+	copy_file(getDir() + "vd_bar.xml", dir + "/Shop/Verifies/over18/description.xml");
+
+	// Wait for the watcher to pick up the new verifier
+	size_t found = 0;
+
+	for (int i = 0; (i < 100) && (found != 2); i++)
+	{
+		usleep(50000);
+
+		silvia_scheme_snapshot* snapshot = registry.acquire();
+
+		found = snapshot->get_verifier_specs("MijnOverheid", 10).size();
+
+		snapshot->release();
+	}
+
+	CPPUNIT_ASSERT(found == 2);
+	CPPUNIT_ASSERT(registry.get_generation() > generation);
+
+	// Saving a key with a base that is not a number fails the reload
+	// and keeps the current snapshot published
+	generation = registry.get_generation();
+
+	std::string ipk = read_file(getDir() + "ipk.xml");
+
+	ipk.insert(ipk.find("<Base_3>") + 8, "not a number");
+
+	write_file(dir + "/MijnOverheid/ipk.xml", ipk);
+
+	usleep(1000000);
+
+	CPPUNIT_ASSERT(registry.get_generation() == generation);
+
+	silvia_scheme_snapshot* snapshot = registry.acquire();
+
+	CPPUNIT_ASSERT(snapshot->get_pubkey("MijnOverheid") != NULL);
+	CPPUNIT_ASSERT(snapshot->get_verifier_specs("MijnOverheid", 10).size() == 2);
+
+	snapshot->release();
+
+	// The watcher keeps running and picks up the repaired key
+	copy_file(getDir() + "ipk.xml", dir + "/MijnOverheid/ipk.xml");
+
+	for (int i = 0; (i < 100) && (registry.get_generation() == generation); i++)
+	{
+		usleep(50000);
+	}
+
+	CPPUNIT_ASSERT(registry.get_generation() > generation);
+
+	registry.stop_watching();
+
+	remove_scheme(dir);
+}
@@ -44,6 +44,11 @@ class xml_tests : public CppUnit::TestFixture
 	CPPUNIT_TEST(test_idemix_read_privkey);
 	CPPUNIT_TEST(test_irma_read_verifier_spec);
 	CPPUNIT_TEST(test_irma_read_issue_spec);
+	CPPUNIT_TEST(test_malformed_files);
+	CPPUNIT_TEST(test_parallel_read);
+	CPPUNIT_TEST(test_scheme_registry);
+	CPPUNIT_TEST(test_scheme_snapshot_lifetime);
+	CPPUNIT_TEST(test_scheme_hot_reload);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -51,6 +56,11 @@ public:
 	void test_idemix_read_privkey();
 	void test_irma_read_verifier_spec();
 	void test_irma_read_issue_spec();
+	void test_malformed_files();
+	void test_parallel_read();
+	void test_scheme_registry();
+	void test_scheme_snapshot_lifetime();
+	void test_scheme_hot_reload();
 
 	void setUp();
 	void tearDown();